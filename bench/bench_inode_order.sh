@@ -0,0 +1,152 @@
+#!/bin/sh
+#***********************************
+#
+# File name: bench/bench_inode_order.sh
+#
+# Aim: Compare the wall time of listing a
+#      directory on a cold cache with entries
+#      looked up in directory order (the
+#      default) and in inode order
+#      (--inode-order)
+#
+#      The directory lives on a freshly made
+#      ext4 image attached to a loop device with
+#      direct I/O, so that reads go to the
+#      backing store rather than the page cache
+#      of the image file. Before every run the
+#      caches are dropped and the file system is
+#      mounted again
+#
+# Usage: sudo bench/bench_inode_order.sh
+#             [NUM_FILES] [NUM_RUNS]
+#
+#        MYLS=path/to/myls selects the binary
+#        (default ./myls)
+#
+#***********************************
+
+set -eu
+
+NUM_FILES=${1:-200000}
+NUM_RUNS=${2:-5}
+MYLS=${MYLS:-./myls}
+
+
+if [ "$(id -u)" -ne 0 ]
+then
+	echo "bench_inode_order.sh: must be run as root" >&2
+	exit 1
+fi
+
+if [ ! -x "$MYLS" ]
+then
+	echo "bench_inode_order.sh: '$MYLS' not found, build it" \
+	     "first or set MYLS" >&2
+	exit 1
+fi
+
+MYLS=$(cd "$(dirname "$MYLS")" && pwd)/$(basename "$MYLS")
+
+
+
+#=== SECTION 1: Making the image and the files ===
+
+WORK_DIR=$(mktemp -d /tmp/bench_inode_order.XXXXXX)
+IMAGE="$WORK_DIR/image.ext4"
+MOUNT_POINT="$WORK_DIR/mnt"
+LOOP_DEVICE=""
+
+cleanup()
+{
+	umount "$MOUNT_POINT" 2>/dev/null || true
+
+	if [ -n "$LOOP_DEVICE" ]
+	then
+		losetup -d "$LOOP_DEVICE" 2>/dev/null || true
+	fi
+
+	rm -rf "$WORK_DIR"
+}
+
+trap cleanup EXIT INT TERM
+
+
+mkdir "$MOUNT_POINT"
+
+# About 4 KiB per file leaves room for the
+# inode table and the directory itself
+truncate -s $((NUM_FILES * 4096 + 64 * 1024 * 1024)) "$IMAGE"
+
+mkfs.ext4 -q -F -N $((NUM_FILES + 1024)) \
+	  -E lazy_itable_init=0,lazy_journal_init=0 "$IMAGE"
+
+LOOP_DEVICE=$(losetup --find --show --direct-io=on "$IMAGE" \
+	      2>/dev/null || losetup --find --show "$IMAGE")
+
+mount "$LOOP_DEVICE" "$MOUNT_POINT"
+
+mkdir "$MOUNT_POINT/files"
+
+# ext4 returns entries in hash order while
+# inodes are allocated in creation order, so
+# directory order is far from inode order
+(cd "$MOUNT_POINT/files" && seq -f 'file%.0f' 1 "$NUM_FILES" \
+	| xargs touch)
+
+sync
+
+
+
+#=== SECTION 2: Timing cold listings ===
+
+# Dropping the caches is not always permitted
+# (e.g. in a container), but mounting the file
+# system again always frees its inode cache
+dropCaches()
+{
+	sync
+
+	echo 3 > /proc/sys/vm/drop_caches 2>/dev/null || true
+
+	umount "$MOUNT_POINT"
+
+	mount "$LOOP_DEVICE" "$MOUNT_POINT"
+}
+
+# Prints the wall time of one cold listing in
+# milliseconds
+timeListing()
+{
+	dropCaches
+
+	startTime=$(date +%s%N)
+
+	"$MYLS" --dir="$MOUNT_POINT/files" "$@" > /dev/null
+
+	endTime=$(date +%s%N)
+
+	echo $(((endTime - startTime) / 1000000))
+}
+
+
+echo "files: $NUM_FILES, runs: $NUM_RUNS"
+
+totalDirOrder=0
+totalInodeOrder=0
+run=1
+
+while [ "$run" -le "$NUM_RUNS" ]
+do
+	dirOrderTime=$(timeListing)
+	inodeOrderTime=$(timeListing --inode-order)
+
+	echo "run $run: directory order ${dirOrderTime} ms," \
+	     "inode order ${inodeOrderTime} ms"
+
+	totalDirOrder=$((totalDirOrder + dirOrderTime))
+	totalInodeOrder=$((totalInodeOrder + inodeOrderTime))
+	run=$((run + 1))
+done
+
+echo "mean: directory order $((totalDirOrder / NUM_RUNS)) ms," \
+     "inode order $((totalInodeOrder / NUM_RUNS)) ms"
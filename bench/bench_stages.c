@@ -0,0 +1,727 @@
+/***********************************
+*
+* File name: bench/bench_stages.c
+*
+* Aim: Time each stage of a listing on its own
+*      (reading the directories, looking up the
+*      metadata, resolving user and group names,
+*      formatting the records and writing them
+*      out) and report the entries per second
+*      and system calls per entry of each, so a
+*      regression can be traced to its stage
+*
+*      The stages are run one after the other
+*      over the whole tree, with the same
+*      functions displayCurrDirFilesInfo() and
+*      displayCurrFileInfo() use
+*
+* Build: gcc -O2 -pthread -o bench_stages bench/bench_stages.c
+*
+* Usage: ./bench_stages [--format=text|jsonl|bin]
+*			[--fields=LIST] [--output=FILE]
+*			DIR
+*
+*	 Every directory below DIR is included.
+*	 Output goes to FILE, by default
+*	 /dev/null
+*
+***********************************/
+
+
+#define _GNU_SOURCE
+
+
+//The headers whose calls are counted, included
+// before the counting macros so that their
+// declarations are left alone
+#include <dirent.h>
+
+#include <fcntl.h>
+
+#include <grp.h>
+
+#include <pwd.h>
+
+#include <sys/stat.h>
+
+#include <sys/uio.h>
+
+#include <unistd.h>
+
+
+
+
+	/*------------------------------------------------
+	 Every system call myls makes on the stages
+	 measured here goes through one of these, which
+	 count it before making it. getpwuid_r() and
+	 getgrgid_r() count as one call each, though
+	 the NSS modules behind them may make several
+	------------------------------------------------*/
+static unsigned long numSyscalls = 0;
+
+#define getdents64(...) (numSyscalls++, getdents64(__VA_ARGS__))
+#define statx(...)      (numSyscalls++, statx(__VA_ARGS__))
+#define fstatat(...)    (numSyscalls++, fstatat(__VA_ARGS__))
+#define open(...)       (numSyscalls++, open(__VA_ARGS__))
+#define openat(...)     (numSyscalls++, openat(__VA_ARGS__))
+#define close(...)      (numSyscalls++, close(__VA_ARGS__))
+#define write(...)      (numSyscalls++, write(__VA_ARGS__))
+#define writev(...)     (numSyscalls++, writev(__VA_ARGS__))
+#define getpwuid_r(...) (numSyscalls++, getpwuid_r(__VA_ARGS__))
+#define getgrgid_r(...) (numSyscalls++, getgrgid_r(__VA_ARGS__))
+
+
+//Only the functions of myls are needed
+#define MYLS_NO_MAIN
+
+#include "../myls.c"
+
+
+
+
+	/*------------------------------------------------
+	 The stages, in the order they run
+	------------------------------------------------*/
+enum BenchStage
+{
+	STAGE_ENUMERATE,
+	STAGE_STAT,
+	STAGE_NAMES,
+	STAGE_FORMAT,
+	STAGE_OUTPUT,
+	NUM_BENCH_STAGES
+};
+
+
+static const char * const stageNames[NUM_BENCH_STAGES] =
+{
+	"enumerate", "stat", "names", "format", "output"
+};
+
+
+	/*------------------------------------------------
+	 A directory of the tree, whose entries are the
+	 'numRecords' records from 'firstRecord' of the
+	 shared record array
+	------------------------------------------------*/
+struct BenchDir
+{
+	char * path;
+
+	size_t firstRecord;
+
+	size_t numRecords;
+};
+
+
+	/*------------------------------------------------
+	 The tree as read by the first stage, and the
+	 time and system calls of every stage
+	------------------------------------------------*/
+struct BenchTree
+{
+	struct BenchDir * dirs;
+
+	size_t numDirs;
+
+	size_t dirsCapacity;
+
+	struct EntryRecordArray records;
+
+	unsigned long long stageNanoseconds[NUM_BENCH_STAGES];
+
+	unsigned long stageSyscalls[NUM_BENCH_STAGES];
+};
+
+
+
+
+	/*------------------------------------------------
+	 Brief: Returns the current time of the
+		monotonic clock in nanoseconds
+	------------------------------------------------*/
+unsigned long long getMonotonicNanoseconds();
+
+
+	/*------------------------------------------------
+	 Brief: Appends the directory 'dirPath' to the
+		directories of 'tree' still to be read
+
+		Returns 0 on success, or -1 if memory ran
+		out
+	------------------------------------------------*/
+int addBenchDir(struct BenchTree * tree, const char * dirPath);
+
+
+	/*------------------------------------------------
+	 Brief: Stage 1. Reads every directory below
+		'rootPath' breadth first, collecting the
+		names of their entries
+
+		Returns 0 on success. On failure, an error
+		message is printed and -1 is returned
+	------------------------------------------------*/
+int enumerateTree(struct BenchTree * tree, const char * rootPath);
+
+
+	/*------------------------------------------------
+	 Brief: Stage 2. Looks up the metadata of every
+		entry, relative to its open directory
+	------------------------------------------------*/
+void statTree(struct BenchTree * tree);
+
+
+	/*------------------------------------------------
+	 Brief: Stage 3. Resolves the owner and group of
+		every entry, filling the name caches
+	------------------------------------------------*/
+void resolveTreeNames(struct BenchTree * tree);
+
+
+	/*------------------------------------------------
+	 Brief: Stage 4. Formats every entry into a
+		memory buffer, which is emptied each time
+		it fills. The first bufferful is kept in
+		'sample' for the output stage
+
+		Returns the number of bytes formatted
+	------------------------------------------------*/
+unsigned long long formatTree(struct BenchTree * tree,
+			      struct OutputBuffer * sample);
+
+
+	/*------------------------------------------------
+	 Brief: Stage 5. Writes 'numBytes' bytes, made
+		of copies of 'sample', to 'outputFd'
+		through an output buffer of the usual size
+	------------------------------------------------*/
+void writeTreeOutput(const struct OutputBuffer * sample,
+		     unsigned long long numBytes, int outputFd);
+
+
+
+
+int main(int argc, char * argv[])
+{
+
+	/*=============================================
+	 SECTION 1: Declaration of variables
+	==============================================*/
+	static const struct option longOptions[] =
+	{
+		{"format", required_argument, NULL, 'T'},
+		{"fields", required_argument, NULL, 'F'},
+		{"output", required_argument, NULL, 'o'},
+		{NULL,     0,                 NULL, 0}
+	};
+
+	static struct BenchTree tree;
+
+	struct OutputBuffer sample = { .outputFd = -1 };
+
+	const char * outputPath = "/dev/null";
+
+	unsigned long long numBytes = 0;
+
+	unsigned long long startTime;
+
+	unsigned long long totalNanoseconds = 0;
+
+	unsigned long totalSyscalls = 0;
+
+	unsigned long syscallsBefore;
+
+	size_t numEntries;
+
+	int outputFd;
+
+	int optionChar;
+
+
+
+	/*=============================================
+	 SECTION 2: Parsing the command line options
+	==============================================*/
+	while ((optionChar = getopt_long(argc, argv, "",
+					 longOptions, NULL)) != -1)
+	{
+		if (optionChar == 'T' && strcmp(optarg, "text") == 0)
+		{
+			listingOptions.outputFormat = FORMAT_TEXT;
+		}
+		else if (optionChar == 'T' && strcmp(optarg, "jsonl") == 0)
+		{
+			listingOptions.outputFormat = FORMAT_JSONL;
+		}
+		else if (optionChar == 'T' && strcmp(optarg, "bin") == 0)
+		{
+			listingOptions.outputFormat = FORMAT_BIN;
+		}
+		else if (optionChar == 'F'
+			 && parseFieldList(optarg,
+					   &listingOptions.outputFields,
+					   &listingOptions.statxMask) == 0)
+		{
+			continue;
+		}
+		else if (optionChar == 'o')
+		{
+			outputPath = optarg;
+		}
+		else
+		{
+			fprintf(stderr,
+				"Usage: bench_stages [--format=text|jsonl|bin]"
+				" [--fields=LIST]\n"
+				"                    [--output=FILE] DIR\n");
+
+			return 1;
+		}
+	}
+
+	if (optind != argc - 1)
+	{
+		fprintf(stderr, "bench_stages: Expected one DIR\n");
+
+		return 1;
+	}
+
+	outputFd = open(outputPath, O_WRONLY | O_CREAT | O_TRUNC
+				    | O_CLOEXEC, 0644);
+
+	if (outputFd == -1)
+	{
+		fprintf(stderr, "bench_stages: Cannot open '%s': %s\n",
+			outputPath, strerror(errno));
+
+		return 1;
+	}
+
+
+
+	/*=============================================
+	 SECTION 3: Running the stages, each timed and
+		    counted on its own
+	==============================================*/
+	for (int stage = 0; stage < NUM_BENCH_STAGES; stage++)
+	{
+		syscallsBefore = numSyscalls;
+
+		startTime = getMonotonicNanoseconds();
+
+		switch (stage)
+		{
+			case STAGE_ENUMERATE:
+				if (enumerateTree(&tree, argv[optind]) == -1)
+				{
+					return 1;
+				}
+
+				break;
+
+			case STAGE_STAT:
+				statTree(&tree);
+
+				break;
+
+			case STAGE_NAMES:
+				resolveTreeNames(&tree);
+
+				break;
+
+			case STAGE_FORMAT:
+				numBytes = formatTree(&tree, &sample);
+
+				break;
+
+			default:
+				writeTreeOutput(&sample, numBytes, outputFd);
+
+				break;
+		}
+
+		tree.stageNanoseconds[stage] =
+			getMonotonicNanoseconds() - startTime;
+
+		tree.stageSyscalls[stage] = numSyscalls - syscallsBefore;
+	}
+
+	close(outputFd);
+
+
+
+	/*=============================================
+	 SECTION 4: Reporting
+	==============================================*/
+	numEntries = tree.records.numRecords;
+
+	printf("directories: %lu\n", (unsigned long) tree.numDirs);
+
+	printf("entries:     %lu\n", (unsigned long) numEntries);
+
+	printf("bytes:       %llu\n\n", numBytes);
+
+	printf("%-10s %12s %14s %15s\n", "stage", "ms",
+	       "entries/sec", "syscalls/entry");
+
+
+	for (int stage = 0; stage <= NUM_BENCH_STAGES; stage++)
+	{
+		unsigned long long nanoseconds = (stage < NUM_BENCH_STAGES)
+			? tree.stageNanoseconds[stage] : totalNanoseconds;
+
+		unsigned long syscalls = (stage < NUM_BENCH_STAGES)
+			? tree.stageSyscalls[stage] : totalSyscalls;
+
+		printf("%-10s %12.2f %14.0f %15.3f\n",
+		       (stage < NUM_BENCH_STAGES) ? stageNames[stage]
+						  : "total",
+		       nanoseconds / 1e6,
+		       (nanoseconds > 0)
+		       ? numEntries * 1e9 / nanoseconds : 0.0,
+		       (numEntries > 0)
+		       ? (double) syscalls / numEntries : 0.0);
+
+		if (stage < NUM_BENCH_STAGES)
+		{
+			totalNanoseconds += nanoseconds;
+
+			totalSyscalls += syscalls;
+		}
+	}
+
+
+	return 0;
+}
+
+
+
+/*---------------------------------------------------------*/
+
+unsigned long long getMonotonicNanoseconds()
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return (unsigned long long) now.tv_sec * 1000000000ULL
+	       + now.tv_nsec;
+}
+
+
+
+/*---------------------------------------------------------*/
+
+int addBenchDir(struct BenchTree * tree, const char * dirPath)
+{
+	struct BenchDir * newDirs = NULL;
+
+	size_t newCapacity;
+
+
+	if (tree->numDirs == tree->dirsCapacity)
+	{
+		newCapacity = (tree->dirsCapacity > 0)
+			      ? tree->dirsCapacity * 2 : 64;
+
+		newDirs = realloc(tree->dirs,
+				  newCapacity * sizeof(*newDirs));
+
+		if (newDirs == NULL)
+		{
+			return -1;
+		}
+
+		tree->dirs = newDirs;
+
+		tree->dirsCapacity = newCapacity;
+	}
+
+	tree->dirs[tree->numDirs].path = strdup(dirPath);
+
+	if (tree->dirs[tree->numDirs].path == NULL)
+	{
+		return -1;
+	}
+
+	tree->numDirs++;
+
+
+	return 0;
+}
+
+
+
+/*---------------------------------------------------------*/
+
+int enumerateTree(struct BenchTree * tree, const char * rootPath)
+{
+
+	struct DirEnumerator enumerator;
+
+	struct DirEntryInfo entryInfo;
+
+	struct BenchDir * dirPtr = NULL;
+
+	char childPath[PATH_MAX];
+
+	int readReturnValue;
+
+
+
+	if (initDirEnumerator(&enumerator, listingOptions.enumBackend,
+			      listingOptions.direntBatchSize) == -1
+	    || addBenchDir(tree, rootPath) == -1)
+	{
+		perror("bench_stages");
+
+		return -1;
+	}
+
+
+	/*============================================
+	 Subdirectories are told apart by d_type, as
+	 in the -R walk, and queued behind the
+	 directories already found
+	=============================================*/
+	for (size_t dirIndex = 0; dirIndex < tree->numDirs; dirIndex++)
+	{
+		dirPtr = &tree->dirs[dirIndex];
+
+		dirPtr->firstRecord = tree->records.numRecords;
+
+		dirPtr->numRecords = 0;
+
+		if (openDirEnumerator(&enumerator, dirPtr->path) == -1)
+		{
+			fprintf(stderr, "bench_stages: Cannot open '%s': %s\n",
+				dirPtr->path, strerror(errno));
+
+			continue;
+		}
+
+		while ((readReturnValue = readNextDirEntry(
+				&enumerator, &entryInfo)) == 1)
+		{
+			if (addEntryName(&tree->records, entryInfo.name,
+					 entryInfo.inodeNum) == -1)
+			{
+				perror("bench_stages");
+
+				return -1;
+			}
+
+			tree->dirs[dirIndex].numRecords++;
+
+			if (entryInfo.direntType == DT_DIR
+			    && snprintf(childPath, sizeof(childPath), "%s/%s",
+					tree->dirs[dirIndex].path,
+					entryInfo.name)
+			       < (int) sizeof(childPath)
+			    && addBenchDir(tree, childPath) == -1)
+			{
+				perror("bench_stages");
+
+				return -1;
+			}
+		}
+
+		closeDirEnumerator(&enumerator);
+	}
+
+	destroyDirEnumerator(&enumerator);
+
+
+	return 0;
+}
+
+
+
+/*---------------------------------------------------------*/
+
+void statTree(struct BenchTree * tree)
+{
+
+	struct EntryRecord * recordPtr = NULL;
+
+	struct stat statBuf;
+
+	int dirFd;
+
+
+
+	for (size_t dirIndex = 0; dirIndex < tree->numDirs; dirIndex++)
+	{
+		dirFd = open(tree->dirs[dirIndex].path,
+			     O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+
+		for (size_t index = 0;
+		     index < tree->dirs[dirIndex].numRecords; index++)
+		{
+			recordPtr = &tree->records.records[
+					tree->dirs[dirIndex].firstRecord + index];
+
+			if (getFileMetadata(dirFd,
+					    getEntryName(&tree->records,
+							 recordPtr->nameOffset),
+					    &statBuf) == -1)
+			{
+				recordPtr->errorNumber = errno;
+
+				continue;
+			}
+
+			storeEntryRecordStat(recordPtr, &statBuf);
+		}
+
+		if (dirFd != -1)
+		{
+			close(dirFd);
+		}
+	}
+}
+
+
+
+/*---------------------------------------------------------*/
+
+void resolveTreeNames(struct BenchTree * tree)
+{
+	struct EntryRecord * recordPtr = NULL;
+
+
+	for (size_t index = 0; index < tree->records.numRecords;
+	     index++)
+	{
+		recordPtr = &tree->records.records[index];
+
+		if (recordPtr->errorNumber != 0)
+		{
+			continue;
+		}
+
+		if (listingOptions.outputFields & FIELD_USER)
+		{
+			lookupUserName(recordPtr->userId);
+		}
+
+		if (listingOptions.outputFields & FIELD_GROUP)
+		{
+			lookupGroupName(recordPtr->groupId);
+		}
+	}
+}
+
+
+
+/*---------------------------------------------------------*/
+
+unsigned long long formatTree(struct BenchTree * tree,
+			      struct OutputBuffer * sample)
+{
+
+	struct OutputBuffer formatBuffer = { .outputFd = -1 };
+
+	struct EntryRecord * recordPtr = NULL;
+
+	struct stat statBuf;
+
+	unsigned long long numBytes = 0;
+
+
+
+	initOutputBuffer(&formatBuffer, -1,
+			 listingOptions.outputBufferSize);
+
+	memset(&statBuf, 0, sizeof(statBuf));
+
+
+	for (size_t index = 0; index < tree->records.numRecords;
+	     index++)
+	{
+		recordPtr = &tree->records.records[index];
+
+		if (recordPtr->errorNumber != 0)
+		{
+			continue;
+		}
+
+		loadEntryRecordStat(recordPtr, &statBuf);
+
+		writeFileStatInfo(&formatBuffer,
+				  getEntryName(&tree->records,
+					       recordPtr->nameOffset),
+				  &statBuf);
+
+
+		//The first bufferful is handed over as the
+		// sample, and a new buffer started
+		if (formatBuffer.length >= listingOptions.outputBufferSize)
+		{
+			numBytes += formatBuffer.length;
+
+			if (sample->data == NULL)
+			{
+				*sample = formatBuffer;
+
+				initOutputBuffer(&formatBuffer, -1,
+						 listingOptions.outputBufferSize);
+			}
+
+			formatBuffer.length = 0;
+		}
+	}
+
+
+	numBytes += formatBuffer.length;
+
+	if (sample->data == NULL)
+	{
+		*sample = formatBuffer;
+	}
+	else
+	{
+		destroyOutputBuffer(&formatBuffer);
+	}
+
+
+	return numBytes;
+}
+
+
+
+/*---------------------------------------------------------*/
+
+void writeTreeOutput(const struct OutputBuffer * sample,
+		     unsigned long long numBytes, int outputFd)
+{
+
+	struct OutputBuffer outBuffer;
+
+	size_t pieceLength;
+
+
+
+	if (sample->length == 0
+	    || initOutputBuffer(&outBuffer, outputFd,
+				listingOptions.outputBufferSize) == -1)
+	{
+		return;
+	}
+
+
+	while (numBytes > 0)
+	{
+		pieceLength = (numBytes < sample->length)
+			      ? numBytes : sample->length;
+
+		appendOutputBytes(&outBuffer, sample->data, pieceLength);
+
+		numBytes -= pieceLength;
+	}
+
+	flushOutputBuffer(&outBuffer);
+
+	destroyOutputBuffer(&outBuffer);
+}
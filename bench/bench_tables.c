@@ -0,0 +1,470 @@
+/***********************************
+*
+* File name: bench/bench_tables.c
+*
+* Aim: Compare the table lookups of
+*      getFileTypeString() and
+*      getFilePermissionsString() with the
+*      bit-by-bit implementations they
+*      replaced
+*
+* Build: gcc -O2 -pthread -o bench_tables bench/bench_tables.c
+*
+* Usage: ./bench_tables [NUM_MODES]
+* 
+***********************************/
+
+
+//Only the functions of myls are needed
+#define MYLS_NO_MAIN
+
+#include "../myls.c"
+
+
+
+
+//Default number of modes converted by each
+// implementation
+#define DEFAULT_NUM_MODES 4000000UL
+
+
+
+	/*------------------------------------------------
+	 Brief: The implementations from before the
+		lookup tables, kept here as the baseline.
+		They write into a caller-supplied buffer
+		and do not render the setuid, setgid and
+		sticky bits
+	------------------------------------------------*/
+void legacyGetFileTypeString(char * fileTypeString,
+			    int fileTypeAndPermsFlags);
+
+void legacyGetFilePermissionsString(char * filePermsString,
+				    mode_t fileTypeAndPermsFlags);
+
+
+	/*------------------------------------------------
+	 Brief: Returns the current time of the
+		monotonic clock in nanoseconds
+	------------------------------------------------*/
+unsigned long long getMonotonicNanoseconds();
+
+
+
+
+int main(int argc, char * argv[])
+{
+
+	/*=============================================
+	 SECTION 1: Declaration of variables
+	==============================================*/
+
+	unsigned long numModes = DEFAULT_NUM_MODES;
+
+	unsigned long index;
+
+	mode_t * modes = NULL;
+
+	char typeBuffer[MAX_STRING_SIZE];
+
+	char permsBuffer[MAX_STRING_SIZE];
+
+	//Keeps the compiler from removing the loops
+	volatile unsigned long checksum = 0;
+
+	unsigned long long startTime;
+
+	unsigned long long legacyTime;
+
+	unsigned long long tableTime;
+
+	unsigned long numMismatches = 0;
+
+	unsigned int seed = 12345;
+
+	static const mode_t fileTypes[] =
+	{
+		S_IFREG, S_IFDIR, S_IFLNK, S_IFCHR,
+		S_IFBLK, S_IFIFO, S_IFSOCK
+	};
+
+
+
+	/*=============================================
+	 SECTION 2: Generating the modes
+
+	 A fixed linear congruential sequence gives
+	 every run the same mix of types and
+	 permission bits
+	==============================================*/
+	if (argc > 1 && parseUnsignedOption("modes", argv[1],
+					    &numModes) == -1)
+	{
+		return 1;
+	}
+
+	modes = malloc(numModes * sizeof(*modes));
+
+	if (modes == NULL)
+	{
+		perror("bench_tables");
+
+		return 1;
+	}
+
+
+	for (index = 0; index < numModes; index++)
+	{
+		seed = seed * 1103515245u + 12345u;
+
+		modes[index] = fileTypes[(seed >> 16) % 7]
+			       | ((seed >> 4) & FILE_PERMS_MASK);
+	}
+
+
+
+	/*=============================================
+	 SECTION 3: Checking that both agree on every
+		    mode without special bits
+	==============================================*/
+	for (index = 0; index < numModes; index++)
+	{
+		legacyGetFileTypeString(typeBuffer, modes[index]);
+
+		legacyGetFilePermissionsString(permsBuffer,
+					       modes[index]);
+
+		if (strcmp(typeBuffer,
+			   getFileTypeString(modes[index])) != 0
+		    || ((modes[index] & 07000) == 0
+			&& strcmp(permsBuffer,
+				  getFilePermissionsString(
+					modes[index])) != 0))
+		{
+			numMismatches++;
+		}
+	}
+
+
+
+	/*=============================================
+	 SECTION 4: Timing both implementations
+	==============================================*/
+	startTime = getMonotonicNanoseconds();
+
+	for (index = 0; index < numModes; index++)
+	{
+		legacyGetFileTypeString(typeBuffer, modes[index]);
+
+		legacyGetFilePermissionsString(permsBuffer,
+					       modes[index]);
+
+		checksum += typeBuffer[0] + permsBuffer[2];
+	}
+
+	legacyTime = getMonotonicNanoseconds() - startTime;
+
+
+	startTime = getMonotonicNanoseconds();
+
+	for (index = 0; index < numModes; index++)
+	{
+		checksum += getFileTypeString(modes[index])[0]
+			    + getFilePermissionsString(modes[index])[2];
+	}
+
+	tableTime = getMonotonicNanoseconds() - startTime;
+
+
+
+	/*=============================================
+	 SECTION 5: Reporting
+	==============================================*/
+	printf("modes:        %lu\n", numModes);
+
+	printf("mismatches:   %lu\n", numMismatches);
+
+	printf("bit-by-bit:   %.2f ns/mode\n",
+	       (double) legacyTime / numModes);
+
+	printf("table lookup: %.2f ns/mode\n",
+	       (double) tableTime / numModes);
+
+	printf("speed-up:     %.1fx\n",
+	       tableTime > 0 ? (double) legacyTime / tableTime : 0.0);
+
+
+	free(modes);
+
+	return numMismatches == 0 ? 0 : 1;
+}
+
+
+
+/*---------------------------------------------------------*/
+
+unsigned long long getMonotonicNanoseconds()
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return (unsigned long long) now.tv_sec * 1000000000ULL
+	       + now.tv_nsec;
+}
+
+
+
+/*---------------------------------------------------------*/
+
+void legacyGetFileTypeString(char * fileTypeString, 
+			    int fileTypeAndPermsFlags)
+{
+
+	
+	/*===============================================
+	 This program retrieves the type of file from
+	 a numerical flag and returns the file type as
+	 a human-readable string
+	================================================*/
+
+	
+	if (S_ISREG(fileTypeAndPermsFlags))
+	{
+		//regular file
+		strcpy(fileTypeString, "Regular");
+
+	}
+	else if (S_ISBLK(fileTypeAndPermsFlags))
+	{
+		//block device file
+		strcpy(fileTypeString,
+		       "Block Device"); 
+
+	}
+	else if (S_ISCHR(fileTypeAndPermsFlags))
+	{
+		//character device file
+		strcpy(fileTypeString,
+		       "Character Device");
+
+	}
+	else if (S_ISDIR(fileTypeAndPermsFlags))
+	{
+		//directory
+		strcpy(fileTypeString, "Directory");
+
+	}
+	else if (S_ISLNK(fileTypeAndPermsFlags))
+	{
+		//symbolic link
+		strcpy(fileTypeString, "Symbolic Link");
+
+	}
+	else if (S_ISFIFO(fileTypeAndPermsFlags))
+	{
+		//named pipe
+		strcpy(fileTypeString, "Named Pipe");
+
+	}
+	else
+	{
+		//socket
+		strcpy(fileTypeString, "Socket");
+
+	}
+
+}
+
+/*---------------------------------------------------------*/
+
+void legacyGetFilePermissionsString(char * filePermsString,
+				    mode_t fileTypeAndPermsFlags)
+{
+
+	/*================================================
+	 FILE PERMISSIONS IN LINUX
+	---------------------------------------------
+	 This function returns a string that contains
+	 the information about the access permissions
+	  of the file, eg 'rwxrwxr--'
+
+
+	 This function uses a numerical flag value
+	 as input to produce the string
+	 version of file access permissions
+
+	
+	 ----------------------------------
+
+	 SECTION 1: User-related Permissions
+
+	 SECTION 2: Group-related Permissions
+
+	 SECTION 3: Others-related Permissions
+		
+
+	 Each section consists of three parts, which
+	 are:
+	   (a) Read permission
+	   (b) Write Permission
+	   (c) Execute Permission
+
+	If the user(User/Group/Others) does not have
+	a particular permission, it would be labelled
+	as '-', otherwise it would be labelled
+	as 'r', 'w' or 'x' respectively.
+	=================================================*/
+
+
+
+
+	/*================================================
+	 SECTION 1: User-related Permissions
+	=================================================*/
+	
+	/*------------------------------
+	  Part(a) User Read Permission
+	-------------------------------*/
+	if(fileTypeAndPermsFlags & S_IRUSR)
+	{
+		filePermsString[0] = 'r';
+	}
+	else
+	{
+		filePermsString[0] = '-';
+	}
+
+
+	
+	/*-------------------------------
+	 Part(b) User Write Permission
+	--------------------------------*/
+	if (fileTypeAndPermsFlags & S_IWUSR)
+	{
+		filePermsString[1] = 'w';
+	}
+	else
+	{
+		filePermsString[1] = '-';
+	}
+
+
+
+	/*---------------------------------
+	 Part(c) User Execute Permission	
+	----------------------------------*/
+
+	if (fileTypeAndPermsFlags & S_IXUSR)
+	{
+		filePermsString[2] = 'x';
+	}
+	else
+	{
+		filePermsString[2] = '-';
+	}
+
+
+
+
+	/*================================================
+	 SECTION 2: Group-related Permissions
+	=================================================*/
+
+
+	/*---------------------------------
+	 Part(a) Group Read Permission
+	----------------------------------*/
+	if (fileTypeAndPermsFlags & S_IRGRP)
+	{
+		filePermsString[3] = 'r';
+	}
+	else
+	{
+		filePermsString[3] = '-';
+	}
+
+
+
+	/*---------------------------------
+	 Part(b) Group Write Permission
+	----------------------------------*/
+	if (fileTypeAndPermsFlags & S_IWGRP)
+	{
+		filePermsString[4] = 'w';
+	}
+	else
+	{
+		filePermsString[4] = '-';
+	}
+
+
+
+	/*---------------------------------
+	 Part(c) Group Execute Permission
+	---------------------------------*/
+	if (fileTypeAndPermsFlags & S_IXGRP)
+	{
+		filePermsString[5] = 'x';
+	}
+	else
+	{
+		filePermsString[5] = '-';
+	}
+
+
+
+	
+	/*==============================================
+	 SECTION 3: Others-related Permissions
+	===============================================*/
+
+	/*----------------------------------
+	 Part (a) Others Read Permission
+	----------------------------------*/
+	if (fileTypeAndPermsFlags & S_IROTH)
+	{
+		filePermsString[6] = 'r';
+	}
+	else
+	{
+		filePermsString[6] = '-';
+	}
+
+
+
+	/*----------------------------------
+	 Part (b) Others Write Permission
+	-----------------------------------*/
+	if (fileTypeAndPermsFlags & S_IWOTH)
+	{
+		filePermsString[7] = 'w';
+	}
+	else
+	{
+		filePermsString[7] = '-';
+	}
+
+
+
+	/*---------------------------------
+	 Part(c) Others Execute Permission
+	---------------------------------*/
+	if (fileTypeAndPermsFlags & S_IXOTH)
+	{
+		filePermsString[8] = 'x';
+	}
+	else
+	{
+		filePermsString[8] = '-';
+	}
+
+
+
+	/*-------------------------------------
+	 Appending of the null-terminating
+	 character
+	--------------------------------------*/	
+
+	filePermsString[9] = '\0';
+}
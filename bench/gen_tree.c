@@ -0,0 +1,662 @@
+/***********************************
+*
+* File name: bench/gen_tree.c
+*
+* Aim: Create a synthetic directory tree to
+*      benchmark myls on, with a given number
+*      of entries per directory, depth, fan-out,
+*      name length and mix of file types
+*
+*      The same options and seed always make the
+*      same names in the same order, so runs on
+*      different machines or commits list the
+*      same tree
+*
+* Build: gcc -O2 -o gen_tree bench/gen_tree.c
+*
+* Usage: ./gen_tree [--files=N] [--depth=D]
+*		    [--fanout=F] [--name-length=L]
+*		    [--size=BYTES] [--mix=LIST]
+*		    [--seed=S] PATH
+*
+*	 PATH must not exist yet. Every directory
+*	 gets N entries besides its F
+*	 subdirectories, down to D levels below
+*	 PATH. LIST weighs the types of those
+*	 entries, e.g. 'reg:90,link:5,fifo:3,sock:1,dir:1'
+*	 (the default), where 'dir' makes empty
+*	 directories. Regular files are BYTES long,
+*	 without taking up any blocks
+*
+***********************************/
+
+
+#define _GNU_SOURCE
+
+
+//For errno
+#include <errno.h>
+
+
+//For open()
+#include <fcntl.h>
+
+
+//For getopt_long()
+#include <getopt.h>
+
+
+//For PATH_MAX
+#include <limits.h>
+
+
+//For printf(), fprintf(), snprintf()
+#include <stdio.h>
+
+
+//For strtoul()
+#include <stdlib.h>
+
+
+//For strcmp(), strchr(), strerror()
+#include <string.h>
+
+
+//For mkdir(), mknod()
+#include <sys/stat.h>
+
+
+//For ftruncate(), symlink(), close()
+#include <unistd.h>
+
+
+
+
+//Kinds of entry the generator makes, in the
+// order of 'typeNames'
+enum EntryType
+{
+	ENTRY_REGULAR,
+	ENTRY_SYMLINK,
+	ENTRY_FIFO,
+	ENTRY_SOCKET,
+	ENTRY_DIRECTORY,
+	NUM_ENTRY_TYPES
+};
+
+
+static const char * const typeNames[NUM_ENTRY_TYPES] =
+{
+	"reg", "link", "fifo", "sock", "dir"
+};
+
+
+	/*------------------------------------------------
+	 What to generate, from the command line, and
+	 the running state of the name generator
+	------------------------------------------------*/
+struct TreeSpec
+{
+	unsigned long filesPerDir;
+
+	unsigned long depth;
+
+	unsigned long fanout;
+
+	unsigned long nameLength;
+
+	unsigned long fileSize;
+
+	unsigned long typeWeights[NUM_ENTRY_TYPES];
+
+	unsigned long totalWeight;
+
+	unsigned int seed;
+
+	unsigned long entriesMade[NUM_ENTRY_TYPES];
+
+	unsigned long dirsMade;
+};
+
+
+
+
+	/*------------------------------------------------
+	 Brief: Parses a weight list such as
+		'reg:90,link:10' into 'spec'. Types
+		that are not listed get no weight
+
+		Returns 0 on success. If the list is
+		invalid, an error message is printed and
+		-1 is returned
+	------------------------------------------------*/
+int parseTypeMix(const char * mixText, struct TreeSpec * spec);
+
+
+	/*------------------------------------------------
+	 Brief: Parses 'optionText' as an unsigned
+		decimal number for the option
+		'optionName'
+
+		Returns 0 on success. On failure, an error
+		message is printed and -1 is returned
+	------------------------------------------------*/
+int parseCount(const char * optionName, const char * optionText,
+	       unsigned long * value);
+
+
+	/*------------------------------------------------
+	 Brief: Returns the next number of the fixed
+		pseudo-random sequence of 'spec'
+	------------------------------------------------*/
+unsigned int nextRandom(struct TreeSpec * spec);
+
+
+	/*------------------------------------------------
+	 Brief: Writes a name of 'spec->nameLength'
+		characters (at least the digits of
+		'index') into 'name', starting with
+		'prefix' and ending in 'index' so that
+		names never collide
+	------------------------------------------------*/
+void makeEntryName(struct TreeSpec * spec, char prefix,
+		   unsigned long index, char * name);
+
+
+	/*------------------------------------------------
+	 Brief: Creates the directory 'dirPath' with its
+		entries, and its subdirectories down to
+		'levelsLeft' more levels. 'dirPath' is
+		in a buffer of PATH_MAX bytes, which is
+		extended in place for the children
+
+		Returns 0 on success. On failure, an error
+		message is printed and -1 is returned
+	------------------------------------------------*/
+int makeTreeDir(struct TreeSpec * spec, char * dirPath,
+		unsigned long levelsLeft);
+
+
+
+
+int main(int argc, char * argv[])
+{
+
+	/*=============================================
+	 SECTION 1: Parsing the command line options
+	==============================================*/
+	static const struct option longOptions[] =
+	{
+		{"files",       required_argument, NULL, 'f'},
+		{"depth",       required_argument, NULL, 'd'},
+		{"fanout",      required_argument, NULL, 'o'},
+		{"name-length", required_argument, NULL, 'n'},
+		{"size",        required_argument, NULL, 's'},
+		{"mix",         required_argument, NULL, 'm'},
+		{"seed",        required_argument, NULL, 'r'},
+		{NULL,          0,                 NULL, 0}
+	};
+
+	struct TreeSpec spec =
+	{
+		.filesPerDir = 10000,
+
+		.depth = 0,
+
+		.fanout = 0,
+
+		.nameLength = 16,
+
+		.fileSize = 0,
+
+		.seed = 1
+	};
+
+	char dirPath[PATH_MAX];
+
+	unsigned long optionValue;
+
+	unsigned long totalEntries = 0;
+
+	int optionChar;
+
+
+	if (parseTypeMix("reg:90,link:5,fifo:3,sock:1,dir:1",
+			 &spec) == -1)
+	{
+		return 1;
+	}
+
+
+	while ((optionChar = getopt_long(argc, argv, "",
+					 longOptions, NULL)) != -1)
+	{
+		switch (optionChar)
+		{
+			case 'f':
+				if (parseCount("files", optarg,
+					       &spec.filesPerDir) == -1)
+				{
+					return 1;
+				}
+
+				break;
+
+			case 'd':
+				if (parseCount("depth", optarg,
+					       &spec.depth) == -1)
+				{
+					return 1;
+				}
+
+				break;
+
+			case 'o':
+				if (parseCount("fanout", optarg,
+					       &spec.fanout) == -1)
+				{
+					return 1;
+				}
+
+				break;
+
+			case 'n':
+				if (parseCount("name-length", optarg,
+					       &spec.nameLength) == -1)
+				{
+					return 1;
+				}
+
+				if (spec.nameLength > NAME_MAX)
+				{
+					spec.nameLength = NAME_MAX;
+				}
+
+				break;
+
+			case 's':
+				if (parseCount("size", optarg,
+					       &spec.fileSize) == -1)
+				{
+					return 1;
+				}
+
+				break;
+
+			case 'm':
+				if (parseTypeMix(optarg, &spec) == -1)
+				{
+					return 1;
+				}
+
+				break;
+
+			case 'r':
+				if (parseCount("seed", optarg,
+					       &optionValue) == -1)
+				{
+					return 1;
+				}
+
+				spec.seed = (unsigned int) optionValue;
+
+				break;
+
+			default:
+				fprintf(stderr,
+					"Usage: gen_tree [--files=N]"
+					" [--depth=D] [--fanout=F]\n"
+					"                [--name-length=L]"
+					" [--size=BYTES] [--mix=LIST]\n"
+					"                [--seed=S] PATH\n");
+
+				return 1;
+		}
+	}
+
+	if (optind != argc - 1)
+	{
+		fprintf(stderr, "gen_tree: Expected one PATH\n");
+
+		return 1;
+	}
+
+	if (strlen(argv[optind]) >= sizeof(dirPath) / 2)
+	{
+		fprintf(stderr, "gen_tree: PATH is too long\n");
+
+		return 1;
+	}
+
+
+
+	/*=============================================
+	 SECTION 2: Making the tree and reporting what
+		    it holds
+	==============================================*/
+	strcpy(dirPath, argv[optind]);
+
+	if (makeTreeDir(&spec, dirPath, spec.depth) == -1)
+	{
+		return 1;
+	}
+
+
+	printf("directories: %lu\n", spec.dirsMade);
+
+	for (int type = 0; type < NUM_ENTRY_TYPES; type++)
+	{
+		printf("%-12s %lu\n", typeNames[type],
+		       spec.entriesMade[type]);
+
+		totalEntries += spec.entriesMade[type];
+	}
+
+	printf("entries:     %lu\n", totalEntries + spec.dirsMade - 1);
+
+
+	return 0;
+}
+
+
+
+/*---------------------------------------------------------*/
+
+int parseTypeMix(const char * mixText, struct TreeSpec * spec)
+{
+
+	const char * itemPtr = mixText;
+
+	const char * colonPtr = NULL;
+
+	char * endPtr = NULL;
+
+	size_t typeLength;
+
+	unsigned long weight;
+
+	int type;
+
+
+	for (type = 0; type < NUM_ENTRY_TYPES; type++)
+	{
+		spec->typeWeights[type] = 0;
+	}
+
+	spec->totalWeight = 0;
+
+
+	while (*itemPtr != '\0')
+	{
+		colonPtr = strchr(itemPtr, ':');
+
+		if (colonPtr == NULL)
+		{
+			break;
+		}
+
+		typeLength = colonPtr - itemPtr;
+
+		for (type = 0; type < NUM_ENTRY_TYPES; type++)
+		{
+			if (strlen(typeNames[type]) == typeLength
+			    && strncmp(typeNames[type], itemPtr,
+				       typeLength) == 0)
+			{
+				break;
+			}
+		}
+
+		errno = 0;
+
+		weight = strtoul(colonPtr + 1, &endPtr, 10);
+
+		if (type == NUM_ENTRY_TYPES || errno != 0
+		    || endPtr == colonPtr + 1
+		    || (*endPtr != ',' && *endPtr != '\0'))
+		{
+			break;
+		}
+
+		spec->typeWeights[type] = weight;
+
+		spec->totalWeight += weight;
+
+		itemPtr = (*endPtr == ',') ? endPtr + 1 : endPtr;
+	}
+
+
+	if (*itemPtr != '\0' || spec->totalWeight == 0)
+	{
+		fprintf(stderr, "gen_tree: Invalid --mix '%s'\n",
+			mixText);
+
+		return -1;
+	}
+
+
+	return 0;
+}
+
+
+
+/*---------------------------------------------------------*/
+
+int parseCount(const char * optionName, const char * optionText,
+	       unsigned long * value)
+{
+	char * endPtr = NULL;
+
+
+	errno = 0;
+
+	*value = strtoul(optionText, &endPtr, 10);
+
+
+	if (errno != 0 || endPtr == optionText || *endPtr != '\0'
+	    || optionText[0] == '-')
+	{
+		fprintf(stderr,
+			"gen_tree: Invalid value '%s' for --%s\n",
+			optionText, optionName);
+
+		return -1;
+	}
+
+
+	return 0;
+}
+
+
+
+/*---------------------------------------------------------*/
+
+unsigned int nextRandom(struct TreeSpec * spec)
+{
+	spec->seed = spec->seed * 1103515245u + 12345u;
+
+	return spec->seed >> 8;
+}
+
+
+
+/*---------------------------------------------------------*/
+
+void makeEntryName(struct TreeSpec * spec, char prefix,
+		   unsigned long index, char * name)
+{
+
+	static const char letters[] =
+		"abcdefghijklmnopqrstuvwxyz0123456789_";
+
+	char digits[32];
+
+	int numDigits;
+
+	size_t length = 0;
+
+
+
+	/*============================================
+	 A random filler between the prefix and the
+	 index gives names the spread of first bytes
+	 real directories have, rather than one long
+	 shared prefix
+	=============================================*/
+	numDigits = snprintf(digits, sizeof(digits), "%lu", index);
+
+	name[length++] = prefix;
+
+	while (length + numDigits < spec->nameLength)
+	{
+		name[length++] = letters[nextRandom(spec)
+					 % (sizeof(letters) - 1)];
+	}
+
+	memcpy(name + length, digits, numDigits + 1);
+}
+
+
+
+/*---------------------------------------------------------*/
+
+int makeTreeDir(struct TreeSpec * spec, char * dirPath,
+		unsigned long levelsLeft)
+{
+
+	/*============================================
+	 SECTION 1: Declaration of variables
+	=============================================*/
+
+	size_t dirLength = strlen(dirPath);
+
+	char * namePtr = dirPath + dirLength + 1;
+
+	unsigned long pick;
+
+	int type;
+
+	int fileFd;
+
+	int returnValue = 0;
+
+
+
+	/*============================================
+	 SECTION 2: Making the directory itself
+	=============================================*/
+	if (mkdir(dirPath, 0755) == -1)
+	{
+		fprintf(stderr, "gen_tree: Cannot create '%s': %s\n",
+			dirPath, strerror(errno));
+
+		return -1;
+	}
+
+	spec->dirsMade++;
+
+	if (dirLength + 2 + NAME_MAX >= PATH_MAX)
+	{
+		fprintf(stderr, "gen_tree: '%s' is too deep\n", dirPath);
+
+		return -1;
+	}
+
+	dirPath[dirLength] = '/';
+
+
+
+	/*============================================
+	 SECTION 3: Making its entries, each of a type
+		    picked by weight
+	=============================================*/
+	for (unsigned long index = 0;
+	     index < spec->filesPerDir && returnValue == 0; index++)
+	{
+		pick = nextRandom(spec) % spec->totalWeight;
+
+		for (type = 0; pick >= spec->typeWeights[type]; type++)
+		{
+			pick -= spec->typeWeights[type];
+		}
+
+		makeEntryName(spec, typeNames[type][0], index, namePtr);
+
+
+		switch (type)
+		{
+			case ENTRY_REGULAR:
+				fileFd = open(dirPath, O_WRONLY | O_CREAT
+						       | O_EXCL | O_CLOEXEC,
+					      0644);
+
+				if (fileFd == -1
+				    || (spec->fileSize > 0
+					&& ftruncate(fileFd,
+						     spec->fileSize) == -1))
+				{
+					returnValue = -1;
+				}
+
+				if (fileFd != -1)
+				{
+					close(fileFd);
+				}
+
+				break;
+
+			case ENTRY_SYMLINK:
+				//Links point at a sibling that may or
+				// may not exist, as links do
+				returnValue = symlink("r0", dirPath);
+
+				break;
+
+			case ENTRY_FIFO:
+				returnValue = mkfifo(dirPath, 0644);
+
+				break;
+
+			case ENTRY_SOCKET:
+				returnValue = mknod(dirPath, S_IFSOCK | 0644, 0);
+
+				break;
+
+			default:
+				returnValue = mkdir(dirPath, 0755);
+
+				break;
+		}
+
+		if (returnValue == -1)
+		{
+			fprintf(stderr, "gen_tree: Cannot create '%s': %s\n",
+				dirPath, strerror(errno));
+		}
+		else
+		{
+			spec->entriesMade[type]++;
+		}
+	}
+
+
+
+	/*============================================
+	 SECTION 4: Making its subdirectories, named
+		    apart from the entries by their
+		    'D' prefix
+	=============================================*/
+	for (unsigned long index = 0;
+	     index < spec->fanout && levelsLeft > 0
+	     && returnValue == 0; index++)
+	{
+		snprintf(namePtr, NAME_MAX + 1, "D%lu", index);
+
+		returnValue = makeTreeDir(spec, dirPath, levelsLeft - 1);
+	}
+
+	dirPath[dirLength] = '\0';
+
+
+	return returnValue;
+}
@@ -0,0 +1,349 @@
+/***********************************
+*
+* File name: libmyls.c
+*
+* Aim: Provide the functions of libmyls.h,
+*      the library form of myls
+*
+* Build: make libmyls.a libmyls.so
+*
+*	 A listing reads its directory with
+*	 the enumerator of myls and looks its
+*	 entries up with collectDirEntries(),
+*	 the same batches myls writes when it
+*	 lists a directory in directory order.
+*	 Each batch is then copied out as
+*	 struct MylsEntry records
+*
+*	 The settings of myls are left at their
+*	 defaults, which look up every field of
+*	 struct MylsEntry and are never changed,
+*	 so listings share nothing but the user
+*	 and group name caches, which are
+*	 locked
+*
+***********************************/
+
+
+//Only the engine of myls is needed
+#define MYLS_NO_MAIN
+
+#include "myls.c"
+
+//For the interface and struct MylsEntry
+#include "libmyls.h"
+
+
+
+
+	/*------------------------------------------------
+	 An open listing: the directory being read,
+	 the records of the current batch, and the
+	 same batch as returned to the caller
+
+	 'pendingError' holds the 'errno' value of a
+	 read that failed after part of a batch had
+	 been collected. That part is returned first
+	 and the error on the next call
+	------------------------------------------------*/
+struct MylsListing
+{
+	struct DirEnumerator enumerator;
+
+	struct EntryRecordArray recordArray;
+
+	struct MylsEntry * entries;
+
+	unsigned int flags;
+
+	int isFinished;
+
+	int pendingError;
+};
+
+
+	/*------------------------------------------------
+	 Brief: Copies the record at 'recordIndex' of
+		'recordArray' into 'entryPtr'
+	------------------------------------------------*/
+void convertEntryRecord(const struct EntryRecordArray * recordArray,
+			size_t recordIndex,
+			struct MylsEntry * entryPtr);
+
+
+
+
+/*---------------------------------------------------------*/
+
+MYLS_API struct MylsListing * mylsOpenListing(const char * dirPath,
+					      unsigned int flags)
+{
+
+	struct MylsListing * listing = NULL;
+
+	int savedErrno;
+
+
+
+	listing = calloc(1, sizeof(*listing));
+
+	if (listing == NULL)
+	{
+		return NULL;
+	}
+
+
+	listing->flags = flags;
+
+	listing->entries = malloc(LISTING_BATCH_ENTRIES
+				  * sizeof(*listing->entries));
+
+	if (listing->entries == NULL
+	    || initDirEnumerator(&listing->enumerator,
+				 listingOptions.enumBackend,
+				 listingOptions.direntBatchSize) == -1)
+	{
+		free(listing->entries);
+
+		free(listing);
+
+		errno = ENOMEM;
+
+		return NULL;
+	}
+
+
+	if (openDirEnumerator(&listing->enumerator, dirPath) == -1)
+	{
+		savedErrno = errno;
+
+		destroyDirEnumerator(&listing->enumerator);
+
+		free(listing->entries);
+
+		free(listing);
+
+		errno = savedErrno;
+
+		return NULL;
+	}
+
+
+	return listing;
+}
+
+
+/*---------------------------------------------------------*/
+
+MYLS_API long mylsReadEntries(struct MylsListing * listing,
+			      const struct MylsEntry ** entries)
+{
+
+	int readReturnValue;
+
+
+
+	/*============================================
+	 SECTION 1: Reporting the end, or an error
+		    held back from the last batch
+	=============================================*/
+	*entries = listing->entries;
+
+	resetEntryRecords(&listing->recordArray);
+
+	if (listing->pendingError != 0)
+	{
+		errno = listing->pendingError;
+
+		listing->pendingError = 0;
+
+		return -1;
+	}
+
+	if (listing->isFinished)
+	{
+		return 0;
+	}
+
+
+
+	/*============================================
+	 SECTION 2: Collecting the next batch
+	=============================================*/
+	readReturnValue = collectDirEntries(
+				&listing->enumerator,
+				&listing->recordArray,
+				LISTING_BATCH_ENTRIES,
+				(listing->flags & MYLS_INODE_ORDER) != 0);
+
+	if (readReturnValue != 1)
+	{
+		listing->isFinished = 1;
+	}
+
+	if (readReturnValue == -1)
+	{
+		if (listing->recordArray.numRecords == 0)
+		{
+			return -1;
+		}
+
+		listing->pendingError = errno;
+	}
+
+
+
+	/*============================================
+	 SECTION 3: Copying it out
+	=============================================*/
+	for (size_t index = 0;
+	     index < listing->recordArray.numRecords; index++)
+	{
+		convertEntryRecord(&listing->recordArray, index,
+				   &listing->entries[index]);
+	}
+
+
+	return (long) listing->recordArray.numRecords;
+}
+
+
+/*---------------------------------------------------------*/
+
+MYLS_API void mylsCloseListing(struct MylsListing * listing)
+{
+	if (listing == NULL)
+	{
+		return;
+	}
+
+	closeDirEnumerator(&listing->enumerator);
+
+	destroyDirEnumerator(&listing->enumerator);
+
+	destroyEntryRecords(&listing->recordArray);
+
+	free(listing->entries);
+
+	free(listing);
+}
+
+
+/*---------------------------------------------------------*/
+
+MYLS_API int mylsForEachEntry(const char * dirPath,
+			      unsigned int flags,
+			      int (*callback)(
+					const struct MylsEntry * entry,
+					void * userData),
+			      void * userData)
+{
+
+	struct MylsListing * listing = NULL;
+
+	const struct MylsEntry * entries = NULL;
+
+	long numEntries;
+
+	int savedErrno;
+
+
+
+	listing = mylsOpenListing(dirPath, flags);
+
+	if (listing == NULL)
+	{
+		return -1;
+	}
+
+
+	while ((numEntries = mylsReadEntries(listing, &entries)) > 0)
+	{
+		for (long index = 0; index < numEntries; index++)
+		{
+			if (callback(&entries[index], userData) != 0)
+			{
+				mylsCloseListing(listing);
+
+				return 0;
+			}
+		}
+	}
+
+
+	savedErrno = errno;
+
+	mylsCloseListing(listing);
+
+	errno = savedErrno;
+
+
+	return (numEntries == -1) ? -1 : 0;
+}
+
+
+/*---------------------------------------------------------*/
+
+MYLS_API const char * mylsUserName(uint32_t userId)
+{
+	return lookupUserName((uid_t) userId);
+}
+
+
+/*---------------------------------------------------------*/
+
+MYLS_API const char * mylsGroupName(uint32_t groupId)
+{
+	return lookupGroupName((gid_t) groupId);
+}
+
+
+/*---------------------------------------------------------*/
+
+void convertEntryRecord(const struct EntryRecordArray * recordArray,
+			size_t recordIndex,
+			struct MylsEntry * entryPtr)
+{
+
+	const struct EntryRecord * recordPtr =
+				&recordArray->records[recordIndex];
+
+
+
+	memset(entryPtr, 0, sizeof(*entryPtr));
+
+	entryPtr->name = getEntryName(recordArray,
+				      recordPtr->nameOffset);
+
+	entryPtr->errorNumber = recordPtr->errorNumber;
+
+	if (recordPtr->errorNumber != 0)
+	{
+		return;
+	}
+
+
+	entryPtr->mode = recordPtr->fileTypeAndPermsFlags;
+
+	entryPtr->size = recordPtr->fileSize;
+
+	entryPtr->inode = recordPtr->inodeNum;
+
+	entryPtr->userId = recordPtr->userId;
+
+	entryPtr->groupId = recordPtr->groupId;
+
+	entryPtr->numLinks = recordPtr->numOfHardLinks;
+
+	entryPtr->deviceMajor = recordPtr->deviceMajorNum;
+
+	entryPtr->deviceMinor = recordPtr->deviceMinorNum;
+
+	entryPtr->accessTime = recordPtr->lastAccessTime;
+
+	entryPtr->modTime = recordPtr->lastModTime;
+
+	entryPtr->modNanoseconds = recordPtr->lastModNanoseconds;
+
+	entryPtr->statusChangeTime = recordPtr->lastStatChgTime;
+}
@@ -0,0 +1,177 @@
+/***********************************
+*
+* File name: libmyls.h
+*
+* Aim: The interface of libmyls, which lists
+*      directories in-process with the same
+*      code as myls, handing the metadata of
+*      their entries to the caller as typed
+*      records instead of printing it
+*
+* Build: make libmyls.a libmyls.so
+*
+* Usage: A listing is opened on a directory,
+*	 and its entries pulled a batch at a
+*	 time until none are left:
+*
+*	     struct MylsListing * listing;
+*	     const struct MylsEntry * entries;
+*	     long numEntries;
+*
+*	     listing = mylsOpenListing("/data", 0);
+*
+*	     while ((numEntries = mylsReadEntries(
+*			listing, &entries)) > 0)
+*	     {
+*		     ... entries[0 .. numEntries-1]
+*	     }
+*
+*	     mylsCloseListing(listing);
+*
+*	 or mylsForEachEntry() calls a function
+*	 for every entry
+*
+*	 Separate listings may be used from
+*	 separate threads at once; one listing
+*	 must not be
+*
+***********************************/
+
+#ifndef LIBMYLS_H
+#define LIBMYLS_H
+
+
+//For uint32_t, uint64_t, int64_t
+#include <stdint.h>
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+//Marks the functions the shared library exports
+#define MYLS_API __attribute__((visibility("default")))
+
+
+//Flag of mylsOpenListing(): look each batch up
+// in order of inode number (see --inode-order)
+#define MYLS_INODE_ORDER 0x1
+
+
+	/*------------------------------------------------
+	 One entry of a directory. 'name' stays valid
+	 until the next mylsReadEntries() or
+	 mylsCloseListing() on its listing
+
+	 If its metadata could not be looked up (e.g.
+	 it was removed while being listed),
+	 'errorNumber' holds the 'errno' value of the
+	 failure and the other fields are zero
+	------------------------------------------------*/
+struct MylsEntry
+{
+	const char * name;
+
+	int errorNumber;
+
+	uint32_t mode;
+
+	uint64_t size;
+
+	uint64_t inode;
+
+	uint32_t userId;
+
+	uint32_t groupId;
+
+	uint32_t numLinks;
+
+	uint32_t deviceMajor;
+
+	uint32_t deviceMinor;
+
+	int64_t accessTime;
+
+	int64_t modTime;
+
+	uint32_t modNanoseconds;
+
+	int64_t statusChangeTime;
+};
+
+
+//An open listing, whose layout is private
+struct MylsListing;
+
+
+	/*------------------------------------------------
+	 Brief: Opens the directory 'dirPath' for
+		listing. 'flags' is 0 or
+		MYLS_INODE_ORDER
+
+		Returns the listing, or NULL with 'errno'
+		set if the directory cannot be opened
+	------------------------------------------------*/
+MYLS_API struct MylsListing * mylsOpenListing(
+				const char * dirPath,
+				unsigned int flags);
+
+
+	/*------------------------------------------------
+	 Brief: Reads the next batch of entries of
+		'listing', with their metadata, and
+		points 'entries' at them. The batch
+		belongs to the listing
+
+		Returns the number of entries, 0 once
+		every entry has been returned, or -1
+		with 'errno' set if the directory could
+		not be read
+	------------------------------------------------*/
+MYLS_API long mylsReadEntries(struct MylsListing * listing,
+			      const struct MylsEntry ** entries);
+
+
+	/*------------------------------------------------
+	 Brief: Closes 'listing' and releases
+		everything it holds
+	------------------------------------------------*/
+MYLS_API void mylsCloseListing(struct MylsListing * listing);
+
+
+	/*------------------------------------------------
+	 Brief: Lists 'dirPath', calling 'callback'
+		with every entry and 'userData'. A
+		callback that returns nonzero ends the
+		listing early
+
+		Returns 0 once every entry has been
+		passed (or the callback stopped), or -1
+		with 'errno' set if the directory could
+		not be opened or read
+	------------------------------------------------*/
+MYLS_API int mylsForEachEntry(const char * dirPath,
+			      unsigned int flags,
+			      int (*callback)(
+					const struct MylsEntry * entry,
+					void * userData),
+			      void * userData);
+
+
+	/*------------------------------------------------
+	 Brief: Return the name of the user 'userId' or
+		the group 'groupId', or "Not Available"
+		if there is none, from the caches myls
+		uses. The string must not be freed
+	------------------------------------------------*/
+MYLS_API const char * mylsUserName(uint32_t userId);
+
+MYLS_API const char * mylsGroupName(uint32_t groupId);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //LIBMYLS_H
@@ -12,8 +12,13 @@
 ***********************************/
 
 
+//For getdents64(), statx() and the other
+// Linux-specific interfaces used below
+#define _GNU_SOURCE
+
+
 //For opendir(), closedir(), readdir(), 
-// rewinddir()
+// rewinddir(), getdents64(), dirfd()
 #include <dirent.h>
 
 
@@ -21,39 +26,115 @@
 #include <errno.h>
 
 
-//For getgrgid()
+//For open()
+#include <fcntl.h>
+
+
+//For fnmatch()
+#include <fnmatch.h>
+
+
+//For getopt_long()
+#include <getopt.h>
+
+
+//For NAME_MAX
+#include <limits.h>
+
+
+//For struct io_uring_params, struct
+// io_uring_sqe, IORING_OP_STATX
+#include <linux/io_uring.h>
+
+
+//For getgrgid_r()
 #include <grp.h>
 
 
-//For getpwuid()
+//For poll()
+#include <poll.h>
+
+
+//For pthread_create(), pthread_mutex_lock(),
+// pthread_cond_wait()
+#include <pthread.h>
+
+
+//For getpwuid_r(), getpwnam()
 #include <pwd.h>
 
 
+//For regcomp(), regexec()
+#include <regex.h>
+
+
+//For sigaction(), signal()
+#include <signal.h>
+
+
+//For fprintf()
 #include <stdio.h>
 
 
+//For uint64_t, uint32_t, UINT64_MAX
+#include <stdint.h>
+
+
+//For malloc(), free(), strtoul(), qsort_r()
+#include <stdlib.h>
+
+
 //for strerror(), strcmp(), strcpy()
 #include <string.h>
 
 
-//For lstat()
+//For inotify_init1(), inotify_add_watch()
+#include <sys/inotify.h>
+
+
+//For mmap(), munmap()
+#include <sys/mman.h>
+
+
+//For sendfile()
+#include <sys/sendfile.h>
+
+
+//For fstatat(), statx()
 #include <sys/stat.h>
 
 
+//For __NR_io_uring_setup, __NR_io_uring_enter
+#include <sys/syscall.h>
+
+
 //For gnu_dev_major(), gnu_dev_minor()
 #include <sys/sysmacros.h>
 
 
+//For socket(), bind(), listen(), accept4(),
+// SO_PEERCRED
+#include <sys/socket.h>
+
+
+//For writev(), struct iovec
+#include <sys/uio.h>
+
+
+//For struct sockaddr_un
+#include <sys/un.h>
+
+
 //For lstat(), opendir(), closedir(),
 // getpwuid(), getgrgid(), rewinddir
 #include <sys/types.h>
 
 
-//For localtime_r()
+//For localtime_r(), tzset()
 #include <time.h>
 
 
-//For lstat()
+//For lstat(), close(), sysconf(), syscall()
 #include <unistd.h>
 
 
@@ -62,820 +143,15437 @@
 #define MAX_STRING_SIZE 1024
 
 
+//Room for a date from convertTimeToDateString(),
+// e.g. "Oct 16 12:34", with the widest year an
+// int can hold
+#define DATE_STRING_SIZE 32
 
-	/*------------------------------------------------
-	 Brief: Display the file information of all the 
-		files in the current directory
 
-		If there is a problem in opening the
-		current directory, an error message will
-		be displayed instead
-	------------------------------------------------*/
-void displayCurrDirFilesInfo();
+//Default size in bytes of the buffer that
+// getdents64() fills with directory entries
+#define DEFAULT_DIRENT_BATCH_SIZE (256 * 1024)
 
 
-	/*-----------------------------------------------
-	 Brief: Display the file information of the 
-		current file. File information includes
-		the user name, group name, type of file,
-		full access permissions.
+//Smallest batch buffer accepted, comfortably
+// larger than one maximum-length entry
+#define MIN_DIRENT_BATCH_SIZE 4096
 
-	 Parameters:
-		fileName - the name of the file of 
-			interest, where the information
-			regarding the file will be
-			displayed
-	------------------------------------------------*/
-void displayCurrFileInfo(const char * fileName);
 
+//Default number of IORING_OP_STATX requests
+// kept in flight by --uring
+#define DEFAULT_URING_QUEUE_DEPTH 256
 
 
-	/*-----------------------------------------------
-	 Brief: Converts a numerical value of file type
-		to its corresponding string form
+//Largest queue depth accepted by --uring-depth
+#define MAX_URING_QUEUE_DEPTH 4096
 
 
-	 Parameters:
-		fileTypeString - This contains the string
-			form of a file type. This is the
-			output of this function 
+//Default size of the buffer that collects
+// the output before it is written to stdout
+#define DEFAULT_OUTPUT_BUFFER_SIZE (256 * 1024)
 
-		fileTypeAndPermsFlags - this contains the
-			numerical value of a file type,
-			which is to be converted by the
-			function into the corresponding
-			file type in string form
-	------------------------------------------------*/
-void getFileTypeString(char * fileTypeString, 
-		      int fileTypeAndPermsFlags);
-		
 
-	/*-------------------------------------------------
-	 Brief: Converts a numerical value of file access 
-		permissions to its corresponding string
-		form
+//Smallest output buffer accepted
+#define MIN_OUTPUT_BUFFER_SIZE 4096
 
-		Eg: In string form,
-		'rwxrwxr-x'  represents 
-		read-write-execute permissions for owner(user)
-		read-write-execute permissions for group
-		read-execute permissions for others
-		
 
-	 Parameters:
-		filePermsString - this is the output of the
-			function. It contains a nine-letter
-			string containing the file access
-			permissions of a file
+//Number of largest files --summary lists by
+// default, and the most --summary=N accepts
+#define DEFAULT_SUMMARY_TOP_COUNT 10
 
-		fileTypeAndPermsFlags - this is the
-			 numerical value containing the
-			 file access permissions. It is used
-			 to convert to its corresponding 
-			 string form and stored in 
-			 'fileTypeString' 
-	-------------------------------------------------*/
-void getFilePermissionsString(char * filePermsString ,
-			mode_t fileTypeAndPermsFlags);
+#define MAX_SUMMARY_TOP_COUNT 1000
 
 
-	   
+//Largest request --serve accepts, and how long
+// a client has to send it
+#define MAX_SERVE_REQUEST_SIZE (64 * 1024)
 
-	/*--------------------------------------------------
-	 Brief: Converts a numerical value of time in
-		seconds away from 1 Jan 12:00am to a
-		date and time in string form 
+#define SERVE_REQUEST_TIMEOUT_SECONDS 5
 
 
-		If the year value in date and time
-		is the same as the current year,
-		the year will not be in the string 
-		dateString
-		E.g: 'May 25 00:30'
+//How long a write to a client may block before
+// the client is dropped
+#define SERVE_SEND_TIMEOUT_SECONDS 5
 
 
-		If the year value in date and time
-		is not the same as the current year,
-		then the year replace the time
-		in the string dateString
-		E.g. 'May 25  2010'
+//Threads answering the clients of --serve, and
+// the most clients left waiting for them
+#define NUM_SERVE_THREADS 8
 
+#define SERVE_QUEUE_SIZE 64
 
-	 Parameters:
-		dateString : the date converted to
-			human readable form from
-			'givenTime'. This is the
-			output of the function
 
-		givenTime : time in seconds, which is
-			the number of seconds elapsed
-			since 1 Jan 1970 12.00am
-	--------------------------------------------------*/
-void convertTimeToDateString(char * dateString, 
-			     time_t givenTime);
+//Largest reply of --serve held in memory until
+// its listing is over. A longer one is spooled
+// to a temporary file, so that a client slow to
+// read it holds up no other client either
+#define SERVE_SPOOL_SIZE (4 * 1024 * 1024)
 
-	
-	/*------------------------------------------------
-	 Brief: Converts a numerical month value to a
-		three-letter word form of month
-		E.g. 'Jan', 'Feb', 'Mar', 'Apr'
 
-		If the user provided an invalid month
-		value, the string "Inv" will be returned
-		instead
+//Every reply of --serve ends with this status
+// line: a NUL, the prefix, the number of
+// errors met in SERVE_STATUS_DIGITS digits and
+// a newline, SERVE_STATUS_SIZE bytes in all, so
+// a client can tell a failed or cut off
+// listing from a complete one
+#define SERVE_STATUS_PREFIX "\0myls-status "
 
+#define SERVE_STATUS_DIGITS 10
 
-	 Parameters:
-		monthString - the word form of 'month'
-			in exactly three letters. This is
-			the return value of the function
+#define SERVE_STATUS_SIZE (sizeof(SERVE_STATUS_PREFIX) - 1 \
+			   + SERVE_STATUS_DIGITS + 1)
 
-		month - the numerical value of month.
-			Eg:
-			0 represents Jan
-			1 represenrs Feb
-			2 represents Mar
-			...
-			11 represents Dec
-	--------------------------------------------------*/
-void getMonthString(char * monthString, int month);
 
+//Bit flags of the fields that can be printed
+// for each file, selected with --fields
+#define FIELD_NAME       (1u << 0)
+#define FIELD_USER       (1u << 1)
+#define FIELD_GROUP      (1u << 2)
+#define FIELD_TYPE       (1u << 3)
+#define FIELD_PERMS      (1u << 4)
+#define FIELD_SIZE       (1u << 5)
+#define FIELD_INODE      (1u << 6)
+#define FIELD_DEV_MAJOR  (1u << 7)
+#define FIELD_DEV_MINOR  (1u << 8)
+#define FIELD_LINKS      (1u << 9)
+#define FIELD_ATIME      (1u << 10)
+#define FIELD_MTIME      (1u << 11)
+#define FIELD_CTIME      (1u << 12)
+#define FIELD_ALL        ((1u << 13) - 1)
 
 
+	/*------------------------------------------------
+	 Layout of --format=bin output. A header of
+	 BINARY_HEADER_SIZE bytes:
+
+	   0  magic "MYLSBIN\0"
+	   8  u32 format version (BINARY_FORMAT_VERSION)
+	  12  u32 header size
+	  16  u32 record size
+	  20  u32 FIELD_* flags of the fields present
+	  24  u64 reserved, zero
+
+	 is followed by records of BINARY_RECORD_SIZE
+	 bytes, all little-endian:
+
+	   0  u64 size          8  u64 inode
+	  16  s64 atime        24  s64 mtime
+	  32  s64 ctime        40  u32 mtime nanoseconds
+	  44  u32 mode         48  u32 uid
+	  52  u32 gid          56  u32 links
+	  60  u32 major        64  u32 minor
+	  68  u16 kind         70  u16 reserved, zero
+	  72  u32 name length  76  u32 reserved, zero
+	  80  name, NUL padded to BINARY_NAME_SIZE
+
+	 Fields not selected with --fields are zero.
+	 A directory heading (kind BINARY_RECORD_DIR)
+	 carries the directory's path as its name, as
+	 does the notice that --watch saw a file
+	 removed (kind BINARY_RECORD_REMOVED). Under
+	 --serve, an error met while listing is a
+	 record of kind BINARY_RECORD_ERROR, whose
+	 name is the message. Where the name is
+	 longer than BINARY_NAME_SIZE bytes, the rest
+	 follows in BINARY_RECORD_CONT records, and
+	 'name length' is the full length
+	------------------------------------------------*/
+#define BINARY_MAGIC "MYLSBIN"
 
+#define BINARY_FORMAT_VERSION 1
 
-int main(int argc, char * argv[])
-{
+#define BINARY_HEADER_SIZE 32
 
-	
-	/*=============================================
-	 If the user did not provide any argument,
-	 display the file information of all the files
-	 in the current directory
+#define BINARY_RECORD_SIZE 336
 
-	 Otherwise, display the file information of the
-	 files provided by the user arguments
-	==============================================*/
-	if (argc == 1)
-	{
-		//display information of all files
-		// in current directory
-		displayCurrDirFilesInfo();
+#define BINARY_NAME_OFFSET 80
 
-	}
-	else
-	{
+#define BINARY_NAME_SIZE (BINARY_RECORD_SIZE - BINARY_NAME_OFFSET)
 
-		for (int index=1; index <argc; index++)
-		{
-			displayCurrFileInfo(argv[index]);
-		}
 
-	}
+enum BinaryRecordKind
+{
+	BINARY_RECORD_ENTRY,
+	BINARY_RECORD_DIR,
+	BINARY_RECORD_CONT,
+	BINARY_RECORD_REMOVED,
+	BINARY_RECORD_ERROR
+};
 
 
-	return 0;
-}
 
 
+	/*------------------------------------------------
+	 The ways in which the entries of a directory
+	 can be enumerated
 
-/*--------------------------------------------------------*/
+	 DIR_ENUM_GETDENTS - read the raw kernel records
+		in large batches with getdents64()
 
-void  displayCurrDirFilesInfo()
+	 DIR_ENUM_READDIR - the portable opendir()/
+		readdir() interface, one entry per call
+	------------------------------------------------*/
+enum DirEnumBackend
 {
-	
-	/*============================================
-	 SECTION 1: Declaration of variables
-	=============================================*/
-	
-	DIR * dirHandle = NULL;
-
-	struct dirent * direntPtr = NULL;
+	DIR_ENUM_GETDENTS,
+	DIR_ENUM_READDIR
+};
 
 
+	/*------------------------------------------------
+	 How file information is written
 
-	/*============================================
-	 SECTION 2: Opening the current directory
-	 
-	 If the current directory cannot be opened,
-	  the error message is displayed. The function
-	  then returns immediately
-	=============================================*/
+	 FORMAT_TEXT - the labelled, human-readable block
 
-	dirHandle = opendir("./");
+	 FORMAT_JSONL - one JSON object per line
 
-	
-	if (dirHandle == NULL)
-	{
-		perror("Failed to open current directory");
+	 FORMAT_BIN - fixed-width little-endian records
+		after a versioned header
+	------------------------------------------------*/
+enum OutputFormat
+{
+	FORMAT_TEXT,
+	FORMAT_JSONL,
+	FORMAT_BIN
+};
 
-		return;
-	}
 
+	/*------------------------------------------------
+	 Layout of one record returned by getdents64().
+	 glibc does not export this structure, so it is
+	 declared here as documented in getdents(2)
+	------------------------------------------------*/
+struct LinuxDirent64
+{
+	ino64_t d_ino;
 
-	
+	off64_t d_off;
 
-	/*===========================================
-	 SECTION 3: Displaying file information of
-	 	    each file
+	unsigned short d_reclen;
 
-	 With the exception of the parent
-	 directory('..') and the current
-	 directory('.') itself, all the files in the 
-	 current directory will be displayed
-	============================================*/
-	
-	
-	while((direntPtr = readdir(dirHandle)) != NULL)
-	{
+	unsigned char d_type;
 
-		if ( strcmp( direntPtr->d_name, "..") != 0
-				&&
-		     strcmp( direntPtr->d_name, "." ) != 0)
-		{
+	char d_name[];
+};
 
-			displayCurrFileInfo(
-					direntPtr->d_name );
-		}
 
-	}//end of while loop
+	/*------------------------------------------------
+	 One directory entry as handed out by the
+	 enumerator. 'name' points into the enumerator's
+	 buffer and stays valid only until the next call
+	 to readNextDirEntry()
+	------------------------------------------------*/
+struct DirEntryInfo
+{
+	const char * name;
 
-	
+	ino_t inodeNum;
 
-	/*===============================================
-	 SECTION 4: Closing the current directory
-	================================================*/
-	closedir(dirHandle);
+	unsigned char direntType;
+};
 
-}
 
+	/*------------------------------------------------
+	 State of a directory enumeration. The batch
+	 buffer is allocated once by initDirEnumerator()
+	 and reused for every directory opened with it
+	------------------------------------------------*/
+struct DirEnumerator
+{
+	enum DirEnumBackend backend;
 
-/*---------------------------------------------------------*/
+	DIR * dirHandle;
 
-void displayCurrFileInfo( const char * fileName)
-{
+	int dirFd;
 
+	char * batchBuffer;
 
-	/*==============================================
-	 SECTION 1: Declation of Variables
-	===============================================*/
+	size_t batchBufferSize;
 
-	struct passwd * passwdPtr = NULL;
+	long batchBytes;
 
-	struct group * groupPtr = NULL;
+	long batchOffset;
 
-	int lstatReturnValue;
+	off64_t entryPosition;
+};
 
-	struct stat statBuf;
 
-	uid_t userId;
+	/*------------------------------------------------
+	 Orders in which the entries of a directory can
+	 be displayed (--sort)
 
-	gid_t groupId;
+	 SORT_NONE - directory order, as read
+	 SORT_NAME - by name, byte by byte
+	 SORT_SIZE - largest first, as 'ls -S'
+	 SORT_MTIME - newest first, as 'ls -t'
+	 SORT_INODE - by inode number
 
-	dev_t deviceNumbers;
+	 Entries with equal sizes, times or inode
+	 numbers are ordered by name
+	------------------------------------------------*/
+enum SortKey
+{
+	SORT_NONE,
+	SORT_NAME,
+	SORT_SIZE,
+	SORT_MTIME,
+	SORT_INODE
+};
 
-	unsigned int deviceMajorNum;
 
-	unsigned int deviceMinorNum;
+	/*------------------------------------------------
+	 Maps the name of a sort order to its key and
+	 the statx() bits the key needs
+	------------------------------------------------*/
+struct SortKeyDescriptor
+{
+	const char * sortName;
 
-	ino_t inodeNum;
+	enum SortKey sortKey;
 
-	off_t fileSize;
+	unsigned int statxBits;
+};
 
-	nlink_t numOfHardLinks;
 
-	mode_t fileTypeAndPermsFlags;
+static const struct SortKeyDescriptor sortKeyDescriptors[] =
+{
+	{"none",  SORT_NONE,  0},
+	{"name",  SORT_NAME,  0},
+	{"size",  SORT_SIZE,  STATX_SIZE},
+	{"mtime", SORT_MTIME, STATX_MTIME},
+	{"inode", SORT_INODE, STATX_INO}
+};
 
-	time_t lastAccessTime;
 
-	time_t lastModTime;
+//Number of entries collected and looked up at a
+// time when a directory is listed in directory
+// order (and with --inode-order, looked up in
+// inode order within the batch)
+#define LISTING_BATCH_ENTRIES 8192
 
-	time_t lastStatChgTime;
 
-	char userName[MAX_STRING_SIZE];	
+//Runs of names at least this long are radix
+// sorted rather than compared with strcmp()
+#define NAME_SORT_RADIX_THRESHOLD 64
 
-	char groupName[MAX_STRING_SIZE];
 
+#define NUM_SORT_KEY_DESCRIPTORS \
+	(sizeof(sortKeyDescriptors) / sizeof(sortKeyDescriptors[0]))
 
-	char lastAccessTimeString[MAX_STRING_SIZE];
-	
-	char lastModTimeString[MAX_STRING_SIZE];
 
-	char lastStatChgTimeString[MAX_STRING_SIZE];
+	/*------------------------------------------------
+	 One entry collected for sorting, in 80 bytes
+	 rather than the 144 of a struct stat: the
+	 metadata fields that can be printed or sorted
+	 by, or the 'errno' value of the failed lookup,
+	 and where the entry's name starts in the name
+	 arena. Until the entry is looked up,
+	 'inodeNum' holds the inode number the
+	 directory gave for it
+	------------------------------------------------*/
+struct EntryRecord
+{
+	uint64_t fileSize;
 
-	char fileTypeString[MAX_STRING_SIZE];
+	uint64_t inodeNum;
 
-	char filePermsString[MAX_STRING_SIZE];
+	int64_t lastAccessTime;
 
+	int64_t lastModTime;
 
+	int64_t lastStatChgTime;
 
-	/*==============================================
-	 SECTION 2: Retrieving the information about
-		    the file
+	uint32_t lastModNanoseconds;
 
-	 (a)First we make a system call using 'lstat()'
-	 to retrieve a group of file data stored in
-	 a struct. If lstat fails, it means the
-	 file does not exists, and the function 
-	 returns immediately
+	uint32_t fileTypeAndPermsFlags;
 
+	uint32_t userId;
 
-	 (b)Second, we retrieve the values stored in
-	 the struct.Some of the values can be
-	 retrieved directly, while some other values
-	 require further processing/more library
-	 function calls  to obtain the desired output/data
+	uint32_t groupId;
 
+	uint32_t numOfHardLinks;
 
-	 (b)(i) Values that be retrieved directly:
-	 ----------------------------------
-	 -Size of file (in bytes)
-	 -i-node number
-	 -number of (hard) links
+	uint32_t deviceMajorNum;
 
+	uint32_t deviceMinorNum;
 
-	 (b)(ii)Values that require further processing/
-	 library function calls
-	 --------------------------------------
-	 -user name of owner owner
-	 -group name of group owner
-	 -type of file
-	 -full access permissions information
-	 -device numbers (major and minor numbers)
-	 -last access time
-	 -last modification time
-	 -last time file status changed
-	===============================================*/
+	int32_t errorNumber;
 
+	uint64_t nameOffset;
+};
 
 
-	/*-----------------------------------------
-	 Part (a) Obtaining all the information
-		  about the file and storing
-		  them in a struct 'statBuf'
+//Size of a chunk of the name arena, as a power
+// of two. Names never span two chunks
+#define NAME_CHUNK_SHIFT 18
 
-	  If the files does not exist or the
-	  data cannot be accessed, then an
-	  error message is printed. 
+#define NAME_CHUNK_SIZE ((size_t) 1 << NAME_CHUNK_SHIFT)
 
-	  The function them immediately returns
-	------------------------------------------*/
-	lstatReturnValue = lstat(fileName,  &statBuf);
-	
 
+//Records (and sort items) kept allocated from one
+// directory to the next. Larger arrays are freed
+// once a directory has been written
+#define MAX_KEPT_ENTRY_RECORDS 16384
 
-	if (lstatReturnValue == -1 )
-	{
-		fprintf(stderr,  
-			"\nmyls: Cannot access '%s': %s\n\n", 
-			 fileName, strerror(errno) );
 
-		return;
+	/*------------------------------------------------
+	 The sort key of one record. 'key' is compared
+	 first and 'minorKey' second, both as unsigned
+	 numbers, and 'recordIndex' locates the record.
+	 Only these 16 bytes move while sorting
+	------------------------------------------------*/
+struct SortItem
+{
+	uint64_t key;
+
+	uint32_t minorKey;
+
+	uint32_t recordIndex;
+};
+
+
+	/*------------------------------------------------
+	 The entries of a directory collected for
+	 sorting. Names are packed into a bump-pointer
+	 arena of NAME_CHUNK_SIZE chunks, in which a
+	 name's offset is its chunk index followed by
+	 its position in the chunk, and all records
+	 into the single 'records' array, so collecting
+	 an entry costs no allocation of its own
+
+	 Once a directory has been written, all
+	 records are dropped at once: the arena keeps
+	 only its first chunk, and arrays grown past
+	 MAX_KEPT_ENTRY_RECORDS are freed
+	------------------------------------------------*/
+struct EntryRecordArray
+{
+	char ** nameChunks;
+
+	size_t numNameChunks;
+
+	size_t nameChunksCapacity;
+
+	size_t namesUsed;
+
+	struct EntryRecord * records;
+
+	size_t numRecords;
+
+	size_t recordsCapacity;
+
+	struct SortItem * sortItems;
+
+	struct SortItem * sortScratch;
+
+	size_t sortItemsCapacity;
+};
+
+
+	/*------------------------------------------------
+	 Settings chosen on the command line
+
+	 'outputFields' holds the FIELD_* flags of the
+	 fields to print, and 'statxMask' the STATX_*
+	 flags derived from them, so that statx() is
+	 only asked for what will be printed
+	------------------------------------------------*/
+struct ListingOptions
+{
+	enum DirEnumBackend enumBackend;
+
+	size_t direntBatchSize;
+
+	unsigned int outputFields;
+
+	unsigned int statxMask;
+
+	unsigned int numWorkers;
+
+	int preserveOrder;
+
+	int useUring;
+
+	unsigned int uringQueueDepth;
+
+	size_t outputBufferSize;
+
+	int recursive;
+
+	enum SortKey sortKey;
+
+	int inodeOrder;
+
+	enum OutputFormat outputFormat;
+
+	const char * snapshotPath;
+
+	const char * sinceSnapshotPath;
+
+	int watchChanges;
+
+	int summarize;
+
+	unsigned int summaryTopCount;
+
+	int groupLinks;
+
+	int errorsToOutput;
+};
+
+
+static struct ListingOptions listingOptions =
+{
+	.enumBackend = DIR_ENUM_GETDENTS,
+
+	.direntBatchSize = DEFAULT_DIRENT_BATCH_SIZE,
+
+	.outputFields = FIELD_ALL,
+
+	.statxMask = STATX_BASIC_STATS,
+
+	.numWorkers = 1,
+
+	.preserveOrder = 1,
+
+	.useUring = 0,
+
+	.uringQueueDepth = DEFAULT_URING_QUEUE_DEPTH,
+
+	.outputBufferSize = DEFAULT_OUTPUT_BUFFER_SIZE,
+
+	.recursive = 0,
+
+	.sortKey = SORT_NONE,
+
+	.inodeOrder = 0,
+
+	.outputFormat = FORMAT_TEXT,
+
+	.snapshotPath = NULL,
+
+	.sinceSnapshotPath = NULL,
+
+	.watchChanges = 0,
+
+	.summarize = 0,
+
+	.summaryTopCount = DEFAULT_SUMMARY_TOP_COUNT,
+
+	.groupLinks = 0,
+
+	.errorsToOutput = 0
+};
+
+
+//Predicates of a --filter expression
+#define FILTER_NAME  0x01
+#define FILTER_REGEX 0x02
+#define FILTER_TYPE  0x04
+#define FILTER_SIZE  0x08
+#define FILTER_MTIME 0x10
+#define FILTER_CTIME 0x20
+#define FILTER_UID   0x40
+
+
+//Predicates decided from a directory entry alone,
+// before any lookup. The type is known from
+// d_type, unless the file system reports
+// DT_UNKNOWN
+#define FILTER_NAME_STAGE (FILTER_NAME | FILTER_REGEX | FILTER_TYPE)
+
+//Predicates decided from the metadata, before the
+// names and dates are formatted. The type is
+// checked again, for DT_UNKNOWN entries
+#define FILTER_STAT_STAGE (FILTER_TYPE | FILTER_SIZE | FILTER_MTIME \
+			   | FILTER_CTIME | FILTER_UID)
+
+
+	/*------------------------------------------------
+	 A --filter expression, compiled once by
+	 parseFilterExpression(). An entry is listed
+	 only if it satisfies every predicate in
+	 'predicates'
+
+	 'typeMask' has bit DT_x set for every type
+	 allowed. The ages given are kept, and the
+	 absolute time ranges are worked out from
+	 them and the time of the listing, by
+	 updateFilterTimes()
+	------------------------------------------------*/
+struct EntryFilter
+{
+	unsigned int predicates;
+
+	const char * nameGlob;
+
+	regex_t nameRegex;
+
+	unsigned int typeMask;
+
+	uint64_t minSize;
+
+	uint64_t maxSize;
+
+	uint64_t minModAge;
+
+	uint64_t maxModAge;
+
+	uint64_t minChgAge;
+
+	uint64_t maxChgAge;
+
+	int64_t minModTime;
+
+	int64_t maxModTime;
+
+	int64_t minChgTime;
+
+	int64_t maxChgTime;
+
+	uid_t userId;
+};
+
+
+	/*------------------------------------------------
+	 Maps the name of a --filter predicate to its
+	 flag and the statx() bits it needs
+	------------------------------------------------*/
+struct FilterPredicateDescriptor
+{
+	const char * predicateName;
+
+	unsigned int predicate;
+
+	unsigned int statxBits;
+};
+
+
+static const struct FilterPredicateDescriptor
+	filterPredicateDescriptors[] =
+{
+	{"name",  FILTER_NAME,  0},
+	{"regex", FILTER_REGEX, 0},
+	{"type",  FILTER_TYPE,  STATX_TYPE},
+	{"size",  FILTER_SIZE,  STATX_SIZE},
+	{"mtime", FILTER_MTIME, STATX_MTIME},
+	{"ctime", FILTER_CTIME, STATX_CTIME},
+	{"uid",   FILTER_UID,   STATX_UID}
+};
+
+
+#define NUM_FILTER_PREDICATE_DESCRIPTORS \
+	(sizeof(filterPredicateDescriptors) \
+	 / sizeof(filterPredicateDescriptors[0]))
+
+
+//Set by --filter
+static struct EntryFilter entryFilter =
+{
+	.predicates = 0
+};
+
+
+	/*------------------------------------------------
+	 Brief: Return whether the entry 'fileName' of
+		type 'direntType' (a DT_* value) passes
+		the name-stage predicates of the filter,
+		and whether metadata 'statBuf' passes
+		the stat-stage ones
+	------------------------------------------------*/
+int matchEntryName(const char * fileName,
+		   unsigned char direntType);
+
+int matchEntryStat(const struct stat * statBuf);
+
+
+	/*------------------------------------------------
+	 Brief: The same, returning 1 at once when the
+		filter has no predicates of that stage
+	------------------------------------------------*/
+static inline int isEntryNameListed(const char * fileName,
+				    unsigned char direntType)
+{
+	return (entryFilter.predicates & FILTER_NAME_STAGE) == 0
+	       || matchEntryName(fileName, direntType);
+}
+
+
+static inline int isEntryStatListed(const struct stat * statBuf)
+{
+	return (entryFilter.predicates & FILTER_STAT_STAGE) == 0
+	       || matchEntryStat(statBuf);
+}
+
+
+	/*------------------------------------------------
+	 An append buffer that records are formatted
+	 into. A buffer with a descriptor is flushed to
+	 it with write()/writev() whenever it fills up;
+	 a buffer with 'outputFd' -1 instead grows, and
+	 holds formatted records in memory (e.g. in the
+	 worker threads of the -j mode)
+
+	 'hasFailed' is set once a write or allocation
+	 has failed, after which output is dropped
+
+	 A memory buffer with a 'spillSize' other than
+	 zero grows to that many bytes at most, and is
+	 then flushed to 'spillFd' like a buffer with a
+	 descriptor (the replies of --serve, spilled to
+	 a temporary file)
+	------------------------------------------------*/
+struct OutputBuffer
+{
+	int outputFd;
+
+	char * data;
+
+	size_t length;
+
+	size_t capacity;
+
+	int hasFailed;
+
+	int spillFd;
+
+	size_t spillSize;
+};
+
+
+//Everything listed on stdout goes through here
+static struct OutputBuffer stdoutBuffer =
+{
+	.outputFd = -1
+};
+
+
+	/*------------------------------------------------
+	 Layout of a --snapshot file, which is mapped
+	 into memory and read in place. Values are in
+	 the byte order of the machine that wrote it,
+	 which 'byteOrderMark' records
+
+	 The header is followed by one section per
+	 listed directory, then the directories'
+	 paths, then a table of SnapshotDir entries
+	 sorted by path. A section holds one column per
+	 field, of 'numEntries' values each: inode,
+	 size, atime, mtime and ctime (64-bit), then
+	 mtime nanoseconds, mode, uid, gid, links,
+	 device major and minor, name offset and name
+	 order (32-bit), and finally the names,
+	 NUL-terminated, padded to 8 bytes. 'name
+	 order' lists the entries by name, so a name
+	 is found with a binary search
+	------------------------------------------------*/
+#define SNAPSHOT_MAGIC "MYLSSNP"
+
+#define SNAPSHOT_FORMAT_VERSION 1
+
+#define SNAPSHOT_BYTE_ORDER_MARK 0x01020304u
+
+
+//Bytes of each entry in the columns of a section
+#define SNAPSHOT_BYTES_PER_ENTRY (5 * 8 + 9 * 4)
+
+
+//A directory whose mtime is less than this many
+// seconds before the snapshot was begun could
+// have changed again within the same tick of the
+// clock, and is not trusted to be unchanged
+#define SNAPSHOT_RACY_SECONDS 1
+
+
+struct SnapshotHeader
+{
+	char magic[8];
+
+	uint32_t formatVersion;
+
+	uint32_t byteOrderMark;
+
+	uint64_t fileSize;
+
+	int64_t startTime;
+
+	uint64_t numDirs;
+
+	uint64_t dirTableOffset;
+
+	uint64_t reserved[2];
+};
+
+
+struct SnapshotDir
+{
+	uint64_t pathOffset;
+
+	uint64_t sectionOffset;
+
+	uint64_t numEntries;
+
+	uint64_t namesLength;
+
+	uint64_t dirInode;
+
+	uint64_t dirDevice;
+
+	int64_t dirModTime;
+
+	uint32_t dirModNanoseconds;
+
+	uint32_t reserved;
+};
+
+
+	/*------------------------------------------------
+	 The columns of one section, located in the
+	 mapped snapshot
+	------------------------------------------------*/
+struct SnapshotColumns
+{
+	size_t numEntries;
+
+	const uint64_t * inodeNums;
+
+	const uint64_t * fileSizes;
+
+	const int64_t * lastAccessTimes;
+
+	const int64_t * lastModTimes;
+
+	const int64_t * lastStatChgTimes;
+
+	const uint32_t * lastModNanoseconds;
+
+	const uint32_t * fileTypeAndPermsFlags;
+
+	const uint32_t * userIds;
+
+	const uint32_t * groupIds;
+
+	const uint32_t * numOfHardLinks;
+
+	const uint32_t * deviceMajorNums;
+
+	const uint32_t * deviceMinorNums;
+
+	const uint32_t * nameOffsets;
+
+	const uint32_t * nameOrder;
+
+	const char * names;
+};
+
+
+	/*------------------------------------------------
+	 A snapshot read with --since-snapshot. 'data'
+	 is NULL when there is none
+	------------------------------------------------*/
+struct Snapshot
+{
+	const unsigned char * data;
+
+	size_t dataLength;
+
+	const struct SnapshotHeader * header;
+
+	const struct SnapshotDir * dirs;
+};
+
+
+	/*------------------------------------------------
+	 A snapshot being written with --snapshot. The
+	 sections go to a temporary file as each
+	 directory is listed, while the directory table
+	 and the paths are kept in memory until the
+	 end, when the file is completed and renamed
+	 over 'filePath'
+	------------------------------------------------*/
+struct SnapshotWriter
+{
+	const char * filePath;
+
+	char * tempPath;
+
+	struct OutputBuffer output;
+
+	uint64_t fileOffset;
+
+	int64_t startTime;
+
+	struct SnapshotDir * dirs;
+
+	size_t numDirs;
+
+	size_t dirsCapacity;
+
+	char * paths;
+
+	size_t pathsUsed;
+
+	size_t pathsCapacity;
+
+	uint32_t * sectionIndices;
+
+	size_t sectionIndicesCapacity;
+};
+
+
+static struct Snapshot previousSnapshot;
+
+static struct SnapshotWriter snapshotWriter;
+
+
+	/*------------------------------------------------
+	 Counters of the work --since-snapshot saved,
+	 printed with --stats
+	------------------------------------------------*/
+struct SnapshotStats
+{
+	unsigned long dirsReused;
+
+	unsigned long dirsRead;
+
+	unsigned long entriesReused;
+
+	unsigned long entriesLookedUp;
+};
+
+
+static struct SnapshotStats snapshotStats;
+
+
+//Default for --watch-window, in milliseconds
+#define DEFAULT_WATCH_WINDOW_MS 50
+
+
+//Events read from inotify at a time
+#define WATCH_EVENT_BUFFER_SIZE (64 * 1024)
+
+
+//What is reported for a watched directory: its
+// entries appearing, changing or going, and the
+// directory itself going
+#define WATCH_DIR_EVENTS (IN_CREATE | IN_DELETE | IN_MODIFY \
+			  | IN_ATTRIB | IN_MOVED_FROM | IN_MOVED_TO \
+			  | IN_DELETE_SELF | IN_MOVE_SELF \
+			  | IN_EXCL_UNLINK)
+
+
+//What is reported for a watched file. A
+// symbolic link is watched itself, as it is
+// listed itself
+#define WATCH_FILE_EVENTS (IN_MODIFY | IN_ATTRIB | IN_DELETE_SELF \
+			   | IN_MOVE_SELF | IN_DONT_FOLLOW)
+
+
+	/*------------------------------------------------
+	 A file or directory watched with --watch. The
+	 kernel numbers watches with small integers, so
+	 the watch of an event is found by indexing
+	 'WatchState.targets' with the number
+	------------------------------------------------*/
+struct WatchTarget
+{
+	char * path;
+
+	int isDir;
+
+	int isWatched;
+};
+
+
+	/*------------------------------------------------
+	 State of --watch. Changes are collected as the
+	 offsets of their paths in the 'pendingPaths'
+	 arena, and found again through 'pendingSlots',
+	 an open-addressing hash table of indices into
+	 'pendingChanges' (plus one, so that zero marks
+	 a free slot). A path already pending is not
+	 added again, so a burst of events on a file
+	 within the window is reported once, as is a
+	 subdirectory that both it and its parent are
+	 watched for
+	------------------------------------------------*/
+struct WatchState
+{
+	int inotifyFd;
+
+	unsigned long windowMilliseconds;
+
+	struct WatchTarget * targets;
+
+	size_t targetsCapacity;
+
+	size_t numWatched;
+
+	size_t * pendingChanges;
+
+	size_t numPendingChanges;
+
+	size_t pendingChangesCapacity;
+
+	char * pendingPaths;
+
+	size_t pendingPathsUsed;
+
+	size_t pendingPathsCapacity;
+
+	uint32_t * pendingSlots;
+
+	size_t numPendingSlots;
+};
+
+
+static struct WatchState watchState =
+{
+	.inotifyFd = -1,
+
+	.windowMilliseconds = DEFAULT_WATCH_WINDOW_MS
+};
+
+
+//Set by SIGINT or SIGTERM to end --serve
+static volatile sig_atomic_t stopServing = 0;
+
+
+	/*------------------------------------------------
+	 State of --serve. The main thread accepts the
+	 clients and queues their connections in the
+	 ring 'queuedFds', from which NUM_SERVE_THREADS
+	 threads take them. Listing uses the global
+	 options and stdout buffer, so requests are
+	 listed one at a time, under 'listingLock',
+	 but are read and have their replies sent in
+	 parallel
+	------------------------------------------------*/
+struct ServeState
+{
+	pthread_mutex_t queueLock;
+
+	pthread_cond_t queueChanged;
+
+	int queuedFds[SERVE_QUEUE_SIZE];
+
+	size_t queueStart;
+
+	size_t numQueued;
+
+	int isStopping;
+
+	pthread_mutex_t listingLock;
+
+	const struct ListingOptions * defaultOptions;
+
+	unsigned int extraStatxBits;
+};
+
+
+static struct ServeState serveState =
+{
+	.queueLock = PTHREAD_MUTEX_INITIALIZER,
+
+	.queueChanged = PTHREAD_COND_INITIALIZER,
+
+	.listingLock = PTHREAD_MUTEX_INITIALIZER
+};
+
+//Files and directories that could not be
+// listed, counted from every thread, which
+// --serve reports at the end of each reply
+static unsigned int numListingErrors = 0;
+
+
+	/*------------------------------------------------
+	 File type strings, indexed by the S_IFMT bits
+	 of a mode shifted down to 0..15
+	------------------------------------------------*/
+#define FILE_TYPE_SHIFT 12
+
+static const char * const fileTypeTable[16] =
+{
+	[S_IFREG >> FILE_TYPE_SHIFT]  = "Regular",
+	[S_IFBLK >> FILE_TYPE_SHIFT]  = "Block Device",
+	[S_IFCHR >> FILE_TYPE_SHIFT]  = "Character Device",
+	[S_IFDIR >> FILE_TYPE_SHIFT]  = "Directory",
+	[S_IFLNK >> FILE_TYPE_SHIFT]  = "Symbolic Link",
+	[S_IFIFO >> FILE_TYPE_SHIFT]  = "Named Pipe",
+	[S_IFSOCK >> FILE_TYPE_SHIFT] = "Socket",
+
+	//Values no file type uses
+	[0]  = "Unknown",
+	[3]  = "Unknown",
+	[5]  = "Unknown",
+	[7]  = "Unknown",
+	[9]  = "Unknown",
+	[11] = "Unknown",
+	[13] = "Unknown",
+	[15] = "Unknown"
+};
+
+
+	/*------------------------------------------------
+	 Permission strings for all 4096 combinations of
+	 the nine permission bits and the setuid, setgid
+	 and sticky bits, generated by the preprocessor
+
+	 FILE_PERMS_STRING(mode) builds the entry of one
+	 mode, and each FILE_PERMS_ROW* macro expands to
+	 four times as many consecutive entries as the
+	 one below it
+	------------------------------------------------*/
+#define FILE_PERMS_MASK 07777
+
+#define FILE_PERMS_BIT(mode, bit, letter) \
+	(((mode) & (bit)) ? (letter) : '-')
+
+#define FILE_PERMS_EXEC(mode, execBit, specialBit, \
+			withExec, withoutExec) \
+	(((mode) & (specialBit)) \
+		? (((mode) & (execBit)) ? (withExec) : (withoutExec)) \
+		: FILE_PERMS_BIT(mode, execBit, 'x'))
+
+#define FILE_PERMS_STRING(mode) \
+	{ \
+		FILE_PERMS_BIT(mode, S_IRUSR, 'r'), \
+		FILE_PERMS_BIT(mode, S_IWUSR, 'w'), \
+		FILE_PERMS_EXEC(mode, S_IXUSR, S_ISUID, 's', 'S'), \
+		FILE_PERMS_BIT(mode, S_IRGRP, 'r'), \
+		FILE_PERMS_BIT(mode, S_IWGRP, 'w'), \
+		FILE_PERMS_EXEC(mode, S_IXGRP, S_ISGID, 's', 'S'), \
+		FILE_PERMS_BIT(mode, S_IROTH, 'r'), \
+		FILE_PERMS_BIT(mode, S_IWOTH, 'w'), \
+		FILE_PERMS_EXEC(mode, S_IXOTH, S_ISVTX, 't', 'T'), \
+		'\0' \
+	}
+
+#define FILE_PERMS_ROW4(mode) \
+	FILE_PERMS_STRING(mode),     FILE_PERMS_STRING((mode) + 1), \
+	FILE_PERMS_STRING((mode) + 2), FILE_PERMS_STRING((mode) + 3)
+
+#define FILE_PERMS_ROW16(mode) \
+	FILE_PERMS_ROW4(mode),        FILE_PERMS_ROW4((mode) + 4), \
+	FILE_PERMS_ROW4((mode) + 8),  FILE_PERMS_ROW4((mode) + 12)
+
+#define FILE_PERMS_ROW64(mode) \
+	FILE_PERMS_ROW16(mode),       FILE_PERMS_ROW16((mode) + 16), \
+	FILE_PERMS_ROW16((mode) + 32), FILE_PERMS_ROW16((mode) + 48)
+
+#define FILE_PERMS_ROW256(mode) \
+	FILE_PERMS_ROW64(mode),        FILE_PERMS_ROW64((mode) + 64), \
+	FILE_PERMS_ROW64((mode) + 128), FILE_PERMS_ROW64((mode) + 192)
+
+#define FILE_PERMS_ROW1024(mode) \
+	FILE_PERMS_ROW256(mode),        FILE_PERMS_ROW256((mode) + 256), \
+	FILE_PERMS_ROW256((mode) + 512), FILE_PERMS_ROW256((mode) + 768)
+
+static const char filePermsTable[FILE_PERMS_MASK + 1][10] =
+{
+	FILE_PERMS_ROW1024(0),
+	FILE_PERMS_ROW1024(1024),
+	FILE_PERMS_ROW1024(2048),
+	FILE_PERMS_ROW1024(3072)
+};
+
+
+#define SECONDS_PER_DAY 86400
+
+
+//Number of slots of each thread's day cache.
+// Always a power of two
+#define DAY_CACHE_SLOTS 256
+
+
+	/*------------------------------------------------
+	 One local day, [dayStart, dayEnd) in Unix time,
+	 throughout which the offset from UTC does not
+	 change. Any time within it shares the date
+	 stored here, and its hour and minute follow
+	 from the seconds elapsed since 'dayStart'
+	------------------------------------------------*/
+struct DayCacheEntry
+{
+	time_t dayStart;
+
+	time_t dayEnd;
+
+	int year;
+
+	int day;
+
+	char monthString[4];
+};
+
+
+	/*------------------------------------------------
+	 Days looked up by convertTimeToDateString(),
+	 indexed by UTC day number. Each thread has its
+	 own cache, so no locking is needed. An empty
+	 slot has dayStart == dayEnd and matches nothing
+	------------------------------------------------*/
+static __thread struct DayCacheEntry dayCache[DAY_CACHE_SLOTS];
+
+
+//The current year, and the time at which it
+// ends. Set by initTimeFormatting(), and moved
+// on by updateTimeFormattingYear() in runs that
+// outlive a year (--watch, --serve). The year is
+// read by every listing thread, so atomically
+static int timeFormatCurrentYear;
+
+static time_t timeFormatYearEnd;
+
+static pthread_once_t timeFormattingInitOnce = PTHREAD_ONCE_INIT;
+
+static pthread_mutex_t timeFormatYearLock = PTHREAD_MUTEX_INITIALIZER;
+
+
+	/*------------------------------------------------
+	 Name of each selectable field, together with
+	 the statx() request bits the field needs. The
+	 device numbers are always returned by statx(),
+	 so they need no request bit
+	------------------------------------------------*/
+struct FieldDescriptor
+{
+	const char * fieldName;
+
+	unsigned int fieldFlag;
+
+	unsigned int statxBits;
+};
+
+
+static const struct FieldDescriptor fieldDescriptors[] =
+{
+	{"name",  FIELD_NAME,      0},
+	{"user",  FIELD_USER,      STATX_UID},
+	{"group", FIELD_GROUP,     STATX_GID},
+	{"type",  FIELD_TYPE,      STATX_TYPE},
+	{"perms", FIELD_PERMS,     STATX_MODE},
+	{"size",  FIELD_SIZE,      STATX_SIZE},
+	{"inode", FIELD_INODE,     STATX_INO},
+	{"major", FIELD_DEV_MAJOR, 0},
+	{"minor", FIELD_DEV_MINOR, 0},
+	{"links", FIELD_LINKS,     STATX_NLINK},
+	{"atime", FIELD_ATIME,     STATX_ATIME},
+	{"mtime", FIELD_MTIME,     STATX_MTIME},
+	{"ctime", FIELD_CTIME,     STATX_CTIME}
+};
+
+
+#define NUM_FIELD_DESCRIPTORS \
+	(sizeof(fieldDescriptors) / sizeof(fieldDescriptors[0]))
+
+
+//Number of pipeline slots per worker thread
+// in the -j mode. This bounds how far the
+// producer can run ahead of the writer
+#define PIPELINE_SLOTS_PER_WORKER 64
+
+
+//Largest number of worker threads accepted
+// by -j
+#define MAX_WORKER_THREADS 256
+
+
+//Initial number of slots of each name cache.
+// Always a power of two
+#define INITIAL_NAME_CACHE_SLOTS 64
+
+
+//Text shown when a user or group name cannot
+// be retrieved
+#define NAME_NOT_AVAILABLE "Not Available"
+
+
+	/*------------------------------------------------
+	 One slot of a uid->name or gid->name cache.
+	 'name' is NULL when the lookup failed, so that
+	 failures are cached as well
+	------------------------------------------------*/
+struct NameCacheSlot
+{
+	unsigned int id;
+
+	int isUsed;
+
+	char * name;
+};
+
+
+	/*------------------------------------------------
+	 An open-addressing hash table with linear
+	 probing, filled on the first lookup of each
+	 id. The table doubles once half of it is used.
+	 Names are allocated separately, so a returned
+	 name stays valid when the table grows.
+	 'lock' makes the cache safe to share between
+	 the worker threads of the -j mode
+	------------------------------------------------*/
+struct NameCache
+{
+	pthread_mutex_t lock;
+
+	struct NameCacheSlot * slots;
+
+	size_t numSlots;
+
+	size_t numUsedSlots;
+
+	unsigned long numHits;
+
+	unsigned long numMisses;
+};
+
+
+static struct NameCache userNameCache =
+{
+	.lock = PTHREAD_MUTEX_INITIALIZER
+};
+
+static struct NameCache groupNameCache =
+{
+	.lock = PTHREAD_MUTEX_INITIALIZER
+};
+
+
+	/*------------------------------------------------
+	 States of a slot of the -j pipeline. A slot
+	 moves FREE -> PENDING (named by the producer)
+	 -> DONE (formatted by a worker) -> FREE
+	 (emitted by the writer)
+	------------------------------------------------*/
+enum PipelineSlotState
+{
+	SLOT_FREE,
+	SLOT_PENDING,
+	SLOT_DONE
+};
+
+
+	/*------------------------------------------------
+	 One entry travelling through the pipeline. The
+	 name and text buffers are kept and reused by
+	 the next entry that occupies the slot
+	------------------------------------------------*/
+struct PipelineSlot
+{
+	enum PipelineSlotState state;
+
+	char * name;
+
+	size_t nameCapacity;
+
+	struct OutputBuffer text;
+};
+
+
+	/*------------------------------------------------
+	 The file arguments to list: those of the
+	 command line, then, with --files-from, the
+	 names read from 'listFile', each ended by
+	 'delimiter' ('\n', or '\0' with -0). 'line'
+	 holds the last name read, and is reused for
+	 the next one
+
+	 'readFailed' is set if 'listFile' could not
+	 be read to its end
+	------------------------------------------------*/
+struct FileArgumentReader
+{
+	char ** arguments;
+
+	int numArguments;
+
+	int nextArgument;
+
+	FILE * listFile;
+
+	const char * listPath;
+
+	int delimiter;
+
+	char * line;
+
+	size_t lineCapacity;
+
+	int readFailed;
+};
+
+
+	/*------------------------------------------------
+	 Shared state of the -j pipeline: a producer
+	 thread enumerates the directory, worker threads
+	 retrieve and format the metadata, and the
+	 calling thread alone writes the results
+
+	 The file arguments are listed the same way,
+	 with the producer taking their names from
+	 'fileArguments' instead, when 'enumerator' is
+	 NULL
+
+	 In order-preserving mode, the entry with
+	 sequence number N always occupies slot
+	 N % numSlots, and the writer emits the slots
+	 strictly in sequence. Otherwise free slots are
+	 taken from 'freeSlots' and the writer emits
+	 whatever 'doneQueue' holds, in completion order
+
+	 'pendingQueue' and 'doneQueue' are rings of
+	 slot indices, each with room for every slot
+
+	 'readErrorNumber' is the 'errno' value of a
+	 failure to read the directory, or 0
+	------------------------------------------------*/
+struct StatPipeline
+{
+	pthread_mutex_t lock;
+
+	pthread_cond_t slotFreed;
+
+	pthread_cond_t workAvailable;
+
+	pthread_cond_t resultReady;
+
+	struct PipelineSlot * slots;
+
+	size_t numSlots;
+
+	size_t * pendingQueue;
+
+	size_t pendingHead;
+
+	size_t numPending;
+
+	size_t * doneQueue;
+
+	size_t doneHead;
+
+	size_t numDone;
+
+	size_t * freeSlots;
+
+	size_t numFreeSlots;
+
+	unsigned long numProduced;
+
+	unsigned long numWritten;
+
+	int producerFinished;
+
+	int preserveOrder;
+
+	struct DirEnumerator * enumerator;
+
+	struct FileArgumentReader * fileArguments;
+
+	const char * dirPath;
+
+	int dirFd;
+
+	int readErrorNumber;
+};
+
+
+//Set by --stats
+static int printStats = 0;
+
+
+//Each power of two nanoseconds is split into
+// 2^STAGE_HISTOGRAM_SUB_BITS buckets
+#define STAGE_HISTOGRAM_SUB_BITS 2
+
+#define STAGE_HISTOGRAM_BUCKETS (64 << STAGE_HISTOGRAM_SUB_BITS)
+
+
+	/*------------------------------------------------
+	 The steps of listing a file that --stats
+	 times, in the order they are reported
+	------------------------------------------------*/
+enum TimedStage
+{
+	TIMED_STAT,
+	TIMED_USER_NAME,
+	TIMED_GROUP_NAME,
+	TIMED_DATE,
+	TIMED_WRITE,
+	NUM_TIMED_STAGES
+};
+
+
+static const char * const timedStageNames[NUM_TIMED_STAGES] =
+{
+	"stat", "user name", "group name", "date", "write"
+};
+
+
+	/*------------------------------------------------
+	 The durations of one stage, in a log-linear
+	 histogram: the range from each power of two to
+	 the next is split into four equal buckets, so
+	 a percentile is known to within 25% at the
+	 cost of counting leading zeros once per call
+	------------------------------------------------*/
+struct StageHistogram
+{
+	unsigned long numCalls;
+
+	unsigned long long totalNanoseconds;
+
+	unsigned long bucketCounts[STAGE_HISTOGRAM_BUCKETS];
+};
+
+
+	/*------------------------------------------------
+	 Each thread times its calls into its own
+	 histograms, without locking, and adds them to
+	 the shared ones with mergeStageTimings() when
+	 it is done
+	------------------------------------------------*/
+static __thread struct StageHistogram
+	threadStageTimings[NUM_TIMED_STAGES];
+
+static struct StageHistogram stageTimings[NUM_TIMED_STAGES];
+
+static pthread_mutex_t stageTimingsLock = PTHREAD_MUTEX_INITIALIZER;
+
+
+	/*------------------------------------------------
+	 Brief: Returns the time a stage starts at, or 0
+		without reading the clock if --stats is
+		off
+	------------------------------------------------*/
+static inline unsigned long long startStageTimer()
+{
+	struct timespec now;
+
+
+	if (!printStats)
+	{
+		return 0;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return (unsigned long long) now.tv_sec * 1000000000ULL
+	       + now.tv_nsec;
+}
+
+
+	/*------------------------------------------------
+	 Brief: Adds the time since 'startTime' to the
+		histogram of 'stage' of this thread, if
+		--stats is on
+	------------------------------------------------*/
+static inline void stopStageTimer(enum TimedStage stage,
+				  unsigned long long startTime)
+{
+	struct StageHistogram * histogramPtr = NULL;
+
+	unsigned long long elapsed;
+
+	int topBit;
+
+	int bucket;
+
+
+	if (!printStats)
+	{
+		return;
+	}
+
+	elapsed = startStageTimer() - startTime;
+
+
+	//Times below 2^SUB_BITS have a bucket each.
+	// Above, the top bit picks the power of two
+	// and the bits below it the bucket within
+	if (elapsed < (1U << STAGE_HISTOGRAM_SUB_BITS))
+	{
+		bucket = (int) elapsed;
+	}
+	else
+	{
+		topBit = 63 - __builtin_clzll(elapsed);
+
+		bucket = ((topBit - STAGE_HISTOGRAM_SUB_BITS + 1)
+			  << STAGE_HISTOGRAM_SUB_BITS)
+			 + (int) ((elapsed >> (topBit
+					       - STAGE_HISTOGRAM_SUB_BITS))
+				  & ((1U << STAGE_HISTOGRAM_SUB_BITS) - 1));
+	}
+
+	histogramPtr = &threadStageTimings[stage];
+
+	histogramPtr->numCalls++;
+
+	histogramPtr->totalNanoseconds += elapsed;
+
+	histogramPtr->bucketCounts[bucket]++;
+}
+
+
+	/*------------------------------------------------
+	 The mtime ages --summary counts entries by:
+	 each bucket takes the entries younger than
+	 'maxAge' seconds and not younger than the
+	 previous bucket's. Times in the future count
+	 as the youngest
+	------------------------------------------------*/
+struct SummaryAgeBucket
+{
+	int64_t maxAge;
+
+	const char * label;
+};
+
+
+static const struct SummaryAgeBucket summaryAgeBuckets[] =
+{
+	{60 * 60,            "1 hour"},
+	{24 * 60 * 60,       "1 day"},
+	{7 * 24 * 60 * 60,   "1 week"},
+	{30 * 24 * 60 * 60,  "30 days"},
+	{365 * 24 * 60 * 60, "1 year"},
+	{INT64_MAX,          NULL}
+};
+
+
+#define NUM_SUMMARY_AGE_BUCKETS \
+	(sizeof(summaryAgeBuckets) / sizeof(summaryAgeBuckets[0]))
+
+
+	/*------------------------------------------------
+	 A candidate for the largest files of
+	 --summary, with its path allocated
+	------------------------------------------------*/
+struct LargestFile
+{
+	uint64_t fileSize;
+
+	char * path;
+};
+
+
+	/*------------------------------------------------
+	 What --summary adds up: entries and bytes in
+	 all, by file type (indexed as 'fileTypeTable')
+	 and by mtime age, and how many names of
+	 inodes already counted were left out
+
+	 'largestFiles' is a min-heap of the largest
+	 regular files seen (see isLargerFile()), so
+	 whether a file belongs in it is told by
+	 comparing with the smallest
+	------------------------------------------------*/
+struct SummaryTotals
+{
+	unsigned long long numEntries;
+
+	unsigned long long numBytes;
+
+	unsigned long long typeEntries[16];
+
+	unsigned long long typeBytes[16];
+
+	unsigned long long ageEntries[NUM_SUMMARY_AGE_BUCKETS];
+
+	unsigned long long ageBytes[NUM_SUMMARY_AGE_BUCKETS];
+
+	unsigned long long numLinksSkipped;
+
+	struct LargestFile * largestFiles;
+
+	size_t numLargestFiles;
+};
+
+
+	/*------------------------------------------------
+	 Each thread adds to its own totals, without
+	 locking, and merges them into the shared ones
+	 with mergeSummaryTotals() when it is done, as
+	 with the stage timings. 'listedDirPath' is
+	 the directory whose entries the thread is
+	 listing, to name the largest files and the
+	 names of --links by, or NULL when they are
+	 named by their full path
+	------------------------------------------------*/
+static __thread struct SummaryTotals threadSummary;
+
+static __thread const char * listedDirPath = NULL;
+
+static struct SummaryTotals summaryTotals;
+
+static pthread_mutex_t summaryTotalsLock = PTHREAD_MUTEX_INITIALIZER;
+
+
+//The time --summary measures ages from
+static time_t summaryStartTime;
+
+
+	/*------------------------------------------------
+	 A set of (device, inode) pairs, in an
+	 open-addressing table of 'numSlots' (a power
+	 of two) slots, in which an inode number of 0
+	 marks an empty slot
+
+	 A slot takes 16 bytes: the device is held as
+	 the kernel's own 32-bit number (see
+	 packDeviceId()), which leaves room for
+	 'lastName', the index + 1 in the names of
+	 --links of the latest name found of the inode
+	 (0 for none). As the table is grown past
+	 seven eighths full, an inode takes 18 to 37
+	 bytes of it. Keys are placed by Robin Hood
+	 probing (see placeInodeKey()), which keeps
+	 probes short at that load
+
+	 --summary counts a file with several links
+	 under the first name it is found by only.
+	 Such files are rare, so all threads share one
+	 set under its lock rather than merge sets of
+	 their own
+	------------------------------------------------*/
+struct InodeKey
+{
+	uint64_t inode;
+
+	uint32_t device;
+
+	uint32_t lastName;
+};
+
+
+struct InodeSet
+{
+	struct InodeKey * slots;
+
+	size_t numSlots;
+
+	size_t numUsed;
+
+	pthread_mutex_t lock;
+};
+
+
+static struct InodeSet linkedInodes =
+{
+	.lock = PTHREAD_MUTEX_INITIALIZER
+};
+
+
+	/*------------------------------------------------
+	 A name --links found an inode with several
+	 links by, with its path allocated.
+	 'previousName' is the index + 1 of the name
+	 found before it of the same inode (0 for
+	 none), so that the names of an inode are
+	 chained from the 'lastName' of its key
+	------------------------------------------------*/
+struct LinkedName
+{
+	char * path;
+
+	uint32_t previousName;
+
+	uint32_t numLinks;
+};
+
+
+	/*------------------------------------------------
+	 What --links collects: the inodes with
+	 several links, and every name they were
+	 found by. Both are kept under the lock of
+	 'inodes'. 'isIncomplete' is set if a name
+	 could not be kept for lack of memory
+	------------------------------------------------*/
+struct LinkGroups
+{
+	struct InodeSet inodes;
+
+	struct LinkedName * names;
+
+	size_t numNames;
+
+	size_t maxNames;
+
+	int isIncomplete;
+};
+
+
+static struct LinkGroups linkGroups =
+{
+	.inodes = {.lock = PTHREAD_MUTEX_INITIALIZER}
+};
+
+
+	/*------------------------------------------------
+	 An inode --links reports, with its names
+	 sorted. 'device' is packed as in its key
+	------------------------------------------------*/
+struct LinkedFile
+{
+	char ** paths;
+
+	size_t numPaths;
+
+	uint64_t inode;
+
+	uint32_t device;
+
+	uint32_t numLinks;
+};
+
+
+	/*------------------------------------------------
+	 One level of the directory being walked by -R.
+	 The walk keeps only the deepest directory open,
+	 so each level records where to resume reading
+	 its directory and the identity of that
+	 directory, which is checked when the walk
+	 returns to it through '..'
+
+	 'pathLength' is the length of the directory's
+	 path within the walk's path buffer
+	------------------------------------------------*/
+struct DirTreeFrame
+{
+	off64_t resumePosition;
+
+	dev_t deviceId;
+
+	ino_t inodeNum;
+
+	size_t pathLength;
+};
+
+
+	/*------------------------------------------------
+	 State of a -R walk: the stack of levels from
+	 the starting directory down to the current one,
+	 and the path of the current directory
+	------------------------------------------------*/
+struct DirTreeWalk
+{
+	struct DirTreeFrame * frames;
+
+	size_t numFrames;
+
+	size_t framesCapacity;
+
+	char * path;
+
+	size_t pathLength;
+
+	size_t pathCapacity;
+};
+
+//Number of names handed out per task when a
+// directory is split in the parallel -R mode
+#define TREE_BATCH_ENTRIES 1024
+
+
+//Initial number of tasks each worker's deque
+// has room for. Deques grow as needed
+#define INITIAL_TREE_DEQUE_CAPACITY 256
+
+
+	/*------------------------------------------------
+	 An open directory shared by the tasks that
+	 list parts of it in the parallel -R mode. The
+	 descriptor is closed when the last task
+	 releases its reference
+	------------------------------------------------*/
+struct TreeDirRef
+{
+	int dirFd;
+
+	unsigned int refCount;
+
+	char path[];
+};
+
+
+	/*------------------------------------------------
+	 Kinds of task of the parallel -R mode
+
+	 TREE_TASK_DIR - enumerate the directory whose
+		path is in 'text', queueing its
+		subdirectories and batches of its entries.
+		If the path is too long to open, 'dirRef'
+		is its parent, and the directory is opened
+		relative to it by the name at 'nameOffset'
+
+	 TREE_TASK_ENTRIES - display the 'numNames'
+		NUL-terminated names packed in 'text',
+		which belong to the directory 'dirRef'
+	------------------------------------------------*/
+enum TreeTaskKind
+{
+	TREE_TASK_DIR,
+	TREE_TASK_ENTRIES
+};
+
+
+struct TreeTask
+{
+	enum TreeTaskKind kind;
+
+	struct TreeDirRef * dirRef;
+
+	size_t numNames;
+
+	size_t nameOffset;
+
+	char text[];
+};
+
+
+	/*------------------------------------------------
+	 A worker's double-ended queue of tasks, a ring
+	 of 'capacity' pointers. The owner pushes and
+	 pops at the bottom, so it works depth first on
+	 what it has just found, while idle workers
+	 steal the oldest task from the top, which
+	 tends to be the largest piece of work
+	------------------------------------------------*/
+struct TreeTaskDeque
+{
+	pthread_mutex_t lock;
+
+	struct TreeTask ** tasks;
+
+	size_t capacity;
+
+	size_t head;
+
+	size_t count;
+};
+
+
+struct TreeWalkShared;
+
+
+	/*------------------------------------------------
+	 State of one worker thread of the parallel -R
+	 mode. Entries are formatted into 'output',
+	 which is appended to stdout once per task,
+	 and 'batchNames' collects the names of the
+	 directory being enumerated until a batch is
+	 full
+	------------------------------------------------*/
+struct TreeWorker
+{
+	struct TreeWalkShared * shared;
+
+	unsigned int index;
+
+	pthread_t thread;
+
+	struct TreeTaskDeque deque;
+
+	struct DirEnumerator enumerator;
+
+	struct OutputBuffer output;
+
+	struct EntryRecordArray sortedRecords;
+
+	char * batchNames;
+
+	size_t batchNamesUsed;
+
+	size_t batchNamesCapacity;
+
+	size_t batchNumNames;
+
+	unsigned long numDirs;
+
+	unsigned long numEntries;
+
+	unsigned long numStolen;
+};
+
+
+	/*------------------------------------------------
+	 State shared by the workers of the parallel -R
+	 mode
+
+	 'outstandingTasks' counts the tasks queued or
+	 running. A worker that finds nothing to do
+	 waits on 'workPosted' until a task is queued,
+	 and all leave once the count reaches zero
+
+	 'outputLock' serialises the appending of the
+	 workers' output to stdout
+	------------------------------------------------*/
+struct TreeWalkShared
+{
+	struct TreeWorker * workers;
+
+	unsigned int numWorkers;
+
+	pthread_mutex_t idleLock;
+
+	pthread_cond_t workPosted;
+
+	unsigned long outstandingTasks;
+
+	unsigned int numIdle;
+
+	pthread_mutex_t outputLock;
+};
+
+
+	/*------------------------------------------------
+	 An io_uring instance set up with raw system
+	 calls: the descriptor of the ring, its three
+	 shared mappings, and pointers to the fields of
+	 the submission and completion rings within them
+	------------------------------------------------*/
+struct UringContext
+{
+	int ringFd;
+
+	unsigned int queueDepth;
+
+	void * sqRingPtr;
+
+	size_t sqRingSize;
+
+	void * cqRingPtr;
+
+	size_t cqRingSize;
+
+	struct io_uring_sqe * sqEntries;
+
+	size_t sqEntriesSize;
+
+	unsigned int * sqHead;
+
+	unsigned int * sqTail;
+
+	unsigned int sqRingMask;
+
+	unsigned int * sqArray;
+
+	unsigned int * cqHead;
+
+	unsigned int * cqTail;
+
+	unsigned int cqRingMask;
+
+	struct io_uring_cqe * cqEntries;
+};
+
+
+
+	/*------------------------------------------------
+	 Brief: Display the file information of all the 
+		files in the directory 'dirPath'
+
+		Every entry is looked up relative to the
+		descriptor of the open directory, so no
+		paths need to be built and the parent
+		components of 'dirPath' are resolved only
+		once
+
+		If there is a problem in opening the
+		directory, an error message will be
+		displayed instead
+
+	 Parameters:
+		dirPath - the directory to list, e.g. './'
+	------------------------------------------------*/
+void displayCurrDirFilesInfo(const char * dirPath);
+
+
+	/*------------------------------------------------
+	 Brief: Displays the file information of every
+		entry of the directory open in
+		'enumerator', with io_uring, the -j
+		pipeline or one entry at a time,
+		depending on the options
+
+		If reading the directory fails, an error
+		message naming 'dirPath' is displayed
+	------------------------------------------------*/
+void displayOpenDirFilesInfo(struct DirEnumerator * enumerator,
+			     const char * dirPath);
+
+
+	/*------------------------------------------------
+	 Brief: Displays the file information of every
+		entry of the directory open in
+		'enumerator' in the order selected with
+		--sort. All entries are looked up and
+		collected into 'recordArray' first, then
+		sorted and written to 'outBuffer'
+
+		If reading the directory fails, an error
+		message naming 'dirPath' is displayed
+	------------------------------------------------*/
+void displayDirFilesInfoSorted(struct OutputBuffer * outBuffer,
+			       struct DirEnumerator * enumerator,
+			       const char * dirPath,
+			       struct EntryRecordArray * recordArray);
+
+
+	/*------------------------------------------------
+	 Brief: Looks up the metadata of 'fileName',
+		relative to 'dirFd', and appends it to
+		'recordArray' along with the name
+
+		Returns 0 on success, or -1 if the arrays
+		could not be grown. A failed lookup is
+		not an error: it is recorded, and
+		reported when the record is written
+	------------------------------------------------*/
+int addEntryRecord(struct EntryRecordArray * recordArray,
+		   int dirFd, const char * fileName);
+
+
+	/*------------------------------------------------
+	 Brief: Appends 'fileName' and its d_ino value
+		to 'recordArray' without looking up its
+		metadata, which lookupEntryRecords() does
+		later for the whole array
+
+		Returns 0 on success, or -1 if the arrays
+		could not be grown
+	------------------------------------------------*/
+int addEntryName(struct EntryRecordArray * recordArray,
+		 const char * fileName, ino_t direntInode);
+
+
+	/*------------------------------------------------
+	 Brief: Looks up the metadata of every record
+		added with addEntryName(), in order of
+		the inode numbers the directory gave, so
+		that on a cold cache the inode table is
+		read in order rather than at random. The
+		records themselves keep their order
+
+		If the sort buffers cannot be allocated,
+		the records are looked up in their own
+		order instead
+	------------------------------------------------*/
+void lookupEntryRecords(struct EntryRecordArray * recordArray,
+			int dirFd);
+
+
+	/*------------------------------------------------
+	 Brief: Reads entries of the directory open in
+		'enumerator' into 'recordArray' until it
+		holds 'maxEntries' records or the
+		directory ends, and looks their metadata
+		up: in inode order once all are read if
+		'inInodeOrder', otherwise each as it is
+		read. Entries the --filter rejects by
+		name or type are skipped unread. This is
+		the collection half of every serial
+		listing, which the records are then
+		written from, and of the iterator of
+		libmyls
+
+		Returns 1 if the batch filled up before
+		the end of the directory, 0 at its end,
+		or -1 with 'errno' set if the directory
+		could not be read or memory ran out. The
+		records collected are valid either way
+	------------------------------------------------*/
+int collectDirEntries(struct DirEnumerator * enumerator,
+		      struct EntryRecordArray * recordArray,
+		      size_t maxEntries, int inInodeOrder);
+
+
+	/*------------------------------------------------
+	 Brief: Displays the file information of every
+		entry of the directory open in
+		'enumerator' in directory order,
+		collecting and looking them up
+		LISTING_BATCH_ENTRIES at a time, in inode
+		order with --inode-order
+	------------------------------------------------*/
+void displayDirFilesInfoBatched(
+				struct OutputBuffer * outBuffer,
+				struct DirEnumerator * enumerator,
+				const char * dirPath,
+				struct EntryRecordArray * recordArray);
+
+
+	/*------------------------------------------------
+	 Brief: Makes sure the sort items of
+		'recordArray' have room for all its
+		records
+
+		Returns 0 on success, -1 on failure
+	------------------------------------------------*/
+int reserveSortItems(struct EntryRecordArray * recordArray);
+
+
+	/*------------------------------------------------
+	 Brief: Orders the records of 'recordArray' by
+		'sortKey', leaving the order in its
+		'sortItems'
+
+		The integer keys are sorted with a radix
+		sort, and names by their first eight bytes
+		the same way, after which only runs of
+		equal keys are compared with strcmp()
+
+		Returns 0 on success, -1 if the sort
+		buffers could not be allocated
+	------------------------------------------------*/
+int sortEntryRecords(struct EntryRecordArray * recordArray,
+		     enum SortKey sortKey);
+
+
+	/*------------------------------------------------
+	 Brief: Orders the 'numItems' sort items from
+		'firstIndex' by name, given that their
+		names are equal in the first 'nameOffset'
+		bytes and none ends before that. Long
+		runs are radix sorted eight bytes at a
+		time, and short ones compared with
+		strcmp()
+	------------------------------------------------*/
+void sortItemsByName(struct EntryRecordArray * recordArray,
+		     size_t firstIndex, size_t numItems,
+		     size_t nameOffset);
+
+
+	/*------------------------------------------------
+	 Brief: Sorts 'numItems' items by 'minorKey'
+		and then 'key' with a least significant
+		digit radix sort, one byte per pass.
+		'scratch' must have room for as many
+		items. Passes in which every item has the
+		same byte are skipped
+	------------------------------------------------*/
+void radixSortItems(struct SortItem * items,
+		    struct SortItem * scratch, size_t numItems);
+
+
+	/*------------------------------------------------
+	 Brief: Writes the records of 'recordArray' to
+		'outBuffer' in the order left by
+		sortEntryRecords(), or in the order they
+		were added if it failed, and empties the
+		array for the next directory
+	------------------------------------------------*/
+void writeEntryRecords(struct OutputBuffer * outBuffer,
+		       struct EntryRecordArray * recordArray,
+		       int isSorted);
+
+
+	/*------------------------------------------------
+	 Brief: Copies the fields of 'statBuf' that can
+		be printed or sorted by into the compact
+		record 'recordPtr'
+	------------------------------------------------*/
+void storeEntryRecordStat(struct EntryRecord * recordPtr,
+			  const struct stat * statBuf);
+
+
+	/*------------------------------------------------
+	 Brief: Fills in the fields of 'statBuf' that
+		writeFileStatInfo() reads from the compact
+		record 'recordPtr'. The other fields are
+		left as they are
+	------------------------------------------------*/
+void loadEntryRecordStat(const struct EntryRecord * recordPtr,
+			 struct stat * statBuf);
+
+
+	/*------------------------------------------------
+	 Brief: Drops every record of 'recordArray' at
+		once, freeing all name chunks but the
+		first and any array grown past
+		MAX_KEPT_ENTRY_RECORDS entries
+	------------------------------------------------*/
+void resetEntryRecords(struct EntryRecordArray * recordArray);
+
+
+	/*------------------------------------------------
+	 Brief: Releases the buffers of 'recordArray'
+	------------------------------------------------*/
+void destroyEntryRecords(struct EntryRecordArray * recordArray);
+
+
+	/*------------------------------------------------
+	 Brief: Displays the file information of every
+		entry of the directory open in
+		'enumerator', reusing what the snapshot
+		read with --since-snapshot knows about
+		it, and adds the directory to the
+		snapshot being written with --snapshot
+
+		If the directory's inode and mtime are
+		those in the snapshot, it is not read at
+		all: its entries are taken from the
+		snapshot. Otherwise it is read, and only
+		entries whose name is new, or whose name
+		now has another inode, are looked up
+
+	 Parameters:
+		outBuffer - the buffer to write into
+
+		enumerator - the open directory
+
+		dirPath - the path of the directory, by
+			which it is found in the snapshot
+
+		recordArray - the records to collect the
+			entries in
+	------------------------------------------------*/
+void displayDirFilesInfoSnapshot(
+				struct OutputBuffer * outBuffer,
+				struct DirEnumerator * enumerator,
+				const char * dirPath,
+				struct EntryRecordArray * recordArray);
+
+
+	/*------------------------------------------------
+	 Brief: Appends entry 'entryIndex' of the
+		snapshot section 'columns' to
+		'recordArray' with its metadata
+
+		Returns 0 on success, or -1 if the arrays
+		could not be grown
+	------------------------------------------------*/
+int addSnapshotEntry(struct EntryRecordArray * recordArray,
+		     const struct SnapshotColumns * columns,
+		     size_t entryIndex);
+
+
+	/*------------------------------------------------
+	 Brief: Maps the snapshot 'filePath' into
+		'snapshot'. A file that does not exist
+		yet leaves 'snapshot' empty, as on the
+		first run
+
+		Returns 0 on success. If the file cannot
+		be read or is not a snapshot of this
+		version and byte order, an error message
+		is printed and -1 is returned
+	------------------------------------------------*/
+int loadSnapshot(struct Snapshot * snapshot,
+		 const char * filePath);
+
+
+	/*------------------------------------------------
+	 Brief: Unmaps a snapshot loaded with
+		loadSnapshot()
+	------------------------------------------------*/
+void unloadSnapshot(struct Snapshot * snapshot);
+
+
+	/*------------------------------------------------
+	 Brief: Finds the directory 'dirPath' in
+		'snapshot' with a binary search of its
+		directory table, and locates its columns
+
+		Returns 0 if found, or -1 if it is not
+		there or its section is damaged
+	------------------------------------------------*/
+int findSnapshotDir(const struct Snapshot * snapshot,
+		    const char * dirPath,
+		    const struct SnapshotDir ** snapshotDir,
+		    struct SnapshotColumns * columns);
+
+
+	/*------------------------------------------------
+	 Brief: Finds the entry named 'fileName' in
+		the section 'columns' with a binary
+		search of its name order
+
+		Returns 0 and stores its index in
+		'entryIndex' if found, -1 otherwise
+	------------------------------------------------*/
+int findSnapshotEntry(const struct SnapshotColumns * columns,
+		      const char * fileName,
+		      size_t * entryIndex);
+
+
+	/*------------------------------------------------
+	 Brief: Starts writing a snapshot to a
+		temporary file next to 'filePath'
+
+		Returns 0 on success. On failure, an error
+		message is printed and -1 is returned
+	------------------------------------------------*/
+int beginSnapshot(struct SnapshotWriter * writer,
+		  const char * filePath);
+
+
+	/*------------------------------------------------
+	 Brief: Appends the section of the directory
+		'dirPath', whose own metadata is
+		'dirStat', holding the records of
+		'recordArray' whose lookup succeeded.
+		Leaves the records ordered by name in
+		the sort items of 'recordArray'. A
+		directory whose section cannot be built
+		is left out of the snapshot
+	------------------------------------------------*/
+void addSnapshotDir(struct SnapshotWriter * writer,
+		    const char * dirPath,
+		    const struct stat * dirStat,
+		    struct EntryRecordArray * recordArray);
+
+
+	/*------------------------------------------------
+	 Brief: Appends 'numBytes' bytes to the
+		snapshot, followed by zeros up to a
+		multiple of 'alignment' bytes
+	------------------------------------------------*/
+void appendSnapshotBytes(struct SnapshotWriter * writer,
+			 const void * bytes, size_t numBytes,
+			 size_t alignment);
+
+
+	/*------------------------------------------------
+	 Brief: Writes the paths, the directory table
+		and the header of the snapshot, and
+		renames it over the previous one
+
+		Returns 0 on success. On failure, an error
+		message is printed, the temporary file is
+		removed and -1 is returned
+	------------------------------------------------*/
+int finishSnapshot(struct SnapshotWriter * writer);
+
+
+	/*------------------------------------------------
+	 Brief: Asks inotify to report changes to the
+		directory (if 'isDir') or file 'path',
+		and remembers the path under the number
+		of the watch. Watching the same file
+		again keeps the first path
+
+		Returns 0 on success. On failure, an error
+		message is printed and -1 is returned
+	------------------------------------------------*/
+int addWatchTarget(const char * path, int isDir);
+
+
+	/*------------------------------------------------
+	 Brief: The loop of --watch. Waits for inotify
+		events, collects the entries they name,
+		and once 'windowMilliseconds' have passed
+		since the first of them, writes one
+		record for each entry that changed
+
+		Returns when nothing is watched any
+		more, or with -1 and an error message
+		printed if inotify cannot be read
+	------------------------------------------------*/
+int watchForChanges();
+
+
+	/*------------------------------------------------
+	 Brief: Adds the entry 'name' of the watched
+		'targetPath' (or the target itself if
+		'name' is empty) to the pending changes,
+		unless it is already there. Takes
+		constant time on average
+
+		Returns 0 on success, or -1 if the
+		pending changes could not be grown
+	------------------------------------------------*/
+int queueWatchChange(const char * targetPath,
+		     const char * name);
+
+
+	/*------------------------------------------------
+	 Brief: Looks up every pending change again and
+		writes its record, or a removal notice if
+		it no longer exists, then empties the
+		pending changes. With -R, a directory
+		that appeared is watched too
+	------------------------------------------------*/
+void reportWatchChanges();
+
+
+	/*------------------------------------------------
+	 Brief: Lists again every watched directory
+		and file, after inotify dropped events
+		because its queue overflowed
+	------------------------------------------------*/
+void relistWatchTargets();
+
+
+	/*------------------------------------------------
+	 Brief: The loop of --serve. Listens on the Unix
+		socket 'socketPath' and hands each client
+		to the threads of runServeThread(), until
+		SIGINT or SIGTERM, when the socket is
+		removed
+
+		'extraStatxBits' are the statx() bits the
+		command line options need whatever the
+		fields a request selects
+
+		Returns 0 once stopped, or -1 with an
+		error message printed if the socket
+		cannot be set up
+	------------------------------------------------*/
+int serveListings(const char * socketPath,
+		  unsigned int extraStatxBits);
+
+
+	/*------------------------------------------------
+	 Brief: A thread of --serve. Takes connections
+		from the queue of 'serveState', reads
+		their request and answers it with
+		handleServeRequest(), until --serve
+		stops
+	------------------------------------------------*/
+void * runServeThread(void * argument);
+
+
+	/*------------------------------------------------
+	 Brief: Reads the request of a client from
+		'connectionFd' into 'request', which
+		has room for 'capacity' bytes, up to an
+		empty record or the end of the stream,
+		and ends it with a NUL byte. The whole
+		request must arrive within
+		SERVE_REQUEST_TIMEOUT_SECONDS
+
+		Returns its length, or -1 if it could not
+		be read in time or is too large
+	------------------------------------------------*/
+ssize_t readServeRequest(int connectionFd, char * request,
+			 size_t capacity);
+
+
+	/*------------------------------------------------
+	 Brief: Lists what 'request' names onto
+		'connectionFd', with 'defaultOptions'
+		but for the fields and format it selects
+
+		A request is a series of NUL-terminated
+		'KEY=VALUE' records, ended by an empty
+		one or the end of the stream:
+
+		    dir=PATH      lists the contents of
+				  PATH, like --dir
+		    file=PATH     lists the file PATH
+		    fields=LIST   like --fields
+		    format=NAME   like --format
+
+		Paths are listed in the order they are
+		given, relative to the directory myls was
+		started in. Files that cannot be listed
+		are reported in place in the reply, and
+		the reply ends with the status line
+		written by writeServeStatus()
+
+		Returns 0 on success. If the request is
+		not valid, nothing is listed, an error
+		message is written to the client, and -1
+		is returned. -1 is also returned if the
+		client does not take its reply within
+		SERVE_SEND_TIMEOUT_SECONDS, after which
+		the rest of the reply is dropped
+	------------------------------------------------*/
+int handleServeRequest(int connectionFd, char * request,
+		       size_t requestLength,
+		       const struct ListingOptions * defaultOptions,
+		       unsigned int extraStatxBits);
+
+
+	/*------------------------------------------------
+	 Brief: Appends the status line that ends a
+		reply of --serve, counting 'numErrors'
+		errors, to 'outBuffer'
+	------------------------------------------------*/
+void writeServeStatus(struct OutputBuffer * outBuffer,
+		      unsigned int numErrors);
+
+
+	/*------------------------------------------------
+	 Brief: Answers a client that is not served
+		with the line 'myls: REASONDETAIL' and a
+		status line counting one error
+	------------------------------------------------*/
+void refuseServeClient(int connectionFd, const char * reason,
+		       const char * detail);
+
+
+	/*------------------------------------------------
+	 Brief: Sends everything written to the
+		temporary file 'spoolFd' to the client
+
+		Returns 0 on success, -1 with 'errno' set
+		on failure
+	------------------------------------------------*/
+int sendSpoolFile(int connectionFd, int spoolFd);
+
+
+	/*------------------------------------------------
+	 Brief: The handler of SIGINT and SIGTERM under
+		--serve
+	------------------------------------------------*/
+void stopServingListings(int signalNumber);
+
+
+	/*------------------------------------------------
+	 Brief: Looks up a sort order by name (e.g.
+		'size')
+
+		Returns its descriptor, or NULL with an
+		error message printed if the name is not
+		recognised
+	------------------------------------------------*/
+const struct SortKeyDescriptor * findSortKey(
+				const char * sortName);
+
+
+	/*------------------------------------------------
+	 Brief: Walks the tree below the directory open
+		in 'enumerator' (-R), whose own entries
+		have already been displayed, and displays
+		each subdirectory's entries under a
+		heading with its path, depth first and in
+		directory order
+
+		Only the directory being read is kept
+		open, and no list of entries is kept, so
+		memory does not grow with the width of the
+		tree, and only by a few dozen bytes (and
+		the path) per level with its depth.
+		Symbolic links are not followed
+
+	 Parameters:
+		enumerator - holds the starting directory
+			open. It is left holding a directory
+			to be closed by the caller
+
+		rootPath - the path of the starting
+			directory, used in headings and
+			error messages
+	------------------------------------------------*/
+void displayDirTreeFilesInfo(struct DirEnumerator * enumerator,
+			     const char * rootPath);
+
+
+	/*------------------------------------------------
+	 Brief: Makes 'path' of the walk the path of
+		its current directory followed by
+		'name', growing the buffer as needed
+
+		Returns 0 on success, -1 if the buffer
+		could not be grown
+	------------------------------------------------*/
+int appendDirTreePath(struct DirTreeWalk * walk,
+		      const char * name);
+
+
+	/*------------------------------------------------
+	 Brief: Pushes a level for the directory open
+		on 'dirFd', whose path is the walk's
+		current path
+
+		Returns 0 on success, -1 if the directory
+		could not be examined or the stack could
+		not be grown
+	------------------------------------------------*/
+int pushDirTreeFrame(struct DirTreeWalk * walk, int dirFd);
+
+
+	/*------------------------------------------------
+	 Brief: Opens the parent of the directory open
+		on 'dirFd', which must be the directory
+		of the walk's top level, and checks it is
+		the same directory as the walk entered
+		from. If '..' leads elsewhere (e.g. the
+		directory was moved), the parent is
+		opened by its path instead
+
+		Returns the descriptor of the parent, or
+		-1 if it could not be opened
+	------------------------------------------------*/
+int openDirTreeParent(struct DirTreeWalk * walk, int dirFd);
+
+
+	/*------------------------------------------------
+	 Brief: Displays the tree below 'rootPath' (-R)
+		with 'listingOptions.numWorkers' threads
+		(-j). Directories become tasks on the
+		workers' deques, and a directory with more
+		than TREE_BATCH_ENTRIES entries is split
+		into batches that other workers can steal,
+		unless it is to be sorted (--sort)
+
+		Each task's output is written as one
+		piece under the heading of its directory.
+		Directories therefore appear in the order
+		they are finished, and a directory that
+		was split appears once per batch
+
+		With --stats, the directories and entries
+		handled by each thread are printed to
+		stderr
+
+		Returns 0 on success, -1 if no thread
+		could be started, in which case nothing
+		has been displayed
+	------------------------------------------------*/
+int displayDirTreeFilesInfoParallel(const char * rootPath);
+
+
+	/*------------------------------------------------
+	 Brief: Entry point of a worker thread of the
+		parallel -R mode. 'argument' is its
+		struct TreeWorker
+	------------------------------------------------*/
+void * runTreeWorker(void * argument);
+
+
+	/*------------------------------------------------
+	 Brief: Enumerates one directory, queueing a
+		TREE_TASK_DIR task for each subdirectory
+		and a TREE_TASK_ENTRIES task for each
+		full batch of entries. The last batch is
+		displayed by the worker itself
+	------------------------------------------------*/
+void runTreeDirTask(struct TreeWorker * worker,
+		    struct TreeTask * task);
+
+
+	/*------------------------------------------------
+	 Brief: Displays the 'numNames' packed names of
+		'names', which are relative to 'dirFd',
+		under the heading 'dirPath', and appends
+		the result to stdout
+	------------------------------------------------*/
+void writeTreeBatch(struct TreeWorker * worker, int dirFd,
+		    const char * dirPath, const char * names,
+		    size_t numNames);
+
+
+	/*------------------------------------------------
+	 Brief: Appends what the worker has formatted
+		to stdout as one piece, and empties its
+		buffer
+	------------------------------------------------*/
+void appendTreeOutput(struct TreeWorker * worker);
+
+
+	/*------------------------------------------------
+	 Brief: Queues a task on the worker's own deque
+		and wakes an idle worker, if any
+
+		Returns 0 on success, -1 if the deque
+		could not be grown, in which case the
+		task has not been queued
+	------------------------------------------------*/
+int pushTreeTask(struct TreeWorker * worker,
+		 struct TreeTask * task);
+
+
+	/*------------------------------------------------
+	 Brief: Returns the newest task of the worker's
+		own deque or, failing that, the oldest
+		task of another worker's deque. Returns
+		NULL if every deque is empty
+	------------------------------------------------*/
+struct TreeTask * takeTreeTask(struct TreeWorker * worker);
+
+
+	/*------------------------------------------------
+	 Brief: Drops one reference to a shared
+		directory, closing and freeing it with
+		the last reference. NULL is ignored
+	------------------------------------------------*/
+void releaseTreeDirRef(struct TreeDirRef * dirRef);
+
+
+	/*------------------------------------------------
+	 Brief: Shares the directory open on 'dirFd'
+		(through a duplicate of the descriptor)
+		with tasks that outlive the enumeration,
+		holding one reference for the caller
+
+		Returns NULL on failure
+	------------------------------------------------*/
+struct TreeDirRef * createTreeDirRef(int dirFd,
+				     const char * dirPath);
+
+
+	/*-----------------------------------------------
+	 Brief: Display the file information of the 
+		current file. File information includes
+		the user name, group name, type of file,
+		full access permissions.
+
+	 Parameters:
+		dirFd - descriptor of the directory that
+			'fileName' is relative to, or
+			AT_FDCWD for the current directory
+
+		fileName - the name of the file of 
+			interest, where the information
+			regarding the file will be
+			displayed
+	------------------------------------------------*/
+void displayCurrFileInfo(int dirFd, const char * fileName);
+
+
+	/*-----------------------------------------------
+	 Brief: Prepares 'reader' to return the
+		'numArguments' names of 'arguments',
+		then, if 'listPath' is not NULL, those
+		read from the file 'listPath' ("-" for
+		stdin), ended by 'delimiter'
+
+		Returns 0 on success, -1 with 'errno'
+		set if the file cannot be opened
+	------------------------------------------------*/
+int openFileArguments(struct FileArgumentReader * reader,
+		      char ** arguments, int numArguments,
+		      const char * listPath, int delimiter);
+
+
+	/*-----------------------------------------------
+	 Brief: Points 'namePtr' at the next file
+		argument of 'reader', which stays valid
+		until the next call. Empty names are
+		skipped
+
+		Returns 1 if there was one, 0 once none
+		are left, or -1 if the list could not be
+		read, which is reported
+	------------------------------------------------*/
+int readNextFileArgument(struct FileArgumentReader * reader,
+			 const char ** namePtr);
+
+
+	/*-----------------------------------------------
+	 Brief: Closes the list file of 'reader' and
+		releases its line buffer
+	------------------------------------------------*/
+void closeFileArguments(struct FileArgumentReader * reader);
+
+
+	/*-----------------------------------------------
+	 Brief: Returns the last component of 'path',
+		which the --filter matches names
+		against, or 'path' itself if it ends
+		with a '/'
+	------------------------------------------------*/
+const char * getPathBaseName(const char * path);
+
+
+	/*-----------------------------------------------
+	 Brief: Does the work of displayCurrFileInfo(),
+		but appends the information to
+		'outBuffer' instead of stdout
+	------------------------------------------------*/
+void writeFileInfo(struct OutputBuffer * outBuffer,
+		   int dirFd, const char * fileName);
+
+
+	/*-----------------------------------------------
+	 Brief: Writes the information of a file whose
+		metadata has already been retrieved
+		into 'statBuf'
+
+	 Parameters:
+		outBuffer - where the information is
+			appended
+
+		fileName - the name of the file, as it
+			is to be displayed
+
+		statBuf - the metadata of the file
+	------------------------------------------------*/
+void writeFileStatInfo(struct OutputBuffer * outBuffer,
+		       const char * fileName,
+		       const struct stat * statBuf);
+
+
+	/*-----------------------------------------------
+	 Brief: Prepares an output buffer of 'capacity'
+		bytes. With 'outputFd' -1 the buffer
+		holds its contents in memory and grows as
+		needed
+
+		Returns 0 on success, -1 if the buffer
+		could not be allocated
+	------------------------------------------------*/
+int initOutputBuffer(struct OutputBuffer * outBuffer,
+		     int outputFd, size_t capacity);
+
+
+	/*-----------------------------------------------
+	 Brief: Releases the memory of an output buffer.
+		Buffered output is not flushed
+	------------------------------------------------*/
+void destroyOutputBuffer(struct OutputBuffer * outBuffer);
+
+
+	/*-----------------------------------------------
+	 Brief: Writes everything buffered to the
+		descriptor of the buffer. Does nothing
+		for a memory buffer
+	------------------------------------------------*/
+void flushOutputBuffer(struct OutputBuffer * outBuffer);
+
+
+	/*-----------------------------------------------
+	 Brief: Writes all the given vectors with
+		writev(), repeating the call after a
+		partial write
+
+		Returns 0 on success, -1 with 'errno'
+		set on failure
+	------------------------------------------------*/
+int writeAllVectors(int outputFd, struct iovec * vectors,
+		    int numVectors);
+
+
+	/*-----------------------------------------------
+	 Brief: Appends bytes, a string, or the decimal
+		form of an integer to an output buffer.
+		The integers are converted by hand rather
+		than through a printf() format string
+	------------------------------------------------*/
+void appendOutputBytes(struct OutputBuffer * outBuffer,
+		       const char * bytes, size_t numBytes);
+
+void appendOutputString(struct OutputBuffer * outBuffer,
+			const char * string);
+
+void appendOutputUnsigned(struct OutputBuffer * outBuffer,
+			  unsigned long long value);
+
+void appendOutputSigned(struct OutputBuffer * outBuffer,
+			long long value);
+
+
+	/*-----------------------------------------------
+	 Brief: Appends one 'label value' line, e.g.
+		"Type of file: Regular\n"
+	------------------------------------------------*/
+void appendOutputField(struct OutputBuffer * outBuffer,
+		       const char * label, const char * value);
+
+
+	/*-----------------------------------------------
+	 Brief: Appends 'string' as a quoted JSON
+		string. Quotes, backslashes and control
+		characters are escaped; bytes that are not
+		part of valid UTF-8 are written as
+		"\udcXX" (as Python's 'surrogateescape'
+		does), so any file name survives
+	------------------------------------------------*/
+void appendJsonString(struct OutputBuffer * outBuffer,
+		      const char * string);
+
+
+	/*-----------------------------------------------
+	 Brief: Writes the file information in
+		'statBuf' as one JSON object on a line of
+		its own (--format=jsonl), with a member
+		for each selected field. Times are seconds
+		since the epoch
+	------------------------------------------------*/
+void writeFileStatJson(struct OutputBuffer * outBuffer,
+		       const char * fileName,
+		       const struct stat * statBuf);
+
+
+	/*-----------------------------------------------
+	 Brief: Writes 'name', with the metadata in
+		'statBuf' (or zeros if it is NULL), as a
+		record of kind 'recordKind' of the binary
+		format, followed by as many
+		BINARY_RECORD_CONT records as the rest of
+		the name needs
+	------------------------------------------------*/
+void writeBinaryRecord(struct OutputBuffer * outBuffer,
+		       enum BinaryRecordKind recordKind,
+		       const char * name,
+		       const struct stat * statBuf);
+
+
+	/*-----------------------------------------------
+	 Brief: Writes the header that starts the
+		output of --format=bin
+	------------------------------------------------*/
+void writeBinaryHeader(struct OutputBuffer * outBuffer);
+
+
+	/*-----------------------------------------------
+	 Brief: Writes the heading that precedes the
+		entries of the directory 'dirPath' in the
+		selected output format
+	------------------------------------------------*/
+void writeDirHeading(struct OutputBuffer * outBuffer,
+		     const char * dirPath);
+
+
+	/*-----------------------------------------------
+	 Brief: Writes the notice that --watch saw the
+		file 'filePath' go, in the selected
+		output format
+	------------------------------------------------*/
+void writeRemovedEntry(struct OutputBuffer * outBuffer,
+		       const char * filePath);
+
+
+	/*-----------------------------------------------
+	 Brief: Writes the error 'message' in the
+		selected output format, where it was met
+		in the listing: '{"error": MESSAGE}' in
+		jsonl, a record of kind
+		BINARY_RECORD_ERROR in bin, and
+		'myls: MESSAGE' between blank lines in
+		text
+	------------------------------------------------*/
+void writeErrorRecord(struct OutputBuffer * outBuffer,
+		      const char * message);
+
+
+	/*-----------------------------------------------
+	 Brief: Stores 'value' at 'bytes' in
+		little-endian byte order, whatever the
+		byte order of the machine
+	------------------------------------------------*/
+void storeLittleEndian(unsigned char * bytes,
+		       uint64_t value, int numBytes);
+
+
+	/*-----------------------------------------------
+	 Brief: Prints the message for a file that
+		cannot be accessed to stderr, after
+		flushing what 'outBuffer' holds so that
+		the message appears in place. Under
+		--serve it is written to 'outBuffer'
+		with writeErrorRecord() instead, for the
+		client to see. Either way it is counted
+		in 'numListingErrors'
+
+	 Parameters:
+		outBuffer - the buffer being listed into
+
+		fileName - the file that failed
+
+		errorNumber - the 'errno' value of the
+			failure
+	------------------------------------------------*/
+void reportAccessError(struct OutputBuffer * outBuffer,
+		       const char * fileName, int errorNumber);
+
+
+	/*-----------------------------------------------
+	 Brief: Reports, as reportAccessError() does,
+		that the directory 'dirPath' could not be
+		opened, or if 'subdirName' is not NULL,
+		its subdirectory 'subdirName'
+	------------------------------------------------*/
+void reportOpenDirError(struct OutputBuffer * outBuffer,
+			const char * dirPath,
+			const char * subdirName, int errorNumber);
+
+
+	/*-----------------------------------------------
+	 Brief: Reports, as reportAccessError() does,
+		that the directory 'dirPath' could not be
+		read, or read to its end
+	------------------------------------------------*/
+void reportReadDirError(struct OutputBuffer * outBuffer,
+			const char * dirPath, int errorNumber);
+
+
+	/*-----------------------------------------------
+	 Brief: Copies the result of statx() into a
+		struct stat, so the rest of the program
+		does not depend on which call produced
+		the metadata
+	------------------------------------------------*/
+void convertStatxToStat(const struct statx * statxBuf,
+			struct stat * statBuf);
+
+
+	/*-----------------------------------------------
+	 Brief: Displays the file information of every
+		entry of an open directory, retrieving the
+		metadata with IORING_OP_STATX requests
+		submitted through io_uring. Entries are
+		read in batches as large as the queue
+		depth, all requests of a batch are
+		submitted with one system call, and the
+		batch is displayed in directory order
+		once its completions have been reaped
+
+		Returns 0 on success, -1 if the ring
+		could not be set up (e.g. the kernel has
+		no io_uring, or it is disabled), in which
+		case nothing has been displayed
+	------------------------------------------------*/
+int displayDirFilesInfoUring(struct DirEnumerator * enumerator,
+			     const char * dirPath);
+
+
+	/*-----------------------------------------------
+	 Brief: Creates an io_uring with room for
+		'queueDepth' requests and maps its rings
+
+		Returns 0 on success, -1 with 'errno'
+		set on failure
+	------------------------------------------------*/
+int setupUringContext(struct UringContext * uring,
+		      unsigned int queueDepth);
+
+
+	/*-----------------------------------------------
+	 Brief: Unmaps the rings and closes the io_uring
+	------------------------------------------------*/
+void destroyUringContext(struct UringContext * uring);
+
+
+	/*-----------------------------------------------
+	 Brief: Displays the file information of every
+		entry of an open directory with the -j
+		pipeline. The entries are enumerated by
+		a producer thread, their metadata is
+		retrieved and formatted by
+		'listingOptions.numWorkers' worker
+		threads, and the results are written by
+		the calling thread, in directory order
+		unless --unordered was given
+
+		Returns 0 on success, -1 if the threads
+		or buffers could not be set up, in which
+		case nothing has been displayed
+
+	 Parameters:
+		enumerator - an enumerator with the
+			directory already open
+
+		dirPath - the path of the directory, used
+			in error messages
+	------------------------------------------------*/
+int displayDirFilesInfoParallel(
+			struct DirEnumerator * enumerator,
+			const char * dirPath);
+
+
+	/*-----------------------------------------------
+	 Brief: Displays the file information of every
+		file argument of 'reader' with the -j
+		pipeline, in the order of the arguments
+		unless --unordered was given
+
+		Returns 0 on success, -1 if the threads
+		or buffers could not be set up, in which
+		case no argument has been read
+	------------------------------------------------*/
+int displayFileArgumentsParallel(struct FileArgumentReader * reader);
+
+
+	/*-----------------------------------------------
+	 Brief: Does the work of the two functions
+		above: runs the -j pipeline over the
+		entries of 'enumerator' or, if it is
+		NULL, the arguments of 'fileArguments'
+	------------------------------------------------*/
+int runStatPipeline(struct DirEnumerator * enumerator,
+		    struct FileArgumentReader * fileArguments,
+		    const char * dirPath);
+
+
+	/*-----------------------------------------------
+	 Brief: Entry points of the producer and worker
+		threads of the -j pipeline. 'argument'
+		is the shared struct StatPipeline
+	------------------------------------------------*/
+void * runPipelineProducer(void * argument);
+
+void * runPipelineWorker(void * argument);
+
+
+	/*-----------------------------------------------
+	 Brief: Reads the name of the next entry the
+		producer of 'pipeline' is to queue into
+		'entryInfo'. A file argument has no
+		dirent type
+
+		Returns 1 if a name was read, 0 once
+		none are left, or -1 on a read error
+	------------------------------------------------*/
+int readNextPipelineEntry(struct StatPipeline * pipeline,
+			  struct DirEntryInfo * entryInfo);
+
+
+	/*-----------------------------------------------
+	 Brief: Retrieves the metadata of a file without
+		following symbolic links. statx() is used
+		with the request mask of the selected
+		fields, so the kernel (or a network file
+		system) only has to supply what will be
+		printed. If the kernel does not provide
+		statx(), fstatat() is used instead
+
+		Returns 0 on success, -1 with 'errno'
+		set on failure
+
+	 Parameters:
+		dirFd - descriptor of the directory that
+			'fileName' is relative to, or
+			AT_FDCWD
+
+		fileName - the name of the file
+
+		statBuf - the retrieved metadata. Only the
+			fields covered by the request mask
+			are guaranteed to be filled in. This
+			is the output of the function
+	------------------------------------------------*/
+int getFileMetadata(int dirFd, const char * fileName,
+		    struct stat * statBuf);
+
+
+	/*-----------------------------------------------
+	 Brief: Converts a comma-separated list of field
+		names (e.g. 'name,size,mtime') into
+		FIELD_* flags and the matching statx()
+		request mask
+
+		Returns 0 on success. If a name is not
+		recognised, an error message is printed
+		and -1 is returned
+	------------------------------------------------*/
+int parseFieldList(const char * fieldList,
+		   unsigned int * outputFields,
+		   unsigned int * statxMask);
+
+
+	/*-----------------------------------------------
+	 Brief: Converts the --format name 'formatName'
+		(text, jsonl or bin) into 'formatPtr'
+
+		Returns 0 on success. If the name is not
+		recognised, an error message is printed
+		and -1 is returned
+	------------------------------------------------*/
+int parseOutputFormat(const char * formatName,
+		      enum OutputFormat * formatPtr);
+
+
+	/*-----------------------------------------------
+	 Brief: Compiles a comma-separated --filter
+		expression (e.g. 'name=*.log,size=1G..')
+		into 'filterPtr', adding to those already
+		there, and the statx() bits its
+		predicates need to 'statxMask'. '\,' is a
+		comma within a predicate
+
+		Returns 0 on success. If a predicate is
+		not valid, an error message is printed
+		and -1 is returned
+	------------------------------------------------*/
+int parseFilterExpression(const char * expression,
+			  struct EntryFilter * filterPtr,
+			  unsigned int * statxMask);
+
+
+	/*-----------------------------------------------
+	 Brief: Compiles the single predicate
+		'NAME=VALUE' in the same way as
+		parseFilterExpression()
+	------------------------------------------------*/
+int parseFilterPredicate(const char * predicate,
+			 struct EntryFilter * filterPtr,
+			 unsigned int * statxMask);
+
+
+	/*-----------------------------------------------
+	 Brief: Converts the range 'MIN..MAX' (either
+		end may be left out) or the single value
+		'VALUE' into '*minValue' and '*maxValue'.
+		A value may end with a character of
+		'unitSuffixes', which multiplies it by
+		the matching 'unitMultipliers' entry
+
+		A single value gives the range
+		VALUE..VALUE, or 0..VALUE if
+		'isUpperBound' is set
+
+		Returns 0 on success, -1 if the range is
+		not valid
+	------------------------------------------------*/
+int parseFilterRange(const char * rangeText,
+		     const char * unitSuffixes,
+		     const uint64_t * unitMultipliers,
+		     int isUpperBound,
+		     uint64_t * minValue, uint64_t * maxValue);
+
+
+	/*-----------------------------------------------
+	 Brief: Converts a range of ages in seconds into
+		the range of times they cover, counting
+		back from 'now'. A minimum age of 0 has no
+		upper limit on the time
+	------------------------------------------------*/
+void convertAgeRange(uint64_t minAge, uint64_t maxAge,
+		     time_t now,
+		     int64_t * minTime, int64_t * maxTime);
+
+
+	/*-----------------------------------------------
+	 Brief: Works out the time ranges of the age
+		predicates of 'filterPtr' from the
+		current time. Called once the expression
+		is compiled, and again per request or
+		batch of events by the modes that keep
+		running, so that their windows move on
+	------------------------------------------------*/
+void updateFilterTimes(struct EntryFilter * filterPtr);
+
+
+	/*-----------------------------------------------
+	 Brief: Returns the user name of 'userId', or
+		"Not Available" if there is none. The
+		name is looked up with getpwuid_r() until
+		a lookup for 'userId' gives an answer,
+		and taken from 'userNameCache' afterwards
+
+		The returned string must not be freed
+	------------------------------------------------*/
+const char * lookupUserName(uid_t userId);
+
+
+	/*-----------------------------------------------
+	 Brief: Returns the group name of 'groupId', or
+		"Not Available" if there is none, using
+		getgrgid_r() and 'groupNameCache' in the
+		same way as lookupUserName()
+	------------------------------------------------*/
+const char * lookupGroupName(gid_t groupId);
+
+
+	/*-----------------------------------------------
+	 Brief: Finds the slot of 'id' in 'cache'. If
+		'id' is not cached, the empty slot where
+		it belongs is returned instead, after
+		growing the table if needed
+
+		Returns NULL if memory ran out
+	------------------------------------------------*/
+struct NameCacheSlot * findNameCacheSlot(
+				struct NameCache * cache,
+				unsigned int id);
+
+
+	/*-----------------------------------------------
+	 Brief: Prints the hit and miss counters of the
+		name caches to stderr
+	------------------------------------------------*/
+void printNameCacheStats();
+
+
+	/*-----------------------------------------------
+	 Brief: Adds the stage timings of the calling
+		thread to the shared ones, and clears
+		them. Every thread that lists files calls
+		it before it ends
+	------------------------------------------------*/
+void mergeStageTimings();
+
+
+	/*-----------------------------------------------
+	 Brief: Returns an upper bound, in nanoseconds,
+		of the 'percentile' percentile of the
+		calls counted in 'histogramPtr': the end
+		of the bucket it falls in
+	------------------------------------------------*/
+unsigned long long getStagePercentile(
+			const struct StageHistogram * histogramPtr,
+			unsigned int percentile);
+
+
+	/*-----------------------------------------------
+	 Brief: Prints the number of calls, total time,
+		and 50th and 99th percentiles of each
+		timed stage to stderr
+	------------------------------------------------*/
+void printStageTimings();
+
+
+	/*-----------------------------------------------
+	 Brief: Adds the entry 'fileName' with metadata
+		'statBuf' to the --summary totals of this
+		thread, unless it is another name of an
+		inode already counted
+	------------------------------------------------*/
+void addToSummary(const char * fileName,
+		  const struct stat * statBuf);
+
+
+	/*-----------------------------------------------
+	 Brief: Adds (deviceId, inodeNum) to 'setPtr'
+
+		Returns 1 if it was not in the set yet,
+		0 if it was, and -1 if the set could not
+		be grown
+	------------------------------------------------*/
+int insertInodeKey(struct InodeSet * setPtr,
+		   dev_t deviceId, ino_t inodeNum);
+
+
+	/*-----------------------------------------------
+	 Brief: Finds the key of (deviceId, inodeNum)
+		in 'setPtr', adding it with no name if
+		it is not there. The caller holds the
+		lock of the set. Unless 'isNew' is NULL,
+		it is set to 1 if the key was added and
+		to 0 if it was found
+
+		Returns the key, or NULL if the set could
+		not be grown
+	------------------------------------------------*/
+struct InodeKey * findInodeKey(struct InodeSet * setPtr,
+			       dev_t deviceId, ino_t inodeNum,
+			       int * isNew);
+
+
+	/*-----------------------------------------------
+	 Brief: Puts 'newKey', which is not in the
+		table of 'numSlots' slots yet, into it
+		by Robin Hood probing: on its way it
+		takes the slot of any key nearer that
+		key's first slot, which then moves on in
+		its place. No key therefore ends far
+		from its first slot, even in a table
+		seven eighths full
+
+		Returns the slot 'newKey' ended in
+	------------------------------------------------*/
+struct InodeKey * placeInodeKey(struct InodeKey * slots,
+				size_t numSlots, struct InodeKey newKey);
+
+
+	/*-----------------------------------------------
+	 Brief: Offers the file 'path' of 'fileSize'
+		bytes to the largest files of
+		'totalsPtr', which takes over 'path' and
+		frees it if the file is not among them
+	------------------------------------------------*/
+void offerLargestFile(struct SummaryTotals * totalsPtr,
+		      uint64_t fileSize, char * path);
+
+
+	/*-----------------------------------------------
+	 Brief: Adds the --summary totals of this thread
+		to the shared ones and clears them
+	------------------------------------------------*/
+void mergeSummaryTotals();
+
+
+	/*-----------------------------------------------
+	 Brief: Writes the --summary totals, as labelled
+		lines or, with --format=jsonl, as one
+		JSON object
+	------------------------------------------------*/
+void writeSummary(struct OutputBuffer * outBuffer);
+
+
+	/*-----------------------------------------------
+	 Brief: Returns the path of the entry 'fileName'
+		of the directory this thread is listing,
+		allocated, or NULL if it could not be
+	------------------------------------------------*/
+char * buildListedPath(const char * fileName);
+
+
+	/*-----------------------------------------------
+	 Brief: Adds the name 'fileName' of the entry
+		with metadata 'statBuf' to the names of
+		its inode for --links, if it is a file
+		with several links
+	------------------------------------------------*/
+void addLinkedName(const char * fileName,
+		   const struct stat * statBuf);
+
+
+	/*-----------------------------------------------
+	 Brief: Writes every inode --links found by
+		more than one name, with those names, as
+		labelled blocks or, with --format=jsonl,
+		one JSON object per inode, and releases
+		what --links collected
+	------------------------------------------------*/
+void writeLinkGroups(struct OutputBuffer * outBuffer);
+
+
+
+	/*-----------------------------------------------
+	 Brief: Prepares an enumerator for use. With the
+		getdents64() backend this allocates the
+		batch buffer that will be reused by every
+		directory opened through the enumerator
+
+		Returns 0 on success, -1 if the buffer
+		could not be allocated
+
+	 Parameters:
+		enumerator - the enumerator to prepare
+
+		backend - how entries are to be read
+
+		batchSize - size in bytes of the
+			getdents64() buffer
+	------------------------------------------------*/
+int initDirEnumerator(struct DirEnumerator * enumerator,
+		      enum DirEnumBackend backend,
+		      size_t batchSize);
+
+
+	/*-----------------------------------------------
+	 Brief: Opens the directory 'dirPath' for
+		enumeration
+
+		Returns 0 on success, -1 with 'errno'
+		set on failure
+	------------------------------------------------*/
+int openDirEnumerator(struct DirEnumerator * enumerator,
+		      const char * dirPath);
+
+
+	/*-----------------------------------------------
+	 Brief: Starts enumerating the directory open on
+		'dirFd', which the enumerator takes over
+		and closes along with the directory
+
+		Returns 0 on success, -1 with 'errno'
+		set on failure, in which case 'dirFd' has
+		been closed
+	------------------------------------------------*/
+int attachDirEnumerator(struct DirEnumerator * enumerator,
+			int dirFd);
+
+
+	/*-----------------------------------------------
+	 Brief: Returns the position just after the
+		entry last returned by readNextDirEntry(),
+		from which seekDirEnumerator() resumes
+		reading, even after the directory has been
+		closed and opened again
+	------------------------------------------------*/
+off64_t tellDirEnumerator(struct DirEnumerator * enumerator);
+
+
+	/*-----------------------------------------------
+	 Brief: Resumes reading the open directory at a
+		position returned by tellDirEnumerator()
+
+		Returns 0 on success, -1 on failure
+	------------------------------------------------*/
+int seekDirEnumerator(struct DirEnumerator * enumerator,
+		      off64_t position);
+
+
+	/*-----------------------------------------------
+	 Brief: Resumes reading the open directory from
+		its first entry
+
+		Returns 0 on success, -1 on failure
+	------------------------------------------------*/
+int rewindDirEnumerator(struct DirEnumerator * enumerator);
+
+
+	/*-----------------------------------------------
+	 Brief: Returns the descriptor of the directory
+		open in the enumerator, for use with the
+		*at() family of calls
+	------------------------------------------------*/
+int getDirEnumeratorFd(struct DirEnumerator * enumerator);
+
+
+	/*-----------------------------------------------
+	 Brief: Retrieves the next entry of the open
+		directory, skipping '.' and '..'
+
+		Returns 1 if an entry was stored in
+		'entryInfo', 0 at the end of the
+		directory and -1 with 'errno' set on error
+	------------------------------------------------*/
+int readNextDirEntry(struct DirEnumerator * enumerator,
+		     struct DirEntryInfo * entryInfo);
+
+
+	/*-----------------------------------------------
+	 Brief: Closes the directory currently open in
+		the enumerator. The batch buffer is kept
+		for the next directory
+	------------------------------------------------*/
+void closeDirEnumerator(struct DirEnumerator * enumerator);
+
+
+	/*-----------------------------------------------
+	 Brief: Releases the batch buffer of an
+		enumerator
+	------------------------------------------------*/
+void destroyDirEnumerator(struct DirEnumerator * enumerator);
+
+
+
+	/*-----------------------------------------------
+	 Brief: Converts a numerical value of file type
+		to its corresponding string form, e.g.
+		"Regular". The string is taken from
+		'fileTypeTable' and must not be modified
+
+
+	 Parameters:
+		fileTypeAndPermsFlags - this contains the
+			numerical value of a file type,
+			which is to be converted by the
+			function into the corresponding
+			file type in string form
+	------------------------------------------------*/
+const char * getFileTypeString(mode_t fileTypeAndPermsFlags);
+		
+
+	/*-------------------------------------------------
+	 Brief: Converts a numerical value of file access 
+		permissions to its corresponding string
+		form
+
+		Eg: In string form,
+		'rwxrwxr-x'  represents 
+		read-write-execute permissions for owner(user)
+		read-write-execute permissions for group
+		read-execute permissions for others
+
+		The setuid, setgid and sticky bits are
+		shown in the execute positions as in
+		'ls': 's'/'t' when the execute bit is
+		also set, 'S'/'T' when it is not
+
+		The nine-letter string is taken from
+		'filePermsTable' and must not be modified
+		
+
+	 Parameters:
+		fileTypeAndPermsFlags - this is the
+			 numerical value containing the
+			 file access permissions. It is used
+			 to convert to its corresponding 
+			 string form
+	-------------------------------------------------*/
+const char * getFilePermissionsString(
+				mode_t fileTypeAndPermsFlags);
+
+
+	   
+
+	/*--------------------------------------------------
+	 Brief: Converts a numerical value of time in
+		seconds away from 1 Jan 12:00am to a
+		date and time in string form 
+
+
+		If the year value in date and time
+		is the same as the current year,
+		the year will not be in the string 
+		dateString
+		E.g: 'May 25 00:30'
+
+
+		If the year value in date and time
+		is not the same as the current year,
+		then the year replace the time
+		in the string dateString
+		E.g. 'May 25  2010'
+
+
+		The current year and time zone are read
+		once per run, and dates are cached per
+		day, so localtime_r() is only called for
+		the first time seen on each day
+
+
+	 Parameters:
+		dateString : the date converted to
+			human readable form from
+			'givenTime', in a buffer of at
+			least DATE_STRING_SIZE bytes. This
+			is the output of the function
+
+		givenTime : time in seconds, which is
+			the number of seconds elapsed
+			since 1 Jan 1970 12.00am
+	--------------------------------------------------*/
+void convertTimeToDateString(char * dateString, 
+			     time_t givenTime);
+
+
+	/*------------------------------------------------
+	 Brief: Reads the time zone and records the
+		current year. Run once, before the first
+		time is converted
+	--------------------------------------------------*/
+void initTimeFormatting();
+
+
+	/*------------------------------------------------
+	 Brief: Records the year containing
+		'currentTime' as the current year, and
+		when that year ends
+	--------------------------------------------------*/
+void setTimeFormattingYear(time_t currentTime);
+
+
+	/*------------------------------------------------
+	 Brief: Moves the current year on if it has
+		ended. Called once per request or batch
+		of events by the modes that keep running,
+		so that times are not formatted against
+		the year they started in
+	--------------------------------------------------*/
+void updateTimeFormattingYear();
+
+
+	/*------------------------------------------------
+	 Brief: Fills in the cache entry for the local
+		day containing 'givenTime', whose
+		broken-down form is 'givenBrokenDownTime'
+
+		Returns 0 on success, or -1 if the offset
+		from UTC changes during that day, in which
+		case it must not be cached
+	--------------------------------------------------*/
+int fillDayCacheEntry(struct DayCacheEntry * entryPtr,
+		      time_t givenTime,
+		      const struct tm * givenBrokenDownTime);
+
+	
+	/*------------------------------------------------
+	 Brief: Converts a numerical month value to a
+		three-letter word form of month
+		E.g. 'Jan', 'Feb', 'Mar', 'Apr'
+
+		If the user provided an invalid month
+		value, the string "Inv" will be returned
+		instead
+
+
+	 Parameters:
+		monthString - the word form of 'month'
+			in exactly three letters. This is
+			the return value of the function
+
+		month - the numerical value of month.
+			Eg:
+			0 represents Jan
+			1 represenrs Feb
+			2 represents Mar
+			...
+			11 represents Dec
+	--------------------------------------------------*/
+void getMonthString(char * monthString, int month);
+
+
+	/*------------------------------------------------
+	 Brief: Prints the command line usage to stderr
+	--------------------------------------------------*/
+void printUsage();
+
+
+	/*------------------------------------------------
+	 Brief: Converts the text of a numerical command
+		line option to an unsigned value. An error
+		message is printed and -1 returned if the
+		text is not a valid non-negative number
+
+	 Parameters:
+		optionName - name of the option, used in
+			the error message
+
+		optionText - the text given by the user
+
+		optionValue - the converted value. This is
+			the output of the function
+	--------------------------------------------------*/
+int parseUnsignedOption(const char * optionName,
+			const char * optionText,
+			unsigned long * optionValue);
+
+
+
+
+
+//The benchmarks under bench/ include this file
+// for its functions and provide their own main()
+#ifndef MYLS_NO_MAIN
+
+int main(int argc, char * argv[])
+{
+
+	/*=============================================
+	 SECTION 1: Parsing the command line options
+
+	 --enum=getdents|readdir selects how the
+	 entries of a directory are read, so the two
+	 backends can be compared against each other
+
+	 --batch-size=BYTES sets the size of the
+	 getdents64() buffer
+
+	 --fields=LIST selects which fields are
+	 printed, and therefore which metadata is
+	 requested from the kernel
+
+	 -d DIR, --dir=DIR lists the contents of DIR.
+	 It may be given several times
+
+	 --stats prints counters about the listing
+	 to stderr once it is complete
+
+	 -j N, --jobs=N retrieves and formats the
+	 metadata of directory entries, and of the
+	 file arguments, with N worker threads.
+	 --unordered lets the results be written as
+	 they complete instead of in directory (or
+	 argument) order
+
+	 --serve=SOCKET keeps running as a daemon
+	 that answers listing requests sent to the
+	 Unix socket SOCKET (see handleServeRequest())
+	 instead of listing paths itself
+
+	 --files-from=FILE also lists the files named
+	 in FILE ("-" for stdin), one per line, after
+	 those of the command line. With -0, --null
+	 the names are ended by NUL bytes instead,
+	 and are read from stdin if no FILE is given
+
+	 --uring retrieves the metadata of directory
+	 entries through io_uring, keeping up to
+	 --uring-depth=N requests in flight
+
+	 --output-buffer=BYTES sets the size of the
+	 buffer the output is collected in
+
+	 -R, --recursive also lists the contents of
+	 every subdirectory of the listed directories,
+	 each under a heading with its path
+
+	 --sort=name|size|mtime|inode displays the
+	 entries of each directory in that order
+	 instead of directory order
+
+	 --inode-order looks entries up in order of
+	 inode number, without changing the order
+	 they are displayed in
+
+	 --format=text|jsonl|bin selects the labelled
+	 text blocks, one JSON object per line, or
+	 fixed-width binary records
+
+	 --snapshot=FILE saves the metadata of every
+	 listed directory to FILE, and
+	 --since-snapshot[=FILE] reuses what such a
+	 file (by default the --snapshot one) holds
+	 for directories that have not changed
+
+	 --watch keeps running after the listing, and
+	 writes the record of every listed entry that
+	 changes, coalescing the changes seen within
+	 --watch-window=MS milliseconds of each other
+
+	 --filter=EXPR lists only the entries that
+	 satisfy every predicate of EXPR. It may be
+	 given several times
+
+	 --summary[=N] prints totals of the listed
+	 entries, by type and by mtime age, and the N
+	 largest files, instead of the entries
+
+	 --links prints the files found by more than
+	 one name (hard links), with those names,
+	 instead of the entries
+	==============================================*/
+	static const struct option longOptions[] =
+	{
+		{"enum",       required_argument, NULL, 'E'},
+		{"batch-size", required_argument, NULL, 'B'},
+		{"fields",     required_argument, NULL, 'F'},
+		{"dir",        required_argument, NULL, 'd'},
+		{"stats",      no_argument,       NULL, 'S'},
+		{"jobs",       required_argument, NULL, 'j'},
+		{"unordered",  no_argument,       NULL, 'U'},
+		{"uring",      no_argument,       NULL, 'I'},
+		{"uring-depth", required_argument, NULL, 'Q'},
+		{"output-buffer", required_argument, NULL, 'O'},
+		{"recursive",  no_argument,       NULL, 'R'},
+		{"sort",       required_argument, NULL, 'K'},
+		{"inode-order", no_argument,      NULL, 'N'},
+		{"format",     required_argument, NULL, 'T'},
+		{"snapshot",   required_argument, NULL, 'P'},
+		{"since-snapshot", optional_argument, NULL, 'V'},
+		{"watch",      no_argument,       NULL, 'W'},
+		{"watch-window", required_argument, NULL, 'Y'},
+		{"filter",     required_argument, NULL, 'X'},
+		{"summary",    optional_argument, NULL, 'M'},
+		{"links",      no_argument,       NULL, 'L'},
+		{"files-from", required_argument, NULL, 'G'},
+		{"null",       no_argument,       NULL, '0'},
+		{"serve",      required_argument, NULL, 'H'},
+		{NULL,         0,                 NULL, 0}
+	};
+
+	int optionChar;
+
+	unsigned long optionValue;
+
+	const char ** listedDirs = NULL;
+
+	int numListedDirs = 0;
+
+	int numListedTargets;
+
+	int needsDirHeading;
+
+	const struct SortKeyDescriptor * sortKeyPtr = NULL;
+
+	unsigned int sortStatxBits = 0;
+
+	unsigned int filterStatxBits = 0;
+
+	const char * fileListPath = NULL;
+
+	int fileListDelimiter = '\n';
+
+	const char * serveSocketPath = NULL;
+
+	struct FileArgumentReader fileArguments;
+
+	const char * fileName = NULL;
+
+	int exitStatus = 0;
+
+
+	//Every argument could be a --dir option, so
+	// this is always large enough
+	listedDirs = malloc(sizeof(*listedDirs) * argc);
+
+	if (listedDirs == NULL)
+	{
+		perror("myls");
+
+		return 1;
+	}
+
+
+	while ((optionChar = getopt_long(argc, argv, "d:j:R0",
+					 longOptions, NULL)) != -1)
+	{
+		switch (optionChar)
+		{
+			case 'E':
+				if (strcmp(optarg, "getdents") == 0)
+				{
+					listingOptions.enumBackend =
+						DIR_ENUM_GETDENTS;
+				}
+				else if (strcmp(optarg, "readdir") == 0)
+				{
+					listingOptions.enumBackend =
+						DIR_ENUM_READDIR;
+				}
+				else
+				{
+					fprintf(stderr,
+						"myls: Invalid enumeration "
+						"backend '%s'\n", optarg);
+
+					printUsage();
+
+					return 1;
+				}
+
+				break;
+
+			case 'B':
+				if (parseUnsignedOption("batch-size",
+							optarg,
+							&optionValue) == -1)
+				{
+					return 1;
+				}
+
+				if (optionValue < MIN_DIRENT_BATCH_SIZE)
+				{
+					optionValue = MIN_DIRENT_BATCH_SIZE;
+				}
+
+				listingOptions.direntBatchSize =
+					optionValue;
+
+				break;
+
+			case 'F':
+				if (parseFieldList(optarg,
+					&listingOptions.outputFields,
+					&listingOptions.statxMask) == -1)
+				{
+					printUsage();
+
+					return 1;
+				}
+
+				break;
+
+			case 'd':
+				listedDirs[numListedDirs++] = optarg;
+
+				break;
+
+			case 'S':
+				printStats = 1;
+
+				break;
+
+			case 'j':
+				if (parseUnsignedOption("jobs", optarg,
+							&optionValue) == -1)
+				{
+					return 1;
+				}
+
+				if (optionValue < 1)
+				{
+					optionValue = 1;
+				}
+				else if (optionValue > MAX_WORKER_THREADS)
+				{
+					optionValue = MAX_WORKER_THREADS;
+				}
+
+				listingOptions.numWorkers = optionValue;
+
+				break;
+
+			case 'U':
+				listingOptions.preserveOrder = 0;
+
+				break;
+
+			case 'I':
+				listingOptions.useUring = 1;
+
+				break;
+
+			case 'Q':
+				if (parseUnsignedOption("uring-depth",
+							optarg,
+							&optionValue) == -1)
+				{
+					return 1;
+				}
+
+				if (optionValue < 1)
+				{
+					optionValue = 1;
+				}
+				else if (optionValue > MAX_URING_QUEUE_DEPTH)
+				{
+					optionValue = MAX_URING_QUEUE_DEPTH;
+				}
+
+				listingOptions.uringQueueDepth = optionValue;
+
+				break;
+
+			case 'O':
+				if (parseUnsignedOption("output-buffer",
+							optarg,
+							&optionValue) == -1)
+				{
+					return 1;
+				}
+
+				if (optionValue < MIN_OUTPUT_BUFFER_SIZE)
+				{
+					optionValue = MIN_OUTPUT_BUFFER_SIZE;
+				}
+
+				listingOptions.outputBufferSize = optionValue;
+
+				break;
+
+			case 'R':
+				listingOptions.recursive = 1;
+
+				break;
+
+			case 'K':
+				sortKeyPtr = findSortKey(optarg);
+
+				if (sortKeyPtr == NULL)
+				{
+					printUsage();
+
+					return 1;
+				}
+
+				listingOptions.sortKey = sortKeyPtr->sortKey;
+
+				sortStatxBits = sortKeyPtr->statxBits;
+
+				break;
+
+			case 'N':
+				listingOptions.inodeOrder = 1;
+
+				break;
+
+			case 'T':
+				if (parseOutputFormat(optarg,
+					&listingOptions.outputFormat) == -1)
+				{
+					printUsage();
+
+					return 1;
+				}
+
+				break;
+
+			case 'P':
+				listingOptions.snapshotPath = optarg;
+
+				break;
+
+			case 'V':
+				listingOptions.sinceSnapshotPath =
+					(optarg != NULL) ? optarg : "";
+
+				break;
+
+			case 'W':
+				listingOptions.watchChanges = 1;
+
+				break;
+
+			case 'Y':
+				if (parseUnsignedOption("watch-window",
+							optarg,
+							&optionValue) == -1)
+				{
+					return 1;
+				}
+
+				watchState.windowMilliseconds = optionValue;
+
+				break;
+
+			case 'M':
+				listingOptions.summarize = 1;
+
+				if (optarg == NULL)
+				{
+					break;
+				}
+
+				if (parseUnsignedOption("summary", optarg,
+							&optionValue) == -1)
+				{
+					return 1;
+				}
+
+				if (optionValue > MAX_SUMMARY_TOP_COUNT)
+				{
+					optionValue = MAX_SUMMARY_TOP_COUNT;
+				}
+
+				listingOptions.summaryTopCount = optionValue;
+
+				break;
+
+			case 'L':
+				listingOptions.groupLinks = 1;
+
+				break;
+
+			case 'G':
+				fileListPath = optarg;
+
+				break;
+
+			case '0':
+				fileListDelimiter = '\0';
+
+				break;
+
+			case 'H':
+				serveSocketPath = optarg;
+
+				break;
+
+			case 'X':
+				if (parseFilterExpression(optarg,
+							  &entryFilter,
+							  &filterStatxBits)
+				    == -1)
+				{
+					printUsage();
+
+					return 1;
+				}
+
+				updateFilterTimes(&entryFilter);
+
+				break;
+
+			default:
+				printUsage();
+
+				return 1;
+		}
+
+	}//end of while loop
+
+
+	//The sort key and what the --filter checks are
+	// needed whether or not they are printed, and
+	// --fields may come after --sort or --filter
+	listingOptions.statxMask |= sortStatxBits | filterStatxBits;
+
+
+	/*=============================================
+	 --serve lists what each request names, one
+	 request after another, so there is nothing
+	 to total, watch or save across them. It
+	 runs until it is stopped
+	==============================================*/
+	if (serveSocketPath != NULL)
+	{
+		if (optind < argc || numListedDirs > 0
+		    || fileListPath != NULL || fileListDelimiter == '\0'
+		    || listingOptions.watchChanges
+		    || listingOptions.summarize
+		    || listingOptions.groupLinks
+		    || listingOptions.snapshotPath != NULL
+		    || listingOptions.sinceSnapshotPath != NULL)
+		{
+			fprintf(stderr, "myls: --serve takes its paths from"
+				" its requests, and cannot be combined with"
+				" paths, --files-from, --watch, --summary,"
+				" --links or snapshots\n");
+
+			printUsage();
+
+			free(listedDirs);
+
+			return 1;
+		}
+
+		if (initOutputBuffer(&stdoutBuffer, STDOUT_FILENO,
+				     listingOptions.outputBufferSize) == -1)
+		{
+			perror("myls");
+
+			free(listedDirs);
+
+			return 1;
+		}
+
+		if (serveListings(serveSocketPath,
+				  sortStatxBits | filterStatxBits) == -1)
+		{
+			exitStatus = 1;
+		}
+
+		destroyOutputBuffer(&stdoutBuffer);
+
+		if (printStats)
+		{
+			printNameCacheStats();
+
+			printStageTimings();
+		}
+
+		free(listedDirs);
+
+		return exitStatus;
+	}
+
+
+	/*=============================================
+	 A snapshot holds every field, whatever is
+	 printed, and directories are then listed one
+	 at a time in this thread, so -j and --uring
+	 do not apply
+	==============================================*/
+	if (listingOptions.sinceSnapshotPath != NULL
+	    && listingOptions.sinceSnapshotPath[0] == '\0')
+	{
+		listingOptions.sinceSnapshotPath =
+			listingOptions.snapshotPath;
+
+		if (listingOptions.sinceSnapshotPath == NULL)
+		{
+			fprintf(stderr, "myls: --since-snapshot needs a"
+				" FILE or --snapshot\n");
+
+			printUsage();
+
+			return 1;
+		}
+	}
+
+	if (listingOptions.snapshotPath != NULL
+	    || listingOptions.sinceSnapshotPath != NULL)
+	{
+		listingOptions.statxMask |= STATX_BASIC_STATS;
+
+		listingOptions.numWorkers = 1;
+
+		listingOptions.useUring = 0;
+	}
+
+	//A snapshot that cannot be read is only
+	// reported: everything is then looked up
+	if (listingOptions.sinceSnapshotPath != NULL)
+	{
+		loadSnapshot(&previousSnapshot,
+			     listingOptions.sinceSnapshotPath);
+	}
+
+	if (listingOptions.snapshotPath != NULL
+	    && beginSnapshot(&snapshotWriter,
+			     listingOptions.snapshotPath) == -1)
+	{
+		return 1;
+	}
+
+
+	/*=============================================
+	 --summary needs the type, size, mtime and
+	 identity of every entry, whatever --fields
+	 selects, but not their order. It has nothing
+	 to report changes with, and no binary form
+	==============================================*/
+	if (listingOptions.summarize)
+	{
+		if (listingOptions.watchChanges
+		    || listingOptions.outputFormat == FORMAT_BIN)
+		{
+			fprintf(stderr, "myls: --summary cannot be combined"
+				" with --watch or --format=bin\n");
+
+			printUsage();
+
+			return 1;
+		}
+
+		listingOptions.statxMask |= STATX_TYPE | STATX_SIZE
+					    | STATX_MTIME | STATX_NLINK
+					    | STATX_INO;
+
+		listingOptions.sortKey = SORT_NONE;
+
+		summaryStartTime = time(NULL);
+	}
+
+
+	/*=============================================
+	 --links, likewise, needs the type, link count
+	 and identity of every entry, and sorts the
+	 names it reports itself
+	==============================================*/
+	if (listingOptions.groupLinks)
+	{
+		if (listingOptions.watchChanges
+		    || listingOptions.outputFormat == FORMAT_BIN)
+		{
+			fprintf(stderr, "myls: --links cannot be combined"
+				" with --watch or --format=bin\n");
+
+			printUsage();
+
+			return 1;
+		}
+
+		listingOptions.statxMask |= STATX_TYPE | STATX_NLINK
+					    | STATX_INO;
+
+		listingOptions.sortKey = SORT_NONE;
+	}
+
+
+	/*=============================================
+	 With --watch, directories are watched as they
+	 are listed, which the -R -j walk would do in
+	 its worker threads, so they are listed in
+	 this one. With -R, the type tells which
+	 changed entries are new directories to watch
+	==============================================*/
+	if (listingOptions.watchChanges)
+	{
+		listingOptions.numWorkers = 1;
+
+		listingOptions.statxMask |= STATX_TYPE;
+
+		watchState.inotifyFd = inotify_init1(IN_CLOEXEC
+						     | IN_NONBLOCK);
+
+		if (watchState.inotifyFd == -1)
+		{
+			perror("myls: inotify");
+
+			return 1;
+		}
+	}
+
+	
+	/*=============================================
+	 SECTION 2: Listing the files
+
+	 If the user did not provide any file or
+	 directory argument, display the file
+	 information of all the files in the current
+	 directory
+
+	 Otherwise, display the file information of the
+	 files provided by the user arguments, followed
+	 by the contents of each directory given with
+	 --dir. When more than one thing is listed, or
+	 with -R, each directory is preceded by its
+	 name. The parallel -R walk writes a heading
+	 before every piece of output, so none is
+	 written here
+
+	 The names of --files-from are read as they
+	 are listed, so a list of any length is never
+	 held in memory at once
+	==============================================*/
+	if (fileListDelimiter == '\0' && fileListPath == NULL)
+	{
+		fileListPath = "-";
+	}
+
+	if (openFileArguments(&fileArguments, argv + optind,
+			      argc - optind, fileListPath,
+			      fileListDelimiter) == -1)
+	{
+		fprintf(stderr, "myls: Cannot open '%s': %s\n",
+			fileListPath, strerror(errno));
+
+		free(listedDirs);
+
+		return 1;
+	}
+
+	numListedTargets = (argc - optind) + numListedDirs
+			   + (fileListPath != NULL);
+
+	needsDirHeading = (numListedTargets > 1
+			   || listingOptions.recursive)
+			  && !(listingOptions.recursive
+			       && listingOptions.numWorkers > 1);
+
+
+	if (initOutputBuffer(&stdoutBuffer, STDOUT_FILENO,
+			     listingOptions.outputBufferSize) == -1)
+	{
+		perror("myls");
+
+		closeFileArguments(&fileArguments);
+
+		free(listedDirs);
+
+		return 1;
+	}
+
+	if (listingOptions.outputFormat == FORMAT_BIN)
+	{
+		writeBinaryHeader(&stdoutBuffer);
+	}
+
+	if (numListedTargets == 0)
+	{
+		//display information of all files
+		// in current directory
+		if (needsDirHeading)
+		{
+			writeDirHeading(&stdoutBuffer, "./");
+		}
+
+		displayCurrDirFilesInfo("./");
+
+	}
+	else
+	{
+
+		//With -j, more than one file argument is
+		// looked up by the workers of the pipeline,
+		// and written in argument order through
+		// its slots. --watch always lists here
+		if (listingOptions.numWorkers == 1
+		    || ((argc - optind) < 2 && fileListPath == NULL)
+		    || displayFileArgumentsParallel(&fileArguments) == -1)
+		{
+			while (readNextFileArgument(&fileArguments,
+						    &fileName) == 1)
+			{
+				if (listingOptions.watchChanges)
+				{
+					addWatchTarget(fileName, 0);
+				}
+
+				displayCurrFileInfo(AT_FDCWD, fileName);
+			}
+		}
+
+		if (fileArguments.readFailed)
+		{
+			exitStatus = 1;
+		}
+
+
+		for (int index = 0; index < numListedDirs; index++)
+		{
+			if (needsDirHeading)
+			{
+				writeDirHeading(&stdoutBuffer,
+						listedDirs[index]);
+			}
+
+			displayCurrDirFilesInfo(listedDirs[index]);
+		}
+
+	}
+
+
+	closeFileArguments(&fileArguments);
+
+
+	if (listingOptions.summarize)
+	{
+		writeSummary(&stdoutBuffer);
+	}
+
+	if (listingOptions.groupLinks)
+	{
+		writeLinkGroups(&stdoutBuffer);
+	}
+
+	flushOutputBuffer(&stdoutBuffer);
+
+
+	if (listingOptions.snapshotPath != NULL
+	    && finishSnapshot(&snapshotWriter) == -1)
+	{
+		exitStatus = 1;
+	}
+
+	unloadSnapshot(&previousSnapshot);
+
+
+	//Runs until nothing listed is left to watch,
+	// or the user stops it
+	if (listingOptions.watchChanges
+	    && watchForChanges() == -1)
+	{
+		exitStatus = 1;
+	}
+
+	destroyOutputBuffer(&stdoutBuffer);
+
+
+	if (printStats)
+	{
+		printNameCacheStats();
+
+		printStageTimings();
+
+		if (listingOptions.sinceSnapshotPath != NULL)
+		{
+			fprintf(stderr,
+				"myls: snapshot: %lu directories reused,"
+				" %lu read, %lu entries reused,"
+				" %lu looked up\n",
+				snapshotStats.dirsReused,
+				snapshotStats.dirsRead,
+				snapshotStats.entriesReused,
+				snapshotStats.entriesLookedUp);
+		}
+	}
+
+
+	free(listedDirs);
+
+	return exitStatus;
+}
+
+#endif //MYLS_NO_MAIN
+
+
+
+/*--------------------------------------------------------*/
+
+void printUsage()
+{
+	fprintf(stderr,
+		"Usage: myls [OPTION]... [FILE]...\n"
+		"  -d, --dir=DIR            list the contents of"
+		" DIR\n"
+		"  --enum=getdents|readdir  directory enumeration"
+		" backend\n"
+		"  --batch-size=BYTES       getdents64() buffer"
+		" size\n"
+		"  --stats                  print cache counters to"
+		" stderr\n"
+		"  -j, --jobs=N             retrieve metadata with N"
+		" threads\n"
+		"  --unordered              with -j, print entries"
+		" as they complete\n"
+		"  --uring                  retrieve metadata through"
+		" io_uring\n"
+		"  --uring-depth=N          io_uring requests kept in"
+		" flight\n"
+		"  --output-buffer=BYTES    size of the output"
+		" buffer\n"
+		"  -R, --recursive          list subdirectories"
+		" recursively\n"
+		"  --sort=WORD              sort entries by name,"
+		" size, mtime or inode\n"
+		"  --inode-order            look entries up in"
+		" inode order\n"
+		"  --format=FORMAT          text (default), jsonl"
+		" or bin\n"
+		"  --snapshot=FILE          save the listed"
+		" directories to FILE\n"
+		"  --since-snapshot[=FILE]  reuse a snapshot for"
+		" unchanged directories\n"
+		"  --watch                  then print entries as"
+		" they change\n"
+		"  --watch-window=MS        coalesce changes within"
+		" MS milliseconds\n"
+		"  --summary[=N]            print totals and the N"
+		" largest files instead\n"
+		"  --links                  print the files listed by"
+		" several names instead\n"
+		"  --files-from=FILE        also list the files named"
+		" in FILE (- for stdin)\n"
+		"  -0, --null               names in FILE end with NUL;"
+		" without FILE, stdin\n"
+		"  --serve=SOCKET           answer listing requests on"
+		" a Unix socket\n"
+		"  --filter=EXPR            list only entries"
+		" matching every predicate:\n"
+		"                           name=GLOB,regex=ERE,"
+		"type=fdlpscb,\n"
+		"                           size=MIN..MAX[KMGT],"
+		"mtime=..AGE[smhdw],\n"
+		"                           ctime=..AGE,uid=ID\n"
+		"  --fields=LIST            comma-separated fields"
+		" to print:\n"
+		"                           name,user,group,type,"
+		"perms,size,inode,\n"
+		"                           major,minor,links,"
+		"atime,mtime,ctime\n");
+}
+
+
+
+/*--------------------------------------------------------*/
+
+int parseUnsignedOption(const char * optionName,
+			const char * optionText,
+			unsigned long * optionValue)
+{
+	char * endPtr = NULL;
+
+
+	errno = 0;
+
+	*optionValue = strtoul(optionText, &endPtr, 10);
+
+
+	if (errno != 0 || endPtr == optionText
+		|| *endPtr != '\0' || optionText[0] == '-')
+	{
+		fprintf(stderr,
+			"myls: Invalid value '%s' for --%s\n",
+			optionText, optionName);
+
+		return -1;
+	}
+
+
+	return 0;
+}
+
+
+
+/*--------------------------------------------------------*/
+
+void  displayCurrDirFilesInfo(const char * dirPath)
+{
+	
+	/*============================================
+	 SECTION 1: Declaration of variables
+	=============================================*/
+	
+	struct DirEnumerator enumerator;
+
+
+
+	/*============================================
+	 With -R and -j, the whole tree is handed to
+	 the work-stealing walk. Should it fail to
+	 start, the tree is walked serially
+	=============================================*/
+	if (listingOptions.recursive
+	    && listingOptions.numWorkers > 1)
+	{
+		if (displayDirTreeFilesInfoParallel(dirPath) == 0)
+		{
+			return;
+		}
+
+		//The heading the walk would have written
+		writeDirHeading(&stdoutBuffer, dirPath);
+	}
+
+
+
+	/*============================================
+	 SECTION 2: Opening the directory
+	 
+	 If the directory cannot be opened,
+	  the error message is displayed. The function
+	  then returns immediately
+	=============================================*/
+
+	if (initDirEnumerator(&enumerator,
+			      listingOptions.enumBackend,
+			      listingOptions.direntBatchSize) == -1)
+	{
+		reportReadDirError(&stdoutBuffer, dirPath, errno);
+
+		return;
+	}
+
+
+	if (openDirEnumerator(&enumerator, dirPath) == -1)
+	{
+		reportOpenDirError(&stdoutBuffer, dirPath, NULL, errno);
+
+		destroyDirEnumerator(&enumerator);
+
+		return;
+	}
+
+
+	/*===========================================
+	 SECTION 3: Displaying file information of
+	 	    each file, and with -R, of each
+		    file below the directory
+	============================================*/
+	displayOpenDirFilesInfo(&enumerator, dirPath);
+
+	if (listingOptions.recursive)
+	{
+		displayDirTreeFilesInfo(&enumerator, dirPath);
+	}
+
+
+	
+	/*===============================================
+	 SECTION 4: Closing the directory
+	================================================*/
+	closeDirEnumerator(&enumerator);
+
+	destroyDirEnumerator(&enumerator);
+
+}
+
+
+/*---------------------------------------------------------*/
+
+void displayOpenDirFilesInfo(struct DirEnumerator * enumerator,
+			     const char * dirPath)
+{
+
+	/*============================================
+	 SECTION 1: Declaration of variables
+	=============================================*/
+
+	static struct EntryRecordArray sortedRecords;
+
+
+	//For the paths of the largest files of
+	// --summary and the names of --links
+	listedDirPath = dirPath;
+
+
+
+	/*===========================================
+	 SECTION 2: Displaying file information of
+	 	    each file
+
+	 The enumerator already leaves out the parent
+	 directory('..') and the current directory('.')
+	 itself, so every entry it returns is displayed.
+	 Each name is looked up relative to the
+	 directory's descriptor
+
+	 Entries are collected in batches of records,
+	 which are then written, the same way libmyls
+	 hands them to its callers. With
+	 --inode-order, each batch is looked up in
+	 inode order
+
+	 With --uring or -j, the entries are handed to
+	 io_uring or the pipeline instead. Should
+	 either fail to start, the listing is done
+	 here as usual
+
+	 With --sort, every entry has to be looked up
+	 before the first can be written, so the whole
+	 directory is collected and sorted instead.
+	 With --snapshot or --since-snapshot, they are
+	 collected too, taking what has not changed
+	 from the previous snapshot. The record array
+	 is kept for the next directory
+
+	 With --watch, the directory is watched before
+	 it is read, so that no change made while it
+	 is listed goes unreported
+	============================================*/
+	if (listingOptions.watchChanges)
+	{
+		addWatchTarget(dirPath, 1);
+	}
+
+	if (listingOptions.snapshotPath != NULL
+	    || listingOptions.sinceSnapshotPath != NULL)
+	{
+		displayDirFilesInfoSnapshot(&stdoutBuffer, enumerator,
+					    dirPath, &sortedRecords);
+	}
+	else if (listingOptions.sortKey != SORT_NONE)
+	{
+		displayDirFilesInfoSorted(&stdoutBuffer, enumerator,
+					  dirPath, &sortedRecords);
+	}
+	else if (!listingOptions.inodeOrder
+		 && listingOptions.useUring
+		 && displayDirFilesInfoUring(enumerator,
+					     dirPath) == 0)
+	{
+		return;
+	}
+	else if (!listingOptions.inodeOrder
+		 && listingOptions.numWorkers > 1
+		 && displayDirFilesInfoParallel(enumerator,
+						dirPath) == 0)
+	{
+		return;
+	}
+	else
+	{
+		displayDirFilesInfoBatched(&stdoutBuffer, enumerator,
+					   dirPath, &sortedRecords);
+	}
+}
+
+
+/*---------------------------------------------------------*/
+
+void displayDirFilesInfoSorted(struct OutputBuffer * outBuffer,
+			       struct DirEnumerator * enumerator,
+			       const char * dirPath,
+			       struct EntryRecordArray * recordArray)
+{
+
+	int readReturnValue;
+
+	int isSorted;
+
+
+
+	/*============================================
+	 SECTION 1: Collecting every entry. With
+		    --inode-order, the entries are
+		    looked up once all have been read,
+		    in inode order
+	=============================================*/
+	readReturnValue = collectDirEntries(enumerator, recordArray,
+					    SIZE_MAX,
+					    listingOptions.inodeOrder);
+
+
+	if (readReturnValue == -1)
+	{
+		reportReadDirError(outBuffer, dirPath, errno);
+	}
+
+
+
+	/*============================================
+	 SECTION 2: Sorting and writing them. If the
+		    sort buffers cannot be allocated,
+		    the entries are still written, in
+		    directory order
+	=============================================*/
+	isSorted = (sortEntryRecords(recordArray,
+				     listingOptions.sortKey) == 0);
+
+	writeEntryRecords(outBuffer, recordArray, isSorted);
+}
+
+
+/*---------------------------------------------------------*/
+
+static inline const char * getEntryName(
+				const struct EntryRecordArray * recordArray,
+				uint64_t nameOffset)
+{
+	return recordArray->nameChunks[nameOffset >> NAME_CHUNK_SHIFT]
+	       + (nameOffset & (NAME_CHUNK_SIZE - 1));
+}
+
+
+/*---------------------------------------------------------*/
+
+int addEntryName(struct EntryRecordArray * recordArray,
+		 const char * fileName, ino_t direntInode)
+{
+
+	size_t nameLength = strlen(fileName) + 1;
+
+	size_t chunkIndex;
+
+	size_t newCapacity;
+
+	char ** newChunks = NULL;
+
+	struct EntryRecord * newRecords = NULL;
+
+	struct EntryRecord * recordPtr = NULL;
+
+
+
+	/*============================================
+	 SECTION 1: Making room in the name arena. A
+		    name that does not fit in the rest
+		    of the current chunk starts the next
+		    one, which is allocated on first use
+	=============================================*/
+	if ((recordArray->namesUsed & (NAME_CHUNK_SIZE - 1))
+		+ nameLength > NAME_CHUNK_SIZE)
+	{
+		recordArray->namesUsed =
+			(recordArray->namesUsed | (NAME_CHUNK_SIZE - 1))
+			+ 1;
+	}
+
+	chunkIndex = recordArray->namesUsed >> NAME_CHUNK_SHIFT;
+
+
+	if (chunkIndex == recordArray->numNameChunks)
+	{
+		if (recordArray->numNameChunks
+			== recordArray->nameChunksCapacity)
+		{
+			newCapacity = (recordArray->nameChunksCapacity > 0)
+				      ? recordArray->nameChunksCapacity * 2
+				      : 16;
+
+			newChunks = realloc(recordArray->nameChunks,
+					    newCapacity * sizeof(*newChunks));
+
+			if (newChunks == NULL)
+			{
+				return -1;
+			}
+
+			recordArray->nameChunks = newChunks;
+
+			recordArray->nameChunksCapacity = newCapacity;
+		}
+
+		recordArray->nameChunks[chunkIndex] =
+			malloc(NAME_CHUNK_SIZE);
+
+		if (recordArray->nameChunks[chunkIndex] == NULL)
+		{
+			return -1;
+		}
+
+		recordArray->numNameChunks++;
+	}
+
+
+
+	/*============================================
+	 SECTION 2: Making room in the record array,
+		    doubling it when full
+	=============================================*/
+	if (recordArray->numRecords
+		== recordArray->recordsCapacity)
+	{
+		newCapacity = (recordArray->recordsCapacity > 0)
+			      ? recordArray->recordsCapacity * 2
+			      : 1024;
+
+		newRecords = realloc(recordArray->records,
+				     newCapacity * sizeof(*newRecords));
+
+		if (newRecords == NULL)
+		{
+			return -1;
+		}
+
+		recordArray->records = newRecords;
+
+		recordArray->recordsCapacity = newCapacity;
+	}
+
+
+
+	/*============================================
+	 SECTION 3: Storing the name
+	=============================================*/
+	recordPtr = &recordArray->records[recordArray->numRecords];
+
+	recordPtr->nameOffset = recordArray->namesUsed;
+
+	recordPtr->errorNumber = 0;
+
+	recordPtr->inodeNum = direntInode;
+
+	memcpy(recordArray->nameChunks[chunkIndex]
+	       + (recordArray->namesUsed & (NAME_CHUNK_SIZE - 1)),
+	       fileName, nameLength);
+
+	recordArray->namesUsed += nameLength;
+
+	recordArray->numRecords++;
+
+
+	return 0;
+}
+
+
+/*---------------------------------------------------------*/
+
+int addEntryRecord(struct EntryRecordArray * recordArray,
+		   int dirFd, const char * fileName)
+{
+
+	struct EntryRecord * recordPtr = NULL;
+
+	struct stat statBuf;
+
+
+
+	if (addEntryName(recordArray, fileName, 0) == -1)
+	{
+		return -1;
+	}
+
+	recordPtr = &recordArray->records[recordArray->numRecords - 1];
+
+	if (getFileMetadata(dirFd, fileName, &statBuf) == -1)
+	{
+		recordPtr->errorNumber = errno;
+	}
+	else
+	{
+		storeEntryRecordStat(recordPtr, &statBuf);
+	}
+
+
+	return 0;
+}
+
+
+/*---------------------------------------------------------*/
+
+void lookupEntryRecords(struct EntryRecordArray * recordArray,
+			int dirFd)
+{
+
+	struct EntryRecord * recordPtr = NULL;
+
+	struct SortItem * itemPtr = NULL;
+
+	struct stat statBuf;
+
+	int isInodeOrdered;
+
+
+
+	/*============================================
+	 SECTION 1: Ordering the records by inode
+		    number, in the sort items, which a
+		    later sortEntryRecords() rebuilds
+	=============================================*/
+	isInodeOrdered = (reserveSortItems(recordArray) == 0);
+
+	if (isInodeOrdered)
+	{
+		for (size_t index = 0;
+		     index < recordArray->numRecords; index++)
+		{
+			itemPtr = &recordArray->sortItems[index];
+
+			itemPtr->key = recordArray->records[index]
+					.inodeNum;
+
+			itemPtr->minorKey = 0;
+
+			itemPtr->recordIndex = (uint32_t) index;
+		}
+
+		radixSortItems(recordArray->sortItems,
+			       recordArray->sortScratch,
+			       recordArray->numRecords);
+	}
+
+
+
+	/*============================================
+	 SECTION 2: Looking the records up in that
+		    order
+	=============================================*/
+	for (size_t index = 0; index < recordArray->numRecords;
+	     index++)
+	{
+		recordPtr = isInodeOrdered
+			? &recordArray->records[recordArray
+					->sortItems[index].recordIndex]
+			: &recordArray->records[index];
+
+		if (getFileMetadata(dirFd,
+				    getEntryName(recordArray,
+						 recordPtr->nameOffset),
+				    &statBuf) == -1)
+		{
+			recordPtr->errorNumber = errno;
+		}
+		else
+		{
+			storeEntryRecordStat(recordPtr, &statBuf);
+		}
+	}
+}
+
+
+/*---------------------------------------------------------*/
+
+int collectDirEntries(struct DirEnumerator * enumerator,
+		      struct EntryRecordArray * recordArray,
+		      size_t maxEntries, int inInodeOrder)
+{
+
+	struct DirEntryInfo entryInfo;
+
+	int readReturnValue = 1;
+
+	int dirFd = getDirEnumeratorFd(enumerator);
+
+
+
+	while (recordArray->numRecords < maxEntries
+	       && (readReturnValue = readNextDirEntry(
+			enumerator, &entryInfo)) == 1)
+	{
+		if (!isEntryNameListed(entryInfo.name,
+				       entryInfo.direntType))
+		{
+			continue;
+		}
+
+		if ((inInodeOrder
+		     ? addEntryName(recordArray, entryInfo.name,
+				    entryInfo.inodeNum)
+		     : addEntryRecord(recordArray, dirFd,
+				      entryInfo.name)) == -1)
+		{
+			errno = ENOMEM;
+
+			readReturnValue = -1;
+
+			break;
+		}
+	}
+
+	if (inInodeOrder)
+	{
+		lookupEntryRecords(recordArray, dirFd);
+	}
+
+
+	return readReturnValue;
+}
+
+
+/*---------------------------------------------------------*/
+
+void displayDirFilesInfoBatched(
+				struct OutputBuffer * outBuffer,
+				struct DirEnumerator * enumerator,
+				const char * dirPath,
+				struct EntryRecordArray * recordArray)
+{
+
+	int readReturnValue = 1;
+
+
+
+	/*============================================
+	 Each batch is read, looked up and written in
+	 directory order before the next is read, so
+	 memory stays bounded however large the
+	 directory is
+	=============================================*/
+	while (readReturnValue == 1)
+	{
+		readReturnValue = collectDirEntries(
+					enumerator, recordArray,
+					LISTING_BATCH_ENTRIES,
+					listingOptions.inodeOrder);
+
+		writeEntryRecords(outBuffer, recordArray, 0);
+	}
+
+
+	if (readReturnValue == -1)
+	{
+		reportReadDirError(outBuffer, dirPath, errno);
+	}
+}
+
+
+/*---------------------------------------------------------*/
+
+static int compareSortItemNames(const void * firstPtr,
+				const void * secondPtr,
+				void * argument)
+{
+	const struct EntryRecordArray * recordArray = argument;
+
+	const struct SortItem * firstItem = firstPtr;
+
+	const struct SortItem * secondItem = secondPtr;
+
+
+	return strcmp(getEntryName(recordArray,
+			recordArray->records[firstItem->recordIndex]
+				.nameOffset),
+		      getEntryName(recordArray,
+			recordArray->records[secondItem->recordIndex]
+				.nameOffset));
+}
+
+
+/*---------------------------------------------------------*/
+
+int sortEntryRecords(struct EntryRecordArray * recordArray,
+		     enum SortKey sortKey)
+{
+
+	/*============================================
+	 SECTION 1: Declaration of variables
+	=============================================*/
+
+	size_t numItems = recordArray->numRecords;
+
+	struct EntryRecord * recordPtr = NULL;
+
+	struct SortItem * itemPtr = NULL;
+
+	const unsigned char * namePtr = NULL;
+
+	size_t runStart;
+
+	size_t runEnd;
+
+
+
+	/*============================================
+	 SECTION 2: Making room for the sort items
+	=============================================*/
+	if (reserveSortItems(recordArray) == -1)
+	{
+		return -1;
+	}
+
+
+
+	/*============================================
+	 SECTION 3: Building the keys
+
+	 The keys are arranged so that ascending
+	 unsigned order is the order wanted: sizes and
+	 times are inverted to put the largest and
+	 newest first, and the sign bit of the seconds
+	 is flipped so that times before 1970 sort
+	 below later ones. Entries whose lookup failed
+	 get the largest key, and come last
+
+	 A name's key is its first eight bytes, most
+	 significant first. As names cannot contain
+	 NUL, padding a shorter name with zeros keeps
+	 the order strcmp() gives
+	=============================================*/
+	for (size_t index = 0; index < numItems; index++)
+	{
+		recordPtr = &recordArray->records[index];
+
+		itemPtr = &recordArray->sortItems[index];
+
+		itemPtr->recordIndex = (uint32_t) index;
+
+		itemPtr->key = 0;
+
+		itemPtr->minorKey = 0;
+
+
+		if (sortKey == SORT_NAME)
+		{
+			namePtr = (const unsigned char *)
+				  getEntryName(recordArray,
+					       recordPtr->nameOffset);
+
+			for (int byteIndex = 0;
+			     byteIndex < 8 && namePtr[byteIndex] != '\0';
+			     byteIndex++)
+			{
+				itemPtr->key |= (uint64_t) namePtr[byteIndex]
+						<< (56 - 8 * byteIndex);
+			}
+		}
+		else if (recordPtr->errorNumber != 0)
+		{
+			itemPtr->key = UINT64_MAX;
+
+			itemPtr->minorKey = UINT32_MAX;
+		}
+		else if (sortKey == SORT_SIZE)
+		{
+			itemPtr->key = ~recordPtr->fileSize;
+		}
+		else if (sortKey == SORT_MTIME)
+		{
+			itemPtr->key = ~((uint64_t) recordPtr->lastModTime
+					 ^ ((uint64_t) 1 << 63));
+
+			itemPtr->minorKey =
+				~recordPtr->lastModNanoseconds;
+		}
+		else
+		{
+			itemPtr->key = recordPtr->inodeNum;
+		}
+	}
+
+
+
+	/*============================================
+	 SECTION 4: Sorting by key, then ordering each
+		    run of equal keys by name. For a name
+		    key, such a run shares its first
+		    eight bytes, which need not be
+		    compared again
+	=============================================*/
+	radixSortItems(recordArray->sortItems,
+		       recordArray->sortScratch, numItems);
+
+
+	for (runStart = 0; runStart < numItems; runStart = runEnd)
+	{
+		itemPtr = &recordArray->sortItems[runStart];
+
+		runEnd = runStart + 1;
+
+		while (runEnd < numItems
+		       && recordArray->sortItems[runEnd].key
+			  == itemPtr->key
+		       && recordArray->sortItems[runEnd].minorKey
+			  == itemPtr->minorKey)
+		{
+			runEnd++;
+		}
+
+		if (runEnd - runStart > 1
+		    && (sortKey != SORT_NAME
+			|| (itemPtr->key & 0xff) != 0))
+		{
+			sortItemsByName(recordArray, runStart,
+					runEnd - runStart,
+					(sortKey == SORT_NAME) ? 8 : 0);
+		}
+	}
+
+
+	return 0;
+}
+
+
+/*---------------------------------------------------------*/
+
+int reserveSortItems(struct EntryRecordArray * recordArray)
+{
+
+	size_t numItems = recordArray->numRecords;
+
+	struct SortItem * newItems = NULL;
+
+
+
+	if (numItems <= recordArray->sortItemsCapacity)
+	{
+		return 0;
+	}
+
+
+	newItems = realloc(recordArray->sortItems,
+			   numItems * sizeof(*newItems));
+
+	if (newItems == NULL)
+	{
+		return -1;
+	}
+
+	recordArray->sortItems = newItems;
+
+	newItems = realloc(recordArray->sortScratch,
+			   numItems * sizeof(*newItems));
+
+	if (newItems == NULL)
+	{
+		return -1;
+	}
+
+	recordArray->sortScratch = newItems;
+
+	recordArray->sortItemsCapacity = numItems;
+
+
+	return 0;
+}
+
+
+/*---------------------------------------------------------*/
+
+void sortItemsByName(struct EntryRecordArray * recordArray,
+		     size_t firstIndex, size_t numItems,
+		     size_t nameOffset)
+{
+
+	struct SortItem * items =
+		recordArray->sortItems + firstIndex;
+
+	struct SortItem * itemPtr = NULL;
+
+	const unsigned char * namePtr = NULL;
+
+	size_t runStart;
+
+	size_t runEnd;
+
+
+
+	/*============================================
+	 SECTION 1: Comparing short runs directly
+	=============================================*/
+	if (numItems < NAME_SORT_RADIX_THRESHOLD)
+	{
+		qsort_r(items, numItems, sizeof(*items),
+			compareSortItemNames, recordArray);
+
+		return;
+	}
+
+
+
+	/*============================================
+	 SECTION 2: Radix sorting a long run by the
+		    eight bytes of the names starting
+		    at 'nameOffset'
+
+	 All names of the run are equal before
+	 'nameOffset' and none ends before it, so no
+	 name is read past its end
+	=============================================*/
+	for (size_t index = 0; index < numItems; index++)
+	{
+		itemPtr = &items[index];
+
+		namePtr = (const unsigned char *)
+			  getEntryName(recordArray,
+				recordArray->records[itemPtr->recordIndex]
+					.nameOffset)
+			  + nameOffset;
+
+		itemPtr->key = 0;
+
+		itemPtr->minorKey = 0;
+
+		for (int byteIndex = 0;
+		     byteIndex < 8 && namePtr[byteIndex] != '\0';
+		     byteIndex++)
+		{
+			itemPtr->key |= (uint64_t) namePtr[byteIndex]
+					<< (56 - 8 * byteIndex);
+		}
+	}
+
+	radixSortItems(items, recordArray->sortScratch + firstIndex,
+		       numItems);
+
+
+
+	/*============================================
+	 SECTION 3: Going on to the next eight bytes
+		    for every run that is still equal.
+		    Names that ended within these bytes
+		    are fully equal, and stay as they are
+	=============================================*/
+	for (runStart = 0; runStart < numItems; runStart = runEnd)
+	{
+		runEnd = runStart + 1;
+
+		while (runEnd < numItems
+		       && items[runEnd].key == items[runStart].key)
+		{
+			runEnd++;
+		}
+
+		if (runEnd - runStart > 1
+		    && (items[runStart].key & 0xff) != 0)
+		{
+			sortItemsByName(recordArray,
+					firstIndex + runStart,
+					runEnd - runStart,
+					nameOffset + 8);
+		}
+	}
+}
+
+
+/*---------------------------------------------------------*/
+
+void radixSortItems(struct SortItem * items,
+		    struct SortItem * scratch, size_t numItems)
+{
+
+	/*============================================
+	 Pass 0 to 3 sort by the bytes of 'minorKey'
+	 and passes 4 to 11 by those of 'key', least
+	 significant first. Every item contributes to
+	 all twelve histograms in a single read of the
+	 array, as the histograms do not depend on the
+	 order the items are in
+	=============================================*/
+	static __thread size_t digitCounts[12][256];
+
+	struct SortItem * sourceItems = items;
+
+	struct SortItem * targetItems = scratch;
+
+	struct SortItem * swapPtr = NULL;
+
+	size_t bucketStart;
+
+	size_t bucketCount;
+
+	unsigned int digit;
+
+
+
+	if (numItems < 2)
+	{
+		return;
+	}
+
+	memset(digitCounts, 0, sizeof(digitCounts));
+
+
+	for (size_t index = 0; index < numItems; index++)
+	{
+		for (int pass = 0; pass < 4; pass++)
+		{
+			digitCounts[pass][(items[index].minorKey
+					   >> (8 * pass)) & 0xff]++;
+		}
+
+		for (int pass = 4; pass < 12; pass++)
+		{
+			digitCounts[pass][(items[index].key
+					   >> (8 * (pass - 4))) & 0xff]++;
+		}
+	}
+
+
+	for (int pass = 0; pass < 12; pass++)
+	{
+		digit = (pass < 4)
+			? (sourceItems[0].minorKey >> (8 * pass)) & 0xff
+			: (sourceItems[0].key >> (8 * (pass - 4))) & 0xff;
+
+		//All items share this byte, so the pass
+		// would not move anything
+		if (digitCounts[pass][digit] == numItems)
+		{
+			continue;
+		}
+
+
+		//Turn the counts into bucket offsets
+		bucketStart = 0;
+
+		for (int bucket = 0; bucket < 256; bucket++)
+		{
+			bucketCount = digitCounts[pass][bucket];
+
+			digitCounts[pass][bucket] = bucketStart;
+
+			bucketStart += bucketCount;
+		}
+
+
+		for (size_t index = 0; index < numItems; index++)
+		{
+			digit = (pass < 4)
+				? (sourceItems[index].minorKey
+				   >> (8 * pass)) & 0xff
+				: (sourceItems[index].key
+				   >> (8 * (pass - 4))) & 0xff;
+
+			targetItems[digitCounts[pass][digit]++] =
+				sourceItems[index];
+		}
+
+		swapPtr = sourceItems;
+
+		sourceItems = targetItems;
+
+		targetItems = swapPtr;
+	}
+
+
+	if (sourceItems != items)
+	{
+		memcpy(items, sourceItems, numItems * sizeof(*items));
+	}
+}
+
+
+/*---------------------------------------------------------*/
+
+void writeEntryRecords(struct OutputBuffer * outBuffer,
+		       struct EntryRecordArray * recordArray,
+		       int isSorted)
+{
+
+	struct EntryRecord * recordPtr = NULL;
+
+	struct stat statBuf;
+
+	const char * fileName = NULL;
+
+	int isSnapshotListing = (listingOptions.snapshotPath != NULL
+				 || listingOptions.sinceSnapshotPath != NULL);
+
+
+
+	for (size_t index = 0; index < recordArray->numRecords;
+	     index++)
+	{
+		recordPtr = isSorted
+			? &recordArray->records[recordArray
+					->sortItems[index].recordIndex]
+			: &recordArray->records[index];
+
+		fileName = getEntryName(recordArray,
+					recordPtr->nameOffset);
+
+		//A snapshot holds every entry, so with one
+		// the names are checked here instead of as
+		// the directory is read
+		if (isSnapshotListing
+		    && !isEntryNameListed(fileName, DT_UNKNOWN))
+		{
+			continue;
+		}
+
+
+		if (recordPtr->errorNumber != 0)
+		{
+			reportAccessError(outBuffer, fileName,
+					  recordPtr->errorNumber);
+		}
+		else
+		{
+			loadEntryRecordStat(recordPtr, &statBuf);
+
+			writeFileStatInfo(outBuffer, fileName, &statBuf);
+		}
+	}
+
+
+	resetEntryRecords(recordArray);
+}
+
+
+/*---------------------------------------------------------*/
+
+void storeEntryRecordStat(struct EntryRecord * recordPtr,
+			  const struct stat * statBuf)
+{
+	recordPtr->fileSize = (uint64_t) statBuf->st_size;
+
+	recordPtr->inodeNum = statBuf->st_ino;
+
+	recordPtr->lastAccessTime = statBuf->st_atim.tv_sec;
+
+	recordPtr->lastModTime = statBuf->st_mtim.tv_sec;
+
+	recordPtr->lastStatChgTime = statBuf->st_ctim.tv_sec;
+
+	recordPtr->lastModNanoseconds =
+		(uint32_t) statBuf->st_mtim.tv_nsec;
+
+	recordPtr->fileTypeAndPermsFlags = statBuf->st_mode;
+
+	recordPtr->userId = statBuf->st_uid;
+
+	recordPtr->groupId = statBuf->st_gid;
+
+	recordPtr->numOfHardLinks = (uint32_t) statBuf->st_nlink;
+
+	recordPtr->deviceMajorNum = gnu_dev_major(statBuf->st_dev);
+
+	recordPtr->deviceMinorNum = gnu_dev_minor(statBuf->st_dev);
+}
+
+
+/*---------------------------------------------------------*/
+
+void loadEntryRecordStat(const struct EntryRecord * recordPtr,
+			 struct stat * statBuf)
+{
+
+	/*============================================
+	 Only the fields writeFileStatInfo() reads are
+	 filled in
+	=============================================*/
+	statBuf->st_size = (off_t) recordPtr->fileSize;
+
+	statBuf->st_ino = recordPtr->inodeNum;
+
+	statBuf->st_atim.tv_sec = recordPtr->lastAccessTime;
+
+	statBuf->st_mtim.tv_sec = recordPtr->lastModTime;
+
+	statBuf->st_ctim.tv_sec = recordPtr->lastStatChgTime;
+
+	statBuf->st_mtim.tv_nsec = recordPtr->lastModNanoseconds;
+
+	statBuf->st_mode = recordPtr->fileTypeAndPermsFlags;
+
+	statBuf->st_uid = recordPtr->userId;
+
+	statBuf->st_gid = recordPtr->groupId;
+
+	statBuf->st_nlink = recordPtr->numOfHardLinks;
+
+	statBuf->st_dev = makedev(recordPtr->deviceMajorNum,
+				  recordPtr->deviceMinorNum);
+}
+
+
+/*---------------------------------------------------------*/
+
+void resetEntryRecords(struct EntryRecordArray * recordArray)
+{
+
+	/*============================================
+	 SECTION 1: Freeing every name chunk but the
+		    first
+	=============================================*/
+	while (recordArray->numNameChunks > 1)
+	{
+		recordArray->numNameChunks--;
+
+		free(recordArray->nameChunks
+			[recordArray->numNameChunks]);
+	}
+
+	recordArray->namesUsed = 0;
+
+	recordArray->numRecords = 0;
+
+
+
+	/*============================================
+	 SECTION 2: Freeing the arrays left large by a
+		    big directory. They are allocated
+		    again when needed
+	=============================================*/
+	if (recordArray->recordsCapacity > MAX_KEPT_ENTRY_RECORDS)
+	{
+		free(recordArray->records);
+
+		recordArray->records = NULL;
+
+		recordArray->recordsCapacity = 0;
+	}
+
+	if (recordArray->sortItemsCapacity > MAX_KEPT_ENTRY_RECORDS)
+	{
+		free(recordArray->sortItems);
+
+		free(recordArray->sortScratch);
+
+		recordArray->sortItems = NULL;
+
+		recordArray->sortScratch = NULL;
+
+		recordArray->sortItemsCapacity = 0;
+	}
+}
+
+
+/*---------------------------------------------------------*/
+
+void destroyEntryRecords(struct EntryRecordArray * recordArray)
+{
+	resetEntryRecords(recordArray);
+
+	if (recordArray->numNameChunks > 0)
+	{
+		free(recordArray->nameChunks[0]);
+	}
+
+	free(recordArray->nameChunks);
+
+	free(recordArray->records);
+
+	free(recordArray->sortItems);
+
+	free(recordArray->sortScratch);
+
+	memset(recordArray, 0, sizeof(*recordArray));
+}
+
+
+/*---------------------------------------------------------*/
+
+const struct SortKeyDescriptor * findSortKey(
+				const char * sortName)
+{
+	for (size_t index = 0; index < NUM_SORT_KEY_DESCRIPTORS;
+	     index++)
+	{
+		if (strcmp(sortKeyDescriptors[index].sortName,
+			   sortName) == 0)
+		{
+			return &sortKeyDescriptors[index];
+		}
+	}
+
+
+	fprintf(stderr, "myls: Unknown sort order '%s'\n", sortName);
+
+	return NULL;
+}
+
+
+/*---------------------------------------------------------*/
+
+void displayDirFilesInfoSnapshot(
+				struct OutputBuffer * outBuffer,
+				struct DirEnumerator * enumerator,
+				const char * dirPath,
+				struct EntryRecordArray * recordArray)
+{
+
+	/*============================================
+	 SECTION 1: Declaration of variables
+	=============================================*/
+
+	struct DirEntryInfo entryInfo;
+
+	struct stat dirStat;
+
+	const struct SnapshotDir * snapshotDir = NULL;
+
+	struct SnapshotColumns columns;
+
+	int hasDirStat;
+
+	int isInSnapshot;
+
+	int isUnchanged;
+
+	int readReturnValue = 0;
+
+	int addReturnValue;
+
+	size_t entryIndex;
+
+	size_t nextIndex = 0;
+
+	int isFound;
+
+	int isSorted = 0;
+
+	int dirFd = getDirEnumeratorFd(enumerator);
+
+
+
+	/*============================================
+	 SECTION 2: Finding the directory in the
+		    previous snapshot, and telling
+		    whether it has changed since
+	=============================================*/
+	hasDirStat = (fstat(dirFd, &dirStat) == 0);
+
+	isInSnapshot = hasDirStat
+		&& findSnapshotDir(&previousSnapshot, dirPath,
+				   &snapshotDir, &columns) == 0;
+
+	isUnchanged = isInSnapshot
+		&& snapshotDir->dirInode == dirStat.st_ino
+		&& snapshotDir->dirDevice == dirStat.st_dev
+		&& snapshotDir->dirModTime == dirStat.st_mtim.tv_sec
+		&& snapshotDir->dirModNanoseconds
+		   == (uint32_t) dirStat.st_mtim.tv_nsec
+		&& snapshotDir->dirModTime + SNAPSHOT_RACY_SECONDS
+		   <= previousSnapshot.header->startTime;
+
+
+
+	/*============================================
+	 SECTION 3: Collecting the entries, from the
+		    snapshot alone when the directory
+		    is unchanged, or by reading it and
+		    looking up only what is new
+	=============================================*/
+	if (isUnchanged)
+	{
+		snapshotStats.dirsReused++;
+
+		for (entryIndex = 0; entryIndex < columns.numEntries;
+		     entryIndex++)
+		{
+			if (addSnapshotEntry(recordArray, &columns,
+					     entryIndex) == -1)
+			{
+				reportAccessError(outBuffer,
+					columns.names
+					+ columns.nameOffsets[entryIndex],
+					ENOMEM);
+			}
+		}
+
+		snapshotStats.entriesReused += columns.numEntries;
+	}
+	else
+	{
+		snapshotStats.dirsRead++;
+
+		while ((readReturnValue = readNextDirEntry(
+				enumerator, &entryInfo)) == 1)
+		{
+			//Directory order rarely changes, so the
+			// entry after the last one found is
+			// tried before searching
+			isFound = 0;
+
+			if (isInSnapshot && nextIndex < columns.numEntries
+			    && strcmp(entryInfo.name,
+				      columns.names
+				      + columns.nameOffsets[nextIndex]) == 0)
+			{
+				entryIndex = nextIndex;
+
+				isFound = 1;
+			}
+			else if (isInSnapshot)
+			{
+				isFound = (findSnapshotEntry(&columns,
+							     entryInfo.name,
+							     &entryIndex) == 0);
+			}
+
+			if (isFound)
+			{
+				nextIndex = entryIndex + 1;
+			}
+
+			if (isFound && columns.inodeNums[entryIndex]
+				       == entryInfo.inodeNum)
+			{
+				addReturnValue = addSnapshotEntry(
+					recordArray, &columns, entryIndex);
+
+				snapshotStats.entriesReused++;
+			}
+			else
+			{
+				addReturnValue = addEntryRecord(
+					recordArray, dirFd, entryInfo.name);
+
+				snapshotStats.entriesLookedUp++;
+			}
+
+			if (addReturnValue == -1)
+			{
+				reportAccessError(outBuffer, entryInfo.name,
+						  ENOMEM);
+			}
+		}
+	}
+
+
+	if (readReturnValue == -1)
+	{
+		reportReadDirError(outBuffer, dirPath, errno);
+	}
+
+
+
+	/*============================================
+	 SECTION 4: Adding the directory to the new
+		    snapshot, unless it could not be
+		    read completely, then sorting and
+		    writing the records
+	=============================================*/
+	if (snapshotWriter.filePath != NULL && hasDirStat
+	    && readReturnValue == 0)
+	{
+		addSnapshotDir(&snapshotWriter, dirPath, &dirStat,
+			       recordArray);
+	}
+
+	if (listingOptions.sortKey != SORT_NONE)
+	{
+		isSorted = (sortEntryRecords(recordArray,
+					     listingOptions.sortKey) == 0);
+	}
+
+	writeEntryRecords(outBuffer, recordArray, isSorted);
+}
+
+
+/*---------------------------------------------------------*/
+
+int addSnapshotEntry(struct EntryRecordArray * recordArray,
+		     const struct SnapshotColumns * columns,
+		     size_t entryIndex)
+{
+
+	struct EntryRecord * recordPtr = NULL;
+
+
+
+	if (addEntryName(recordArray,
+			 columns->names
+			 + columns->nameOffsets[entryIndex],
+			 columns->inodeNums[entryIndex]) == -1)
+	{
+		return -1;
+	}
+
+	recordPtr = &recordArray->records[recordArray->numRecords - 1];
+
+	recordPtr->fileSize = columns->fileSizes[entryIndex];
+
+	recordPtr->lastAccessTime =
+		columns->lastAccessTimes[entryIndex];
+
+	recordPtr->lastModTime = columns->lastModTimes[entryIndex];
+
+	recordPtr->lastStatChgTime =
+		columns->lastStatChgTimes[entryIndex];
+
+	recordPtr->lastModNanoseconds =
+		columns->lastModNanoseconds[entryIndex];
+
+	recordPtr->fileTypeAndPermsFlags =
+		columns->fileTypeAndPermsFlags[entryIndex];
+
+	recordPtr->userId = columns->userIds[entryIndex];
+
+	recordPtr->groupId = columns->groupIds[entryIndex];
+
+	recordPtr->numOfHardLinks =
+		columns->numOfHardLinks[entryIndex];
+
+	recordPtr->deviceMajorNum =
+		columns->deviceMajorNums[entryIndex];
+
+	recordPtr->deviceMinorNum =
+		columns->deviceMinorNums[entryIndex];
+
+
+	return 0;
+}
+
+
+/*---------------------------------------------------------*/
+
+int loadSnapshot(struct Snapshot * snapshot,
+		 const char * filePath)
+{
+
+	int fileFd;
+
+	struct stat statBuf;
+
+	void * mappedData = NULL;
+
+	const struct SnapshotHeader * header = NULL;
+
+
+
+	memset(snapshot, 0, sizeof(*snapshot));
+
+
+
+	/*============================================
+	 SECTION 1: Mapping the file
+	=============================================*/
+	fileFd = open(filePath, O_RDONLY | O_CLOEXEC);
+
+	if (fileFd == -1)
+	{
+		if (errno == ENOENT)
+		{
+			return 0;
+		}
+
+		fprintf(stderr, "myls: Cannot read snapshot '%s': %s\n",
+			filePath, strerror(errno));
+
+		return -1;
+	}
+
+	if (fstat(fileFd, &statBuf) == -1
+	    || (size_t) statBuf.st_size < sizeof(*header))
+	{
+		fprintf(stderr, "myls: '%s' is not a snapshot\n",
+			filePath);
+
+		close(fileFd);
+
+		return -1;
+	}
+
+	mappedData = mmap(NULL, statBuf.st_size, PROT_READ,
+			  MAP_PRIVATE, fileFd, 0);
+
+	close(fileFd);
+
+	if (mappedData == MAP_FAILED)
+	{
+		fprintf(stderr, "myls: Cannot map snapshot '%s': %s\n",
+			filePath, strerror(errno));
+
+		return -1;
+	}
+
+
+
+	/*============================================
+	 SECTION 2: Checking the header and that the
+		    directory table lies in the file
+	=============================================*/
+	header = mappedData;
+
+	if (memcmp(header->magic, SNAPSHOT_MAGIC,
+		   sizeof(SNAPSHOT_MAGIC)) != 0
+	    || header->formatVersion != SNAPSHOT_FORMAT_VERSION
+	    || header->byteOrderMark != SNAPSHOT_BYTE_ORDER_MARK
+	    || header->fileSize != (uint64_t) statBuf.st_size
+	    || header->dirTableOffset % 8 != 0
+	    || header->dirTableOffset > header->fileSize
+	    || header->numDirs > (header->fileSize
+				  - header->dirTableOffset)
+				 / sizeof(struct SnapshotDir))
+	{
+		fprintf(stderr,
+			"myls: '%s' is not a snapshot of this version"
+			" of myls\n", filePath);
+
+		munmap(mappedData, statBuf.st_size);
+
+		return -1;
+	}
+
+
+	snapshot->data = mappedData;
+
+	snapshot->dataLength = statBuf.st_size;
+
+	snapshot->header = header;
+
+	snapshot->dirs = (const struct SnapshotDir *)
+			 (snapshot->data + header->dirTableOffset);
+
+
+	return 0;
+}
+
+
+/*---------------------------------------------------------*/
+
+void unloadSnapshot(struct Snapshot * snapshot)
+{
+	if (snapshot->data != NULL)
+	{
+		munmap((void *) snapshot->data, snapshot->dataLength);
+	}
+
+	memset(snapshot, 0, sizeof(*snapshot));
+}
+
+
+/*---------------------------------------------------------*/
+
+int findSnapshotDir(const struct Snapshot * snapshot,
+		    const char * dirPath,
+		    const struct SnapshotDir ** snapshotDir,
+		    struct SnapshotColumns * columns)
+{
+
+	/*============================================
+	 SECTION 1: Declaration of variables
+	=============================================*/
+
+	size_t lowIndex = 0;
+
+	size_t highIndex;
+
+	size_t middleIndex;
+
+	const struct SnapshotDir * dirPtr = NULL;
+
+	const unsigned char * sectionPtr = NULL;
+
+	size_t numEntries;
+
+	int comparison;
+
+
+
+	/*============================================
+	 SECTION 2: Searching the table, whose paths
+		    have been checked to end within the
+		    file only when they are compared
+	=============================================*/
+	if (snapshot->data == NULL)
+	{
+		return -1;
+	}
+
+	highIndex = snapshot->header->numDirs;
+
+	while (lowIndex < highIndex)
+	{
+		middleIndex = lowIndex + (highIndex - lowIndex) / 2;
+
+		dirPtr = &snapshot->dirs[middleIndex];
+
+		if (dirPtr->pathOffset >= snapshot->dataLength
+		    || memchr(snapshot->data + dirPtr->pathOffset, '\0',
+			      snapshot->dataLength - dirPtr->pathOffset)
+		       == NULL)
+		{
+			return -1;
+		}
+
+		comparison = strcmp(dirPath, (const char *)
+				    (snapshot->data + dirPtr->pathOffset));
+
+		if (comparison == 0)
+		{
+			break;
+		}
+
+		if (comparison < 0)
+		{
+			highIndex = middleIndex;
+		}
+		else
+		{
+			lowIndex = middleIndex + 1;
+		}
+	}
+
+	if (lowIndex >= highIndex)
+	{
+		return -1;
+	}
+
+
+
+	/*============================================
+	 SECTION 3: Locating the columns, after
+		    checking that the section, its
+		    name offsets and its name order
+		    stay within the file
+	=============================================*/
+	numEntries = dirPtr->numEntries;
+
+	if (dirPtr->sectionOffset % 8 != 0
+	    || dirPtr->sectionOffset > snapshot->dataLength
+	    || numEntries > (snapshot->dataLength
+			     - dirPtr->sectionOffset)
+			    / SNAPSHOT_BYTES_PER_ENTRY
+	    || dirPtr->namesLength > snapshot->dataLength
+				     - dirPtr->sectionOffset
+				     - numEntries
+				       * SNAPSHOT_BYTES_PER_ENTRY)
+	{
+		return -1;
+	}
+
+	sectionPtr = snapshot->data + dirPtr->sectionOffset;
+
+	columns->numEntries = numEntries;
+
+	columns->inodeNums = (const uint64_t *) sectionPtr;
+
+	columns->fileSizes = columns->inodeNums + numEntries;
+
+	columns->lastAccessTimes = (const int64_t *)
+				   (columns->fileSizes + numEntries);
+
+	columns->lastModTimes = columns->lastAccessTimes + numEntries;
+
+	columns->lastStatChgTimes = columns->lastModTimes + numEntries;
+
+	columns->lastModNanoseconds = (const uint32_t *)
+		(columns->lastStatChgTimes + numEntries);
+
+	columns->fileTypeAndPermsFlags =
+		columns->lastModNanoseconds + numEntries;
+
+	columns->userIds = columns->fileTypeAndPermsFlags + numEntries;
+
+	columns->groupIds = columns->userIds + numEntries;
+
+	columns->numOfHardLinks = columns->groupIds + numEntries;
+
+	columns->deviceMajorNums = columns->numOfHardLinks + numEntries;
+
+	columns->deviceMinorNums = columns->deviceMajorNums + numEntries;
+
+	columns->nameOffsets = columns->deviceMinorNums + numEntries;
+
+	columns->nameOrder = columns->nameOffsets + numEntries;
+
+	columns->names = (const char *)
+			 (columns->nameOrder + numEntries);
+
+
+	if (numEntries > 0
+	    && (dirPtr->namesLength == 0
+		|| columns->names[dirPtr->namesLength - 1] != '\0'))
+	{
+		return -1;
+	}
+
+	for (size_t index = 0; index < numEntries; index++)
+	{
+		if (columns->nameOffsets[index] >= dirPtr->namesLength
+		    || columns->nameOrder[index] >= numEntries)
+		{
+			return -1;
+		}
+	}
+
+
+	*snapshotDir = dirPtr;
+
+
+	return 0;
+}
+
+
+/*---------------------------------------------------------*/
+
+int findSnapshotEntry(const struct SnapshotColumns * columns,
+		      const char * fileName,
+		      size_t * entryIndex)
+{
+
+	size_t lowIndex = 0;
+
+	size_t highIndex = columns->numEntries;
+
+	size_t middleIndex;
+
+	uint32_t candidateIndex;
+
+	int comparison;
+
+
+
+	while (lowIndex < highIndex)
+	{
+		middleIndex = lowIndex + (highIndex - lowIndex) / 2;
+
+		candidateIndex = columns->nameOrder[middleIndex];
+
+		comparison = strcmp(fileName,
+				    columns->names
+				    + columns->nameOffsets[candidateIndex]);
+
+		if (comparison == 0)
+		{
+			*entryIndex = candidateIndex;
+
+			return 0;
+		}
+
+		if (comparison < 0)
+		{
+			highIndex = middleIndex;
+		}
+		else
+		{
+			lowIndex = middleIndex + 1;
+		}
+	}
+
+
+	return -1;
+}
+
+
+/*---------------------------------------------------------*/
+
+int beginSnapshot(struct SnapshotWriter * writer,
+		  const char * filePath)
+{
+
+	int fileFd;
+
+	struct SnapshotHeader header;
+
+
+
+	memset(writer, 0, sizeof(*writer));
+
+	writer->tempPath = malloc(strlen(filePath) + sizeof(".XXXXXX"));
+
+	if (writer->tempPath == NULL)
+	{
+		perror("myls");
+
+		return -1;
+	}
+
+	strcpy(writer->tempPath, filePath);
+
+	strcat(writer->tempPath, ".XXXXXX");
+
+
+	fileFd = mkstemp(writer->tempPath);
+
+	if (fileFd == -1
+	    || initOutputBuffer(&writer->output, fileFd,
+				DEFAULT_OUTPUT_BUFFER_SIZE) == -1)
+	{
+		fprintf(stderr, "myls: Cannot write snapshot '%s': %s\n",
+			filePath, strerror(errno));
+
+		if (fileFd != -1)
+		{
+			close(fileFd);
+
+			unlink(writer->tempPath);
+		}
+
+		free(writer->tempPath);
+
+		writer->tempPath = NULL;
+
+		return -1;
+	}
+
+
+	//The header is written again, complete, at
+	// the end
+	writer->filePath = filePath;
+
+	writer->startTime = time(NULL);
+
+	memset(&header, 0, sizeof(header));
+
+	appendSnapshotBytes(writer, &header, sizeof(header), 8);
+
+
+	return 0;
+}
+
+
+/*---------------------------------------------------------*/
+
+void addSnapshotDir(struct SnapshotWriter * writer,
+		    const char * dirPath,
+		    const struct stat * dirStat,
+		    struct EntryRecordArray * recordArray)
+{
+
+	/*============================================
+	 SECTION 1: Declaration of variables
+	=============================================*/
+
+	size_t numRecords = recordArray->numRecords;
+
+	struct EntryRecord * recordPtr = NULL;
+
+	struct SnapshotDir * dirPtr = NULL;
+
+	void * newArray = NULL;
+
+	size_t newCapacity;
+
+	size_t pathLength = strlen(dirPath) + 1;
+
+	size_t numEntries = 0;
+
+	uint32_t nameOffset = 0;
+
+	uint64_t value64;
+
+	uint32_t value32;
+
+	const char * fileName = NULL;
+
+
+
+	/*============================================
+	 SECTION 2: Making room for the directory and
+		    its path, numbering the records
+		    that go into the section, and
+		    ordering them by name
+	=============================================*/
+	if (writer->numDirs == writer->dirsCapacity)
+	{
+		newCapacity = (writer->dirsCapacity > 0)
+			      ? writer->dirsCapacity * 2 : 64;
+
+		newArray = realloc(writer->dirs,
+				   newCapacity * sizeof(*writer->dirs));
+
+		if (newArray == NULL)
+		{
+			return;
+		}
+
+		writer->dirs = newArray;
+
+		writer->dirsCapacity = newCapacity;
+	}
+
+	if (writer->pathsUsed + pathLength > writer->pathsCapacity)
+	{
+		newCapacity = (writer->pathsCapacity > 0)
+			      ? writer->pathsCapacity * 2 : 4096;
+
+		while (newCapacity < writer->pathsUsed + pathLength)
+		{
+			newCapacity *= 2;
+		}
+
+		newArray = realloc(writer->paths, newCapacity);
+
+		if (newArray == NULL)
+		{
+			return;
+		}
+
+		writer->paths = newArray;
+
+		writer->pathsCapacity = newCapacity;
+	}
+
+	if (numRecords > writer->sectionIndicesCapacity)
+	{
+		newArray = realloc(writer->sectionIndices,
+				   numRecords
+				   * sizeof(*writer->sectionIndices));
+
+		if (newArray == NULL)
+		{
+			return;
+		}
+
+		writer->sectionIndices = newArray;
+
+		writer->sectionIndicesCapacity = numRecords;
+	}
+
+	//Name offsets and indices are 32-bit
+	if (recordArray->namesUsed > UINT32_MAX
+	    || sortEntryRecords(recordArray, SORT_NAME) == -1)
+	{
+		return;
+	}
+
+	for (size_t index = 0; index < numRecords; index++)
+	{
+		writer->sectionIndices[index] = (uint32_t) numEntries;
+
+		if (recordArray->records[index].errorNumber == 0)
+		{
+			numEntries++;
+		}
+	}
+
+
+
+	/*============================================
+	 SECTION 3: Writing the columns, each a pass
+		    over the records, skipping those
+		    whose lookup failed
+	=============================================*/
+	dirPtr = &writer->dirs[writer->numDirs];
+
+	dirPtr->pathOffset = writer->pathsUsed;
+
+	dirPtr->sectionOffset = writer->fileOffset;
+
+	dirPtr->numEntries = numEntries;
+
+	dirPtr->dirInode = dirStat->st_ino;
+
+	dirPtr->dirDevice = dirStat->st_dev;
+
+	dirPtr->dirModTime = dirStat->st_mtim.tv_sec;
+
+	dirPtr->dirModNanoseconds = dirStat->st_mtim.tv_nsec;
+
+	dirPtr->reserved = 0;
+
+
+	for (int column = 0; column < 14; column++)
+	{
+		for (size_t index = 0; index < numRecords; index++)
+		{
+			recordPtr = &recordArray->records[index];
+
+			if (recordPtr->errorNumber != 0)
+			{
+				continue;
+			}
+
+			switch (column)
+			{
+				case 0:
+					value64 = recordPtr->inodeNum;
+					break;
+
+				case 1:
+					value64 = recordPtr->fileSize;
+					break;
+
+				case 2:
+					value64 = recordPtr->lastAccessTime;
+					break;
+
+				case 3:
+					value64 = recordPtr->lastModTime;
+					break;
+
+				case 4:
+					value64 = recordPtr->lastStatChgTime;
+					break;
+
+				case 5:
+					value32 = recordPtr->lastModNanoseconds;
+					break;
+
+				case 6:
+					value32 = recordPtr
+						  ->fileTypeAndPermsFlags;
+					break;
+
+				case 7:
+					value32 = recordPtr->userId;
+					break;
+
+				case 8:
+					value32 = recordPtr->groupId;
+					break;
+
+				case 9:
+					value32 = recordPtr->numOfHardLinks;
+					break;
+
+				case 10:
+					value32 = recordPtr->deviceMajorNum;
+					break;
+
+				case 11:
+					value32 = recordPtr->deviceMinorNum;
+					break;
+
+				case 12:
+					value32 = nameOffset;
+
+					nameOffset += strlen(getEntryName(
+						recordArray,
+						recordPtr->nameOffset)) + 1;
+					break;
+
+				default:
+					//The name order goes through the
+					// records in sorted order instead
+					recordPtr = &recordArray->records
+						[recordArray->sortItems[index]
+							.recordIndex];
+
+					if (recordPtr->errorNumber != 0)
+					{
+						continue;
+					}
+
+					value32 = writer->sectionIndices
+						[recordArray->sortItems[index]
+							.recordIndex];
+					break;
+			}
+
+			if (column < 5)
+			{
+				appendSnapshotBytes(writer, &value64, 8, 1);
+			}
+			else
+			{
+				appendSnapshotBytes(writer, &value32, 4, 1);
+			}
+		}
+	}
+
+
+
+	/*============================================
+	 SECTION 4: Writing the names, and recording
+		    the directory
+	=============================================*/
+	for (size_t index = 0; index < numRecords; index++)
+	{
+		recordPtr = &recordArray->records[index];
+
+		if (recordPtr->errorNumber == 0)
+		{
+			fileName = getEntryName(recordArray,
+						recordPtr->nameOffset);
+
+			appendSnapshotBytes(writer, fileName,
+					    strlen(fileName) + 1, 1);
+		}
+	}
+
+	dirPtr->namesLength = nameOffset;
+
+	appendSnapshotBytes(writer, NULL, 0, 8);
+
+
+	memcpy(writer->paths + writer->pathsUsed, dirPath, pathLength);
+
+	writer->pathsUsed += pathLength;
+
+	writer->numDirs++;
+}
+
+
+/*---------------------------------------------------------*/
+
+void appendSnapshotBytes(struct SnapshotWriter * writer,
+			 const void * bytes, size_t numBytes,
+			 size_t alignment)
+{
+	static const char zeros[8];
+
+
+	if (numBytes > 0)
+	{
+		appendOutputBytes(&writer->output, bytes, numBytes);
+
+		writer->fileOffset += numBytes;
+	}
+
+
+	if (writer->fileOffset % alignment != 0)
+	{
+		numBytes = alignment - writer->fileOffset % alignment;
+
+		appendOutputBytes(&writer->output, zeros, numBytes);
+
+		writer->fileOffset += numBytes;
+	}
+}
+
+
+/*---------------------------------------------------------*/
+
+static int compareSnapshotDirPaths(const void * firstPtr,
+				   const void * secondPtr,
+				   void * argument)
+{
+	const char * paths = argument;
+
+	const struct SnapshotDir * firstDir = firstPtr;
+
+	const struct SnapshotDir * secondDir = secondPtr;
+
+
+	return strcmp(paths + firstDir->pathOffset,
+		      paths + secondDir->pathOffset);
+}
+
+
+/*---------------------------------------------------------*/
+
+int finishSnapshot(struct SnapshotWriter * writer)
+{
+
+	struct SnapshotHeader header;
+
+	uint64_t pathsOffset;
+
+	int fileFd = writer->output.outputFd;
+
+	int returnValue = 0;
+
+
+
+	/*============================================
+	 SECTION 1: Writing the paths and the table of
+		    directories, sorted by path. A path
+		    listed twice keeps only one entry
+		    found by the binary search, which is
+		    harmless
+	=============================================*/
+	pathsOffset = writer->fileOffset;
+
+	appendSnapshotBytes(writer, writer->paths, writer->pathsUsed, 8);
+
+	qsort_r(writer->dirs, writer->numDirs, sizeof(*writer->dirs),
+		compareSnapshotDirPaths, writer->paths);
+
+	for (size_t index = 0; index < writer->numDirs; index++)
+	{
+		writer->dirs[index].pathOffset += pathsOffset;
+	}
+
+
+	memset(&header, 0, sizeof(header));
+
+	memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+
+	header.formatVersion = SNAPSHOT_FORMAT_VERSION;
+
+	header.byteOrderMark = SNAPSHOT_BYTE_ORDER_MARK;
+
+	header.startTime = writer->startTime;
+
+	header.numDirs = writer->numDirs;
+
+	header.dirTableOffset = writer->fileOffset;
+
+	appendSnapshotBytes(writer, writer->dirs,
+			    writer->numDirs * sizeof(*writer->dirs), 8);
+
+	header.fileSize = writer->fileOffset;
+
+	flushOutputBuffer(&writer->output);
+
+
+
+	/*============================================
+	 SECTION 2: Completing the header, and putting
+		    the file in place only once all of
+		    it is on disk
+	=============================================*/
+	if (writer->output.hasFailed
+	    || pwrite(fileFd, &header, sizeof(header), 0)
+	       != (ssize_t) sizeof(header)
+	    || fsync(fileFd) == -1)
+	{
+		returnValue = -1;
+	}
+
+	if (close(fileFd) == -1)
+	{
+		returnValue = -1;
+	}
+
+	if (returnValue == 0
+	    && rename(writer->tempPath, writer->filePath) == -1)
+	{
+		returnValue = -1;
+	}
+
+	if (returnValue == -1)
+	{
+		fprintf(stderr, "myls: Cannot write snapshot '%s': %s\n",
+			writer->filePath, strerror(errno));
+
+		unlink(writer->tempPath);
+	}
+
+
+	destroyOutputBuffer(&writer->output);
+
+	free(writer->tempPath);
+
+	free(writer->dirs);
+
+	free(writer->paths);
+
+	free(writer->sectionIndices);
+
+	memset(writer, 0, sizeof(*writer));
+
+
+	return returnValue;
+}
+
+
+/*---------------------------------------------------------*/
+
+int addWatchTarget(const char * path, int isDir)
+{
+
+	struct WatchTarget * newTargets = NULL;
+
+	size_t newCapacity;
+
+	char * pathCopy = NULL;
+
+	int watchDescriptor;
+
+
+
+	/*============================================
+	 IN_MASK_ADD keeps what an earlier watch of
+	 the same file asked for, e.g. a directory
+	 given both as a FILE and with --dir
+	=============================================*/
+	watchDescriptor = inotify_add_watch(watchState.inotifyFd, path,
+					    (isDir ? WATCH_DIR_EVENTS
+						   : WATCH_FILE_EVENTS)
+					    | IN_MASK_ADD);
+
+	if (watchDescriptor == -1)
+	{
+		flushOutputBuffer(&stdoutBuffer);
+
+		fprintf(stderr, "myls: Cannot watch '%s': %s\n",
+			path, strerror(errno));
+
+		return -1;
+	}
+
+
+
+	/*============================================
+	 SECTION 1: Growing the targets. The kernel
+		    numbers watches upwards from 1, so
+		    the array stays about as long as
+		    the number of watches
+	=============================================*/
+	if ((size_t) watchDescriptor >= watchState.targetsCapacity)
+	{
+		newCapacity = (watchState.targetsCapacity > 0)
+			      ? watchState.targetsCapacity * 2 : 64;
+
+		while (newCapacity <= (size_t) watchDescriptor)
+		{
+			newCapacity *= 2;
+		}
+
+		newTargets = realloc(watchState.targets,
+				     newCapacity * sizeof(*newTargets));
+
+		if (newTargets == NULL)
+		{
+			perror("myls");
+
+			inotify_rm_watch(watchState.inotifyFd,
+					 watchDescriptor);
+
+			return -1;
+		}
+
+		memset(newTargets + watchState.targetsCapacity, 0,
+		       (newCapacity - watchState.targetsCapacity)
+		       * sizeof(*newTargets));
+
+		watchState.targets = newTargets;
+
+		watchState.targetsCapacity = newCapacity;
+	}
+
+
+
+	/*============================================
+	 SECTION 2: Remembering the path. A file
+		    listed twice, or by two names, gets
+		    the same watch back
+	=============================================*/
+	if (watchState.targets[watchDescriptor].isWatched)
+	{
+		watchState.targets[watchDescriptor].isDir |= isDir;
+
+		return 0;
+	}
+
+	pathCopy = strdup(path);
+
+	if (pathCopy == NULL)
+	{
+		perror("myls");
+
+		inotify_rm_watch(watchState.inotifyFd, watchDescriptor);
+
+		return -1;
+	}
+
+	free(watchState.targets[watchDescriptor].path);
+
+	watchState.targets[watchDescriptor].path = pathCopy;
+
+	watchState.targets[watchDescriptor].isDir = isDir;
+
+	watchState.targets[watchDescriptor].isWatched = 1;
+
+	watchState.numWatched++;
+
+
+	return 0;
+}
+
+
+/*---------------------------------------------------------*/
+
+static long long getMonotonicMilliseconds()
+{
+	struct timespec now;
+
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return (long long) now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+
+/*---------------------------------------------------------*/
+
+int watchForChanges()
+{
+
+	/*============================================
+	 SECTION 1: Declaration of variables
+	=============================================*/
+
+	char * eventBuffer = NULL;
+
+	const struct inotify_event * eventPtr = NULL;
+
+	struct WatchTarget * targetPtr = NULL;
+
+	struct pollfd pollInfo;
+
+	long long deadline = 0;
+
+	long long timeout;
+
+	ssize_t numRead;
+
+	size_t numPendingBefore;
+
+	int pollReturnValue;
+
+	int returnValue = 0;
+
+
+	//inotify_event starts with an int, and
+	// malloc() aligns for anything
+	eventBuffer = malloc(WATCH_EVENT_BUFFER_SIZE);
+
+	if (eventBuffer == NULL)
+	{
+		perror("myls");
+
+		return -1;
+	}
+
+	pollInfo.fd = watchState.inotifyFd;
+
+	pollInfo.events = POLLIN;
+
+
+
+	while (watchState.numWatched > 0
+	       || watchState.numPendingChanges > 0)
+	{
+
+		/*====================================
+		 SECTION 2: Waiting for events, or,
+			    with changes pending, for
+			    the end of their window
+		=====================================*/
+		timeout = -1;
+
+		if (watchState.numPendingChanges > 0)
+		{
+			timeout = deadline - getMonotonicMilliseconds();
+
+			if (timeout <= 0 || watchState.numWatched == 0)
+			{
+				reportWatchChanges();
+
+				continue;
+			}
+		}
+
+		pollReturnValue = poll(&pollInfo, 1, (int) timeout);
+
+		if (pollReturnValue == -1 && errno != EINTR)
+		{
+			perror("myls: poll");
+
+			returnValue = -1;
+
+			break;
+		}
+
+		if (pollReturnValue <= 0)
+		{
+			continue;
+		}
+
+		numRead = read(watchState.inotifyFd, eventBuffer,
+			       WATCH_EVENT_BUFFER_SIZE);
+
+		if (numRead == -1)
+		{
+			if (errno == EAGAIN || errno == EINTR)
+			{
+				continue;
+			}
+
+			perror("myls: inotify");
+
+			returnValue = -1;
+
+			break;
+		}
+
+
+
+		/*====================================
+		 SECTION 3: Queueing the entry each
+			    event is about. Events carry
+			    the number of their watch,
+			    which indexes the targets
+		=====================================*/
+		numPendingBefore = watchState.numPendingChanges;
+
+		for (ssize_t offset = 0; offset < numRead;
+		     offset += sizeof(*eventPtr) + eventPtr->len)
+		{
+			eventPtr = (const struct inotify_event *)
+				   (eventBuffer + offset);
+
+			if (eventPtr->mask & IN_Q_OVERFLOW)
+			{
+				flushOutputBuffer(&stdoutBuffer);
+
+				fprintf(stderr, "myls: Events were lost,"
+					" listing everything again\n");
+
+				relistWatchTargets();
+
+				continue;
+			}
+
+			if (eventPtr->wd < 0
+			    || (size_t) eventPtr->wd
+			       >= watchState.targetsCapacity
+			    || watchState.targets[eventPtr->wd].path == NULL)
+			{
+				continue;
+			}
+
+			targetPtr = &watchState.targets[eventPtr->wd];
+
+			if (eventPtr->mask & IN_IGNORED)
+			{
+				if (targetPtr->isWatched)
+				{
+					targetPtr->isWatched = 0;
+
+					watchState.numWatched--;
+				}
+
+				continue;
+			}
+
+			//Once moved, the watch would report its
+			// entries under a path that is no longer
+			// theirs, so the move is its last event
+			if (eventPtr->mask & IN_MOVE_SELF)
+			{
+				inotify_rm_watch(watchState.inotifyFd,
+						 eventPtr->wd);
+			}
+
+			if (queueWatchChange(targetPtr->path,
+					     (eventPtr->len > 0)
+					     ? eventPtr->name : "") == -1)
+			{
+				perror("myls");
+			}
+		}
+
+
+		//The window starts with the first change
+		// after a report
+		if (numPendingBefore == 0
+		    && watchState.numPendingChanges > 0)
+		{
+			deadline = getMonotonicMilliseconds()
+				   + watchState.windowMilliseconds;
+		}
+	}
+
+
+	free(eventBuffer);
+
+
+	return returnValue;
+}
+
+
+/*---------------------------------------------------------*/
+
+static inline size_t hashWatchPath(const char * path,
+				   size_t numSlots)
+{
+	//FNV-1a
+	uint64_t hash = 14695981039346656037ULL;
+
+
+	for (; *path != '\0'; path++)
+	{
+		hash = (hash ^ (unsigned char) *path)
+		       * 1099511628211ULL;
+	}
+
+	return (size_t) (hash & (numSlots - 1));
+}
+
+
+/*---------------------------------------------------------*/
+
+int queueWatchChange(const char * targetPath,
+		     const char * name)
+{
+
+	/*============================================
+	 SECTION 1: Declaration of variables
+	=============================================*/
+
+	size_t targetLength = strlen(targetPath);
+
+	size_t nameLength = strlen(name);
+
+	int needsSlash;
+
+	size_t pathLength;
+
+	size_t newCapacity;
+
+	char * newPaths = NULL;
+
+	size_t * newChanges = NULL;
+
+	uint32_t * newSlots = NULL;
+
+	size_t slotIndex;
+
+	char * path = NULL;
+
+
+	//Paths are joined as the -R walk joins them,
+	// so that both name a file the same way
+	needsSlash = nameLength > 0 && targetLength > 0
+		     && targetPath[targetLength - 1] != '/';
+
+	pathLength = targetLength + needsSlash + nameLength;
+
+
+
+	/*============================================
+	 SECTION 2: Growing the arena, the changes and
+		    the hash table. The table is kept
+		    at most half full, and rebuilt from
+		    the changes when it grows
+	=============================================*/
+	if (watchState.pendingPathsUsed + pathLength + 1
+	    > watchState.pendingPathsCapacity)
+	{
+		newCapacity = (watchState.pendingPathsCapacity > 0)
+			      ? watchState.pendingPathsCapacity * 2
+			      : PATH_MAX;
+
+		while (watchState.pendingPathsUsed + pathLength + 1
+		       > newCapacity)
+		{
+			newCapacity *= 2;
+		}
+
+		newPaths = realloc(watchState.pendingPaths, newCapacity);
+
+		if (newPaths == NULL)
+		{
+			return -1;
+		}
+
+		watchState.pendingPaths = newPaths;
+
+		watchState.pendingPathsCapacity = newCapacity;
+	}
+
+	if (watchState.numPendingChanges
+	    == watchState.pendingChangesCapacity)
+	{
+		newCapacity = (watchState.pendingChangesCapacity > 0)
+			      ? watchState.pendingChangesCapacity * 2 : 64;
+
+		newChanges = realloc(watchState.pendingChanges,
+				     newCapacity * sizeof(*newChanges));
+
+		if (newChanges == NULL)
+		{
+			return -1;
+		}
+
+		watchState.pendingChanges = newChanges;
+
+		watchState.pendingChangesCapacity = newCapacity;
+	}
+
+	if ((watchState.numPendingChanges + 1) * 2
+	    > watchState.numPendingSlots)
+	{
+		newCapacity = (watchState.numPendingSlots > 0)
+			      ? watchState.numPendingSlots * 2 : 128;
+
+		newSlots = calloc(newCapacity, sizeof(*newSlots));
+
+		if (newSlots == NULL)
+		{
+			return -1;
+		}
+
+		for (size_t index = 0;
+		     index < watchState.numPendingChanges; index++)
+		{
+			slotIndex = hashWatchPath(watchState.pendingPaths
+						  + watchState.pendingChanges[index],
+						  newCapacity);
+
+			while (newSlots[slotIndex] != 0)
+			{
+				slotIndex = (slotIndex + 1) & (newCapacity - 1);
+			}
+
+			newSlots[slotIndex] = index + 1;
+		}
+
+		free(watchState.pendingSlots);
+
+		watchState.pendingSlots = newSlots;
+
+		watchState.numPendingSlots = newCapacity;
+	}
+
+
+
+	/*============================================
+	 SECTION 3: Building the path at the end of
+		    the arena, and keeping it only if
+		    it is not pending already
+	=============================================*/
+	path = watchState.pendingPaths + watchState.pendingPathsUsed;
+
+	memcpy(path, targetPath, targetLength);
+
+	if (needsSlash)
+	{
+		path[targetLength] = '/';
+	}
+
+	memcpy(path + targetLength + needsSlash, name, nameLength + 1);
+
+
+	slotIndex = hashWatchPath(path, watchState.numPendingSlots);
+
+	while (watchState.pendingSlots[slotIndex] != 0)
+	{
+		if (strcmp(watchState.pendingPaths
+			   + watchState.pendingChanges[
+				watchState.pendingSlots[slotIndex] - 1],
+			   path) == 0)
+		{
+			return 0;
+		}
+
+		slotIndex = (slotIndex + 1)
+			    & (watchState.numPendingSlots - 1);
+	}
+
+	watchState.pendingSlots[slotIndex] =
+		watchState.numPendingChanges + 1;
+
+	watchState.pendingChanges[watchState.numPendingChanges++] =
+		watchState.pendingPathsUsed;
+
+	watchState.pendingPathsUsed += pathLength + 1;
+
+
+	return 0;
+}
+
+
+/*---------------------------------------------------------*/
+
+void reportWatchChanges()
+{
+
+	struct stat statBuf;
+
+	const char * path = NULL;
+
+	int isListed;
+
+
+
+	updateTimeFormattingYear();
+
+	updateFilterTimes(&entryFilter);
+
+
+	/*============================================
+	 Whatever the events were, the entry is looked
+	 up as it is now, so a file written many times
+	 within the window gets one record with its
+	 final size, and one created and removed again
+	 is reported as removed
+
+	 A directory that appears under -R is watched
+	 from here on, even if the --filter leaves it
+	 out, but entries made in it before that are
+	 only seen once they change again
+	=============================================*/
+	for (size_t index = 0; index < watchState.numPendingChanges;
+	     index++)
+	{
+		path = watchState.pendingPaths
+		       + watchState.pendingChanges[index];
+
+		isListed = isEntryNameListed(getPathBaseName(path),
+					     DT_UNKNOWN);
+
+		if (getFileMetadata(AT_FDCWD, path, &statBuf) == 0)
+		{
+			if (isListed)
+			{
+				writeFileStatInfo(&stdoutBuffer, path,
+						  &statBuf);
+			}
+
+			if (listingOptions.recursive
+			    && S_ISDIR(statBuf.st_mode))
+			{
+				addWatchTarget(path, 1);
+			}
+		}
+		else if (!isListed)
+		{
+			continue;
+		}
+		else if (errno == ENOENT || errno == ENOTDIR)
+		{
+			writeRemovedEntry(&stdoutBuffer, path);
+		}
+		else
+		{
+			reportAccessError(&stdoutBuffer, path, errno);
+		}
+	}
+
+	flushOutputBuffer(&stdoutBuffer);
+
+
+	watchState.numPendingChanges = 0;
+
+	watchState.pendingPathsUsed = 0;
+
+	if (watchState.pendingSlots != NULL)
+	{
+		memset(watchState.pendingSlots, 0,
+		       watchState.numPendingSlots
+		       * sizeof(*watchState.pendingSlots));
+	}
+}
+
+
+/*---------------------------------------------------------*/
+
+void relistWatchTargets()
+{
+
+	int isRecursive = listingOptions.recursive;
+
+
+	updateTimeFormattingYear();
+
+	updateFilterTimes(&entryFilter);
+
+
+	//Every directory that -R reached has a target
+	// of its own, so none is walked again
+	listingOptions.recursive = 0;
+
+	for (size_t index = 0; index < watchState.targetsCapacity;
+	     index++)
+	{
+		if (!watchState.targets[index].isWatched)
+		{
+			continue;
+		}
+
+		if (watchState.targets[index].isDir)
+		{
+			writeDirHeading(&stdoutBuffer,
+					watchState.targets[index].path);
+
+			displayCurrDirFilesInfo(
+				watchState.targets[index].path);
+		}
+		else if (queueWatchChange(watchState.targets[index].path,
+					  "") == -1)
+		{
+			perror("myls");
+		}
+	}
+
+	listingOptions.recursive = isRecursive;
+
+
+	reportWatchChanges();
+}
+
+
+/*---------------------------------------------------------*/
+
+int serveListings(const char * socketPath,
+		  unsigned int extraStatxBits)
+{
+
+	/*============================================
+	 SECTION 1: Declaration of variables
+	=============================================*/
+
+	struct ListingOptions defaultOptions = listingOptions;
+
+	struct sockaddr_un socketAddress;
+
+	struct sigaction stopAction;
+
+	struct stat socketStat;
+
+	struct ucred peerCredentials;
+
+	socklen_t credentialsLength;
+
+	mode_t savedMask;
+
+	sigset_t stopSignals;
+
+	sigset_t savedSignals;
+
+	pthread_t serveThreads[NUM_SERVE_THREADS];
+
+	int numThreads;
+
+	int listenFd;
+
+	int connectionFd;
+
+	int probeFd;
+
+	int bindReturnValue = -1;
+
+
+
+	/*============================================
+	 SECTION 2: Creating the socket. A socket file
+		    left behind by a daemon that has
+		    gone is replaced, but not one that
+		    a daemon still accepts on
+
+	 The socket is made with no access for the
+	 group and others, so only the daemon's user
+	 (and root) can connect: a listing shows what
+	 the daemon's user can see
+	=============================================*/
+	if (strlen(socketPath) >= sizeof(socketAddress.sun_path))
+	{
+		fprintf(stderr, "myls: Socket path '%s' is too long\n",
+			socketPath);
+
+		return -1;
+	}
+
+	memset(&socketAddress, 0, sizeof(socketAddress));
+
+	socketAddress.sun_family = AF_UNIX;
+
+	strcpy(socketAddress.sun_path, socketPath);
+
+
+	if (lstat(socketPath, &socketStat) == 0
+	    && S_ISSOCK(socketStat.st_mode))
+	{
+		probeFd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+
+		if (probeFd != -1
+		    && connect(probeFd,
+			       (struct sockaddr *) &socketAddress,
+			       sizeof(socketAddress)) == 0)
+		{
+			fprintf(stderr, "myls: '%s' is already being"
+				" served\n", socketPath);
+
+			close(probeFd);
+
+			return -1;
+		}
+
+		if (probeFd != -1)
+		{
+			close(probeFd);
+		}
+
+		unlink(socketPath);
+	}
+
+
+	listenFd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+
+	//No thread has been started yet, so none
+	// creates a file under this mask
+	savedMask = umask(077);
+
+	if (listenFd != -1)
+	{
+		bindReturnValue = bind(listenFd,
+				       (struct sockaddr *) &socketAddress,
+				       sizeof(socketAddress));
+	}
+
+	umask(savedMask);
+
+	if (bindReturnValue == -1
+	    || listen(listenFd, SOMAXCONN) == -1)
+	{
+		fprintf(stderr, "myls: Cannot serve on '%s': %s\n",
+			socketPath, strerror(errno));
+
+		if (listenFd != -1)
+		{
+			close(listenFd);
+		}
+
+		return -1;
+	}
+
+
+
+	/*============================================
+	 SECTION 3: Stopping cleanly
+
+	 SIGINT and SIGTERM interrupt accept(), as
+	 they are not restarted, so the loop ends and
+	 the socket is removed. A client that leaves
+	 before reading everything must not end the
+	 daemon with SIGPIPE
+	=============================================*/
+	memset(&stopAction, 0, sizeof(stopAction));
+
+	stopAction.sa_handler = stopServingListings;
+
+	sigemptyset(&stopAction.sa_mask);
+
+	sigaction(SIGINT, &stopAction, NULL);
+
+	sigaction(SIGTERM, &stopAction, NULL);
+
+	signal(SIGPIPE, SIG_IGN);
+
+
+
+	/*============================================
+	 SECTION 4: Starting the threads that answer
+		    the clients. They block SIGINT and
+		    SIGTERM, which are left to this
+		    thread
+	=============================================*/
+
+	//Errors about the listed files concern the
+	// client, so they go in its reply
+	defaultOptions.errorsToOutput = 1;
+
+	serveState.defaultOptions = &defaultOptions;
+
+	serveState.extraStatxBits = extraStatxBits;
+
+
+	sigemptyset(&stopSignals);
+
+	sigaddset(&stopSignals, SIGINT);
+
+	sigaddset(&stopSignals, SIGTERM);
+
+	pthread_sigmask(SIG_BLOCK, &stopSignals, &savedSignals);
+
+	for (numThreads = 0; numThreads < NUM_SERVE_THREADS; numThreads++)
+	{
+		if (pthread_create(&serveThreads[numThreads], NULL,
+				   runServeThread, NULL) != 0)
+		{
+			break;
+		}
+	}
+
+	pthread_sigmask(SIG_SETMASK, &savedSignals, NULL);
+
+	if (numThreads == 0)
+	{
+		fprintf(stderr, "myls: Cannot start the threads of"
+			" --serve\n");
+
+		close(listenFd);
+
+		unlink(socketPath);
+
+		return -1;
+	}
+
+
+
+	/*============================================
+	 SECTION 5: Queueing the clients. The user
+		    and group names looked up for one,
+		    like the time zone and the dates
+		    formatted in each thread, stay
+		    cached for the next
+	=============================================*/
+	while (!stopServing)
+	{
+		connectionFd = accept4(listenFd, NULL, NULL,
+				       SOCK_CLOEXEC);
+
+		if (connectionFd == -1)
+		{
+			if (errno != EINTR && errno != ECONNABORTED)
+			{
+				perror("myls: accept");
+			}
+
+			continue;
+		}
+
+
+		//The user of the client is checked as
+		// well, as the owner of the socket file
+		// may have opened up its mode
+		credentialsLength = sizeof(peerCredentials);
+
+		if (getsockopt(connectionFd, SOL_SOCKET, SO_PEERCRED,
+			       &peerCredentials, &credentialsLength) == -1
+		    || (peerCredentials.uid != geteuid()
+			&& peerCredentials.uid != 0))
+		{
+			refuseServeClient(connectionFd, "Permission denied",
+					  "");
+
+			close(connectionFd);
+
+			continue;
+		}
+
+
+		pthread_mutex_lock(&serveState.queueLock);
+
+		if (serveState.numQueued < SERVE_QUEUE_SIZE)
+		{
+			serveState.queuedFds[(serveState.queueStart
+					      + serveState.numQueued)
+					     % SERVE_QUEUE_SIZE] = connectionFd;
+
+			serveState.numQueued++;
+
+			pthread_cond_signal(&serveState.queueChanged);
+
+			connectionFd = -1;
+		}
+
+		pthread_mutex_unlock(&serveState.queueLock);
+
+
+		//Every thread is busy, and enough clients
+		// wait already
+		if (connectionFd != -1)
+		{
+			refuseServeClient(connectionFd, "Too many clients"
+					  " waiting", "");
+
+			close(connectionFd);
+		}
+
+	}//end of while loop
+
+
+
+	/*============================================
+	 SECTION 6: Stopping the threads once their
+		    clients are answered, and removing
+		    the socket
+	=============================================*/
+	pthread_mutex_lock(&serveState.queueLock);
+
+	serveState.isStopping = 1;
+
+	pthread_cond_broadcast(&serveState.queueChanged);
+
+	pthread_mutex_unlock(&serveState.queueLock);
+
+	for (int index = 0; index < numThreads; index++)
+	{
+		pthread_join(serveThreads[index], NULL);
+	}
+
+	//Clients still waiting get no answer
+	while (serveState.numQueued > 0)
+	{
+		close(serveState.queuedFds[serveState.queueStart]);
+
+		serveState.queueStart = (serveState.queueStart + 1)
+					% SERVE_QUEUE_SIZE;
+
+		serveState.numQueued--;
+	}
+
+
+	close(listenFd);
+
+	unlink(socketPath);
+
+	listingOptions = defaultOptions;
+
+
+	return 0;
+}
+
+
+/*---------------------------------------------------------*/
+
+void * runServeThread(void * argument)
+{
+
+	struct timeval sendTimeout =
+	{
+		.tv_sec = SERVE_SEND_TIMEOUT_SECONDS
+	};
+
+	char * request = NULL;
+
+	ssize_t requestLength;
+
+	int connectionFd;
+
+
+
+	(void) argument;
+
+	request = malloc(MAX_SERVE_REQUEST_SIZE);
+
+	if (request == NULL)
+	{
+		perror("myls");
+
+		return NULL;
+	}
+
+
+	while (1)
+	{
+		pthread_mutex_lock(&serveState.queueLock);
+
+		while (serveState.numQueued == 0 && !serveState.isStopping)
+		{
+			pthread_cond_wait(&serveState.queueChanged,
+					  &serveState.queueLock);
+		}
+
+		if (serveState.isStopping)
+		{
+			pthread_mutex_unlock(&serveState.queueLock);
+
+			break;
+		}
+
+		connectionFd = serveState.queuedFds[serveState.queueStart];
+
+		serveState.queueStart = (serveState.queueStart + 1)
+					% SERVE_QUEUE_SIZE;
+
+		serveState.numQueued--;
+
+		pthread_mutex_unlock(&serveState.queueLock);
+
+
+		//A client that does not read its reply is
+		// dropped rather than left to hold the
+		// thread
+		setsockopt(connectionFd, SOL_SOCKET, SO_SNDTIMEO,
+			   &sendTimeout, sizeof(sendTimeout));
+
+		requestLength = readServeRequest(connectionFd, request,
+						 MAX_SERVE_REQUEST_SIZE);
+
+		if (requestLength == -1)
+		{
+			fprintf(stderr, "myls: Cannot read a request: %s\n",
+				strerror(errno));
+
+			//Told to the client too, if it is
+			// still there to read it
+			refuseServeClient(connectionFd, "Invalid request: ",
+					  "too large or too slow");
+		}
+		else
+		{
+			handleServeRequest(connectionFd, request,
+					   (size_t) requestLength,
+					   serveState.defaultOptions,
+					   serveState.extraStatxBits);
+		}
+
+		close(connectionFd);
+
+	}//end of while loop
+
+
+	free(request);
+
+	mergeStageTimings();
+
+
+	return NULL;
+}
+
+
+/*---------------------------------------------------------*/
+
+ssize_t readServeRequest(int connectionFd, char * request,
+			 size_t capacity)
+{
+
+	struct pollfd pollInfo =
+	{
+		.fd = connectionFd,
+		.events = POLLIN
+	};
+
+	long long deadline = getMonotonicMilliseconds()
+			     + SERVE_REQUEST_TIMEOUT_SECONDS * 1000;
+
+	long long timeout;
+
+	size_t length = 0;
+
+	ssize_t numRead;
+
+	int pollReturnValue;
+
+
+
+	//One byte is kept for the NUL that ends the
+	// last record. The whole request must come
+	// before the deadline, however it is split,
+	// so a client sending a byte at a time
+	// cannot hold the daemon up either
+	while (length < capacity - 1)
+	{
+		timeout = deadline - getMonotonicMilliseconds();
+
+		if (timeout <= 0)
+		{
+			errno = ETIMEDOUT;
+
+			return -1;
+		}
+
+		pollReturnValue = poll(&pollInfo, 1, (int) timeout);
+
+		if (pollReturnValue == -1 && errno == EINTR && !stopServing)
+		{
+			continue;
+		}
+
+		if (pollReturnValue == -1)
+		{
+			return -1;
+		}
+
+		if (pollReturnValue == 0)
+		{
+			errno = ETIMEDOUT;
+
+			return -1;
+		}
+
+
+		numRead = read(connectionFd, request + length,
+			       capacity - 1 - length);
+
+		if (numRead == -1 && errno == EINTR && !stopServing)
+		{
+			continue;
+		}
+
+		if (numRead == -1)
+		{
+			return -1;
+		}
+
+		if (numRead == 0)
+		{
+			request[length] = '\0';
+
+			return (ssize_t) length;
+		}
+
+
+		//An empty record, i.e. a NUL at the start
+		// or after another, ends the request
+		for (size_t index = length;
+		     index < length + (size_t) numRead; index++)
+		{
+			if (request[index] == '\0'
+			    && (index == 0 || request[index - 1] == '\0'))
+			{
+				return (ssize_t) index;
+			}
+		}
+
+		length += (size_t) numRead;
+	}
+
+
+	errno = E2BIG;
+
+	return -1;
+}
+
+
+/*---------------------------------------------------------*/
+
+int handleServeRequest(int connectionFd, char * request,
+		       size_t requestLength,
+		       const struct ListingOptions * defaultOptions,
+		       unsigned int extraStatxBits)
+{
+
+	/*============================================
+	 SECTION 1: Declaration of variables
+	=============================================*/
+
+	struct ListingOptions requestOptions = *defaultOptions;
+
+	struct iovec replyVector;
+
+	char * requestEnd = request + requestLength;
+
+	char * recordPtr = NULL;
+
+	const char * invalidRecord = NULL;
+
+	int savedOutputFd;
+
+	int spoolFd;
+
+	int isSpooled;
+
+	int numTargets = 0;
+
+	int needsDirHeading;
+
+	int hasFailed;
+
+
+
+	/*============================================
+	 SECTION 2: Reading the options of the
+		    request, over those of the command
+		    line, and counting its paths
+	=============================================*/
+	for (recordPtr = request; recordPtr < requestEnd;
+	     recordPtr += strlen(recordPtr) + 1)
+	{
+		if (strncmp(recordPtr, "dir=", 4) == 0
+		    || strncmp(recordPtr, "file=", 5) == 0)
+		{
+			numTargets++;
+		}
+		else if (strncmp(recordPtr, "fields=", 7) == 0)
+		{
+			if (parseFieldList(recordPtr + 7,
+					   &requestOptions.outputFields,
+					   &requestOptions.statxMask) == -1)
+			{
+				invalidRecord = recordPtr;
+
+				break;
+			}
+		}
+		else if (strncmp(recordPtr, "format=", 7) == 0)
+		{
+			if (parseOutputFormat(recordPtr + 7,
+					&requestOptions.outputFormat) == -1)
+			{
+				invalidRecord = recordPtr;
+
+				break;
+			}
+		}
+		else
+		{
+			invalidRecord = recordPtr;
+
+			break;
+		}
+	}
+
+	if (invalidRecord != NULL || numTargets == 0)
+	{
+		refuseServeClient(connectionFd, "Invalid request: ",
+				  (invalidRecord != NULL)
+				  ? invalidRecord : "no dir= or file=");
+
+		return -1;
+	}
+
+	//Whatever the fields, what the sort and
+	// --filter of the command line check
+	requestOptions.statxMask |= extraStatxBits;
+
+
+
+	/*============================================
+	 SECTION 3: Listing the paths, one request at
+		    a time, with the same headings as
+		    on the command line. The reply is
+		    held in stdoutBuffer up to
+		    SERVE_SPOOL_SIZE bytes, and spooled
+		    to a temporary file past that, or
+		    where none can be made, sent as it
+		    comes
+	=============================================*/
+	spoolFd = open(P_tmpdir, O_TMPFILE | O_RDWR | O_CLOEXEC, 0600);
+
+	pthread_mutex_lock(&serveState.listingLock);
+
+	listingOptions = requestOptions;
+
+	updateTimeFormattingYear();
+
+	updateFilterTimes(&entryFilter);
+
+	__atomic_store_n(&numListingErrors, 0, __ATOMIC_RELAXED);
+
+	savedOutputFd = stdoutBuffer.outputFd;
+
+	stdoutBuffer.outputFd = -1;
+
+	stdoutBuffer.spillFd = (spoolFd != -1) ? spoolFd : connectionFd;
+
+	stdoutBuffer.spillSize = SERVE_SPOOL_SIZE;
+
+	stdoutBuffer.length = 0;
+
+	stdoutBuffer.hasFailed = 0;
+
+
+	needsDirHeading = (numTargets > 1 || listingOptions.recursive)
+			  && !(listingOptions.recursive
+			       && listingOptions.numWorkers > 1);
+
+	if (listingOptions.outputFormat == FORMAT_BIN)
+	{
+		writeBinaryHeader(&stdoutBuffer);
+	}
+
+	for (recordPtr = request; recordPtr < requestEnd;
+	     recordPtr += strlen(recordPtr) + 1)
+	{
+		if (strncmp(recordPtr, "file=", 5) == 0)
+		{
+			displayCurrFileInfo(AT_FDCWD, recordPtr + 5);
+		}
+		else if (strncmp(recordPtr, "dir=", 4) == 0)
+		{
+			if (needsDirHeading)
+			{
+				writeDirHeading(&stdoutBuffer, recordPtr + 4);
+			}
+
+			displayCurrDirFilesInfo(recordPtr + 4);
+		}
+	}
+
+	writeServeStatus(&stdoutBuffer,
+			 __atomic_load_n(&numListingErrors,
+					 __ATOMIC_RELAXED));
+
+
+
+	/*============================================
+	 SECTION 4: Sending the reply once the next
+		    request may be listed. A reply held
+		    whole is taken out of stdoutBuffer.
+		    A client that stops reading gets no
+		    status line, so it can tell its
+		    reply was cut short
+	=============================================*/
+	replyVector.iov_base = NULL;
+
+	replyVector.iov_len = 0;
+
+	isSpooled = (spoolFd != -1 && stdoutBuffer.outputFd == spoolFd);
+
+	if (stdoutBuffer.outputFd == -1)
+	{
+		replyVector.iov_base = stdoutBuffer.data;
+
+		replyVector.iov_len = stdoutBuffer.length;
+
+		stdoutBuffer.data = NULL;
+
+		stdoutBuffer.length = 0;
+
+		stdoutBuffer.capacity = 0;
+	}
+	else
+	{
+		flushOutputBuffer(&stdoutBuffer);
+	}
+
+	hasFailed = stdoutBuffer.hasFailed;
+
+	stdoutBuffer.outputFd = savedOutputFd;
+
+	stdoutBuffer.spillSize = 0;
+
+	pthread_mutex_unlock(&serveState.listingLock);
+
+
+	if (!hasFailed && replyVector.iov_len > 0
+	    && writeAllVectors(connectionFd, &replyVector, 1) == -1)
+	{
+		hasFailed = 1;
+	}
+
+	if (!hasFailed && isSpooled
+	    && sendSpoolFile(connectionFd, spoolFd) == -1)
+	{
+		hasFailed = 1;
+	}
+
+	free(replyVector.iov_base);
+
+	if (spoolFd != -1)
+	{
+		close(spoolFd);
+	}
+
+	if (hasFailed)
+	{
+		fprintf(stderr, "myls: A reply could not be sent in full,"
+			" and its client was dropped\n");
+
+		return -1;
+	}
+
+
+	return 0;
+}
+
+
+/*---------------------------------------------------------*/
+
+void writeServeStatus(struct OutputBuffer * outBuffer,
+		      unsigned int numErrors)
+{
+	char digits[SERVE_STATUS_DIGITS + 2];
+
+
+	snprintf(digits, sizeof(digits), "%0*u\n", SERVE_STATUS_DIGITS,
+		 numErrors);
+
+	appendOutputBytes(outBuffer, SERVE_STATUS_PREFIX,
+			  sizeof(SERVE_STATUS_PREFIX) - 1);
+
+	appendOutputBytes(outBuffer, digits, SERVE_STATUS_DIGITS + 1);
+}
+
+
+/*---------------------------------------------------------*/
+
+void refuseServeClient(int connectionFd, const char * reason,
+		       const char * detail)
+{
+	struct OutputBuffer reply;
+
+
+	if (initOutputBuffer(&reply, connectionFd,
+			     MIN_OUTPUT_BUFFER_SIZE) == -1)
+	{
+		return;
+	}
+
+	appendOutputString(&reply, "myls: ");
+
+	appendOutputString(&reply, reason);
+
+	appendOutputString(&reply, detail);
+
+	appendOutputString(&reply, "\n");
+
+	writeServeStatus(&reply, 1);
+
+	flushOutputBuffer(&reply);
+
+	destroyOutputBuffer(&reply);
+}
+
+
+/*---------------------------------------------------------*/
+
+int sendSpoolFile(int connectionFd, int spoolFd)
+{
+
+	off_t spoolSize = lseek(spoolFd, 0, SEEK_CUR);
+
+	off_t offset = 0;
+
+	ssize_t numSent;
+
+
+
+	while (offset < spoolSize)
+	{
+		numSent = sendfile(connectionFd, spoolFd, &offset,
+				   (size_t) (spoolSize - offset));
+
+		if (numSent == -1 && errno == EINTR)
+		{
+			continue;
+		}
+
+		if (numSent <= 0)
+		{
+			return -1;
+		}
+	}
+
+
+	return (spoolSize == -1) ? -1 : 0;
+}
+
+
+/*---------------------------------------------------------*/
+
+void stopServingListings(int signalNumber)
+{
+	(void) signalNumber;
+
+	stopServing = 1;
+}
+
+
+/*---------------------------------------------------------*/
+
+int initDirEnumerator(struct DirEnumerator * enumerator,
+		      enum DirEnumBackend backend,
+		      size_t batchSize)
+{
+	enumerator->backend = backend;
+
+	enumerator->dirHandle = NULL;
+
+	enumerator->dirFd = -1;
+
+	enumerator->batchBuffer = NULL;
+
+	enumerator->batchBufferSize = 0;
+
+	enumerator->batchBytes = 0;
+
+	enumerator->batchOffset = 0;
+
+	enumerator->entryPosition = 0;
+
+
+	/*--------------------------------------------
+	 readdir() manages its own buffer, so only
+	 the getdents64() backend needs one
+	---------------------------------------------*/
+	if (backend == DIR_ENUM_GETDENTS)
+	{
+		enumerator->batchBuffer = malloc(batchSize);
+
+		if (enumerator->batchBuffer == NULL)
+		{
+			return -1;
+		}
+
+		enumerator->batchBufferSize = batchSize;
+	}
+
+
+	return 0;
+}
+
+
+/*---------------------------------------------------------*/
+
+int openDirEnumerator(struct DirEnumerator * enumerator,
+		      const char * dirPath)
+{
+	enumerator->batchBytes = 0;
+
+	enumerator->batchOffset = 0;
+
+	enumerator->entryPosition = 0;
+
+
+	if (enumerator->backend == DIR_ENUM_READDIR)
+	{
+		enumerator->dirHandle = opendir(dirPath);
+
+		return (enumerator->dirHandle == NULL) ? -1 : 0;
+	}
+
+
+	enumerator->dirFd = open(dirPath,
+				 O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+
+	return (enumerator->dirFd == -1) ? -1 : 0;
+}
+
+
+/*---------------------------------------------------------*/
+
+int attachDirEnumerator(struct DirEnumerator * enumerator,
+			int dirFd)
+{
+	enumerator->batchBytes = 0;
+
+	enumerator->batchOffset = 0;
+
+	enumerator->entryPosition = 0;
+
+
+	if (enumerator->backend == DIR_ENUM_READDIR)
+	{
+		enumerator->dirHandle = fdopendir(dirFd);
+
+		if (enumerator->dirHandle == NULL)
+		{
+			close(dirFd);
+
+			return -1;
+		}
+
+		return 0;
+	}
+
+
+	enumerator->dirFd = dirFd;
+
+	return 0;
+}
+
+
+/*---------------------------------------------------------*/
+
+off64_t tellDirEnumerator(struct DirEnumerator * enumerator)
+{
+	//glibc's telldir() value is the kernel's
+	// directory offset, so it stays meaningful
+	// after the directory is opened again
+	if (enumerator->backend == DIR_ENUM_READDIR)
+	{
+		return telldir(enumerator->dirHandle);
+	}
+
+	return enumerator->entryPosition;
+}
+
+
+/*---------------------------------------------------------*/
+
+int seekDirEnumerator(struct DirEnumerator * enumerator,
+		      off64_t position)
+{
+	if (enumerator->backend == DIR_ENUM_READDIR)
+	{
+		seekdir(enumerator->dirHandle, (long) position);
+
+		return 0;
+	}
+
+
+	enumerator->batchBytes = 0;
+
+	enumerator->batchOffset = 0;
+
+	enumerator->entryPosition = position;
+
+	return (lseek64(enumerator->dirFd, position,
+			SEEK_SET) == -1) ? -1 : 0;
+}
+
+
+/*---------------------------------------------------------*/
+
+int rewindDirEnumerator(struct DirEnumerator * enumerator)
+{
+	if (enumerator->backend == DIR_ENUM_READDIR)
+	{
+		rewinddir(enumerator->dirHandle);
+
+		return 0;
+	}
+
+	return seekDirEnumerator(enumerator, 0);
+}
+
+
+/*---------------------------------------------------------*/
+
+int getDirEnumeratorFd(struct DirEnumerator * enumerator)
+{
+	if (enumerator->backend == DIR_ENUM_READDIR)
+	{
+		return dirfd(enumerator->dirHandle);
+	}
+
+	return enumerator->dirFd;
+}
+
+
+/*---------------------------------------------------------*/
+
+static inline int isDotOrDotDot(const char * name)
+{
+	//Cheaper than two strcmp() calls, and most
+	// names are rejected at the first character
+	return name[0] == '.'
+		&& (name[1] == '\0'
+		    || (name[1] == '.' && name[2] == '\0'));
+}
+
+
+/*---------------------------------------------------------*/
+
+static inline int isSubdirEntry(int dirFd,
+				const struct DirEntryInfo * entryInfo)
+{
+	struct stat statBuf;
+
+
+	if (entryInfo->direntType != DT_UNKNOWN)
+	{
+		return entryInfo->direntType == DT_DIR;
+	}
+
+	//Only file systems that do not fill in
+	// d_type cost a stat here
+	return fstatat(dirFd, entryInfo->name, &statBuf,
+		       AT_SYMLINK_NOFOLLOW) == 0
+		&& S_ISDIR(statBuf.st_mode);
+}
+
+
+/*---------------------------------------------------------*/
+
+int readNextDirEntry(struct DirEnumerator * enumerator,
+		     struct DirEntryInfo * entryInfo)
+{
+
+	struct dirent * direntPtr = NULL;
+
+	struct LinuxDirent64 * rawDirentPtr = NULL;
+
+	ssize_t bytesRead;
+
+
+
+	/*============================================
+	 SECTION 1: The readdir() backend
+	=============================================*/
+	if (enumerator->backend == DIR_ENUM_READDIR)
+	{
+		errno = 0;
+
+		while ((direntPtr = readdir(enumerator->dirHandle))
+			!= NULL)
+		{
+			if (!isDotOrDotDot(direntPtr->d_name))
+			{
+				entryInfo->name = direntPtr->d_name;
+
+				entryInfo->inodeNum = direntPtr->d_ino;
+
+				entryInfo->direntType =
+					direntPtr->d_type;
+
+				return 1;
+			}
+		}
+
+
+		return (errno != 0) ? -1 : 0;
+	}
+
+
+
+	/*============================================
+	 SECTION 2: The getdents64() backend
+
+	 Records are consumed from the batch buffer
+	 until it is exhausted, at which point the
+	 next batch is read with a single system call.
+	 A return of zero bytes marks the end of the
+	 directory
+	=============================================*/
+	for (;;)
+	{
+		while (enumerator->batchOffset
+			< enumerator->batchBytes)
+		{
+			rawDirentPtr = (struct LinuxDirent64 *)
+				(enumerator->batchBuffer
+				 + enumerator->batchOffset);
+
+			enumerator->batchOffset +=
+				rawDirentPtr->d_reclen;
+
+			enumerator->entryPosition =
+				rawDirentPtr->d_off;
+
+
+			if (!isDotOrDotDot(rawDirentPtr->d_name))
+			{
+				entryInfo->name = rawDirentPtr->d_name;
+
+				entryInfo->inodeNum =
+					rawDirentPtr->d_ino;
+
+				entryInfo->direntType =
+					rawDirentPtr->d_type;
+
+				return 1;
+			}
+		}
+
+
+		bytesRead = getdents64(enumerator->dirFd,
+				       enumerator->batchBuffer,
+				       enumerator->batchBufferSize);
+
+		if (bytesRead <= 0)
+		{
+			return (bytesRead == 0) ? 0 : -1;
+		}
+
+		enumerator->batchBytes = bytesRead;
+
+		enumerator->batchOffset = 0;
+	}
+
+}
+
+
+/*---------------------------------------------------------*/
+
+void closeDirEnumerator(struct DirEnumerator * enumerator)
+{
+	if (enumerator->dirHandle != NULL)
+	{
+		closedir(enumerator->dirHandle);
+
+		enumerator->dirHandle = NULL;
+	}
+
+	if (enumerator->dirFd != -1)
+	{
+		close(enumerator->dirFd);
+
+		enumerator->dirFd = -1;
+	}
+}
+
+
+/*---------------------------------------------------------*/
+
+void destroyDirEnumerator(struct DirEnumerator * enumerator)
+{
+	free(enumerator->batchBuffer);
+
+	enumerator->batchBuffer = NULL;
+
+	enumerator->batchBufferSize = 0;
+}
+
+
+/*---------------------------------------------------------*/
+
+void displayDirTreeFilesInfo(struct DirEnumerator * enumerator,
+			     const char * rootPath)
+{
+
+	/*============================================
+	 SECTION 1: Declaration of variables
+	=============================================*/
+
+	struct DirTreeWalk walk;
+
+	struct DirEntryInfo entryInfo;
+
+	struct DirTreeFrame * framePtr = NULL;
+
+	int readReturnValue;
+
+	int dirFd = getDirEnumeratorFd(enumerator);
+
+	int childFd;
+
+	int parentFd;
+
+
+
+	/*============================================
+	 SECTION 2: Entering the starting directory
+
+	 Its entries have just been displayed, so it
+	 is read again from the start, this time only
+	 looking for subdirectories
+	=============================================*/
+	memset(&walk, 0, sizeof(walk));
+
+	if (appendDirTreePath(&walk, rootPath) == -1
+	    || pushDirTreeFrame(&walk, dirFd) == -1
+	    || rewindDirEnumerator(enumerator) == -1)
+	{
+		flushOutputBuffer(&stdoutBuffer);
+
+		fprintf(stderr,
+			"Failed to walk directory '%s': %s\n",
+			rootPath, strerror(errno));
+
+		free(walk.frames);
+
+		free(walk.path);
+
+		return;
+	}
+
+
+
+	/*============================================
+	 SECTION 3: Walking the tree
+
+	 The top level's directory is read until a
+	 subdirectory is found, which then becomes the
+	 new top level. Once a directory has been read
+	 to the end, the walk returns to its parent
+	 and resumes reading it after the subdirectory
+	=============================================*/
+	while (walk.numFrames > 0)
+	{
+		framePtr = &walk.frames[walk.numFrames - 1];
+
+		//A position of -1 marks a directory that
+		// could not be read again from the start
+		readReturnValue = (framePtr->resumePosition == -1)
+				  ? 0
+				  : readNextDirEntry(enumerator,
+						     &entryInfo);
+
+
+		/*------------------------------------
+		 Part (a) Skipping entries that are
+			  not directories. d_type tells
+			  without a stat, except on file
+			  systems that report DT_UNKNOWN
+		-------------------------------------*/
+		if (readReturnValue == 1
+		    && !isSubdirEntry(dirFd, &entryInfo))
+		{
+			continue;
+		}
+
+
+
+		/*------------------------------------
+		 Part (b) Descending into a
+			  subdirectory. O_NOFOLLOW keeps
+			  the walk from leaving the tree
+			  through a symbolic link swapped
+			  in since it was read
+		-------------------------------------*/
+		if (readReturnValue == 1)
+		{
+			framePtr->resumePosition =
+				tellDirEnumerator(enumerator);
+
+			if (appendDirTreePath(&walk,
+					      entryInfo.name) == -1)
+			{
+				reportOpenDirError(&stdoutBuffer, walk.path,
+						   entryInfo.name, errno);
+
+				continue;
+			}
+
+
+			childFd = openat(dirFd, entryInfo.name,
+					 O_RDONLY | O_DIRECTORY
+					 | O_NOFOLLOW | O_CLOEXEC);
+
+			if (childFd == -1
+			    || pushDirTreeFrame(&walk, childFd) == -1)
+			{
+				reportOpenDirError(&stdoutBuffer, walk.path,
+						   NULL, errno);
+
+				if (childFd != -1)
+				{
+					close(childFd);
+				}
+
+				walk.pathLength = framePtr->pathLength;
+
+				walk.path[walk.pathLength] = '\0';
+
+				continue;
+			}
+
+
+			closeDirEnumerator(enumerator);
+
+			if (attachDirEnumerator(enumerator,
+						childFd) == -1)
+			{
+				//The walk can neither go on here
+				// nor return to the parent
+				reportOpenDirError(&stdoutBuffer, walk.path,
+						   NULL, errno);
+
+				break;
+			}
+
+			dirFd = getDirEnumeratorFd(enumerator);
+
+
+			writeDirHeading(&stdoutBuffer, walk.path);
+
+			displayOpenDirFilesInfo(enumerator, walk.path);
+
+			if (rewindDirEnumerator(enumerator) == -1)
+			{
+				reportReadDirError(&stdoutBuffer, walk.path, errno);
+
+				//Treated as read to the end
+				walk.frames[walk.numFrames - 1]
+					.resumePosition = -1;
+			}
+
+			continue;
+		}
+
+
+
+		/*------------------------------------
+		 Part (c) Returning to the parent once
+			  the directory has been read
+			  to the end
+		-------------------------------------*/
+		if (readReturnValue == -1)
+		{
+			reportReadDirError(&stdoutBuffer, walk.path, errno);
+		}
+
+
+		walk.numFrames--;
+
+		if (walk.numFrames == 0)
+		{
+			break;
+		}
+
+		framePtr = &walk.frames[walk.numFrames - 1];
+
+		walk.pathLength = framePtr->pathLength;
+
+		walk.path[walk.pathLength] = '\0';
+
+
+		parentFd = openDirTreeParent(&walk, dirFd);
+
+		closeDirEnumerator(enumerator);
+
+		if (parentFd == -1
+		    || attachDirEnumerator(enumerator, parentFd) == -1
+		    || seekDirEnumerator(enumerator,
+					 framePtr->resumePosition) == -1)
+		{
+			flushOutputBuffer(&stdoutBuffer);
+
+			fprintf(stderr,
+				"Failed to return to directory '%s': %s\n",
+				walk.path, strerror(errno));
+
+			break;
+		}
+
+		dirFd = getDirEnumeratorFd(enumerator);
+
+	}//end of while loop
+
+
+
+	/*============================================
+	 SECTION 4: Releasing the walk
+	=============================================*/
+	free(walk.frames);
+
+	free(walk.path);
+}
+
+
+/*---------------------------------------------------------*/
+
+int appendDirTreePath(struct DirTreeWalk * walk,
+		      const char * name)
+{
+
+	size_t nameLength = strlen(name);
+
+	size_t newLength;
+
+	size_t newCapacity;
+
+	char * newPath = NULL;
+
+	int needsSlash;
+
+
+
+	//The starting directory's own path is taken
+	// as given, e.g. './', without adding a '/'
+	needsSlash = walk->pathLength > 0
+		     && walk->path[walk->pathLength - 1] != '/';
+
+	newLength = walk->pathLength + needsSlash + nameLength;
+
+
+	if (newLength + 1 > walk->pathCapacity)
+	{
+		newCapacity = (walk->pathCapacity > 0)
+			      ? walk->pathCapacity : PATH_MAX;
+
+		while (newCapacity < newLength + 1)
+		{
+			newCapacity *= 2;
+		}
+
+		newPath = realloc(walk->path, newCapacity);
+
+		if (newPath == NULL)
+		{
+			return -1;
+		}
+
+		walk->path = newPath;
+
+		walk->pathCapacity = newCapacity;
+	}
+
+
+	if (needsSlash)
+	{
+		walk->path[walk->pathLength] = '/';
+	}
+
+	memcpy(walk->path + walk->pathLength + needsSlash, name,
+	       nameLength + 1);
+
+	walk->pathLength = newLength;
+
+
+	return 0;
+}
+
+
+/*---------------------------------------------------------*/
+
+int pushDirTreeFrame(struct DirTreeWalk * walk, int dirFd)
+{
+
+	struct stat statBuf;
+
+	struct DirTreeFrame * newFrames = NULL;
+
+	size_t newCapacity;
+
+
+
+	if (fstat(dirFd, &statBuf) == -1)
+	{
+		return -1;
+	}
+
+
+	if (walk->numFrames == walk->framesCapacity)
+	{
+		newCapacity = (walk->framesCapacity > 0)
+			      ? walk->framesCapacity * 2 : 64;
+
+		newFrames = realloc(walk->frames,
+				    newCapacity * sizeof(*newFrames));
+
+		if (newFrames == NULL)
+		{
+			return -1;
+		}
+
+		walk->frames = newFrames;
+
+		walk->framesCapacity = newCapacity;
+	}
+
+
+	walk->frames[walk->numFrames].resumePosition = 0;
+
+	walk->frames[walk->numFrames].deviceId = statBuf.st_dev;
+
+	walk->frames[walk->numFrames].inodeNum = statBuf.st_ino;
+
+	walk->frames[walk->numFrames].pathLength = walk->pathLength;
+
+	walk->numFrames++;
+
+
+	return 0;
+}
+
+
+/*---------------------------------------------------------*/
+
+int openDirTreeParent(struct DirTreeWalk * walk, int dirFd)
+{
+
+	struct DirTreeFrame * parentFrame =
+		&walk->frames[walk->numFrames - 1];
+
+	struct stat statBuf;
+
+	int parentFd;
+
+
+
+	/*============================================
+	 '..' is tried first, as it works however
+	 deep the walk is, while the path may be
+	 longer than PATH_MAX
+	=============================================*/
+	parentFd = openat(dirFd, "..",
+			  O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+
+	if (parentFd != -1
+	    && fstat(parentFd, &statBuf) == 0
+	    && statBuf.st_dev == parentFrame->deviceId
+	    && statBuf.st_ino == parentFrame->inodeNum)
+	{
+		return parentFd;
+	}
+
+	if (parentFd != -1)
+	{
+		close(parentFd);
+	}
+
+
+
+	parentFd = open(walk->path,
+			O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+
+	if (parentFd != -1
+	    && fstat(parentFd, &statBuf) == 0
+	    && statBuf.st_dev == parentFrame->deviceId
+	    && statBuf.st_ino == parentFrame->inodeNum)
+	{
+		return parentFd;
+	}
+
+	if (parentFd != -1)
+	{
+		close(parentFd);
+
+		errno = ESTALE;
+	}
+
+
+	return -1;
+}
+
+
+/*---------------------------------------------------------*/
+
+int displayDirTreeFilesInfoParallel(const char * rootPath)
+{
+
+	/*============================================
+	 SECTION 1: Declaration of variables
+	=============================================*/
+
+	struct TreeWalkShared shared;
+
+	struct TreeWorker * workerPtr = NULL;
+
+	struct TreeTask * rootTask = NULL;
+
+	size_t rootPathLength = strlen(rootPath);
+
+	unsigned int numWorkersReady = 0;
+
+	unsigned int numWorkersStarted = 0;
+
+
+
+	/*============================================
+	 SECTION 2: Setting up the workers
+
+	 The starting directory is the first task, on
+	 the deque of the first worker, from which the
+	 others steal
+	=============================================*/
+	memset(&shared, 0, sizeof(shared));
+
+	shared.numWorkers = listingOptions.numWorkers;
+
+	shared.workers = calloc(shared.numWorkers,
+				sizeof(*shared.workers));
+
+	rootTask = malloc(sizeof(*rootTask) + rootPathLength + 1);
+
+	if (shared.workers == NULL || rootTask == NULL)
+	{
+		free(shared.workers);
+
+		free(rootTask);
+
+		return -1;
+	}
+
+	pthread_mutex_init(&shared.idleLock, NULL);
+
+	pthread_cond_init(&shared.workPosted, NULL);
+
+	pthread_mutex_init(&shared.outputLock, NULL);
+
+
+	for (unsigned int index = 0; index < shared.numWorkers;
+	     index++)
+	{
+		workerPtr = &shared.workers[index];
+
+		workerPtr->shared = &shared;
+
+		workerPtr->index = index;
+
+		pthread_mutex_init(&workerPtr->deque.lock, NULL);
+
+		if (initDirEnumerator(&workerPtr->enumerator,
+				      listingOptions.enumBackend,
+				      listingOptions.direntBatchSize) == -1
+		    || initOutputBuffer(&workerPtr->output, -1,
+				listingOptions.outputBufferSize) == -1)
+		{
+			break;
+		}
+
+		numWorkersReady++;
+	}
+
+
+	rootTask->kind = TREE_TASK_DIR;
+
+	rootTask->dirRef = NULL;
+
+	rootTask->numNames = 0;
+
+	rootTask->nameOffset = 0;
+
+	memcpy(rootTask->text, rootPath, rootPathLength + 1);
+
+	if (numWorkersReady == shared.numWorkers
+	    && pushTreeTask(&shared.workers[0], rootTask) == 0)
+	{
+		rootTask = NULL;
+	}
+
+
+
+	/*============================================
+	 SECTION 3: Running the workers
+
+	 If no worker can be started, the root task
+	 is still queued, and is dropped so that the
+	 caller can walk the tree serially
+	=============================================*/
+	if (rootTask == NULL)
+	{
+		for (unsigned int index = 0;
+		     index < shared.numWorkers; index++)
+		{
+			if (pthread_create(&shared.workers[index].thread,
+					   NULL, runTreeWorker,
+					   &shared.workers[index]) != 0)
+			{
+				break;
+			}
+
+			numWorkersStarted++;
+		}
+
+		for (unsigned int index = 0;
+		     index < numWorkersStarted; index++)
+		{
+			pthread_join(shared.workers[index].thread, NULL);
+		}
+
+		if (numWorkersStarted == 0)
+		{
+			rootTask = takeTreeTask(&shared.workers[0]);
+		}
+	}
+
+
+
+	/*============================================
+	 SECTION 4: Reporting the per-thread counters
+		    and releasing the workers
+	=============================================*/
+	if (printStats && numWorkersStarted > 0)
+	{
+		for (unsigned int index = 0;
+		     index < shared.numWorkers; index++)
+		{
+			workerPtr = &shared.workers[index];
+
+			fprintf(stderr,
+				"myls: thread %u: %lu directories, "
+				"%lu entries, %lu tasks stolen\n",
+				index, workerPtr->numDirs,
+				workerPtr->numEntries,
+				workerPtr->numStolen);
+		}
+	}
+
+
+	for (unsigned int index = 0; index < shared.numWorkers;
+	     index++)
+	{
+		workerPtr = &shared.workers[index];
+
+		if (index < numWorkersReady)
+		{
+			destroyDirEnumerator(&workerPtr->enumerator);
+
+			destroyOutputBuffer(&workerPtr->output);
+		}
+		else
+		{
+			//Its enumerator may have been set up
+			// before its output buffer failed
+			free(workerPtr->enumerator.batchBuffer);
+		}
+
+		free(workerPtr->deque.tasks);
+
+		free(workerPtr->batchNames);
+
+		destroyEntryRecords(&workerPtr->sortedRecords);
+
+		pthread_mutex_destroy(&workerPtr->deque.lock);
+	}
+
+	free(shared.workers);
+
+	free(rootTask);
+
+	pthread_mutex_destroy(&shared.idleLock);
+
+	pthread_cond_destroy(&shared.workPosted);
+
+	pthread_mutex_destroy(&shared.outputLock);
+
+
+	return (numWorkersStarted == 0) ? -1 : 0;
+}
+
+
+/*---------------------------------------------------------*/
+
+void * runTreeWorker(void * argument)
+{
+
+	struct TreeWorker * worker = argument;
+
+	struct TreeWalkShared * shared = worker->shared;
+
+	struct TreeTask * task = NULL;
+
+
+
+	for (;;)
+	{
+
+		/*------------------------------------
+		 Part (a) Finding a task, or waiting
+			  for one to be queued
+
+		 The idle count is raised before the
+		 deques are searched again under
+		 'idleLock', so a task queued after
+		 that search always finds this worker
+		 waiting and wakes it
+		-------------------------------------*/
+		task = takeTreeTask(worker);
+
+		if (task == NULL)
+		{
+			pthread_mutex_lock(&shared->idleLock);
+
+			__atomic_add_fetch(&shared->numIdle, 1,
+					   __ATOMIC_SEQ_CST);
+
+			while ((task = takeTreeTask(worker)) == NULL
+			       && __atomic_load_n(&shared->outstandingTasks,
+						  __ATOMIC_SEQ_CST) > 0)
+			{
+				pthread_cond_wait(&shared->workPosted,
+						  &shared->idleLock);
+			}
+
+			__atomic_sub_fetch(&shared->numIdle, 1,
+					   __ATOMIC_SEQ_CST);
+
+			pthread_mutex_unlock(&shared->idleLock);
+
+
+			if (task == NULL)
+			{
+				break;
+			}
+		}
+
+
+
+		/*------------------------------------
+		 Part (b) Running the task. Once the
+			  last outstanding task is done,
+			  the waiting workers are woken
+			  so that they can leave
+		-------------------------------------*/
+		if (task->kind == TREE_TASK_DIR)
+		{
+			runTreeDirTask(worker, task);
+		}
+		else
+		{
+			writeTreeBatch(worker, task->dirRef->dirFd,
+				       task->dirRef->path, task->text,
+				       task->numNames);
+
+			releaseTreeDirRef(task->dirRef);
+		}
+
+		free(task);
+
+
+		if (__atomic_sub_fetch(&shared->outstandingTasks, 1,
+				       __ATOMIC_SEQ_CST) == 0)
+		{
+			pthread_mutex_lock(&shared->idleLock);
+
+			pthread_cond_broadcast(&shared->workPosted);
+
+			pthread_mutex_unlock(&shared->idleLock);
+		}
+
+	}//end of for loop
+
+
+	mergeStageTimings();
+
+	mergeSummaryTotals();
+
+
+	return NULL;
+}
+
+
+/*---------------------------------------------------------*/
+
+void runTreeDirTask(struct TreeWorker * worker,
+		    struct TreeTask * task)
+{
+
+	/*============================================
+	 SECTION 1: Declaration of variables
+	=============================================*/
+
+	const char * dirPath = task->text;
+
+	size_t dirPathLength = strlen(dirPath);
+
+	struct DirEntryInfo entryInfo;
+
+	struct TreeDirRef * dirRef = NULL;
+
+	struct TreeTask * newTask = NULL;
+
+	size_t nameLength;
+
+	size_t newCapacity;
+
+	char * newNames = NULL;
+
+	int needsSlash;
+
+	int hasQueuedBatch = 0;
+
+	int readReturnValue;
+
+	int openReturnValue;
+
+	int childFd;
+
+	int dirFd;
+
+
+
+	/*============================================
+	 SECTION 2: Opening the directory, relative
+		    to its parent if its path is too
+		    long
+	=============================================*/
+	if (task->dirRef != NULL)
+	{
+		childFd = openat(task->dirRef->dirFd,
+				 dirPath + task->nameOffset,
+				 O_RDONLY | O_DIRECTORY
+				 | O_NOFOLLOW | O_CLOEXEC);
+
+		releaseTreeDirRef(task->dirRef);
+
+		task->dirRef = NULL;
+
+		openReturnValue = (childFd == -1)
+			? -1
+			: attachDirEnumerator(&worker->enumerator,
+					      childFd);
+	}
+	else
+	{
+		openReturnValue = openDirEnumerator(
+					&worker->enumerator, dirPath);
+	}
+
+
+	if (openReturnValue == -1)
+	{
+		reportOpenDirError(&worker->output, dirPath, NULL, errno);
+
+		appendTreeOutput(worker);
+
+		return;
+	}
+
+	dirFd = getDirEnumeratorFd(&worker->enumerator);
+
+	worker->numDirs++;
+
+	worker->batchNamesUsed = 0;
+
+	worker->batchNumNames = 0;
+
+	//The starting directory's own path is taken
+	// as given, e.g. './', without adding a '/'
+	needsSlash = dirPathLength > 0
+		     && dirPath[dirPathLength - 1] != '/';
+
+
+
+	/*============================================
+	 SECTION 3: Enumerating the entries
+	=============================================*/
+	while ((readReturnValue = readNextDirEntry(
+			&worker->enumerator, &entryInfo)) == 1)
+	{
+		nameLength = strlen(entryInfo.name) + 1;
+
+
+		/*------------------------------------
+		 Part (a) Queueing a subdirectory.
+			  d_type tells without a stat,
+			  except on file systems that
+			  report DT_UNKNOWN
+
+		 A subdirectory whose path would be
+		 too long to open keeps this directory
+		 open until it has been opened. Only
+		 such paths do, so that a wide tree
+		 does not hold a descriptor for every
+		 directory waiting in the deques
+		-------------------------------------*/
+		if (isSubdirEntry(dirFd, &entryInfo))
+		{
+			newTask = malloc(sizeof(*newTask) + dirPathLength
+					 + needsSlash + nameLength);
+
+			if (newTask != NULL)
+			{
+				newTask->kind = TREE_TASK_DIR;
+
+				newTask->dirRef = NULL;
+
+				newTask->numNames = 0;
+
+				newTask->nameOffset = dirPathLength
+						      + needsSlash;
+
+				if (dirPathLength + needsSlash
+					+ nameLength > PATH_MAX)
+				{
+					if (dirRef == NULL)
+					{
+						dirRef = createTreeDirRef(
+							dirFd, dirPath);
+					}
+
+					if (dirRef == NULL)
+					{
+						free(newTask);
+
+						newTask = NULL;
+					}
+					else
+					{
+						__atomic_add_fetch(
+							&dirRef->refCount, 1,
+							__ATOMIC_RELAXED);
+
+						newTask->dirRef = dirRef;
+					}
+				}
+
+				memcpy(newTask->text, dirPath,
+				       dirPathLength);
+
+				newTask->text[dirPathLength] = '/';
+
+				memcpy(newTask->text + dirPathLength
+				       + needsSlash, entryInfo.name,
+				       nameLength);
+			}
+
+			if (newTask == NULL
+			    || pushTreeTask(worker, newTask) == -1)
+			{
+				reportOpenDirError(&worker->output, dirPath,
+						   entryInfo.name, ENOMEM);
+
+				appendTreeOutput(worker);
+
+				if (newTask != NULL)
+				{
+					releaseTreeDirRef(newTask->dirRef);
+				}
+
+				free(newTask);
+			}
+		}
+
+
+
+		/*------------------------------------
+		 Part (b) Adding the entry to the
+			  current batch, unless the
+			  --filter rejects it by name or
+			  type. A rejected subdirectory is
+			  still walked
+		-------------------------------------*/
+		if (!isEntryNameListed(entryInfo.name,
+				       entryInfo.direntType))
+		{
+			continue;
+		}
+
+		if (worker->batchNamesUsed + nameLength
+			> worker->batchNamesCapacity)
+		{
+			newCapacity = (worker->batchNamesCapacity > 0)
+				      ? worker->batchNamesCapacity * 2
+				      : TREE_BATCH_ENTRIES * 32;
+
+			while (newCapacity < worker->batchNamesUsed
+					     + nameLength)
+			{
+				newCapacity *= 2;
+			}
+
+			newNames = realloc(worker->batchNames,
+					   newCapacity);
+
+			if (newNames == NULL)
+			{
+				reportAccessError(&worker->output,
+						  entryInfo.name, ENOMEM);
+
+				continue;
+			}
+
+			worker->batchNames = newNames;
+
+			worker->batchNamesCapacity = newCapacity;
+		}
+
+		memcpy(worker->batchNames + worker->batchNamesUsed,
+		       entryInfo.name, nameLength);
+
+		worker->batchNamesUsed += nameLength;
+
+		worker->batchNumNames++;
+
+
+		//A directory to be sorted is kept whole
+		if (worker->batchNumNames < TREE_BATCH_ENTRIES
+		    || listingOptions.sortKey != SORT_NONE)
+		{
+			continue;
+		}
+
+
+
+		/*------------------------------------
+		 Part (c) Queueing a full batch for
+			  any worker to display, sharing
+			  the directory with it
+		-------------------------------------*/
+		if (dirRef == NULL)
+		{
+			dirRef = createTreeDirRef(dirFd, dirPath);
+		}
+
+		newTask = NULL;
+
+		if (dirRef != NULL)
+		{
+			newTask = malloc(sizeof(*newTask)
+					 + worker->batchNamesUsed);
+		}
+
+		if (newTask != NULL)
+		{
+			newTask->kind = TREE_TASK_ENTRIES;
+
+			newTask->dirRef = dirRef;
+
+			newTask->numNames = worker->batchNumNames;
+
+			newTask->nameOffset = 0;
+
+			memcpy(newTask->text, worker->batchNames,
+			       worker->batchNamesUsed);
+
+			__atomic_add_fetch(&dirRef->refCount, 1,
+					   __ATOMIC_RELAXED);
+
+			if (pushTreeTask(worker, newTask) == -1)
+			{
+				releaseTreeDirRef(dirRef);
+
+				free(newTask);
+
+				newTask = NULL;
+			}
+			else
+			{
+				hasQueuedBatch = 1;
+			}
+		}
+
+		//If the batch could not be queued, it is
+		// displayed here instead
+		if (newTask == NULL)
+		{
+			writeTreeBatch(worker, dirFd, dirPath,
+				       worker->batchNames,
+				       worker->batchNumNames);
+		}
+
+		worker->batchNamesUsed = 0;
+
+		worker->batchNumNames = 0;
+
+	}//end of while loop
+
+
+	if (readReturnValue == -1)
+	{
+		reportReadDirError(&worker->output, dirPath, errno);
+
+		appendTreeOutput(worker);
+	}
+
+
+
+	/*============================================
+	 SECTION 4: Displaying the last batch
+
+	 A directory none of whose batches was queued
+	 is always displayed here, so that even an
+	 empty one gets its heading
+	=============================================*/
+	if (worker->batchNumNames > 0 || !hasQueuedBatch)
+	{
+		writeTreeBatch(worker, dirFd, dirPath,
+			       worker->batchNames,
+			       worker->batchNumNames);
+	}
+
+	closeDirEnumerator(&worker->enumerator);
+
+	releaseTreeDirRef(dirRef);
+}
+
+
+/*---------------------------------------------------------*/
+
+void writeTreeBatch(struct TreeWorker * worker, int dirFd,
+		    const char * dirPath, const char * names,
+		    size_t numNames)
+{
+
+	const char * namePtr = names;
+
+
+
+	writeDirHeading(&worker->output, dirPath);
+
+	listedDirPath = dirPath;
+
+
+	if (listingOptions.sortKey != SORT_NONE)
+	{
+		for (size_t index = 0; index < numNames; index++)
+		{
+			if (addEntryRecord(&worker->sortedRecords, dirFd,
+					   namePtr) == -1)
+			{
+				reportAccessError(&worker->output, namePtr,
+						  ENOMEM);
+			}
+
+			namePtr += strlen(namePtr) + 1;
+		}
+
+		writeEntryRecords(&worker->output,
+				  &worker->sortedRecords,
+				  sortEntryRecords(&worker->sortedRecords,
+					listingOptions.sortKey) == 0);
+	}
+	else
+	{
+		for (size_t index = 0; index < numNames; index++)
+		{
+			writeFileInfo(&worker->output, dirFd, namePtr);
+
+			namePtr += strlen(namePtr) + 1;
+		}
+	}
+
+	worker->numEntries += numNames;
+
+
+	//The whole batch goes out as one piece
+	appendTreeOutput(worker);
+}
+
+
+/*---------------------------------------------------------*/
+
+void appendTreeOutput(struct TreeWorker * worker)
+{
+	struct TreeWalkShared * shared = worker->shared;
+
+
+	pthread_mutex_lock(&shared->outputLock);
+
+	appendOutputBytes(&stdoutBuffer, worker->output.data,
+			  worker->output.length);
+
+	pthread_mutex_unlock(&shared->outputLock);
+
+	worker->output.length = 0;
+}
+
+
+/*---------------------------------------------------------*/
+
+int pushTreeTask(struct TreeWorker * worker,
+		 struct TreeTask * task)
+{
+
+	struct TreeWalkShared * shared = worker->shared;
+
+	struct TreeTaskDeque * deque = &worker->deque;
+
+	struct TreeTask ** newTasks = NULL;
+
+	size_t newCapacity;
+
+
+
+	/*============================================
+	 SECTION 1: Queueing the task at the bottom,
+		    growing the ring if it is full
+
+	 The task is counted before it can be taken,
+	 so the count never reaches zero while any
+	 task is left
+	=============================================*/
+	pthread_mutex_lock(&deque->lock);
+
+	if (deque->count == deque->capacity)
+	{
+		newCapacity = (deque->capacity > 0)
+			      ? deque->capacity * 2
+			      : INITIAL_TREE_DEQUE_CAPACITY;
+
+		newTasks = malloc(newCapacity * sizeof(*newTasks));
+
+		if (newTasks == NULL)
+		{
+			pthread_mutex_unlock(&deque->lock);
+
+			return -1;
+		}
+
+		//Unwrap the ring into the new array
+		for (size_t index = 0; index < deque->count; index++)
+		{
+			newTasks[index] = deque->tasks[(deque->head
+							+ index)
+						       % deque->capacity];
+		}
+
+		free(deque->tasks);
+
+		deque->tasks = newTasks;
+
+		deque->capacity = newCapacity;
+
+		deque->head = 0;
+	}
+
+	__atomic_add_fetch(&shared->outstandingTasks, 1,
+			   __ATOMIC_SEQ_CST);
+
+	deque->tasks[(deque->head + deque->count)
+		     % deque->capacity] = task;
+
+	deque->count++;
+
+	pthread_mutex_unlock(&deque->lock);
+
+
+
+	/*============================================
+	 SECTION 2: Waking an idle worker
+	=============================================*/
+	if (__atomic_load_n(&shared->numIdle, __ATOMIC_SEQ_CST) > 0)
+	{
+		pthread_mutex_lock(&shared->idleLock);
+
+		pthread_cond_signal(&shared->workPosted);
+
+		pthread_mutex_unlock(&shared->idleLock);
+	}
+
+
+	return 0;
+}
+
+
+/*---------------------------------------------------------*/
+
+struct TreeTask * takeTreeTask(struct TreeWorker * worker)
+{
+
+	struct TreeWalkShared * shared = worker->shared;
+
+	struct TreeTaskDeque * deque = &worker->deque;
+
+	struct TreeTask * task = NULL;
+
+	unsigned int victimIndex;
+
+
+
+	/*============================================
+	 SECTION 1: Popping the newest task of the
+		    worker's own deque
+	=============================================*/
+	pthread_mutex_lock(&deque->lock);
+
+	if (deque->count > 0)
+	{
+		deque->count--;
+
+		task = deque->tasks[(deque->head + deque->count)
+				    % deque->capacity];
+	}
+
+	pthread_mutex_unlock(&deque->lock);
+
+	if (task != NULL)
+	{
+		return task;
+	}
+
+
+
+	/*============================================
+	 SECTION 2: Stealing the oldest task of
+		    another deque, trying the other
+		    workers in turn from the next one
+	=============================================*/
+	for (unsigned int offset = 1; offset < shared->numWorkers;
+	     offset++)
+	{
+		victimIndex = (worker->index + offset)
+			      % shared->numWorkers;
+
+		deque = &shared->workers[victimIndex].deque;
+
+		pthread_mutex_lock(&deque->lock);
+
+		if (deque->count > 0)
+		{
+			task = deque->tasks[deque->head];
+
+			deque->head = (deque->head + 1)
+				      % deque->capacity;
+
+			deque->count--;
+		}
+
+		pthread_mutex_unlock(&deque->lock);
+
+		if (task != NULL)
+		{
+			worker->numStolen++;
+
+			return task;
+		}
+	}
+
+
+	return NULL;
+}
+
+
+/*---------------------------------------------------------*/
+
+struct TreeDirRef * createTreeDirRef(int dirFd,
+				     const char * dirPath)
+{
+
+	size_t dirPathLength = strlen(dirPath);
+
+	struct TreeDirRef * dirRef = NULL;
+
+
+
+	dirRef = malloc(sizeof(*dirRef) + dirPathLength + 1);
+
+	if (dirRef == NULL)
+	{
+		return NULL;
+	}
+
+	//The enumerator closes its own descriptor
+	// once the directory has been read
+	dirRef->dirFd = fcntl(dirFd, F_DUPFD_CLOEXEC, 0);
+
+	if (dirRef->dirFd == -1)
+	{
+		free(dirRef);
+
+		return NULL;
+	}
+
+	dirRef->refCount = 1;
+
+	memcpy(dirRef->path, dirPath, dirPathLength + 1);
+
+
+	return dirRef;
+}
+
+
+/*---------------------------------------------------------*/
+
+void releaseTreeDirRef(struct TreeDirRef * dirRef)
+{
+	if (dirRef != NULL
+	    && __atomic_sub_fetch(&dirRef->refCount, 1,
+				  __ATOMIC_ACQ_REL) == 0)
+	{
+		close(dirRef->dirFd);
+
+		free(dirRef);
+	}
+}
+
+
+/*---------------------------------------------------------*/
+
+int displayDirFilesInfoParallel(
+			struct DirEnumerator * enumerator,
+			const char * dirPath)
+{
+	return runStatPipeline(enumerator, NULL, dirPath);
+}
+
+
+/*---------------------------------------------------------*/
+
+int displayFileArgumentsParallel(struct FileArgumentReader * reader)
+{
+	//The arguments are named by their own paths,
+	// relative to the working directory
+	return runStatPipeline(NULL, reader, NULL);
+}
+
+
+/*---------------------------------------------------------*/
+
+int runStatPipeline(struct DirEnumerator * enumerator,
+		    struct FileArgumentReader * fileArguments,
+		    const char * dirPath)
+{
+
+	/*============================================
+	 SECTION 1: Declaration of variables
+	=============================================*/
+
+	struct StatPipeline pipeline;
+
+	pthread_t producerThread;
+
+	pthread_t workerThreads[MAX_WORKER_THREADS];
+
+	unsigned int numWorkersStarted = 0;
+
+	struct PipelineSlot * slotPtr = NULL;
+
+	size_t slotIndex;
+
+	int setupFailed = 0;
+
+
+
+	/*============================================
+	 SECTION 2: Setting up the shared state
+	=============================================*/
+	memset(&pipeline, 0, sizeof(pipeline));
+
+	pthread_mutex_init(&pipeline.lock, NULL);
+
+	pthread_cond_init(&pipeline.slotFreed, NULL);
+
+	pthread_cond_init(&pipeline.workAvailable, NULL);
+
+	pthread_cond_init(&pipeline.resultReady, NULL);
+
+	pipeline.numSlots = (size_t) listingOptions.numWorkers
+			    * PIPELINE_SLOTS_PER_WORKER;
+
+	pipeline.slots = calloc(pipeline.numSlots,
+				sizeof(*pipeline.slots));
+
+	pipeline.pendingQueue = malloc(pipeline.numSlots
+				       * sizeof(size_t));
+
+	pipeline.doneQueue = malloc(pipeline.numSlots
+				    * sizeof(size_t));
+
+	pipeline.freeSlots = malloc(pipeline.numSlots
+				    * sizeof(size_t));
+
+	pipeline.preserveOrder = listingOptions.preserveOrder;
+
+	pipeline.enumerator = enumerator;
+
+	pipeline.fileArguments = fileArguments;
+
+	pipeline.dirPath = dirPath;
+
+	pipeline.dirFd = (enumerator != NULL)
+			 ? getDirEnumeratorFd(enumerator) : AT_FDCWD;
+
+
+	if (pipeline.slots == NULL || pipeline.pendingQueue == NULL
+	    || pipeline.doneQueue == NULL
+	    || pipeline.freeSlots == NULL)
+	{
+		setupFailed = 1;
+	}
+	else
+	{
+		//Each slot formats into a growing memory
+		// buffer, kept for the whole listing
+		for (slotIndex = 0; slotIndex < pipeline.numSlots;
+		     slotIndex++)
+		{
+			pipeline.slots[slotIndex].text.outputFd = -1;
+		}
+
+		//Popped from the end, so slot 0 is used first
+		for (slotIndex = 0; slotIndex < pipeline.numSlots;
+		     slotIndex++)
+		{
+			pipeline.freeSlots[slotIndex] =
+				pipeline.numSlots - 1 - slotIndex;
+		}
+
+		pipeline.numFreeSlots = pipeline.numSlots;
+	}
+
+
+
+	/*============================================
+	 SECTION 3: Starting the threads
+
+	 If no worker can be started, nothing has been
+	 read from the directory or the arguments yet,
+	 so the caller can still list them serially
+	=============================================*/
+	if (!setupFailed)
+	{
+		for (unsigned int index = 0;
+		     index < listingOptions.numWorkers; index++)
+		{
+			if (pthread_create(&workerThreads[index], NULL,
+					   runPipelineWorker,
+					   &pipeline) != 0)
+			{
+				break;
+			}
+
+			numWorkersStarted++;
+		}
+
+		if (numWorkersStarted == 0
+		    || pthread_create(&producerThread, NULL,
+				      runPipelineProducer,
+				      &pipeline) != 0)
+		{
+			//Let any started workers exit
+			pthread_mutex_lock(&pipeline.lock);
+
+			pipeline.producerFinished = 1;
+
+			pthread_cond_broadcast(&pipeline.workAvailable);
+
+			pthread_mutex_unlock(&pipeline.lock);
+
+			setupFailed = 1;
+		}
+	}
+
+
+
+	/*============================================
+	 SECTION 4: Writing the results
+
+	 The writer waits for the next result, which
+	 is either the next entry in sequence or the
+	 next completed one, writes it and frees its
+	 slot for the producer. It stops once the
+	 producer is finished and every produced
+	 entry has been written
+	=============================================*/
+	pthread_mutex_lock(&pipeline.lock);
+
+	while (!setupFailed)
+	{
+		slotPtr = NULL;
+
+		if (pipeline.preserveOrder)
+		{
+			slotIndex = pipeline.numWritten
+				    % pipeline.numSlots;
+
+			if (pipeline.numWritten < pipeline.numProduced
+			    && pipeline.slots[slotIndex].state
+				== SLOT_DONE)
+			{
+				slotPtr = &pipeline.slots[slotIndex];
+			}
+		}
+		else if (pipeline.numDone > 0)
+		{
+			slotIndex = pipeline.doneQueue[pipeline.doneHead];
+
+			pipeline.doneHead = (pipeline.doneHead + 1)
+					    % pipeline.numSlots;
+
+			pipeline.numDone--;
+
+			slotPtr = &pipeline.slots[slotIndex];
+		}
+
+
+		if (slotPtr == NULL)
+		{
+			if (pipeline.producerFinished
+			    && pipeline.numWritten
+				== pipeline.numProduced)
+			{
+				break;
+			}
+
+			pthread_cond_wait(&pipeline.resultReady,
+					  &pipeline.lock);
+
+			continue;
+		}
+
+
+		//The slot is not touched by other threads
+		// until it is freed, so it can be written
+		// without holding the lock
+		pthread_mutex_unlock(&pipeline.lock);
+
+		appendOutputBytes(&stdoutBuffer, slotPtr->text.data,
+				  slotPtr->text.length);
+
+		slotPtr->text.length = 0;
+
+		pthread_mutex_lock(&pipeline.lock);
+
+
+		slotPtr->state = SLOT_FREE;
+
+		pipeline.numWritten++;
+
+		if (!pipeline.preserveOrder)
+		{
+			pipeline.freeSlots[pipeline.numFreeSlots++] =
+				slotIndex;
+		}
+
+		pthread_cond_signal(&pipeline.slotFreed);
+
+	}//end of while loop
+
+	pthread_mutex_unlock(&pipeline.lock);
+
+
+
+	/*============================================
+	 SECTION 5: Joining the threads and releasing
+		    the shared state
+	=============================================*/
+	if (!setupFailed)
+	{
+		pthread_join(producerThread, NULL);
+	}
+
+	if (pipeline.readErrorNumber != 0)
+	{
+		reportReadDirError(&stdoutBuffer, dirPath,
+				   pipeline.readErrorNumber);
+	}
+
+	for (unsigned int index = 0; index < numWorkersStarted;
+	     index++)
+	{
+		pthread_join(workerThreads[index], NULL);
+	}
+
+
+	if (pipeline.slots != NULL)
+	{
+		for (slotIndex = 0; slotIndex < pipeline.numSlots;
+		     slotIndex++)
+		{
+			free(pipeline.slots[slotIndex].name);
+
+			destroyOutputBuffer(
+				&pipeline.slots[slotIndex].text);
+		}
+	}
+
+	free(pipeline.slots);
+
+	free(pipeline.pendingQueue);
+
+	free(pipeline.doneQueue);
+
+	free(pipeline.freeSlots);
+
+	pthread_mutex_destroy(&pipeline.lock);
+
+	pthread_cond_destroy(&pipeline.slotFreed);
+
+	pthread_cond_destroy(&pipeline.workAvailable);
+
+	pthread_cond_destroy(&pipeline.resultReady);
+
+
+	return setupFailed ? -1 : 0;
+}
+
+
+/*---------------------------------------------------------*/
+
+void * runPipelineProducer(void * argument)
+{
+
+	struct StatPipeline * pipeline = argument;
+
+	struct DirEntryInfo entryInfo;
+
+	struct PipelineSlot * slotPtr = NULL;
+
+	size_t slotIndex;
+
+	size_t nameLength;
+
+	char * newName = NULL;
+
+	int readReturnValue;
+
+
+
+	while ((readReturnValue = readNextPipelineEntry(
+			pipeline, &entryInfo)) == 1)
+	{
+		//An entry the --filter rejects by name
+		// or type never takes a slot. A file
+		// argument is matched by its last
+		// component
+		if (!isEntryNameListed((pipeline->enumerator != NULL)
+				       ? entryInfo.name
+				       : getPathBaseName(entryInfo.name),
+				       entryInfo.direntType))
+		{
+			continue;
+		}
+
+
+		/*------------------------------------
+		 Part (a) Waiting for a free slot
+		-------------------------------------*/
+		pthread_mutex_lock(&pipeline->lock);
+
+		for (;;)
+		{
+			if (pipeline->preserveOrder)
+			{
+				slotIndex = pipeline->numProduced
+					    % pipeline->numSlots;
+
+				if (pipeline->slots[slotIndex].state
+					== SLOT_FREE)
+				{
+					break;
+				}
+			}
+			else if (pipeline->numFreeSlots > 0)
+			{
+				slotIndex = pipeline->freeSlots[
+					--pipeline->numFreeSlots];
+
+				break;
+			}
+
+			pthread_cond_wait(&pipeline->slotFreed,
+					  &pipeline->lock);
+		}
+
+		pthread_mutex_unlock(&pipeline->lock);
+
+
+
+		/*------------------------------------
+		 Part (b) Copying the name into the
+			  slot, whose buffer only grows
+		-------------------------------------*/
+		slotPtr = &pipeline->slots[slotIndex];
+
+		nameLength = strlen(entryInfo.name) + 1;
+
+		if (nameLength > slotPtr->nameCapacity)
+		{
+			newName = realloc(slotPtr->name, nameLength);
+
+			if (newName == NULL)
+			{
+				//The error takes the place of the
+				// entry, and goes straight to the
+				// writer
+				reportAccessError(&slotPtr->text,
+						  entryInfo.name, ENOMEM);
+
+				pthread_mutex_lock(&pipeline->lock);
+
+				slotPtr->state = SLOT_DONE;
+
+				pipeline->numProduced++;
+
+				if (!pipeline->preserveOrder)
+				{
+					pipeline->doneQueue[
+						(pipeline->doneHead
+						 + pipeline->numDone)
+						% pipeline->numSlots] =
+						slotIndex;
+
+					pipeline->numDone++;
+				}
+
+				pthread_cond_signal(&pipeline->resultReady);
+
+				pthread_mutex_unlock(&pipeline->lock);
+
+				continue;
+			}
+
+			slotPtr->name = newName;
+
+			slotPtr->nameCapacity = nameLength;
+		}
+
+		memcpy(slotPtr->name, entryInfo.name, nameLength);
+
+
+
+		/*------------------------------------
+		 Part (c) Queueing the slot for the
+			  workers
+		-------------------------------------*/
+		pthread_mutex_lock(&pipeline->lock);
+
+		slotPtr->state = SLOT_PENDING;
+
+		pipeline->pendingQueue[(pipeline->pendingHead
+					+ pipeline->numPending)
+				       % pipeline->numSlots] = slotIndex;
+
+		pipeline->numPending++;
+
+		pipeline->numProduced++;
+
+		pthread_cond_signal(&pipeline->workAvailable);
+
+		pthread_mutex_unlock(&pipeline->lock);
+
+	}//end of while loop
+
+
+	//readNextFileArgument() reports its own
+	// errors. The writer reports this one once
+	// every entry read has been written
+	if (readReturnValue == -1 && pipeline->enumerator != NULL)
+	{
+		pipeline->readErrorNumber = errno;
+	}
+
+
+	pthread_mutex_lock(&pipeline->lock);
+
+	pipeline->producerFinished = 1;
+
+	pthread_cond_broadcast(&pipeline->workAvailable);
+
+	pthread_cond_broadcast(&pipeline->resultReady);
+
+	pthread_mutex_unlock(&pipeline->lock);
+
+
+	return NULL;
+}
+
+
+/*---------------------------------------------------------*/
+
+void * runPipelineWorker(void * argument)
+{
+
+	struct StatPipeline * pipeline = argument;
+
+	struct PipelineSlot * slotPtr = NULL;
+
+	size_t slotIndex;
+
+
+
+	listedDirPath = pipeline->dirPath;
+
+	pthread_mutex_lock(&pipeline->lock);
+
+	for (;;)
+	{
+
+		/*------------------------------------
+		 Part (a) Taking the oldest pending
+			  entry, or leaving once the
+			  producer has finished and
+			  nothing is left
+		-------------------------------------*/
+		if (pipeline->numPending == 0)
+		{
+			if (pipeline->producerFinished)
+			{
+				break;
+			}
+
+			pthread_cond_wait(&pipeline->workAvailable,
+					  &pipeline->lock);
+
+			continue;
+		}
+
+		slotIndex = pipeline->pendingQueue[pipeline->pendingHead];
+
+		pipeline->pendingHead = (pipeline->pendingHead + 1)
+					% pipeline->numSlots;
+
+		pipeline->numPending--;
+
+		pthread_mutex_unlock(&pipeline->lock);
+
+
+
+		/*------------------------------------
+		 Part (b) Retrieving and formatting
+			  the information into memory
+		-------------------------------------*/
+		slotPtr = &pipeline->slots[slotIndex];
+
+		writeFileInfo(&slotPtr->text, pipeline->dirFd,
+			      slotPtr->name);
+
+
+
+		/*------------------------------------
+		 Part (c) Handing the result to the
+			  writer
+		-------------------------------------*/
+		pthread_mutex_lock(&pipeline->lock);
+
+		slotPtr->state = SLOT_DONE;
+
+		if (!pipeline->preserveOrder)
+		{
+			pipeline->doneQueue[(pipeline->doneHead
+					     + pipeline->numDone)
+					    % pipeline->numSlots] = slotIndex;
+
+			pipeline->numDone++;
+		}
+
+		pthread_cond_signal(&pipeline->resultReady);
+
+	}//end of for loop
+
+	pthread_mutex_unlock(&pipeline->lock);
+
+
+	mergeStageTimings();
+
+	mergeSummaryTotals();
+
+	return NULL;
+}
+
+
+/*---------------------------------------------------------*/
+
+int readNextPipelineEntry(struct StatPipeline * pipeline,
+			  struct DirEntryInfo * entryInfo)
+{
+	if (pipeline->enumerator != NULL)
+	{
+		return readNextDirEntry(pipeline->enumerator, entryInfo);
+	}
+
+	entryInfo->inodeNum = 0;
+
+	entryInfo->direntType = DT_UNKNOWN;
+
+	return readNextFileArgument(pipeline->fileArguments,
+				    &entryInfo->name);
+}
+
+
+/*---------------------------------------------------------*/
+
+int setupUringContext(struct UringContext * uring,
+		      unsigned int queueDepth)
+{
+
+	struct io_uring_params uringParams;
+
+	size_t sqRingSize;
+
+	size_t cqRingSize;
+
+	char * sqRingPtr = NULL;
+
+	char * cqRingPtr = NULL;
+
+
+
+	/*============================================
+	 SECTION 1: Creating the ring
+	=============================================*/
+	memset(uring, 0, sizeof(*uring));
+
+	memset(&uringParams, 0, sizeof(uringParams));
+
+	uring->ringFd = syscall(__NR_io_uring_setup, queueDepth,
+				&uringParams);
+
+	if (uring->ringFd == -1)
+	{
+		return -1;
+	}
+
+
+
+	/*============================================
+	 SECTION 2: Mapping the submission and
+		    completion rings, which share one
+		    mapping on kernels that offer
+		    IORING_FEAT_SINGLE_MMAP
+	=============================================*/
+	sqRingSize = uringParams.sq_off.array
+		     + uringParams.sq_entries * sizeof(unsigned int);
+
+	cqRingSize = uringParams.cq_off.cqes
+		     + uringParams.cq_entries
+		       * sizeof(struct io_uring_cqe);
+
+	if (uringParams.features & IORING_FEAT_SINGLE_MMAP)
+	{
+		if (cqRingSize > sqRingSize)
+		{
+			sqRingSize = cqRingSize;
+		}
+
+		cqRingSize = sqRingSize;
+	}
+
+
+	sqRingPtr = mmap(NULL, sqRingSize,
+			 PROT_READ | PROT_WRITE,
+			 MAP_SHARED | MAP_POPULATE,
+			 uring->ringFd, IORING_OFF_SQ_RING);
+
+	if (sqRingPtr == MAP_FAILED)
+	{
+		close(uring->ringFd);
+
+		return -1;
+	}
+
+	uring->sqRingPtr = sqRingPtr;
+
+	uring->sqRingSize = sqRingSize;
+
+
+	if (uringParams.features & IORING_FEAT_SINGLE_MMAP)
+	{
+		cqRingPtr = sqRingPtr;
+	}
+	else
+	{
+		cqRingPtr = mmap(NULL, cqRingSize,
+				 PROT_READ | PROT_WRITE,
+				 MAP_SHARED | MAP_POPULATE,
+				 uring->ringFd, IORING_OFF_CQ_RING);
+
+		if (cqRingPtr == MAP_FAILED)
+		{
+			munmap(sqRingPtr, sqRingSize);
+
+			close(uring->ringFd);
+
+			return -1;
+		}
+
+		uring->cqRingPtr = cqRingPtr;
+
+		uring->cqRingSize = cqRingSize;
+	}
+
+
+	uring->sqEntries = mmap(NULL, uringParams.sq_entries
+				      * sizeof(struct io_uring_sqe),
+				PROT_READ | PROT_WRITE,
+				MAP_SHARED | MAP_POPULATE,
+				uring->ringFd, IORING_OFF_SQES);
+
+	if (uring->sqEntries == MAP_FAILED)
+	{
+		destroyUringContext(uring);
+
+		return -1;
+	}
+
+	uring->sqEntriesSize = uringParams.sq_entries
+			       * sizeof(struct io_uring_sqe);
+
+
+
+	/*============================================
+	 SECTION 3: Locating the ring fields
+	=============================================*/
+	uring->sqHead = (unsigned int *)
+			(sqRingPtr + uringParams.sq_off.head);
+
+	uring->sqTail = (unsigned int *)
+			(sqRingPtr + uringParams.sq_off.tail);
+
+	uring->sqRingMask = *(unsigned int *)
+			    (sqRingPtr + uringParams.sq_off.ring_mask);
+
+	uring->sqArray = (unsigned int *)
+			 (sqRingPtr + uringParams.sq_off.array);
+
+	uring->cqHead = (unsigned int *)
+			(cqRingPtr + uringParams.cq_off.head);
+
+	uring->cqTail = (unsigned int *)
+			(cqRingPtr + uringParams.cq_off.tail);
+
+	uring->cqRingMask = *(unsigned int *)
+			    (cqRingPtr + uringParams.cq_off.ring_mask);
+
+	uring->cqEntries = (struct io_uring_cqe *)
+			   (cqRingPtr + uringParams.cq_off.cqes);
+
+	uring->queueDepth = uringParams.sq_entries;
+
+
+	return 0;
+}
+
+
+/*---------------------------------------------------------*/
+
+void destroyUringContext(struct UringContext * uring)
+{
+	if (uring->sqEntries != NULL && uring->sqEntries != MAP_FAILED)
+	{
+		munmap(uring->sqEntries, uring->sqEntriesSize);
+	}
+
+	if (uring->cqRingPtr != NULL)
+	{
+		munmap(uring->cqRingPtr, uring->cqRingSize);
+	}
+
+	if (uring->sqRingPtr != NULL)
+	{
+		munmap(uring->sqRingPtr, uring->sqRingSize);
+	}
+
+	close(uring->ringFd);
+
+	memset(uring, 0, sizeof(*uring));
+
+	uring->ringFd = -1;
+}
+
+
+/*---------------------------------------------------------*/
+
+int displayDirFilesInfoUring(struct DirEnumerator * enumerator,
+			     const char * dirPath)
+{
+
+	/*============================================
+	 SECTION 1: Declaration of variables
+	=============================================*/
+
+	struct UringContext uring;
+
+	struct statx * statxBufs = NULL;
+
+	size_t * nameOffsets = NULL;
+
+	int * statxResults = NULL;
+
+	char * isCompleted = NULL;
+
+	char * nameBuffer = NULL;
+
+	size_t nameBufferSize;
+
+	size_t nameBufferUsed;
+
+	size_t nameLength;
+
+	struct DirEntryInfo entryInfo;
+
+	struct io_uring_sqe * sqePtr = NULL;
+
+	struct io_uring_cqe * cqePtr = NULL;
+
+	struct stat statBuf;
+
+	unsigned int batchSize;
+
+	unsigned int numSubmitted;
+
+	unsigned int numCompleted;
+
+	long enterReturnValue;
+
+	int uringFailed = 0;
+
+	unsigned int sqTail;
+
+	unsigned int cqHead;
+
+	int readReturnValue = 1;
+
+	int dirFd = getDirEnumeratorFd(enumerator);
+
+	const char * fileName = NULL;
+
+
+
+	/*============================================
+	 SECTION 2: Setting up the ring and the per
+		    batch buffers
+
+	 Each batch holds at most one entry per
+	 submission queue slot, and every name of the
+	 batch is copied into 'nameBuffer', where it
+	 stays until its request has completed
+	=============================================*/
+	if (setupUringContext(&uring,
+			      listingOptions.uringQueueDepth) == -1)
+	{
+		return -1;
+	}
+
+	nameBufferSize = (size_t) uring.queueDepth * (NAME_MAX + 1);
+
+	statxBufs = malloc(uring.queueDepth * sizeof(*statxBufs));
+
+	nameOffsets = malloc(uring.queueDepth * sizeof(*nameOffsets));
+
+	statxResults = malloc(uring.queueDepth
+			      * sizeof(*statxResults));
+
+	isCompleted = malloc(uring.queueDepth);
+
+	nameBuffer = malloc(nameBufferSize);
+
+	if (statxBufs == NULL || nameOffsets == NULL
+	    || statxResults == NULL || isCompleted == NULL
+	    || nameBuffer == NULL)
+	{
+		free(statxBufs);
+
+		free(nameOffsets);
+
+		free(statxResults);
+
+		free(isCompleted);
+
+		free(nameBuffer);
+
+		destroyUringContext(&uring);
+
+		return -1;
+	}
+
+
+
+	/*============================================
+	 SECTION 3: Processing the directory batch by
+		    batch
+	=============================================*/
+	while (readReturnValue == 1 && !uringFailed)
+	{
+
+		/*------------------------------------
+		 Part (a) Queueing one IORING_OP_STATX
+			  request per entry, up to the
+			  depth of the ring
+		-------------------------------------*/
+		batchSize = 0;
+
+		nameBufferUsed = 0;
+
+		sqTail = *uring.sqTail;
+
+		while (batchSize < uring.queueDepth
+		       && (readReturnValue = readNextDirEntry(
+				enumerator, &entryInfo)) == 1)
+		{
+			if (!isEntryNameListed(entryInfo.name,
+					       entryInfo.direntType))
+			{
+				continue;
+			}
+
+			nameLength = strlen(entryInfo.name) + 1;
+
+			memcpy(nameBuffer + nameBufferUsed,
+			       entryInfo.name, nameLength);
+
+			nameOffsets[batchSize] = nameBufferUsed;
+
+			isCompleted[batchSize] = 0;
+
+			nameBufferUsed += nameLength;
+
+
+			sqePtr = &uring.sqEntries[sqTail
+						  & uring.sqRingMask];
+
+			memset(sqePtr, 0, sizeof(*sqePtr));
+
+			sqePtr->opcode = IORING_OP_STATX;
+
+			sqePtr->fd = dirFd;
+
+			sqePtr->addr = (unsigned long)
+				(nameBuffer + nameOffsets[batchSize]);
+
+			sqePtr->len = listingOptions.statxMask;
+
+			sqePtr->off = (unsigned long)
+				&statxBufs[batchSize];
+
+			sqePtr->statx_flags = AT_SYMLINK_NOFOLLOW;
+
+			sqePtr->user_data = batchSize;
+
+			uring.sqArray[sqTail & uring.sqRingMask] =
+				sqTail & uring.sqRingMask;
+
+			sqTail++;
+
+			batchSize++;
+		}
+
+
+		if (batchSize == 0)
+		{
+			break;
+		}
+
+
+		//Publish the new tail only after the
+		// entries have been filled in
+		__atomic_store_n(uring.sqTail, sqTail,
+				 __ATOMIC_RELEASE);
+
+
+
+		/*------------------------------------
+		 Part (b) Submitting the whole batch
+			  and reaping completions
+			  until all have arrived
+
+		 io_uring_enter() may accept fewer
+		 requests than were queued, so the
+		 rest is submitted on the next call.
+		 If it fails outright, the requests it
+		 has not accepted are taken back off
+		 the ring and the ring is not used
+		 again for this directory
+		-------------------------------------*/
+		numSubmitted = 0;
+
+		numCompleted = 0;
+
+		while (numCompleted < batchSize)
+		{
+			enterReturnValue = syscall(__NR_io_uring_enter,
+					uring.ringFd,
+					batchSize - numSubmitted, 1,
+					IORING_ENTER_GETEVENTS, NULL, 0);
+
+			if (enterReturnValue == -1
+			    && errno != EINTR && errno != EAGAIN
+			    && errno != EBUSY)
+			{
+				__atomic_store_n(uring.sqTail,
+					sqTail - (batchSize - numSubmitted),
+					__ATOMIC_RELEASE);
+
+				uringFailed = 1;
+
+				break;
+			}
+
+			if (enterReturnValue > 0)
+			{
+				numSubmitted += enterReturnValue;
+			}
+
+
+			cqHead = *uring.cqHead;
+
+			while (cqHead != __atomic_load_n(uring.cqTail,
+							  __ATOMIC_ACQUIRE))
+			{
+				cqePtr = &uring.cqEntries[cqHead
+							  & uring.cqRingMask];
+
+				statxResults[cqePtr->user_data] =
+					cqePtr->res;
+
+				isCompleted[cqePtr->user_data] = 1;
+
+				cqHead++;
+
+				numCompleted++;
+			}
+
+			__atomic_store_n(uring.cqHead, cqHead,
+					 __ATOMIC_RELEASE);
+		}
+
+
+
+		/*------------------------------------
+		 Part (c) Formatting the batch in
+			  directory order
+
+		 A request the kernel could not run
+		 (e.g. a kernel older than 5.6 that
+		 rejects IORING_OP_STATX with EINVAL)
+		 is retried with getFileMetadata()
+		-------------------------------------*/
+		for (unsigned int index = 0; index < batchSize;
+		     index++)
+		{
+			fileName = nameBuffer + nameOffsets[index];
+
+			if (!isCompleted[index]
+			    || statxResults[index] == -EINVAL
+			    || statxResults[index] == -ENOSYS
+			    || statxResults[index] == -EOPNOTSUPP)
+			{
+				writeFileInfo(&stdoutBuffer, dirFd,
+					      fileName);
+
+				continue;
+			}
+
+			if (statxResults[index] < 0)
+			{
+				reportAccessError(&stdoutBuffer, fileName,
+						  -statxResults[index]);
+
+				continue;
+			}
+
+			convertStatxToStat(&statxBufs[index], &statBuf);
+
+			writeFileStatInfo(&stdoutBuffer, fileName,
+					  &statBuf);
+		}
+
+	}//end of while loop
+
+
+	//Whatever is left after a failure of the
+	// ring is listed the usual way
+	while (uringFailed && readReturnValue == 1
+	       && (readReturnValue = readNextDirEntry(
+			enumerator, &entryInfo)) == 1)
+	{
+		if (isEntryNameListed(entryInfo.name,
+				      entryInfo.direntType))
+		{
+			writeFileInfo(&stdoutBuffer, dirFd,
+				      entryInfo.name);
+		}
+	}
+
+	if (readReturnValue == -1)
+	{
+		reportReadDirError(&stdoutBuffer, dirPath, errno);
+	}
+
+
+
+	/*============================================
+	 SECTION 4: Releasing the ring and buffers
+
+	 Closing the ring cancels any request still in
+	 flight after a failure. The buffers such a
+	 request points into are then left allocated,
+	 as the kernel may still write to them
+	=============================================*/
+	destroyUringContext(&uring);
+
+	if (!uringFailed)
+	{
+		free(statxBufs);
+
+		free(nameBuffer);
+	}
+
+	free(nameOffsets);
+
+	free(statxResults);
+
+	free(isCompleted);
+
+
+	return 0;
+}
+
+
+/*---------------------------------------------------------*/
+
+void displayCurrFileInfo(int dirFd, const char * fileName)
+{
+	listedDirPath = NULL;
+
+	if (isEntryNameListed(getPathBaseName(fileName), DT_UNKNOWN))
+	{
+		writeFileInfo(&stdoutBuffer, dirFd, fileName);
+	}
+}
+
+
+/*---------------------------------------------------------*/
+
+int openFileArguments(struct FileArgumentReader * reader,
+		      char ** arguments, int numArguments,
+		      const char * listPath, int delimiter)
+{
+	memset(reader, 0, sizeof(*reader));
+
+	reader->arguments = arguments;
+
+	reader->numArguments = numArguments;
+
+	reader->listPath = listPath;
+
+	reader->delimiter = delimiter;
+
+
+	if (listPath == NULL)
+	{
+		return 0;
+	}
+
+	if (strcmp(listPath, "-") == 0)
+	{
+		reader->listFile = stdin;
+
+		return 0;
+	}
+
+	reader->listFile = fopen(listPath, "re");
+
+
+	return (reader->listFile != NULL) ? 0 : -1;
+}
+
+
+/*---------------------------------------------------------*/
+
+int readNextFileArgument(struct FileArgumentReader * reader,
+			 const char ** namePtr)
+{
+
+	ssize_t lineLength;
+
+
+
+	/*============================================
+	 SECTION 1: The command line arguments come
+		    first
+	=============================================*/
+	if (reader->nextArgument < reader->numArguments)
+	{
+		*namePtr = reader->arguments[reader->nextArgument++];
+
+		return 1;
+	}
+
+	if (reader->listFile == NULL)
+	{
+		return 0;
+	}
+
+
+
+	/*============================================
+	 SECTION 2: Then the names of the list, with
+		    their delimiter removed. The last
+		    one need not have one
+	=============================================*/
+	errno = 0;
+
+	while ((lineLength = getdelim(&reader->line,
+				      &reader->lineCapacity,
+				      reader->delimiter,
+				      reader->listFile)) != -1)
+	{
+		if (lineLength > 0
+		    && reader->line[lineLength - 1] == reader->delimiter)
+		{
+			reader->line[--lineLength] = '\0';
+		}
+
+		if (lineLength > 0)
+		{
+			*namePtr = reader->line;
+
+			return 1;
+		}
+	}
+
+	if (ferror(reader->listFile))
+	{
+		fprintf(stderr, "myls: Failed to read '%s': %s\n",
+			reader->listPath, strerror(errno));
+
+		reader->readFailed = 1;
+
+		return -1;
+	}
+
+
+	return 0;
+}
+
+
+/*---------------------------------------------------------*/
+
+void closeFileArguments(struct FileArgumentReader * reader)
+{
+	if (reader->listFile != NULL && reader->listFile != stdin)
+	{
+		fclose(reader->listFile);
+	}
+
+	free(reader->line);
+
+	reader->listFile = NULL;
+
+	reader->line = NULL;
+}
+
+
+/*---------------------------------------------------------*/
+
+const char * getPathBaseName(const char * path)
+{
+	const char * slashPtr = strrchr(path, '/');
+
+
+	if (slashPtr == NULL || slashPtr[1] == '\0')
+	{
+		return path;
+	}
+
+	return slashPtr + 1;
+}
+
+
+/*---------------------------------------------------------*/
+
+void writeFileInfo(struct OutputBuffer * outBuffer,
+		   int dirFd, const char * fileName)
+{
+
+	struct stat statBuf;
+
+
+	/*-----------------------------------------
+	  Obtaining the information needed for
+	  the selected fields and storing them
+	  in a struct 'statBuf'
+
+	  If the files does not exist or the
+	  data cannot be accessed, then an
+	  error message is printed. 
+
+	  The function them immediately returns
+	------------------------------------------*/
+	if (getFileMetadata(dirFd, fileName, &statBuf) == -1)
+	{
+		reportAccessError(outBuffer, fileName, errno);
+
+		return;
+	}
+
+
+	writeFileStatInfo(outBuffer, fileName, &statBuf);
+}
+
+
+/*---------------------------------------------------------*/
+
+void writeFileStatInfo(struct OutputBuffer * outBuffer,
+		       const char * fileName,
+		       const struct stat * statBuf)
+{
+
+
+	/*==============================================
+	 SECTION 1: Declation of Variables
+	===============================================*/
+
+	unsigned int outputFields = listingOptions.outputFields;
+
+	uid_t userId;
+
+	gid_t groupId;
+
+	dev_t deviceNumbers;
+
+	unsigned int deviceMajorNum;
+
+	unsigned int deviceMinorNum;
+
+	ino_t inodeNum;
+
+	off_t fileSize;
+
+	nlink_t numOfHardLinks;
+
+	mode_t fileTypeAndPermsFlags;
+
+	time_t lastAccessTime;
+
+	time_t lastModTime;
+
+	time_t lastStatChgTime;
+
+	const char * userName = "";
+
+	const char * groupName = "";
+
+
+	char lastAccessTimeString[DATE_STRING_SIZE];
+	
+	char lastModTimeString[DATE_STRING_SIZE];
+
+	char lastStatChgTimeString[DATE_STRING_SIZE];
+
+	const char * fileTypeString = "";
+
+	const char * filePermsString = "";
+
+	unsigned long long stageStartTime;
+
+
+
+	/*==============================================
+	 An entry the --filter rejects by its metadata
+	 is dropped here, before its owner, group and
+	 dates are looked up and formatted
+	===============================================*/
+	if (!isEntryStatListed(statBuf))
+	{
+		return;
+	}
+
+	//--summary and --links only collect the entry
+	if (listingOptions.summarize || listingOptions.groupLinks)
+	{
+		if (listingOptions.groupLinks)
+		{
+			addLinkedName(fileName, statBuf);
+		}
+
+		if (listingOptions.summarize)
+		{
+			addToSummary(fileName, statBuf);
+		}
+
+		return;
+	}
+
+
+
+	/*==============================================
+	 The machine-readable formats are written by
+	 functions of their own
+	===============================================*/
+	if (listingOptions.outputFormat == FORMAT_JSONL)
+	{
+		writeFileStatJson(outBuffer, fileName, statBuf);
+
+		return;
+	}
+
+	if (listingOptions.outputFormat == FORMAT_BIN)
+	{
+		writeBinaryRecord(outBuffer, BINARY_RECORD_ENTRY,
+				  fileName, statBuf);
+
+		return;
+	}
+
+
+
+	/*==============================================
+	 SECTION 2: Retrieving the information about
+		    the file
+
+	 (a)First the caller makes a system call using
+	 'statx()' (or 'fstatat()', or an io_uring
+	 request) to retrieve a group of file data
+	 stored in a struct, which is passed to this
+	 function
+
+
+	 (b)Second, we retrieve the values stored in
+	 the struct.Some of the values can be
+	 retrieved directly, while some other values
+	 require further processing/more library
+	 function calls  to obtain the desired output/data
+
+
+	 (b)(i) Values that be retrieved directly:
+	 ----------------------------------
+	 -Size of file (in bytes)
+	 -i-node number
+	 -number of (hard) links
+
+
+	 (b)(ii)Values that require further processing/
+	 library function calls
+	 --------------------------------------
+	 -user name of owner owner
+	 -group name of group owner
+	 -type of file
+	 -full access permissions information
+	 -device numbers (major and minor numbers)
+	 -last access time
+	 -last modification time
+	 -last time file status changed
+	===============================================*/
+
+
+
+	/*------------------------------------
+	Part (b)(i)  Values that are retrieved
+	 directly
+	-----------------------------------*/
+	fileSize = statBuf->st_size;
+	
+	inodeNum = statBuf->st_ino;
+
+	numOfHardLinks = statBuf->st_nlink;
+
+
+	/*-------------------------------------
+	 Part (b)(ii) Values that require
+	 more processing/library calls
+	--------------------------------------*/
+
+
+	
+	/*---------------------------------------
+	 Part (b)(ii)(i) Retrieving User Name	
+
+	 Retrieval of the user name may fail,
+	 so the string 'userName' would be
+	 set to 'Not Available' if it fails.
+
+	 Otherwise, 'userName' would contain the
+	 user name of the owner owner. Names are
+	 cached, so each owner is only looked up
+	 once per run
+	-----------------------------------------*/	
+	userId = statBuf->st_uid;
+
+
+	if (outputFields & FIELD_USER)
+	{
+		stageStartTime = startStageTimer();
+
+		userName = lookupUserName(userId);
+
+		stopStageTimer(TIMED_USER_NAME, stageStartTime);
+	}
+
+
+	/*---------------------------------------
+	 Part(b)(ii)(ii) Retrieving Group Name	
+
+	 Retrieval of the group name may fail,
+	 so the string 'groupName' would be
+	 set to 'Not Available' if it fails
+
+	 Otherwise, 'groupName' would contain
+	 the group name of the group owner
+	-----------------------------------------*/
+	groupId = statBuf->st_gid;
+
+
+	if (outputFields & FIELD_GROUP)
+	{
+		stageStartTime = startStageTimer();
+
+		groupName = lookupGroupName(groupId);
+
+		stopStageTimer(TIMED_GROUP_NAME, stageStartTime);
+	}
+	
+	
+
+	/*---------------------------------------
+	 Part(b)(ii)(iii) Retrieving file type
+	 and file access permissions in string	
+
+	 
+	 The variable 'fileTypeAndPermsFlag'
+	 contains the data of file type and file
+	 access permissions in numerical form. 
+	 
+	 Further processing is required to obtain
+	 these data in string form
+	-----------------------------------------*/
+	fileTypeAndPermsFlags = statBuf->st_mode;
+
+	if (outputFields & FIELD_TYPE)
+	{
+		fileTypeString = getFileTypeString(
+					fileTypeAndPermsFlags);
+	}
+
+	if (outputFields & FIELD_PERMS)
+	{
+		filePermsString = getFilePermissionsString(
+					fileTypeAndPermsFlags);
+	}
+
+
+
+	/*---------------------------------------
+	 Part(b)(ii)(iv) Retrieving major and minor
+	 device numbers
+
+	 
+	 The variable 'deviceNumbers'
+	 contains both the device major and minor
+	 numbers 
+	 
+	 Further function calls to gnu_dev_major() 
+	 and gnu_dev_minor() are required to obtain the
+	 major and minor numbers respectively
+	-----------------------------------------*/
+	deviceNumbers = statBuf->st_dev;
+
+	deviceMajorNum = gnu_dev_major(deviceNumbers);
+
+	deviceMinorNum = gnu_dev_minor(deviceNumbers);
+
+
+
+	/*---------------------------------------
+	 Part(b)(ii)(v) Retrieving last access,last
+	 modification and last status change time
+
+	 
+	 The variables 'lastAccessTime',
+	 'lastModTime' and 'lastStatChgTime' 
+	 contains the information, but in number of
+	 seconds from 12am 1970. 
+	 
+	 Further function calls are required to
+	 to change them to user readable format
+	 in string (in local time) 
+	-----------------------------------------*/	
+	lastAccessTime = statBuf->st_atime;
+
+	lastModTime = statBuf->st_mtime;
+
+	lastStatChgTime = statBuf->st_ctime;
+
+		
+	if (outputFields & FIELD_ATIME)
+	{
+		stageStartTime = startStageTimer();
+
+		convertTimeToDateString(lastAccessTimeString,
+					lastAccessTime);
+
+		stopStageTimer(TIMED_DATE, stageStartTime);
+	}
+
+	if (outputFields & FIELD_MTIME)
+	{
+		stageStartTime = startStageTimer();
+
+		convertTimeToDateString(lastModTimeString,
+					lastModTime);
+
+		stopStageTimer(TIMED_DATE, stageStartTime);
+	}
+
+	if (outputFields & FIELD_CTIME)
+	{
+		stageStartTime = startStageTimer();
+
+		convertTimeToDateString(lastStatChgTimeString,
+					lastStatChgTime);
+
+		stopStageTimer(TIMED_DATE, stageStartTime);
+	}
+	
+
+	/*==============================================
+	 SECTION 3: Displaying the selected file
+		    information
+
+	 Every line is appended to 'outBuffer' as a
+	 label followed by its value, with integers
+	 converted by hand, so no format string is
+	 parsed at runtime
+	===============================================*/
+	appendOutputBytes(outBuffer, "\n", 1);
+
+	if (outputFields & FIELD_NAME)
+	{
+		appendOutputField(outBuffer, "File Name: ",
+				  fileName);
+	}
+
+	if (outputFields & FIELD_USER)
+	{
+		appendOutputField(outBuffer,
+				  "User Name of Owner Owner: ",
+				  userName);
+	}
+
+	if (outputFields & FIELD_GROUP)
+	{
+		appendOutputField(outBuffer,
+				  "Group Name of Group Owner: ",
+				  groupName);
+	}
+
+	if (outputFields & FIELD_TYPE)
+	{
+		appendOutputField(outBuffer, "Type of file: ",
+				  fileTypeString);
+	}
+
+	if (outputFields & FIELD_PERMS)
+	{
+		appendOutputField(outBuffer,
+				  "Full Access Permission: ",
+				  filePermsString);
+	}
+
+	if (outputFields & FIELD_SIZE)
+	{
+		appendOutputString(outBuffer,
+				   "Size of file (bytes): ");
+
+		appendOutputSigned(outBuffer, fileSize);
+
+		appendOutputBytes(outBuffer, "\n", 1);
+	}
+
+	if (outputFields & FIELD_INODE)
+	{
+		appendOutputString(outBuffer, "Inode num: ");
+
+		appendOutputUnsigned(outBuffer, inodeNum);
+
+		appendOutputBytes(outBuffer, "\n", 1);
+	}
+
+	if (outputFields & FIELD_DEV_MAJOR)
+	{
+		appendOutputString(outBuffer,
+				   "Device Major Number: ");
+
+		appendOutputUnsigned(outBuffer, deviceMajorNum);
+
+		appendOutputBytes(outBuffer, "\n", 1);
+	}
+
+	if (outputFields & FIELD_DEV_MINOR)
+	{
+		appendOutputString(outBuffer,
+				   "Device Minor Number: ");
+
+		appendOutputUnsigned(outBuffer, deviceMinorNum);
+
+		appendOutputBytes(outBuffer, "\n", 1);
+	}
+
+	if (outputFields & FIELD_LINKS)
+	{
+		appendOutputString(outBuffer, "No of links: ");
+
+		appendOutputUnsigned(outBuffer, numOfHardLinks);
+
+		appendOutputBytes(outBuffer, "\n", 1);
+	}
+
+	if (outputFields & FIELD_ATIME)
+	{
+		appendOutputField(outBuffer, "Last Access Time: ",
+				  lastAccessTimeString);
+	}
+
+	if (outputFields & FIELD_MTIME)
+	{
+		appendOutputField(outBuffer,
+				  "Last Modification Time: ",
+				  lastModTimeString);
+	}
+
+	if (outputFields & FIELD_CTIME)
+	{
+		appendOutputField(outBuffer,
+				  "Last Time File Status Change: ",
+				  lastStatChgTimeString);
+	}
+
+	appendOutputBytes(outBuffer, "\n", 1);
+
+}
+
+
+
+/*---------------------------------------------------------*/
+
+int initOutputBuffer(struct OutputBuffer * outBuffer,
+		     int outputFd, size_t capacity)
+{
+	outBuffer->outputFd = outputFd;
+
+	outBuffer->length = 0;
+
+	outBuffer->capacity = capacity;
+
+	outBuffer->hasFailed = 0;
+
+	outBuffer->spillFd = -1;
+
+	outBuffer->spillSize = 0;
+
+	outBuffer->data = malloc(capacity);
+
+
+	if (outBuffer->data == NULL)
+	{
+		outBuffer->capacity = 0;
+
+		outBuffer->hasFailed = 1;
+
+		return -1;
+	}
+
+
+	return 0;
+}
+
+
+/*---------------------------------------------------------*/
+
+void destroyOutputBuffer(struct OutputBuffer * outBuffer)
+{
+	free(outBuffer->data);
+
+	outBuffer->data = NULL;
+
+	outBuffer->length = 0;
+
+	outBuffer->capacity = 0;
+}
+
+
+/*---------------------------------------------------------*/
+
+int writeAllVectors(int outputFd, struct iovec * vectors,
+		    int numVectors)
+{
+
+	ssize_t bytesWritten;
+
+	unsigned long long stageStartTime;
+
+
+
+	/*==========================================
+	 writev() may write less than asked, e.g.
+	 into a full pipe, so the vectors are
+	 advanced past what was written and the
+	 call is repeated
+	===========================================*/
+	while (numVectors > 0)
+	{
+		stageStartTime = startStageTimer();
+
+		bytesWritten = writev(outputFd, vectors, numVectors);
+
+		stopStageTimer(TIMED_WRITE, stageStartTime);
+
+		if (bytesWritten == -1)
+		{
+			if (errno == EINTR)
+			{
+				continue;
+			}
+
+			return -1;
+		}
+
+
+		while (numVectors > 0
+		       && (size_t) bytesWritten >= vectors->iov_len)
+		{
+			bytesWritten -= vectors->iov_len;
+
+			vectors++;
+
+			numVectors--;
+		}
+
+		if (numVectors > 0)
+		{
+			vectors->iov_base = (char *) vectors->iov_base
+					    + bytesWritten;
+
+			vectors->iov_len -= bytesWritten;
+		}
+	}
+
+
+	return 0;
+}
+
+
+/*---------------------------------------------------------*/
+
+void flushOutputBuffer(struct OutputBuffer * outBuffer)
+{
+
+	struct iovec vector;
+
+
+
+	if (outBuffer->outputFd == -1 || outBuffer->length == 0)
+	{
+		return;
+	}
+
+
+	vector.iov_base = outBuffer->data;
+
+	vector.iov_len = outBuffer->length;
+
+	if (!outBuffer->hasFailed
+	    && writeAllVectors(outBuffer->outputFd, &vector, 1) == -1)
+	{
+		//Output is dropped from now on, as with a
+		// stdio stream in the error state
+		outBuffer->hasFailed = 1;
+	}
+
+	outBuffer->length = 0;
+}
+
+
+/*---------------------------------------------------------*/
+
+void appendOutputBytes(struct OutputBuffer * outBuffer,
+		       const char * bytes, size_t numBytes)
+{
+
+	struct iovec vectors[2];
+
+	size_t newCapacity;
+
+	char * newData = NULL;
+
+
+
+	//Nothing to add, e.g. the text of an entry
+	// that --summary, --links or --filter left
+	// out, which may not even have a buffer
+	if (numBytes == 0)
+	{
+		return;
+	}
+
+
+
+	/*==========================================
+	 SECTION 1: The common case, where the bytes
+		    fit in the remaining space
+	===========================================*/
+	if (outBuffer->length + numBytes <= outBuffer->capacity)
+	{
+		memcpy(outBuffer->data + outBuffer->length,
+		       bytes, numBytes);
+
+		outBuffer->length += numBytes;
+
+		return;
+	}
+
+
+
+	/*==========================================
+	 SECTION 2: A memory buffer grows to fit,
+		    unless it would grow past its
+		    'spillSize', from which point it
+		    is flushed like the buffers of
+		    SECTION 3
+	===========================================*/
+	if (outBuffer->outputFd == -1 && outBuffer->spillSize > 0
+	    && outBuffer->length + numBytes > outBuffer->spillSize)
+	{
+		outBuffer->outputFd = outBuffer->spillFd;
+
+		outBuffer->spillSize = 0;
+	}
+
+	if (outBuffer->outputFd == -1)
+	{
+		if (outBuffer->hasFailed)
+		{
+			return;
+		}
+
+		newCapacity = (outBuffer->capacity > 0)
+			      ? outBuffer->capacity : MAX_STRING_SIZE;
+
+		while (newCapacity < outBuffer->length + numBytes)
+		{
+			newCapacity *= 2;
+		}
+
+		newData = realloc(outBuffer->data, newCapacity);
+
+		if (newData == NULL)
+		{
+			outBuffer->hasFailed = 1;
+
+			return;
+		}
+
+		outBuffer->data = newData;
+
+		outBuffer->capacity = newCapacity;
+
+		memcpy(outBuffer->data + outBuffer->length,
+		       bytes, numBytes);
+
+		outBuffer->length += numBytes;
+
+		return;
+	}
+
+
+
+	/*==========================================
+	 SECTION 3: A buffer backed by a descriptor
+		    is flushed. A chunk of at least
+		    half the buffer is not copied at
+		    all, but written together with the
+		    buffered bytes in one writev()
+	===========================================*/
+	if (numBytes >= outBuffer->capacity / 2)
+	{
+		vectors[0].iov_base = outBuffer->data;
+
+		vectors[0].iov_len = outBuffer->length;
+
+		vectors[1].iov_base = (char *) bytes;
+
+		vectors[1].iov_len = numBytes;
+
+		if (!outBuffer->hasFailed
+		    && writeAllVectors(outBuffer->outputFd,
+				       vectors, 2) == -1)
+		{
+			outBuffer->hasFailed = 1;
+		}
+
+		outBuffer->length = 0;
+
+		return;
+	}
+
+
+	flushOutputBuffer(outBuffer);
+
+	memcpy(outBuffer->data, bytes, numBytes);
+
+	outBuffer->length = numBytes;
+}
+
+
+/*---------------------------------------------------------*/
+
+void appendOutputString(struct OutputBuffer * outBuffer,
+			const char * string)
+{
+	appendOutputBytes(outBuffer, string, strlen(string));
+}
+
+
+/*---------------------------------------------------------*/
+
+void appendOutputUnsigned(struct OutputBuffer * outBuffer,
+			  unsigned long long value)
+{
+
+	//Large enough for the 20 digits of the
+	// largest 64-bit value
+	char digits[24];
+
+	char * digitPtr = digits + sizeof(digits);
+
+
+
+	/*==========================================
+	 The digits are produced from the least
+	 significant end, filling 'digits' from
+	 the back
+	===========================================*/
+	do
+	{
+		*--digitPtr = (char) ('0' + value % 10);
+
+		value /= 10;
+
+	} while (value != 0);
+
+
+	appendOutputBytes(outBuffer, digitPtr,
+			  digits + sizeof(digits) - digitPtr);
+}
+
+
+/*---------------------------------------------------------*/
+
+void appendOutputSigned(struct OutputBuffer * outBuffer,
+			long long value)
+{
+	if (value < 0)
+	{
+		appendOutputBytes(outBuffer, "-", 1);
+
+		//Negated as unsigned, which is also
+		// correct for the most negative value
+		appendOutputUnsigned(outBuffer,
+				     0ULL - (unsigned long long) value);
+
+		return;
+	}
+
+
+	appendOutputUnsigned(outBuffer, (unsigned long long) value);
+}
+
+
+/*---------------------------------------------------------*/
+
+void appendOutputField(struct OutputBuffer * outBuffer,
+		       const char * label, const char * value)
+{
+	appendOutputString(outBuffer, label);
+
+	appendOutputString(outBuffer, value);
+
+	appendOutputBytes(outBuffer, "\n", 1);
+}
+
+
+/*---------------------------------------------------------*/
+
+void appendJsonString(struct OutputBuffer * outBuffer,
+		      const char * string)
+{
+
+	static const char hexDigits[] = "0123456789abcdef";
+
+	const unsigned char * bytePtr =
+		(const unsigned char *) string;
+
+	const unsigned char * runStart = bytePtr;
+
+	char escape[8];
+
+	size_t sequenceLength;
+
+	unsigned char minSecond;
+
+	unsigned char maxSecond;
+
+	size_t index;
+
+
+
+	appendOutputBytes(outBuffer, "\"", 1);
+
+
+	while (*bytePtr != '\0')
+	{
+
+		/*==========================================
+		 SECTION 1: Measuring the character that
+			    starts at 'bytePtr', and the
+			    range its second byte must lie in
+			    for the sequence to be neither
+			    overlong nor a surrogate nor past
+			    U+10FFFF
+		===========================================*/
+		minSecond = 0x80;
+
+		maxSecond = 0xbf;
+
+		if (*bytePtr < 0x80)
+		{
+			sequenceLength = 1;
+		}
+		else if (*bytePtr >= 0xc2 && *bytePtr <= 0xdf)
+		{
+			sequenceLength = 2;
+		}
+		else if (*bytePtr >= 0xe0 && *bytePtr <= 0xef)
+		{
+			sequenceLength = 3;
+
+			minSecond = (*bytePtr == 0xe0) ? 0xa0 : 0x80;
+
+			maxSecond = (*bytePtr == 0xed) ? 0x9f : 0xbf;
+		}
+		else if (*bytePtr >= 0xf0 && *bytePtr <= 0xf4)
+		{
+			sequenceLength = 4;
+
+			minSecond = (*bytePtr == 0xf0) ? 0x90 : 0x80;
+
+			maxSecond = (*bytePtr == 0xf4) ? 0x8f : 0xbf;
+		}
+		else
+		{
+			sequenceLength = 0;
+		}
+
+		for (index = 1; index < sequenceLength; index++)
+		{
+			if (bytePtr[index] < ((index == 1) ? minSecond
+							    : 0x80)
+			    || bytePtr[index] > ((index == 1) ? maxSecond
+							       : 0xbf))
+			{
+				sequenceLength = 0;
+
+				break;
+			}
+		}
+
+
+
+		/*==========================================
+		 SECTION 2: Copying valid characters as
+			    they are, in runs, and escaping
+			    the rest
+		===========================================*/
+		if (sequenceLength > 1
+		    || (sequenceLength == 1 && *bytePtr >= 0x20
+			&& *bytePtr != '"' && *bytePtr != '\\'))
+		{
+			bytePtr += sequenceLength;
+
+			continue;
+		}
+
+
+		appendOutputBytes(outBuffer, (const char *) runStart,
+				  bytePtr - runStart);
+
+		if (*bytePtr == '"' || *bytePtr == '\\')
+		{
+			escape[0] = '\\';
+
+			escape[1] = (char) *bytePtr;
+
+			appendOutputBytes(outBuffer, escape, 2);
+		}
+		else
+		{
+			memcpy(escape, (sequenceLength == 1) ? "\\u00"
+							     : "\\udc", 4);
+
+			escape[4] = hexDigits[*bytePtr >> 4];
+
+			escape[5] = hexDigits[*bytePtr & 0x0f];
+
+			appendOutputBytes(outBuffer, escape, 6);
+		}
+
+		bytePtr++;
+
+		runStart = bytePtr;
+	}
+
+
+	appendOutputBytes(outBuffer, (const char *) runStart,
+			  bytePtr - runStart);
+
+	appendOutputBytes(outBuffer, "\"", 1);
+}
+
+
+/*---------------------------------------------------------*/
+
+void writeFileStatJson(struct OutputBuffer * outBuffer,
+		       const char * fileName,
+		       const struct stat * statBuf)
+{
+
+	/*==============================================
+	 Every selected field becomes one member, in
+	 the order of the text format. Each member is
+	 preceded by ',' except the first, which is
+	 preceded by '{'
+	===============================================*/
+	unsigned int outputFields = listingOptions.outputFields;
+
+	const char * separator = "{";
+
+	const char * name = NULL;
+
+	unsigned long long stageStartTime;
+
+
+
+	if (outputFields & FIELD_NAME)
+	{
+		appendOutputString(outBuffer, "{\"name\":");
+
+		appendJsonString(outBuffer, fileName);
+
+		separator = ",";
+	}
+
+	if (outputFields & FIELD_USER)
+	{
+		appendOutputString(outBuffer, separator);
+
+		appendOutputString(outBuffer, "\"uid\":");
+
+		appendOutputUnsigned(outBuffer, statBuf->st_uid);
+
+		appendOutputString(outBuffer, ",\"user\":");
+
+		stageStartTime = startStageTimer();
+
+		name = lookupUserName(statBuf->st_uid);
+
+		stopStageTimer(TIMED_USER_NAME, stageStartTime);
+
+		appendJsonString(outBuffer, name);
+
+		separator = ",";
+	}
+
+	if (outputFields & FIELD_GROUP)
+	{
+		appendOutputString(outBuffer, separator);
+
+		appendOutputString(outBuffer, "\"gid\":");
+
+		appendOutputUnsigned(outBuffer, statBuf->st_gid);
+
+		appendOutputString(outBuffer, ",\"group\":");
+
+		stageStartTime = startStageTimer();
+
+		name = lookupGroupName(statBuf->st_gid);
+
+		stopStageTimer(TIMED_GROUP_NAME, stageStartTime);
+
+		appendJsonString(outBuffer, name);
+
+		separator = ",";
+	}
+
+	if (outputFields & FIELD_TYPE)
+	{
+		appendOutputString(outBuffer, separator);
+
+		appendOutputString(outBuffer, "\"type\":");
+
+		appendJsonString(outBuffer,
+				 getFileTypeString(statBuf->st_mode));
+
+		separator = ",";
+	}
+
+	if (outputFields & FIELD_PERMS)
+	{
+		appendOutputString(outBuffer, separator);
+
+		appendOutputString(outBuffer, "\"mode\":");
+
+		appendOutputUnsigned(outBuffer,
+				     statBuf->st_mode & FILE_PERMS_MASK);
+
+		appendOutputString(outBuffer, ",\"perms\":");
+
+		appendJsonString(outBuffer,
+			getFilePermissionsString(statBuf->st_mode));
+
+		separator = ",";
+	}
+
+	if (outputFields & FIELD_SIZE)
+	{
+		appendOutputString(outBuffer, separator);
+
+		appendOutputString(outBuffer, "\"size\":");
+
+		appendOutputSigned(outBuffer, statBuf->st_size);
+
+		separator = ",";
+	}
+
+	if (outputFields & FIELD_INODE)
+	{
+		appendOutputString(outBuffer, separator);
+
+		appendOutputString(outBuffer, "\"inode\":");
+
+		appendOutputUnsigned(outBuffer, statBuf->st_ino);
+
+		separator = ",";
+	}
+
+	if (outputFields & FIELD_DEV_MAJOR)
+	{
+		appendOutputString(outBuffer, separator);
+
+		appendOutputString(outBuffer, "\"major\":");
+
+		appendOutputUnsigned(outBuffer,
+				     gnu_dev_major(statBuf->st_dev));
+
+		separator = ",";
+	}
+
+	if (outputFields & FIELD_DEV_MINOR)
+	{
+		appendOutputString(outBuffer, separator);
+
+		appendOutputString(outBuffer, "\"minor\":");
+
+		appendOutputUnsigned(outBuffer,
+				     gnu_dev_minor(statBuf->st_dev));
+
+		separator = ",";
+	}
+
+	if (outputFields & FIELD_LINKS)
+	{
+		appendOutputString(outBuffer, separator);
+
+		appendOutputString(outBuffer, "\"links\":");
+
+		appendOutputUnsigned(outBuffer, statBuf->st_nlink);
+
+		separator = ",";
+	}
+
+	if (outputFields & FIELD_ATIME)
+	{
+		appendOutputString(outBuffer, separator);
+
+		appendOutputString(outBuffer, "\"atime\":");
+
+		appendOutputSigned(outBuffer, statBuf->st_atime);
+
+		separator = ",";
+	}
+
+	if (outputFields & FIELD_MTIME)
+	{
+		appendOutputString(outBuffer, separator);
+
+		appendOutputString(outBuffer, "\"mtime\":");
+
+		appendOutputSigned(outBuffer, statBuf->st_mtime);
+
+		separator = ",";
+	}
+
+	if (outputFields & FIELD_CTIME)
+	{
+		appendOutputString(outBuffer, separator);
+
+		appendOutputString(outBuffer, "\"ctime\":");
+
+		appendOutputSigned(outBuffer, statBuf->st_ctime);
+
+		separator = ",";
+	}
+
+	//With no field selected the object is empty
+	appendOutputString(outBuffer, (separator[0] == '{')
+				      ? "{}\n" : "}\n");
+}
+
+
+/*---------------------------------------------------------*/
+
+void writeBinaryRecord(struct OutputBuffer * outBuffer,
+		       enum BinaryRecordKind recordKind,
+		       const char * name,
+		       const struct stat * statBuf)
+{
+
+	unsigned int outputFields = listingOptions.outputFields;
+
+	unsigned char record[BINARY_RECORD_SIZE];
+
+	size_t nameLength = strlen(name);
+
+	size_t pieceLength;
+
+
+
+	/*==============================================
+	 SECTION 1: Packing the metadata. Continuation
+		    records carry only a piece of the
+		    name
+	===============================================*/
+	memset(record, 0, sizeof(record));
+
+	if (statBuf != NULL)
+	{
+		if (outputFields & FIELD_SIZE)
+		{
+			storeLittleEndian(record + 0,
+					  (uint64_t) statBuf->st_size, 8);
+		}
+
+		if (outputFields & FIELD_INODE)
+		{
+			storeLittleEndian(record + 8, statBuf->st_ino, 8);
+		}
+
+		if (outputFields & FIELD_ATIME)
+		{
+			storeLittleEndian(record + 16,
+					  (uint64_t) statBuf->st_atime, 8);
+		}
+
+		if (outputFields & FIELD_MTIME)
+		{
+			storeLittleEndian(record + 24,
+					  (uint64_t) statBuf->st_mtime, 8);
+
+			storeLittleEndian(record + 40,
+					  statBuf->st_mtim.tv_nsec, 4);
+		}
+
+		if (outputFields & FIELD_CTIME)
+		{
+			storeLittleEndian(record + 32,
+					  (uint64_t) statBuf->st_ctime, 8);
+		}
+
+		if (outputFields & (FIELD_TYPE | FIELD_PERMS))
+		{
+			storeLittleEndian(record + 44,
+					  statBuf->st_mode, 4);
+		}
+
+		if (outputFields & FIELD_USER)
+		{
+			storeLittleEndian(record + 48,
+					  statBuf->st_uid, 4);
+		}
+
+		if (outputFields & FIELD_GROUP)
+		{
+			storeLittleEndian(record + 52,
+					  statBuf->st_gid, 4);
+		}
+
+		if (outputFields & FIELD_LINKS)
+		{
+			storeLittleEndian(record + 56,
+					  statBuf->st_nlink, 4);
+		}
+
+		if (outputFields & FIELD_DEV_MAJOR)
+		{
+			storeLittleEndian(record + 60,
+				gnu_dev_major(statBuf->st_dev), 4);
+		}
+
+		if (outputFields & FIELD_DEV_MINOR)
+		{
+			storeLittleEndian(record + 64,
+				gnu_dev_minor(statBuf->st_dev), 4);
+		}
+	}
+
+	storeLittleEndian(record + 68, recordKind, 2);
+
+	storeLittleEndian(record + 72, nameLength, 4);
+
+
+
+	/*==============================================
+	 SECTION 2: Writing the record, and the rest
+		    of a long name in continuation
+		    records
+	===============================================*/
+	do
+	{
+		pieceLength = (nameLength < BINARY_NAME_SIZE)
+			      ? nameLength : BINARY_NAME_SIZE;
+
+		memcpy(record + BINARY_NAME_OFFSET, name, pieceLength);
+
+		appendOutputBytes(outBuffer, (const char *) record,
+				  sizeof(record));
+
+		name += pieceLength;
+
+		nameLength -= pieceLength;
+
+
+		memset(record, 0, sizeof(record));
+
+		storeLittleEndian(record + 68, BINARY_RECORD_CONT, 2);
+
+	} while (nameLength > 0);
+}
+
+
+/*---------------------------------------------------------*/
+
+void writeBinaryHeader(struct OutputBuffer * outBuffer)
+{
+	unsigned char header[BINARY_HEADER_SIZE];
+
+
+	memset(header, 0, sizeof(header));
+
+	memcpy(header, BINARY_MAGIC, sizeof(BINARY_MAGIC));
+
+	storeLittleEndian(header + 8, BINARY_FORMAT_VERSION, 4);
+
+	storeLittleEndian(header + 12, BINARY_HEADER_SIZE, 4);
+
+	storeLittleEndian(header + 16, BINARY_RECORD_SIZE, 4);
+
+	storeLittleEndian(header + 20, listingOptions.outputFields, 4);
+
+	appendOutputBytes(outBuffer, (const char *) header,
+			  sizeof(header));
+}
+
+
+/*---------------------------------------------------------*/
+
+void writeDirHeading(struct OutputBuffer * outBuffer,
+		     const char * dirPath)
+{
+	if (listingOptions.summarize || listingOptions.groupLinks)
+	{
+		return;
+	}
+
+	if (listingOptions.outputFormat == FORMAT_JSONL)
+	{
+		appendOutputString(outBuffer, "{\"dir\":");
+
+		appendJsonString(outBuffer, dirPath);
+
+		appendOutputString(outBuffer, "}\n");
+	}
+	else if (listingOptions.outputFormat == FORMAT_BIN)
+	{
+		writeBinaryRecord(outBuffer, BINARY_RECORD_DIR,
+				  dirPath, NULL);
+	}
+	else
+	{
+		appendOutputString(outBuffer, "\n");
+
+		appendOutputString(outBuffer, dirPath);
+
+		appendOutputString(outBuffer, ":\n");
+	}
+}
+
+
+/*---------------------------------------------------------*/
+
+void writeRemovedEntry(struct OutputBuffer * outBuffer,
+		       const char * filePath)
+{
+	if (listingOptions.outputFormat == FORMAT_JSONL)
+	{
+		appendOutputString(outBuffer, "{\"removed\":");
+
+		appendJsonString(outBuffer, filePath);
+
+		appendOutputString(outBuffer, "}\n");
+	}
+	else if (listingOptions.outputFormat == FORMAT_BIN)
+	{
+		writeBinaryRecord(outBuffer, BINARY_RECORD_REMOVED,
+				  filePath, NULL);
+	}
+	else
+	{
+		appendOutputString(outBuffer, "\nRemoved: ");
+
+		appendOutputString(outBuffer, filePath);
+
+		appendOutputString(outBuffer, "\n\n");
+	}
+}
+
+
+/*---------------------------------------------------------*/
+
+void writeErrorRecord(struct OutputBuffer * outBuffer,
+		      const char * message)
+{
+	if (listingOptions.outputFormat == FORMAT_JSONL)
+	{
+		appendOutputString(outBuffer, "{\"error\":");
+
+		appendJsonString(outBuffer, message);
+
+		appendOutputString(outBuffer, "}\n");
+	}
+	else if (listingOptions.outputFormat == FORMAT_BIN)
+	{
+		writeBinaryRecord(outBuffer, BINARY_RECORD_ERROR,
+				  message, NULL);
+	}
+	else
+	{
+		appendOutputString(outBuffer, "\nmyls: ");
+
+		appendOutputString(outBuffer, message);
+
+		appendOutputString(outBuffer, "\n\n");
+	}
+}
+
+
+/*---------------------------------------------------------*/
+
+void storeLittleEndian(unsigned char * bytes,
+		       uint64_t value, int numBytes)
+{
+	for (int index = 0; index < numBytes; index++)
+	{
+		bytes[index] = (unsigned char) (value >> (8 * index));
+	}
+}
+
+
+/*---------------------------------------------------------*/
+
+void reportAccessError(struct OutputBuffer * outBuffer,
+		       const char * fileName, int errorNumber)
+{
+	char * message = NULL;
+
+
+	__atomic_add_fetch(&numListingErrors, 1, __ATOMIC_RELAXED);
+
+	if (listingOptions.errorsToOutput
+	    && asprintf(&message, "Cannot access '%s': %s", fileName,
+			strerror(errorNumber)) != -1)
+	{
+		writeErrorRecord(outBuffer, message);
+
+		free(message);
+
+		return;
+	}
+
+
+	//What has been listed so far is written out
+	// first, so the message appears in place
+	flushOutputBuffer(outBuffer);
+
+	fprintf(stderr,
+		"\nmyls: Cannot access '%s': %s\n\n",
+		fileName, strerror(errorNumber));
+}
+
+
+/*---------------------------------------------------------*/
+
+void reportOpenDirError(struct OutputBuffer * outBuffer,
+			const char * dirPath,
+			const char * subdirName, int errorNumber)
+{
+	char * message = NULL;
+
+	const char * separator = (subdirName != NULL) ? "/" : "";
+
+
+	if (subdirName == NULL)
+	{
+		subdirName = "";
+	}
+
+	__atomic_add_fetch(&numListingErrors, 1, __ATOMIC_RELAXED);
+
+	if (listingOptions.errorsToOutput
+	    && asprintf(&message, "Failed to open directory '%s%s%s': %s",
+			dirPath, separator, subdirName,
+			strerror(errorNumber)) != -1)
+	{
+		writeErrorRecord(outBuffer, message);
+
+		free(message);
+
+		return;
+	}
+
+
+	flushOutputBuffer(outBuffer);
+
+	fprintf(stderr, "Failed to open directory '%s%s%s': %s\n",
+		dirPath, separator, subdirName, strerror(errorNumber));
+}
+
+
+/*---------------------------------------------------------*/
+
+void reportReadDirError(struct OutputBuffer * outBuffer,
+			const char * dirPath, int errorNumber)
+{
+	char * message = NULL;
+
+
+	__atomic_add_fetch(&numListingErrors, 1, __ATOMIC_RELAXED);
+
+	if (listingOptions.errorsToOutput
+	    && asprintf(&message, "Failed to read directory '%s': %s",
+			dirPath, strerror(errorNumber)) != -1)
+	{
+		writeErrorRecord(outBuffer, message);
+
+		free(message);
+
+		return;
+	}
+
+
+	flushOutputBuffer(outBuffer);
+
+	fprintf(stderr, "Failed to read directory '%s': %s\n",
+		dirPath, strerror(errorNumber));
+}
+
+
+/*---------------------------------------------------------*/
+
+int getFileMetadata(int dirFd, const char * fileName,
+		    struct stat * statBuf)
+{
+
+	/*===============================================
+	 'statxUnavailable' is set the first time the
+	 kernel reports that it has no statx(), after
+	 which fstatat() is used directly. Both look
+	 'fileName' up relative to 'dirFd', so only
+	 the final component is resolved. The -j
+	 workers, the pipeline and libmyls all get
+	 here, so the flag is read and set
+	 atomically
+	================================================*/
+	static int statxUnavailable = 0;
+
+	struct statx statxBuf;
+
+	unsigned long long stageStartTime = startStageTimer();
+
+	int returnValue;
+
+
+
+	/*===============================================
+	 SECTION 1: Falling back to fstatat()
+	================================================*/
+	if (__atomic_load_n(&statxUnavailable, __ATOMIC_RELAXED))
+	{
+		returnValue = fstatat(dirFd, fileName, statBuf,
+				      AT_SYMLINK_NOFOLLOW);
+
+		stopStageTimer(TIMED_STAT, stageStartTime);
+
+		return returnValue;
+	}
+
+
+
+	/*===============================================
+	 SECTION 2: Requesting only the needed fields
+	================================================*/
+	returnValue = statx(dirFd, fileName, AT_SYMLINK_NOFOLLOW,
+			    listingOptions.statxMask, &statxBuf);
+
+	if (returnValue == -1 && errno == ENOSYS)
+	{
+		__atomic_store_n(&statxUnavailable, 1, __ATOMIC_RELAXED);
+
+		returnValue = fstatat(dirFd, fileName, statBuf,
+				      AT_SYMLINK_NOFOLLOW);
+
+		stopStageTimer(TIMED_STAT, stageStartTime);
+
+		return returnValue;
+	}
+
+	stopStageTimer(TIMED_STAT, stageStartTime);
+
+	if (returnValue == -1)
+	{
+		return -1;
+	}
+
+
+
+	/*===============================================
+	 SECTION 3: Copying the result into a struct
+		    stat
+	================================================*/
+	convertStatxToStat(&statxBuf, statBuf);
+
+
+	return 0;
+}
+
+
+
+/*---------------------------------------------------------*/
+
+void convertStatxToStat(const struct statx * statxBuf,
+			struct stat * statBuf)
+{
+	memset(statBuf, 0, sizeof(*statBuf));
+
+	statBuf->st_dev = makedev(statxBuf->stx_dev_major,
+				  statxBuf->stx_dev_minor);
+
+	statBuf->st_ino = statxBuf->stx_ino;
+
+	statBuf->st_mode = statxBuf->stx_mode;
+
+	statBuf->st_nlink = statxBuf->stx_nlink;
+
+	statBuf->st_uid = statxBuf->stx_uid;
+
+	statBuf->st_gid = statxBuf->stx_gid;
+
+	statBuf->st_rdev = makedev(statxBuf->stx_rdev_major,
+				   statxBuf->stx_rdev_minor);
+
+	statBuf->st_size = statxBuf->stx_size;
+
+	statBuf->st_blksize = statxBuf->stx_blksize;
+
+	statBuf->st_blocks = statxBuf->stx_blocks;
+
+	statBuf->st_atim.tv_sec = statxBuf->stx_atime.tv_sec;
+
+	statBuf->st_atim.tv_nsec = statxBuf->stx_atime.tv_nsec;
+
+	statBuf->st_mtim.tv_sec = statxBuf->stx_mtime.tv_sec;
+
+	statBuf->st_mtim.tv_nsec = statxBuf->stx_mtime.tv_nsec;
+
+	statBuf->st_ctim.tv_sec = statxBuf->stx_ctime.tv_sec;
+
+	statBuf->st_ctim.tv_nsec = statxBuf->stx_ctime.tv_nsec;
+}
+
+
+
+/*---------------------------------------------------------*/
+
+int parseOutputFormat(const char * formatName,
+		      enum OutputFormat * formatPtr)
+{
+	if (strcmp(formatName, "text") == 0)
+	{
+		*formatPtr = FORMAT_TEXT;
+	}
+	else if (strcmp(formatName, "jsonl") == 0)
+	{
+		*formatPtr = FORMAT_JSONL;
+	}
+	else if (strcmp(formatName, "bin") == 0)
+	{
+		*formatPtr = FORMAT_BIN;
+	}
+	else
+	{
+		fprintf(stderr, "myls: Invalid output format '%s'\n",
+			formatName);
+
+		return -1;
+	}
+
+
+	return 0;
+}
+
+
+/*---------------------------------------------------------*/
+
+int parseFieldList(const char * fieldList,
+		   unsigned int * outputFields,
+		   unsigned int * statxMask)
+{
+
+	const char * fieldStart = fieldList;
+
+	const char * fieldEnd = NULL;
+
+	size_t fieldLength;
+
+	size_t index;
+
+
+
+	*outputFields = 0;
+
+	*statxMask = 0;
+
+
+	/*===============================================
+	 Each comma-separated name is looked up in
+	 'fieldDescriptors', and its flag and statx()
+	 bits are added to the outputs
+	================================================*/
+	while (*fieldStart != '\0')
+	{
+		fieldEnd = strchr(fieldStart, ',');
+
+		if (fieldEnd == NULL)
+		{
+			fieldEnd = fieldStart + strlen(fieldStart);
+		}
+
+		fieldLength = fieldEnd - fieldStart;
+
+
+		for (index = 0; index < NUM_FIELD_DESCRIPTORS;
+		     index++)
+		{
+			if (strlen(fieldDescriptors[index].fieldName)
+				== fieldLength
+			    && strncmp(fieldDescriptors[index].fieldName,
+				       fieldStart, fieldLength) == 0)
+			{
+				break;
+			}
+		}
+
+
+		if (index == NUM_FIELD_DESCRIPTORS)
+		{
+			fprintf(stderr,
+				"myls: Unknown field '%.*s'\n",
+				(int) fieldLength, fieldStart);
+
+			return -1;
+		}
+
+
+		*outputFields |= fieldDescriptors[index].fieldFlag;
+
+		*statxMask |= fieldDescriptors[index].statxBits;
+
+
+		fieldStart = (*fieldEnd == ',') ? fieldEnd + 1
+						: fieldEnd;
+	}
+
+
+	return 0;
+}
+
+
+
+/*---------------------------------------------------------*/
+
+int parseFilterExpression(const char * expression,
+			  struct EntryFilter * filterPtr,
+			  unsigned int * statxMask)
+{
+
+	char * expressionCopy = NULL;
+
+	char * predicate = NULL;
+
+	char * nextPredicate = NULL;
+
+	char * readPtr = NULL;
+
+	char * writePtr = NULL;
+
+	const char * previousGlob = filterPtr->nameGlob;
+
+
+
+	//The copy is kept if the name glob points
+	// into it
+	expressionCopy = strdup(expression);
+
+	if (expressionCopy == NULL)
+	{
+		perror("myls");
+
+		return -1;
+	}
+
+	predicate = expressionCopy;
+
+
+	while (predicate != NULL)
+	{
+		//The predicate ends at the first comma
+		// not preceded by a backslash, and '\,'
+		// is unescaped in place on the way
+		readPtr = predicate;
+
+		writePtr = predicate;
+
+		while (*readPtr != '\0' && *readPtr != ',')
+		{
+			if (readPtr[0] == '\\' && readPtr[1] == ',')
+			{
+				readPtr++;
+			}
+
+			*writePtr++ = *readPtr++;
+		}
+
+		nextPredicate = (*readPtr == ',') ? readPtr + 1 : NULL;
+
+		*writePtr = '\0';
+
+
+		if (parseFilterPredicate(predicate, filterPtr,
+					 statxMask) == -1)
+		{
+			break;
+		}
+
+		predicate = nextPredicate;
+	}
+
+
+	if (filterPtr->nameGlob == previousGlob)
+	{
+		free(expressionCopy);
+	}
+
+	return (predicate == NULL) ? 0 : -1;
+}
+
+
+/*---------------------------------------------------------*/
+
+int parseFilterPredicate(const char * predicate,
+			 struct EntryFilter * filterPtr,
+			 unsigned int * statxMask)
+{
+
+	/*============================================
+	 SECTION 1: Declaration of variables
+	=============================================*/
+
+	static const char sizeSuffixes[] = "KMGT";
+
+	static const uint64_t sizeMultipliers[] =
+	{
+		1ULL << 10, 1ULL << 20, 1ULL << 30, 1ULL << 40
+	};
+
+	static const char ageSuffixes[] = "smhdw";
+
+	static const uint64_t ageMultipliers[] =
+	{
+		1, 60, 60 * 60, 24 * 60 * 60, 7 * 24 * 60 * 60
+	};
+
+	static const char typeLetters[] = "fdlpscb";
+
+	static const unsigned char direntTypes[] =
+	{
+		DT_REG, DT_DIR, DT_LNK, DT_FIFO, DT_SOCK, DT_CHR, DT_BLK
+	};
+
+	const char * value = strchr(predicate, '=');
+
+	const struct FilterPredicateDescriptor * descriptorPtr = NULL;
+
+	size_t nameLength = 0;
+
+	unsigned int newPredicate = 0;
+
+	unsigned int newStatxBits = 0;
+
+	uint64_t minValue;
+
+	uint64_t maxValue;
+
+	unsigned long long userNumber;
+
+	const char * letterPtr = NULL;
+
+	struct passwd * passwdPtr = NULL;
+
+	char * endPtr = NULL;
+
+	int isValid = 0;
+
+
+
+	/*============================================
+	 SECTION 2: Finding which predicate it is
+	=============================================*/
+	if (value != NULL && value[1] != '\0')
+	{
+		nameLength = value - predicate;
+
+		value++;
+
+		for (size_t index = 0;
+		     index < NUM_FILTER_PREDICATE_DESCRIPTORS; index++)
+		{
+			descriptorPtr = &filterPredicateDescriptors[index];
+
+			if (strlen(descriptorPtr->predicateName) == nameLength
+			    && strncmp(descriptorPtr->predicateName,
+				       predicate, nameLength) == 0)
+			{
+				newPredicate = descriptorPtr->predicate;
+
+				newStatxBits = descriptorPtr->statxBits;
+			}
+		}
+	}
+
+	if (newPredicate != 0
+	    && (filterPtr->predicates & newPredicate) != 0)
+	{
+		fprintf(stderr, "myls: Filter predicate '%.*s' "
+			"given twice\n", (int) nameLength, predicate);
+
+		return -1;
+	}
+
+
+
+	/*============================================
+	 SECTION 3: Compiling its value
+	=============================================*/
+	switch (newPredicate)
+	{
+		case FILTER_NAME:
+			filterPtr->nameGlob = value;
+
+			isValid = 1;
+
+			break;
+
+		case FILTER_REGEX:
+			isValid = (regcomp(&filterPtr->nameRegex, value,
+					   REG_EXTENDED | REG_NOSUB) == 0);
+
+			break;
+
+		case FILTER_TYPE:
+			filterPtr->typeMask = 0;
+
+			for (isValid = 1; *value != '\0' && isValid; value++)
+			{
+				letterPtr = strchr(typeLetters, *value);
+
+				isValid = (letterPtr != NULL);
+
+				if (isValid)
+				{
+					filterPtr->typeMask |= 1u << direntTypes[
+						letterPtr - typeLetters];
+				}
+			}
+
+			break;
+
+		case FILTER_SIZE:
+			isValid = (parseFilterRange(value, sizeSuffixes,
+						    sizeMultipliers, 0,
+						    &filterPtr->minSize,
+						    &filterPtr->maxSize) == 0);
+
+			break;
+
+		case FILTER_MTIME:
+		case FILTER_CTIME:
+			isValid = (parseFilterRange(value, ageSuffixes,
+						    ageMultipliers, 1,
+						    &minValue,
+						    &maxValue) == 0);
+
+			if (isValid && newPredicate == FILTER_MTIME)
+			{
+				filterPtr->minModAge = minValue;
+
+				filterPtr->maxModAge = maxValue;
+			}
+			else if (isValid)
+			{
+				filterPtr->minChgAge = minValue;
+
+				filterPtr->maxChgAge = maxValue;
+			}
+
+			break;
+
+		case FILTER_UID:
+			//A number that fits a uid_t, or else a
+			// user name
+			errno = 0;
+
+			userNumber = strtoull(value, &endPtr, 10);
+
+			isValid = (errno == 0 && *endPtr == '\0'
+				   && value[0] != '-'
+				   && userNumber <= UINT32_MAX);
+
+			if (isValid)
+			{
+				filterPtr->userId = (uid_t) userNumber;
+			}
+
+			if (!isValid)
+			{
+				passwdPtr = getpwnam(value);
+
+				isValid = (passwdPtr != NULL);
+
+				if (isValid)
+				{
+					filterPtr->userId = passwdPtr->pw_uid;
+				}
+			}
+
+			break;
+	}
+
+
+	if (!isValid)
+	{
+		fprintf(stderr, "myls: Invalid filter predicate '%s'\n",
+			predicate);
+
+		return -1;
+	}
+
+
+	filterPtr->predicates |= newPredicate;
+
+	*statxMask |= newStatxBits;
+
+
+	return 0;
+}
+
+
+/*---------------------------------------------------------*/
+
+int parseFilterRange(const char * rangeText,
+		     const char * unitSuffixes,
+		     const uint64_t * unitMultipliers,
+		     int isUpperBound,
+		     uint64_t * minValue, uint64_t * maxValue)
+{
+
+	const char * rangeEnd = strstr(rangeText, "..");
+
+	const char * textPtr = rangeText;
+
+	uint64_t * boundPtr = minValue;
+
+	const char * suffixPtr = NULL;
+
+	char * endPtr = NULL;
+
+
+
+	*minValue = 0;
+
+	*maxValue = UINT64_MAX;
+
+	//A range needs at least one end
+	if (rangeEnd != NULL && rangeEnd == rangeText
+	    && rangeEnd[2] == '\0')
+	{
+		return -1;
+	}
+
+
+	/*============================================
+	 Each end present is read in turn: the
+	 minimum up to the '..', then the maximum
+	 after it
+	=============================================*/
+	while (textPtr != NULL)
+	{
+		if (textPtr != rangeEnd && *textPtr != '\0')
+		{
+			if (*textPtr < '0' || *textPtr > '9')
+			{
+				return -1;
+			}
+
+			errno = 0;
+
+			*boundPtr = strtoull(textPtr, &endPtr, 10);
+
+			if (errno != 0)
+			{
+				return -1;
+			}
+
+			if (*endPtr != '\0' && endPtr != rangeEnd)
+			{
+				suffixPtr = strchr(unitSuffixes, *endPtr);
+
+				if (suffixPtr == NULL || *suffixPtr == '\0'
+				    || *boundPtr > UINT64_MAX
+				       / unitMultipliers[suffixPtr
+							 - unitSuffixes])
+				{
+					return -1;
+				}
+
+				*boundPtr *= unitMultipliers[suffixPtr
+							     - unitSuffixes];
+
+				endPtr++;
+			}
+
+			if (*endPtr != '\0' && endPtr != rangeEnd)
+			{
+				return -1;
+			}
+		}
+
+
+		if (rangeEnd == NULL)
+		{
+			//A single value
+			if (isUpperBound)
+			{
+				*maxValue = *minValue;
+
+				*minValue = 0;
+			}
+			else
+			{
+				*maxValue = *minValue;
+			}
+
+			textPtr = NULL;
+		}
+		else if (boundPtr == minValue)
+		{
+			textPtr = rangeEnd + 2;
+
+			boundPtr = maxValue;
+		}
+		else
+		{
+			textPtr = NULL;
+		}
+	}
+
+
+	return (*minValue <= *maxValue) ? 0 : -1;
+}
+
+
+/*---------------------------------------------------------*/
+
+void convertAgeRange(uint64_t minAge, uint64_t maxAge,
+		     time_t now,
+		     int64_t * minTime, int64_t * maxTime)
+{
+	//Ages beyond the range of a time_t reach
+	// back without limit
+	*minTime = (maxAge > (uint64_t) INT64_MAX / 2)
+		   ? INT64_MIN : (int64_t) now - (int64_t) maxAge;
+
+	*maxTime = (minAge > (uint64_t) INT64_MAX / 2)
+		   ? INT64_MIN : (int64_t) now - (int64_t) minAge;
+
+	//An age of 0 also takes in times ahead of the
+	// clock, e.g. from another machine's
+	if (minAge == 0)
+	{
+		*maxTime = INT64_MAX;
+	}
+}
+
+
+/*---------------------------------------------------------*/
+
+void updateFilterTimes(struct EntryFilter * filterPtr)
+{
+	time_t now = time(NULL);
+
+
+	if (filterPtr->predicates & FILTER_MTIME)
+	{
+		convertAgeRange(filterPtr->minModAge, filterPtr->maxModAge,
+				now, &filterPtr->minModTime,
+				&filterPtr->maxModTime);
+	}
+
+	if (filterPtr->predicates & FILTER_CTIME)
+	{
+		convertAgeRange(filterPtr->minChgAge, filterPtr->maxChgAge,
+				now, &filterPtr->minChgTime,
+				&filterPtr->maxChgTime);
+	}
+}
+
+
+/*---------------------------------------------------------*/
+
+int matchEntryName(const char * fileName,
+		   unsigned char direntType)
+{
+	unsigned int predicates = entryFilter.predicates;
+
+
+	//The cheapest first. An unknown type is left
+	// to matchEntryStat()
+	if ((predicates & FILTER_TYPE) && direntType != DT_UNKNOWN
+	    && (entryFilter.typeMask & (1u << direntType)) == 0)
+	{
+		return 0;
+	}
+
+	if ((predicates & FILTER_NAME)
+	    && fnmatch(entryFilter.nameGlob, fileName, 0) != 0)
+	{
+		return 0;
+	}
+
+	if ((predicates & FILTER_REGEX)
+	    && regexec(&entryFilter.nameRegex, fileName,
+		       0, NULL, 0) != 0)
+	{
+		return 0;
+	}
+
+
+	return 1;
+}
+
+
+/*---------------------------------------------------------*/
+
+int matchEntryStat(const struct stat * statBuf)
+{
+	unsigned int predicates = entryFilter.predicates;
+
+
+	if ((predicates & FILTER_TYPE)
+	    && (entryFilter.typeMask
+		& (1u << IFTODT(statBuf->st_mode))) == 0)
+	{
+		return 0;
+	}
+
+	if ((predicates & FILTER_SIZE)
+	    && ((uint64_t) statBuf->st_size < entryFilter.minSize
+		|| (uint64_t) statBuf->st_size > entryFilter.maxSize))
+	{
+		return 0;
+	}
+
+	if ((predicates & FILTER_MTIME)
+	    && (statBuf->st_mtim.tv_sec < entryFilter.minModTime
+		|| statBuf->st_mtim.tv_sec > entryFilter.maxModTime))
+	{
+		return 0;
+	}
+
+	if ((predicates & FILTER_CTIME)
+	    && (statBuf->st_ctim.tv_sec < entryFilter.minChgTime
+		|| statBuf->st_ctim.tv_sec > entryFilter.maxChgTime))
+	{
+		return 0;
+	}
+
+	if ((predicates & FILTER_UID)
+	    && statBuf->st_uid != entryFilter.userId)
+	{
+		return 0;
+	}
+
+
+	return 1;
+}
+
+
+
+/*---------------------------------------------------------*/
+
+const char * lookupUserName(uid_t userId)
+{
+
+	struct NameCacheSlot * slotPtr = NULL;
+
+	const char * cachedName = NULL;
+
+	struct passwd passwdBuf;
+
+	struct passwd * passwdPtr = NULL;
+
+	char * lookupBuffer = NULL;
+
+	char * nameCopy = NULL;
+
+	long lookupBufferSize;
+
+	int lookupReturnValue;
+
+
+
+	/*=============================================
+	 SECTION 1: Checking the cache
+
+	 The lock is held until the function returns,
+	 so that concurrent misses on the same id
+	 only look it up once
+	==============================================*/
+	pthread_mutex_lock(&userNameCache.lock);
+
+	slotPtr = findNameCacheSlot(&userNameCache, userId);
+
+	if (slotPtr == NULL)
+	{
+		pthread_mutex_unlock(&userNameCache.lock);
+
+		return NAME_NOT_AVAILABLE;
+	}
+
+	if (slotPtr->isUsed)
+	{
+		userNameCache.numHits++;
+
+		cachedName = slotPtr->name;
+
+		pthread_mutex_unlock(&userNameCache.lock);
+
+		return (cachedName != NULL) ? cachedName
+					    : NAME_NOT_AVAILABLE;
+	}
+
+	userNameCache.numMisses++;
+
+
+
+	/*=============================================
+	 SECTION 2: Looking the name up with the
+		    reentrant getpwuid_r(), growing the
+		    buffer while it reports ERANGE
+	==============================================*/
+	lookupBufferSize = sysconf(_SC_GETPW_R_SIZE_MAX);
+
+	if (lookupBufferSize <= 0)
+	{
+		lookupBufferSize = MAX_STRING_SIZE;
+	}
+
+
+	do
+	{
+		free(lookupBuffer);
+
+		lookupBuffer = malloc(lookupBufferSize);
+
+		if (lookupBuffer == NULL)
+		{
+			pthread_mutex_unlock(&userNameCache.lock);
+
+			return NAME_NOT_AVAILABLE;
+		}
+
+		lookupReturnValue = getpwuid_r(userId, &passwdBuf,
+					       lookupBuffer,
+					       lookupBufferSize,
+					       &passwdPtr);
+
+		lookupBufferSize *= 2;
+
+	} while (lookupReturnValue == ERANGE);
+
+
+
+	/*=============================================
+	 SECTION 3: Storing the result in the cache
+
+	 A user that does not exist is stored too,
+	 with no name, but not a lookup that failed,
+	 e.g. for want of memory or with the name
+	 service down, as the next may succeed
+	==============================================*/
+	if (lookupReturnValue == 0 && passwdPtr != NULL)
+	{
+		nameCopy = strdup(passwdPtr->pw_name);
+	}
+
+	free(lookupBuffer);
+
+	if (lookupReturnValue != 0
+	    || (passwdPtr != NULL && nameCopy == NULL))
+	{
+		pthread_mutex_unlock(&userNameCache.lock);
+
+		return NAME_NOT_AVAILABLE;
+	}
+
+
+	slotPtr->id = userId;
+
+	slotPtr->isUsed = 1;
+
+	slotPtr->name = nameCopy;
+
+	userNameCache.numUsedSlots++;
+
+
+	cachedName = slotPtr->name;
+
+	//The slot may move once the lock is released,
+	// but the name it points to does not
+	pthread_mutex_unlock(&userNameCache.lock);
+
+	return (cachedName != NULL) ? cachedName
+				    : NAME_NOT_AVAILABLE;
+}
+
+
+
+/*---------------------------------------------------------*/
+
+const char * lookupGroupName(gid_t groupId)
+{
+
+	struct NameCacheSlot * slotPtr = NULL;
+
+	const char * cachedName = NULL;
+
+	struct group groupBuf;
+
+	struct group * groupPtr = NULL;
+
+	char * lookupBuffer = NULL;
+
+	char * nameCopy = NULL;
+
+	long lookupBufferSize;
+
+	int lookupReturnValue;
+
+
+
+	/*=============================================
+	 SECTION 1: Checking the cache
+
+	 The lock is held until the function returns,
+	 so that concurrent misses on the same id
+	 only look it up once
+	==============================================*/
+	pthread_mutex_lock(&groupNameCache.lock);
+
+	slotPtr = findNameCacheSlot(&groupNameCache, groupId);
+
+	if (slotPtr == NULL)
+	{
+		pthread_mutex_unlock(&groupNameCache.lock);
+
+		return NAME_NOT_AVAILABLE;
+	}
+
+	if (slotPtr->isUsed)
+	{
+		groupNameCache.numHits++;
+
+		cachedName = slotPtr->name;
+
+		pthread_mutex_unlock(&groupNameCache.lock);
+
+		return (cachedName != NULL) ? cachedName
+					    : NAME_NOT_AVAILABLE;
+	}
+
+	groupNameCache.numMisses++;
+
+
+
+	/*=============================================
+	 SECTION 2: Looking the name up with the
+		    reentrant getgrgid_r(), growing the
+		    buffer while it reports ERANGE. Groups
+		    with many members need large buffers
+	==============================================*/
+	lookupBufferSize = sysconf(_SC_GETGR_R_SIZE_MAX);
+
+	if (lookupBufferSize <= 0)
+	{
+		lookupBufferSize = MAX_STRING_SIZE;
+	}
+
+
+	do
+	{
+		free(lookupBuffer);
+
+		lookupBuffer = malloc(lookupBufferSize);
+
+		if (lookupBuffer == NULL)
+		{
+			pthread_mutex_unlock(&groupNameCache.lock);
+
+			return NAME_NOT_AVAILABLE;
+		}
+
+		lookupReturnValue = getgrgid_r(groupId, &groupBuf,
+					       lookupBuffer,
+					       lookupBufferSize,
+					       &groupPtr);
+
+		lookupBufferSize *= 2;
+
+	} while (lookupReturnValue == ERANGE);
+
+
+
+	/*=============================================
+	 SECTION 3: Storing the result in the cache
+
+	 A group that does not exist is stored too,
+	 with no name, but not a lookup that failed,
+	 e.g. for want of memory or with the name
+	 service down, as the next may succeed
+	==============================================*/
+	if (lookupReturnValue == 0 && groupPtr != NULL)
+	{
+		nameCopy = strdup(groupPtr->gr_name);
+	}
+
+	free(lookupBuffer);
+
+	if (lookupReturnValue != 0
+	    || (groupPtr != NULL && nameCopy == NULL))
+	{
+		pthread_mutex_unlock(&groupNameCache.lock);
+
+		return NAME_NOT_AVAILABLE;
+	}
+
+
+	slotPtr->id = groupId;
+
+	slotPtr->isUsed = 1;
+
+	slotPtr->name = nameCopy;
+
+	groupNameCache.numUsedSlots++;
+
+
+	cachedName = slotPtr->name;
+
+	//The slot may move once the lock is released,
+	// but the name it points to does not
+	pthread_mutex_unlock(&groupNameCache.lock);
+
+	return (cachedName != NULL) ? cachedName
+				    : NAME_NOT_AVAILABLE;
+}
+
+
+
+/*---------------------------------------------------------*/
+
+static inline size_t hashNameCacheId(unsigned int id,
+				     size_t numSlots)
+{
+	//Fibonacci hashing spreads the small,
+	// consecutive ids that are typical of
+	// users and groups across the table
+	return (size_t) ((id * 2654435761u) & (numSlots - 1));
+}
+
+
+/*---------------------------------------------------------*/
+
+struct NameCacheSlot * findNameCacheSlot(
+				struct NameCache * cache,
+				unsigned int id)
+{
+
+	struct NameCacheSlot * oldSlots = NULL;
+
+	size_t oldNumSlots;
+
+	size_t slotIndex;
+
+
+
+	/*=============================================
+	 SECTION 1: Allocating or growing the table
+
+	 The table is kept at most half full so that
+	 probe sequences stay short. When it grows,
+	 every used slot is re-inserted
+	==============================================*/
+	if (cache->slots == NULL
+	    || (cache->numUsedSlots + 1) * 2 > cache->numSlots)
+	{
+		oldSlots = cache->slots;
+
+		oldNumSlots = cache->numSlots;
+
+		cache->numSlots = (oldSlots == NULL)
+				  ? INITIAL_NAME_CACHE_SLOTS
+				  : oldNumSlots * 2;
+
+		cache->slots = calloc(cache->numSlots,
+				      sizeof(*cache->slots));
+
+		if (cache->slots == NULL)
+		{
+			cache->slots = oldSlots;
+
+			cache->numSlots = oldNumSlots;
+
+			return NULL;
+		}
+
+
+		for (size_t index = 0; index < oldNumSlots; index++)
+		{
+			if (!oldSlots[index].isUsed)
+			{
+				continue;
+			}
+
+			slotIndex = hashNameCacheId(oldSlots[index].id,
+						    cache->numSlots);
+
+			while (cache->slots[slotIndex].isUsed)
+			{
+				slotIndex = (slotIndex + 1)
+					    & (cache->numSlots - 1);
+			}
+
+			cache->slots[slotIndex] = oldSlots[index];
+		}
+
+		free(oldSlots);
+	}
+
+
+
+	/*=============================================
+	 SECTION 2: Linear probing until either 'id'
+		    or an empty slot is found
+	==============================================*/
+	slotIndex = hashNameCacheId(id, cache->numSlots);
+
+	while (cache->slots[slotIndex].isUsed
+	       && cache->slots[slotIndex].id != id)
+	{
+		slotIndex = (slotIndex + 1) & (cache->numSlots - 1);
+	}
+
+
+	return &cache->slots[slotIndex];
+}
+
+
+
+/*---------------------------------------------------------*/
+
+void printNameCacheStats()
+{
+	fprintf(stderr,
+		"myls: user name cache: %lu hits, %lu misses\n"
+		"myls: group name cache: %lu hits, %lu misses\n",
+		userNameCache.numHits, userNameCache.numMisses,
+		groupNameCache.numHits, groupNameCache.numMisses);
+}
+
+
+
+/*---------------------------------------------------------*/
+
+void mergeStageTimings()
+{
+	struct StageHistogram * sharedPtr = NULL;
+
+	struct StageHistogram * threadPtr = NULL;
+
+
+	if (!printStats)
+	{
+		return;
+	}
+
+	pthread_mutex_lock(&stageTimingsLock);
+
+	for (int stage = 0; stage < NUM_TIMED_STAGES; stage++)
+	{
+		sharedPtr = &stageTimings[stage];
+
+		threadPtr = &threadStageTimings[stage];
+
+		sharedPtr->numCalls += threadPtr->numCalls;
+
+		sharedPtr->totalNanoseconds += threadPtr->totalNanoseconds;
+
+		for (int bucket = 0; bucket < STAGE_HISTOGRAM_BUCKETS;
+		     bucket++)
+		{
+			sharedPtr->bucketCounts[bucket] +=
+				threadPtr->bucketCounts[bucket];
+		}
+
+		memset(threadPtr, 0, sizeof(*threadPtr));
+	}
+
+	pthread_mutex_unlock(&stageTimingsLock);
+}
+
+
+
+/*---------------------------------------------------------*/
+
+unsigned long long getStagePercentile(
+			const struct StageHistogram * histogramPtr,
+			unsigned int percentile)
+{
+	unsigned long rank;
+
+	unsigned long numSeen = 0;
+
+	int bucket;
+
+	int topBit;
+
+	int subBucket;
+
+
+	//The rank of the percentile among the calls,
+	// rounded up, counting from 1
+	rank = (histogramPtr->numCalls * percentile + 99) / 100;
+
+	if (rank == 0)
+	{
+		return 0;
+	}
+
+	for (bucket = 0; bucket < STAGE_HISTOGRAM_BUCKETS - 1; bucket++)
+	{
+		numSeen += histogramPtr->bucketCounts[bucket];
+
+		if (numSeen >= rank)
+		{
+			break;
+		}
+	}
+
+
+	//The inverse of the mapping in stopStageTimer()
+	if (bucket < (1 << STAGE_HISTOGRAM_SUB_BITS))
+	{
+		return bucket + 1;
+	}
+
+	topBit = (bucket >> STAGE_HISTOGRAM_SUB_BITS)
+		 + STAGE_HISTOGRAM_SUB_BITS - 1;
+
+	subBucket = bucket & ((1 << STAGE_HISTOGRAM_SUB_BITS) - 1);
+
+	return (1ULL << topBit)
+	       + ((unsigned long long) (subBucket + 1)
+		  << (topBit - STAGE_HISTOGRAM_SUB_BITS));
+}
+
+
+
+/*---------------------------------------------------------*/
+
+void printStageTimings()
+{
+	const struct StageHistogram * histogramPtr = NULL;
+
+
+	mergeStageTimings();
+
+	fprintf(stderr, "myls: %-10s %10s %12s %10s %10s\n",
+		"stage", "calls", "total ms", "p50 ns", "p99 ns");
+
+
+	for (int stage = 0; stage < NUM_TIMED_STAGES; stage++)
+	{
+		histogramPtr = &stageTimings[stage];
+
+		if (histogramPtr->numCalls == 0)
+		{
+			continue;
+		}
+
+		fprintf(stderr, "myls: %-10s %10lu %12.3f %10llu %10llu\n",
+			timedStageNames[stage], histogramPtr->numCalls,
+			histogramPtr->totalNanoseconds / 1e6,
+			getStagePercentile(histogramPtr, 50),
+			getStagePercentile(histogramPtr, 99));
+	}
+}
+
+
+
+/*---------------------------------------------------------*/
+
+void addToSummary(const char * fileName,
+		  const struct stat * statBuf)
+{
+
+	/*============================================
+	 SECTION 1: Declaration of variables
+	=============================================*/
+
+	struct SummaryTotals * totalsPtr = &threadSummary;
+
+	int typeIndex = (statBuf->st_mode & S_IFMT) >> FILE_TYPE_SHIFT;
+
+	uint64_t fileSize = (uint64_t) statBuf->st_size;
+
+	int64_t modAge = (int64_t) summaryStartTime
+			 - statBuf->st_mtim.tv_sec;
+
+	size_t bucket = 0;
+
+	char * path = NULL;
+
+
+
+	/*============================================
+	 SECTION 2: Leaving out other names of an
+		    inode already counted. Directories
+		    are never linked twice, their link
+		    count being their subdirectories
+		    instead. Should the set fail to
+		    grow, the name is counted
+	=============================================*/
+	if (statBuf->st_nlink > 1 && !S_ISDIR(statBuf->st_mode)
+	    && insertInodeKey(&linkedInodes, statBuf->st_dev,
+			      statBuf->st_ino) == 0)
+	{
+		totalsPtr->numLinksSkipped++;
+
+		return;
+	}
+
+
+
+	/*============================================
+	 SECTION 3: Adding the entry up
+	=============================================*/
+	totalsPtr->numEntries++;
+
+	totalsPtr->numBytes += fileSize;
+
+	totalsPtr->typeEntries[typeIndex]++;
+
+	totalsPtr->typeBytes[typeIndex] += fileSize;
+
+
+	while (bucket + 1 < NUM_SUMMARY_AGE_BUCKETS
+	       && modAge >= summaryAgeBuckets[bucket].maxAge)
+	{
+		bucket++;
+	}
+
+	totalsPtr->ageEntries[bucket]++;
+
+	totalsPtr->ageBytes[bucket] += fileSize;
+
+
+
+	/*============================================
+	 SECTION 4: Offering a regular file to the
+		    largest files. Its path is only
+		    built if it could be kept, which
+		    for a file as large as the smallest
+		    kept depends on the path
+	=============================================*/
+	if (!S_ISREG(statBuf->st_mode)
+	    || listingOptions.summaryTopCount == 0
+	    || (totalsPtr->numLargestFiles
+		  >= listingOptions.summaryTopCount
+		&& fileSize < totalsPtr->largestFiles[0].fileSize))
+	{
+		return;
+	}
+
+	path = buildListedPath(fileName);
+
+	offerLargestFile(totalsPtr, fileSize, path);
+}
+
+
+/*---------------------------------------------------------*/
+
+char * buildListedPath(const char * fileName)
+{
+
+	size_t dirPathLength;
+
+	int needsSlash;
+
+	char * path = NULL;
+
+
+
+	if (listedDirPath == NULL)
+	{
+		return strdup(fileName);
+	}
+
+
+	dirPathLength = strlen(listedDirPath);
+
+	needsSlash = dirPathLength > 0
+		     && listedDirPath[dirPathLength - 1] != '/';
+
+	path = malloc(dirPathLength + needsSlash + strlen(fileName) + 1);
+
+	if (path != NULL)
+	{
+		memcpy(path, listedDirPath, dirPathLength);
+
+		path[dirPathLength] = '/';
+
+		strcpy(path + dirPathLength + needsSlash, fileName);
+	}
+
+
+	return path;
+}
+
+
+/*---------------------------------------------------------*/
+
+static inline uint32_t packDeviceId(dev_t deviceId)
+{
+	//The kernel numbers devices with 12 bits of
+	// major and 20 of minor number, so no device
+	// number it reports is lost
+	return (uint32_t) (gnu_dev_major(deviceId) << 20)
+	       | (uint32_t) (gnu_dev_minor(deviceId) & 0xFFFFF);
+}
+
+
+/*---------------------------------------------------------*/
+
+static inline size_t hashInodeKey(uint64_t inode, uint32_t device,
+				  size_t numSlots)
+{
+	uint64_t hash = (inode ^ ((uint64_t) device << 32))
+			* 0x9E3779B97F4A7C15ULL;
+
+
+	return (size_t) (hash >> 32) & (numSlots - 1);
+}
+
+
+/*---------------------------------------------------------*/
+
+static inline size_t getInodeKeyDistance(const struct InodeKey * slots,
+					 size_t numSlots, size_t slotIndex)
+{
+	size_t homeIndex = hashInodeKey(slots[slotIndex].inode,
+					slots[slotIndex].device, numSlots);
+
+
+	return (slotIndex - homeIndex) & (numSlots - 1);
+}
+
+
+/*---------------------------------------------------------*/
+
+int insertInodeKey(struct InodeSet * setPtr,
+		   dev_t deviceId, ino_t inodeNum)
+{
+
+	struct InodeKey * keyPtr = NULL;
+
+	int isNew = 0;
+
+
+
+	pthread_mutex_lock(&setPtr->lock);
+
+	keyPtr = findInodeKey(setPtr, deviceId, inodeNum, &isNew);
+
+	pthread_mutex_unlock(&setPtr->lock);
+
+
+	if (keyPtr == NULL)
+	{
+		return -1;
+	}
+
+	return isNew;
+}
+
+
+/*---------------------------------------------------------*/
+
+struct InodeKey * findInodeKey(struct InodeSet * setPtr,
+			       dev_t deviceId, ino_t inodeNum,
+			       int * isNew)
+{
+
+	struct InodeKey * newSlots = NULL;
+
+	struct InodeKey * keyPtr = NULL;
+
+	struct InodeKey newKey;
+
+	uint32_t device = packDeviceId(deviceId);
+
+	uint64_t inode = (uint64_t) inodeNum;
+
+	size_t newNumSlots;
+
+	size_t slotIndex;
+
+
+
+	/*============================================
+	 SECTION 1: Growing the table past seven
+		    eighths full, placing every key
+		    again in the new one
+	=============================================*/
+	if ((setPtr->numUsed + 1) * 8 > setPtr->numSlots * 7)
+	{
+		newNumSlots = (setPtr->numSlots > 0)
+			      ? setPtr->numSlots * 2 : 1024;
+
+		newSlots = calloc(newNumSlots, sizeof(*newSlots));
+
+		if (newSlots == NULL)
+		{
+			return NULL;
+		}
+
+		for (size_t index = 0; index < setPtr->numSlots; index++)
+		{
+			if (setPtr->slots[index].inode != 0)
+			{
+				placeInodeKey(newSlots, newNumSlots,
+					      setPtr->slots[index]);
+			}
+		}
+
+		free(setPtr->slots);
+
+		setPtr->slots = newSlots;
+
+		setPtr->numSlots = newNumSlots;
+	}
+
+
+
+	/*============================================
+	 SECTION 2: Probing for the key. It is not
+		    there once the probe meets an
+		    empty slot, or a key nearer its
+		    own first slot than the key would
+		    be to its own
+	=============================================*/
+	slotIndex = hashInodeKey(inode, device, setPtr->numSlots);
+
+	for (size_t distance = 0; setPtr->slots[slotIndex].inode != 0;
+	     distance++)
+	{
+		keyPtr = &setPtr->slots[slotIndex];
+
+		if (keyPtr->inode == inode && keyPtr->device == device)
+		{
+			if (isNew != NULL)
+			{
+				*isNew = 0;
+			}
+
+			return keyPtr;
+		}
+
+		if (getInodeKeyDistance(setPtr->slots, setPtr->numSlots,
+					slotIndex) < distance)
+		{
+			break;
+		}
+
+		slotIndex = (slotIndex + 1) & (setPtr->numSlots - 1);
+	}
+
+
+
+	/*============================================
+	 SECTION 3: Adding the key, with no name yet
+	=============================================*/
+	newKey.inode = inode;
+
+	newKey.device = device;
+
+	newKey.lastName = 0;
+
+	keyPtr = placeInodeKey(setPtr->slots, setPtr->numSlots, newKey);
+
+	setPtr->numUsed++;
+
+	if (isNew != NULL)
+	{
+		*isNew = 1;
+	}
+
+
+	return keyPtr;
+}
+
+
+/*---------------------------------------------------------*/
+
+struct InodeKey * placeInodeKey(struct InodeKey * slots,
+				size_t numSlots, struct InodeKey newKey)
+{
+
+	struct InodeKey * placedPtr = NULL;
+
+	struct InodeKey residentKey;
+
+	size_t slotIndex = hashInodeKey(newKey.inode, newKey.device,
+					numSlots);
+
+	size_t distance = 0;
+
+	size_t residentDistance;
+
+
+
+	while (slots[slotIndex].inode != 0)
+	{
+		residentDistance = getInodeKeyDistance(slots, numSlots,
+						       slotIndex);
+
+		//A key nearer its first slot than the one
+		// being placed gives its slot up, and is
+		// the one placed further on
+		if (residentDistance < distance)
+		{
+			residentKey = slots[slotIndex];
+
+			slots[slotIndex] = newKey;
+
+			if (placedPtr == NULL)
+			{
+				placedPtr = &slots[slotIndex];
+			}
+
+			newKey = residentKey;
+
+			distance = residentDistance;
+		}
+
+		slotIndex = (slotIndex + 1) & (numSlots - 1);
+
+		distance++;
+	}
+
+	slots[slotIndex] = newKey;
+
+
+	return (placedPtr != NULL) ? placedPtr : &slots[slotIndex];
+}
+
+
+/*---------------------------------------------------------*/
+
+void addLinkedName(const char * fileName,
+		   const struct stat * statBuf)
+{
+
+	struct InodeKey * keyPtr = NULL;
+
+	struct LinkedName * newNames = NULL;
+
+	struct LinkedName * namePtr = NULL;
+
+	size_t newMaxNames;
+
+	char * path = NULL;
+
+
+
+	//Directories are never linked twice, their
+	// link count being their subdirectories
+	// instead
+	if (statBuf->st_nlink < 2 || S_ISDIR(statBuf->st_mode))
+	{
+		return;
+	}
+
+	path = buildListedPath(fileName);
+
+
+	pthread_mutex_lock(&linkGroups.inodes.lock);
+
+
+	/*============================================
+	 SECTION 1: Making room for the name, whose
+		    index + 1 must fit in the 32 bits
+		    of 'lastName'
+	=============================================*/
+	if (path != NULL && linkGroups.numNames == linkGroups.maxNames)
+	{
+		newMaxNames = (linkGroups.maxNames > 0)
+			      ? linkGroups.maxNames * 2 : 1024;
+
+		if (newMaxNames < UINT32_MAX)
+		{
+			newNames = realloc(linkGroups.names,
+					   newMaxNames * sizeof(*newNames));
+		}
+
+		if (newNames != NULL)
+		{
+			linkGroups.names = newNames;
+
+			linkGroups.maxNames = newMaxNames;
+		}
+	}
+
+	if (path != NULL && linkGroups.numNames < linkGroups.maxNames)
+	{
+		keyPtr = findInodeKey(&linkGroups.inodes, statBuf->st_dev,
+				      statBuf->st_ino, NULL);
+	}
+
+	if (keyPtr == NULL)
+	{
+		linkGroups.isIncomplete = 1;
+
+		pthread_mutex_unlock(&linkGroups.inodes.lock);
+
+		free(path);
+
+		return;
+	}
+
+
+
+	/*============================================
+	 SECTION 2: Chaining the name to the names
+		    found before of its inode
+	=============================================*/
+	namePtr = &linkGroups.names[linkGroups.numNames];
+
+	namePtr->path = path;
+
+	namePtr->previousName = keyPtr->lastName;
+
+	namePtr->numLinks = (uint32_t) statBuf->st_nlink;
+
+	linkGroups.numNames++;
+
+	keyPtr->lastName = (uint32_t) linkGroups.numNames;
+
+
+	pthread_mutex_unlock(&linkGroups.inodes.lock);
+}
+
+
+/*---------------------------------------------------------*/
+
+static int compareLinkedPaths(const void * firstPtr,
+			      const void * secondPtr)
+{
+	return strcmp(*(char * const *) firstPtr,
+		      *(char * const *) secondPtr);
+}
+
+
+/*---------------------------------------------------------*/
+
+static int compareLinkedFiles(const void * firstPtr,
+			      const void * secondPtr)
+{
+	const struct LinkedFile * firstFile = firstPtr;
+
+	const struct LinkedFile * secondFile = secondPtr;
+
+
+	//By their first name, as their names are
+	// sorted
+	return strcmp(firstFile->paths[0], secondFile->paths[0]);
+}
+
+
+/*---------------------------------------------------------*/
+
+void writeLinkGroups(struct OutputBuffer * outBuffer)
+{
+
+	/*============================================
+	 SECTION 1: Declaration of variables
+	=============================================*/
+
+	int isJson = (listingOptions.outputFormat == FORMAT_JSONL);
+
+	struct InodeKey * keyPtr = NULL;
+
+	struct LinkedName * namePtr = NULL;
+
+	struct LinkedFile * files = NULL;
+
+	struct LinkedFile * filePtr = NULL;
+
+	char ** paths = NULL;
+
+	size_t numFiles = 0;
+
+	size_t numPaths = 0;
+
+	size_t numSlots;
+
+	size_t firstPath;
+
+	uint32_t nameIndex;
+
+
+
+	/*============================================
+	 SECTION 2: Gathering the inodes found by
+		    more than one name, each with its
+		    names in order
+	=============================================*/
+	files = malloc((linkGroups.inodes.numUsed + 1) * sizeof(*files));
+
+	paths = malloc((linkGroups.numNames + 1) * sizeof(*paths));
+
+	//Without them, nothing is written
+	numSlots = linkGroups.inodes.numSlots;
+
+	if (files == NULL || paths == NULL)
+	{
+		perror("myls");
+
+		numSlots = 0;
 	}
 
-	
+	for (size_t index = 0; index < numSlots; index++)
+	{
+		keyPtr = &linkGroups.inodes.slots[index];
 
+		if (keyPtr->lastName == 0
+		    || linkGroups.names[keyPtr->lastName - 1]
+			   .previousName == 0)
+		{
+			continue;
+		}
 
-	/*------------------------------------
-	Part (b)(i)  Values that are retrieved
-	 directly
-	-----------------------------------*/
-	fileSize = statBuf.st_size;
-	
-	inodeNum = statBuf.st_ino;
+		firstPath = numPaths;
 
-	numOfHardLinks = statBuf.st_nlink;
+		for (nameIndex = keyPtr->lastName; nameIndex != 0;
+		     nameIndex = namePtr->previousName)
+		{
+			namePtr = &linkGroups.names[nameIndex - 1];
 
+			paths[numPaths++] = namePtr->path;
+		}
 
-	/*-------------------------------------
-	 Part (b)(ii) Values that require
-	 more processing/library calls
-	--------------------------------------*/
+		qsort(&paths[firstPath], numPaths - firstPath,
+		      sizeof(*paths), compareLinkedPaths);
 
+		filePtr = &files[numFiles++];
 
-	
-	/*---------------------------------------
-	 Part (b)(ii)(i) Retrieving User Name	
+		filePtr->paths = &paths[firstPath];
 
-	 Retrieval of the user name may fail,
-	 so the string 'userName' would be
-	 set to 'Not Available' if it fails.
+		filePtr->numPaths = numPaths - firstPath;
 
-	 Otherwise, 'userName' would contain the
-	 user name of the owner owner
-	-----------------------------------------*/	
-	userId = statBuf.st_uid;
+		filePtr->inode = keyPtr->inode;
+
+		filePtr->device = keyPtr->device;
 
+		filePtr->numLinks =
+			linkGroups.names[keyPtr->lastName - 1].numLinks;
+	}
 
-	if ((passwdPtr = getpwuid(userId)) != NULL)
+	if (numFiles > 0)
 	{
-		strcpy(userName,passwdPtr->pw_name);
-				
+		qsort(files, numFiles, sizeof(*files), compareLinkedFiles);
 	}
-	else
+
+
+
+	/*============================================
+	 SECTION 3: Writing them. The device is
+		    written as its major and minor
+		    numbers, as by the listing
+	=============================================*/
+	for (size_t index = 0; index < numFiles; index++)
 	{
-		strcpy(userName, "Not Available");
-			
+		filePtr = &files[index];
+
+		appendOutputString(outBuffer, isJson
+					      ? "{\"linked\":{\"major\":"
+					      : "\nInode ");
+
+		if (!isJson)
+		{
+			appendOutputUnsigned(outBuffer, filePtr->inode);
+
+			appendOutputString(outBuffer, " on device ");
+		}
+
+		appendOutputUnsigned(outBuffer, filePtr->device >> 20);
+
+		appendOutputString(outBuffer, isJson ? ",\"minor\":" : ":");
+
+		appendOutputUnsigned(outBuffer, filePtr->device & 0xFFFFF);
+
+		if (isJson)
+		{
+			appendOutputString(outBuffer, ",\"inode\":");
+
+			appendOutputUnsigned(outBuffer, filePtr->inode);
+		}
+
+		appendOutputString(outBuffer, isJson ? ",\"links\":" : ", ");
+
+		appendOutputUnsigned(outBuffer, filePtr->numLinks);
+
+		appendOutputString(outBuffer, isJson ? ",\"paths\":["
+						     : " links, listed as:\n");
+
+		for (size_t pathIndex = 0; pathIndex < filePtr->numPaths;
+		     pathIndex++)
+		{
+			if (isJson)
+			{
+				appendOutputString(outBuffer,
+						   (pathIndex > 0) ? "," : "");
+
+				appendJsonString(outBuffer,
+						 filePtr->paths[pathIndex]);
+			}
+			else
+			{
+				appendOutputString(outBuffer, "\t");
+
+				appendOutputString(outBuffer,
+						   filePtr->paths[pathIndex]);
+
+				appendOutputString(outBuffer, "\n");
+			}
+		}
+
+		appendOutputString(outBuffer, isJson ? "]}}\n" : "");
+	}
+
+	if (!isJson)
+	{
+		appendOutputString(outBuffer, "\nFiles listed by more than "
+					      "one name: ");
+
+		appendOutputUnsigned(outBuffer, numFiles);
+
+		appendOutputString(outBuffer, ", by ");
+
+		appendOutputUnsigned(outBuffer, numPaths);
+
+		appendOutputString(outBuffer, " names\n");
+	}
+
+	if (linkGroups.isIncomplete)
+	{
+		fprintf(stderr, "myls: --links: not every name could be "
+			"kept, for lack of memory\n");
+	}
+
+
+
+	/*============================================
+	 SECTION 4: Releasing what --links collected
+	=============================================*/
+	for (size_t index = 0; index < linkGroups.numNames; index++)
+	{
+		free(linkGroups.names[index].path);
+	}
+
+	free(linkGroups.names);
+
+	free(linkGroups.inodes.slots);
+
+	free(files);
+
+	free(paths);
+
+	linkGroups.names = NULL;
+
+	linkGroups.numNames = 0;
+
+	linkGroups.maxNames = 0;
+
+	linkGroups.inodes.slots = NULL;
+
+	linkGroups.inodes.numSlots = 0;
+
+	linkGroups.inodes.numUsed = 0;
+}
+
+
+/*---------------------------------------------------------*/
+
+static inline int isLargerFile(const struct LargestFile * firstFile,
+			       const struct LargestFile * secondFile)
+{
+	//Of files of the same size, the first by path
+	// counts as the larger, so that which are
+	// kept does not depend on the order they are
+	// found in
+	return firstFile->fileSize > secondFile->fileSize
+	       || (firstFile->fileSize == secondFile->fileSize
+		   && strcmp(firstFile->path, secondFile->path) < 0);
+}
+
+
+/*---------------------------------------------------------*/
+
+void offerLargestFile(struct SummaryTotals * totalsPtr,
+		      uint64_t fileSize, char * path)
+{
+
+	struct LargestFile * heap = totalsPtr->largestFiles;
+
+	struct LargestFile newFile = {fileSize, path};
+
+	size_t heapSize = totalsPtr->numLargestFiles;
+
+	size_t index;
+
+	size_t childIndex;
+
+
+
+	if (path == NULL)
+	{
+		return;
+	}
+
+	if (heap == NULL)
+	{
+		heap = malloc(listingOptions.summaryTopCount
+			      * sizeof(*heap));
+
+		if (heap == NULL)
+		{
+			free(path);
+
+			return;
+		}
+
+		totalsPtr->largestFiles = heap;
+	}
+
+
+	/*============================================
+	 Until the heap is full, the file is added at
+	 the bottom and moved up past larger parents.
+	 Once it is, a file larger than the smallest
+	 replaces it at the top and moves down past
+	 smaller children
+	=============================================*/
+	if (heapSize < listingOptions.summaryTopCount)
+	{
+		index = heapSize;
+
+		while (index > 0
+		       && isLargerFile(&heap[(index - 1) / 2], &newFile))
+		{
+			heap[index] = heap[(index - 1) / 2];
+
+			index = (index - 1) / 2;
+		}
+
+		heap[index] = newFile;
+
+		totalsPtr->numLargestFiles++;
+
+		return;
+	}
+
+	if (!isLargerFile(&newFile, &heap[0]))
+	{
+		free(path);
+
+		return;
+	}
+
+	free(heap[0].path);
+
+	index = 0;
+
+	while ((childIndex = index * 2 + 1) < heapSize)
+	{
+		if (childIndex + 1 < heapSize
+		    && isLargerFile(&heap[childIndex],
+				    &heap[childIndex + 1]))
+		{
+			childIndex++;
+		}
+
+		if (!isLargerFile(&newFile, &heap[childIndex]))
+		{
+			break;
+		}
+
+		heap[index] = heap[childIndex];
+
+		index = childIndex;
+	}
+
+	heap[index] = newFile;
+}
+
+
+/*---------------------------------------------------------*/
+
+void mergeSummaryTotals()
+{
+	struct SummaryTotals * totalsPtr = &threadSummary;
+
+
+	pthread_mutex_lock(&summaryTotalsLock);
+
+	summaryTotals.numEntries += totalsPtr->numEntries;
+
+	summaryTotals.numBytes += totalsPtr->numBytes;
+
+	summaryTotals.numLinksSkipped += totalsPtr->numLinksSkipped;
+
+	for (int typeIndex = 0; typeIndex < 16; typeIndex++)
+	{
+		summaryTotals.typeEntries[typeIndex] +=
+			totalsPtr->typeEntries[typeIndex];
+
+		summaryTotals.typeBytes[typeIndex] +=
+			totalsPtr->typeBytes[typeIndex];
+	}
+
+	for (size_t bucket = 0; bucket < NUM_SUMMARY_AGE_BUCKETS;
+	     bucket++)
+	{
+		summaryTotals.ageEntries[bucket] +=
+			totalsPtr->ageEntries[bucket];
+
+		summaryTotals.ageBytes[bucket] +=
+			totalsPtr->ageBytes[bucket];
+	}
+
+	for (size_t index = 0; index < totalsPtr->numLargestFiles;
+	     index++)
+	{
+		offerLargestFile(&summaryTotals,
+				 totalsPtr->largestFiles[index].fileSize,
+				 totalsPtr->largestFiles[index].path);
+	}
+
+	pthread_mutex_unlock(&summaryTotalsLock);
+
+
+	free(totalsPtr->largestFiles);
+
+	memset(totalsPtr, 0, sizeof(*totalsPtr));
+}
+
+
+/*---------------------------------------------------------*/
+
+static int compareLargestFiles(const void * firstPtr,
+			       const void * secondPtr)
+{
+	const struct LargestFile * firstFile = firstPtr;
+
+	const struct LargestFile * secondFile = secondPtr;
+
+
+	//Largest first
+	if (isLargerFile(firstFile, secondFile))
+	{
+		return -1;
 	}
 
+	return isLargerFile(secondFile, firstFile) ? 1 : 0;
+}
+
+
+/*---------------------------------------------------------*/
+
+void writeSummary(struct OutputBuffer * outBuffer)
+{
+
+	/*============================================
+	 SECTION 1: Declaration of variables
+	=============================================*/
+
+	int isJson = (listingOptions.outputFormat == FORMAT_JSONL);
+
+	const char * separator = "";
+
+	const char * label = NULL;
+
+	struct LargestFile * filePtr = NULL;
+
+
+
+	/*============================================
+	 SECTION 2: Taking in this thread's totals,
+		    and ordering the largest files
+	=============================================*/
+	mergeSummaryTotals();
+
+	qsort(summaryTotals.largestFiles, summaryTotals.numLargestFiles,
+	      sizeof(*summaryTotals.largestFiles), compareLargestFiles);
+
+
+
+	/*============================================
+	 SECTION 3: Writing the totals
+	=============================================*/
+	appendOutputString(outBuffer, isJson ? "{\"summary\":{\"entries\":"
+					     : "\nEntries: ");
+
+	appendOutputUnsigned(outBuffer, summaryTotals.numEntries);
+
+	appendOutputString(outBuffer, isJson ? ",\"bytes\":"
+					     : "\nTotal size (bytes): ");
+
+	appendOutputUnsigned(outBuffer, summaryTotals.numBytes);
+
+	appendOutputString(outBuffer, isJson ? ",\"links_skipped\":"
+					     : "\nOther names of linked "
+					       "files, not counted: ");
+
+	appendOutputUnsigned(outBuffer, summaryTotals.numLinksSkipped);
+
+	appendOutputString(outBuffer, isJson ? ",\"types\":[" : "\n");
+
+
+
+	/*============================================
+	 SECTION 4: Writing the types found
+	=============================================*/
+	for (int typeIndex = 0; typeIndex < 16; typeIndex++)
+	{
+		if (summaryTotals.typeEntries[typeIndex] == 0)
+		{
+			continue;
+		}
 
-	/*---------------------------------------
-	 Part(b)(ii)(ii) Retrieving Group Name	
+		if (isJson)
+		{
+			appendOutputString(outBuffer, separator);
 
-	 Retrieval of the group name may fail,
-	 so the string 'groupName' would be
-	 set to 'Not Available' if it fails
+			appendOutputString(outBuffer, "{\"type\":");
 
-	 Otherwise, 'groupName' would contain
-	 the group name of the group owner
-	-----------------------------------------*/
-	groupId = statBuf.st_gid;
+			appendJsonString(outBuffer,
+					 fileTypeTable[typeIndex]);
 
+			appendOutputString(outBuffer, ",\"entries\":");
 
-	if ((groupPtr = getgrgid(groupId)) != NULL)
-	{
-		strcpy(groupName, groupPtr->gr_name);
-			
-	}
-	else
-	{
-		strcpy(groupName, "Not Available");
-	}
-	
-	
+			separator = ",";
+		}
+		else
+		{
+			appendOutputString(outBuffer,
+					   fileTypeTable[typeIndex]);
 
-	/*---------------------------------------
-	 Part(b)(ii)(iii) Retrieving file type
-	 and file access permissions in string	
+			appendOutputString(outBuffer, ": ");
+		}
 
-	 
-	 The variable 'fileTypeAndPermsFlag'
-	 contains the data of file type and file
-	 access permissions in numerical form. 
-	 
-	 Further processing is required to obtain
-	 these data in string form
-	-----------------------------------------*/
-	fileTypeAndPermsFlags = statBuf.st_mode;
+		appendOutputUnsigned(outBuffer,
+				     summaryTotals.typeEntries[typeIndex]);
 
-	getFileTypeString(fileTypeString,
-			  fileTypeAndPermsFlags);
+		appendOutputString(outBuffer, isJson ? ",\"bytes\":"
+						     : " entries, ");
 
-	getFilePermissionsString(filePermsString,
-				fileTypeAndPermsFlags);
+		appendOutputUnsigned(outBuffer,
+				     summaryTotals.typeBytes[typeIndex]);
 
+		appendOutputString(outBuffer, isJson ? "}" : " bytes\n");
+	}
 
 
-	/*---------------------------------------
-	 Part(b)(ii)(iv) Retrieving major and minor
-	 device numbers
 
-	 
-	 The variable 'deviceNumbers'
-	 contains both the device major and minor
-	 numbers 
-	 
-	 Further function calls to gnu_dev_major() 
-	 and gnu_dev_minor() are required to obtain the
-	 major and minor numbers respectively
-	-----------------------------------------*/
-	deviceNumbers = statBuf.st_dev;
+	/*============================================
+	 SECTION 5: Writing the mtime ages
+	=============================================*/
+	appendOutputString(outBuffer, isJson ? "],\"ages\":[" : "");
 
-	deviceMajorNum = gnu_dev_major(deviceNumbers);
+	for (size_t bucket = 0; bucket < NUM_SUMMARY_AGE_BUCKETS;
+	     bucket++)
+	{
+		label = summaryAgeBuckets[bucket].label;
 
-	deviceMinorNum = gnu_dev_minor(deviceNumbers);
+		if (isJson)
+		{
+			appendOutputString(outBuffer, (bucket > 0)
+					   ? ",{\"max_age\":" : "{\"max_age\":");
+
+			if (label != NULL)
+			{
+				appendOutputSigned(outBuffer,
+					summaryAgeBuckets[bucket].maxAge);
+			}
+			else
+			{
+				appendOutputString(outBuffer, "null");
+			}
+
+			appendOutputString(outBuffer, ",\"entries\":");
+		}
+		else
+		{
+			appendOutputString(outBuffer,
+				(bucket == 0) ? "Modified under "
+				: (label == NULL) ? "Modified over "
+				: "Modified ");
+
+			if (bucket > 0)
+			{
+				appendOutputString(outBuffer,
+					summaryAgeBuckets[bucket - 1].label);
+			}
+
+			if (bucket > 0 && label != NULL)
+			{
+				appendOutputString(outBuffer, " to ");
+			}
+
+			if (label != NULL)
+			{
+				appendOutputString(outBuffer, label);
+			}
+
+			appendOutputString(outBuffer, " ago: ");
+		}
 
+		appendOutputUnsigned(outBuffer,
+				     summaryTotals.ageEntries[bucket]);
 
+		appendOutputString(outBuffer, isJson ? ",\"bytes\":"
+						     : " entries, ");
 
-	/*---------------------------------------
-	 Part(b)(ii)(v) Retrieving last access,last
-	 modification and last status change time
+		appendOutputUnsigned(outBuffer,
+				     summaryTotals.ageBytes[bucket]);
 
-	 
-	 The variables 'lastAccessTime',
-	 'lastModTime' and 'lastStatChgTime' 
-	 contains the information, but in number of
-	 seconds from 12am 1970. 
-	 
-	 Further function calls are required to
-	 to change them to user readable format
-	 in string (in local time) 
-	-----------------------------------------*/	
-	lastAccessTime = statBuf.st_atime;
+		appendOutputString(outBuffer, isJson ? "}" : " bytes\n");
+	}
 
-	lastModTime = statBuf.st_mtime;
 
-	lastStatChgTime = statBuf.st_ctime;
 
-		
-	convertTimeToDateString(lastAccessTimeString,
-				lastAccessTime);
+	/*============================================
+	 SECTION 6: Writing the largest files
+	=============================================*/
+	appendOutputString(outBuffer, isJson ? "],\"largest\":[" : "");
 
-	convertTimeToDateString(lastModTimeString,
-				lastModTime);
+	for (size_t index = 0; index < summaryTotals.numLargestFiles;
+	     index++)
+	{
+		filePtr = &summaryTotals.largestFiles[index];
 
-	convertTimeToDateString(lastStatChgTimeString,
-				lastStatChgTime);
-	
+		if (isJson)
+		{
+			appendOutputString(outBuffer, (index > 0)
+					   ? ",{\"path\":" : "{\"path\":");
 
-	/*==============================================
-	 SECTION 3: Displaying all the file information
-	===============================================*/
-	printf("\n");
+			appendJsonString(outBuffer, filePtr->path);
 
-	printf("File Name: %s\n", fileName);
-	
-	printf("User Name of Owner Owner: %s\n", userName);
+			appendOutputString(outBuffer, ",\"size\":");
 
-	printf("Group Name of Group Owner: %s\n", groupName);
+			appendOutputUnsigned(outBuffer, filePtr->fileSize);
 
-	printf("Type of file: %s\n", fileTypeString);
+			appendOutputString(outBuffer, "}");
+		}
+		else
+		{
+			appendOutputString(outBuffer, "Large file: ");
 
-	printf("Full Access Permission: %s\n",
-		filePermsString);	
+			appendOutputUnsigned(outBuffer, filePtr->fileSize);
 
-	printf("Size of file (bytes): %ld\n", fileSize);
+			appendOutputString(outBuffer, " bytes, ");
 
-	printf("Inode num: %lu\n", inodeNum);
+			appendOutputString(outBuffer, filePtr->path);
 
-	printf("Device Major Number: %d\n",
-		deviceMajorNum);
+			appendOutputString(outBuffer, "\n");
+		}
 
-	printf("Device Minor Number: %d\n",
-		deviceMinorNum);
+		free(filePtr->path);
+	}
 
-	printf("No of links: %lu\n", numOfHardLinks);
+	appendOutputString(outBuffer, isJson ? "]}}\n" : "\n");
 
-	printf("Last Access Time: %s\n",
-		lastAccessTimeString);
 
-	printf("Last Modification Time: %s\n",
-		lastModTimeString);
-	
-	printf("Last Time File Status Change: %s\n",
-		lastStatChgTimeString);
+	free(summaryTotals.largestFiles);
 
-	printf("\n");
+	summaryTotals.largestFiles = NULL;
 
+	summaryTotals.numLargestFiles = 0;
 }
 
 
 
 /*---------------------------------------------------------*/
 
-void getFileTypeString(char * fileTypeString, 
-		      int fileTypeAndPermsFlags)
+const char * getFileTypeString(mode_t fileTypeAndPermsFlags)
 {
 
-	
 	/*===============================================
-	 This program retrieves the type of file from
-	 a numerical flag and returns the file type as
-	 a human-readable string
+	 The file type bits are a 4-bit field, so they
+	 index 'fileTypeTable' directly
 	================================================*/
+	return fileTypeTable[(fileTypeAndPermsFlags & S_IFMT)
+			     >> FILE_TYPE_SHIFT];
+}
 
-	
-	if (S_ISREG(fileTypeAndPermsFlags))
-	{
-		//regular file
-		strcpy(fileTypeString, "Regular");
+/*---------------------------------------------------------*/
 
-	}
-	else if (S_ISBLK(fileTypeAndPermsFlags))
-	{
-		//block device file
-		strcpy(fileTypeString,
-		       "Block Device"); 
+const char * getFilePermissionsString(
+				mode_t fileTypeAndPermsFlags)
+{
 
-	}
-	else if (S_ISCHR(fileTypeAndPermsFlags))
-	{
-		//character device file
-		strcpy(fileTypeString,
-		       "Character Device");
+	/*================================================
+	 The permission and special bits together are
+	 12 bits wide, so they index 'filePermsTable'
+	 directly. See FILE_PERMS_STRING for how each
+	 entry is built
+	=================================================*/
+	return filePermsTable[fileTypeAndPermsFlags
+			      & FILE_PERMS_MASK];
+}
 
-	}
-	else if (S_ISDIR(fileTypeAndPermsFlags))
-	{
-		//directory
-		strcpy(fileTypeString, "Directory");
 
-	}
-	else if (S_ISLNK(fileTypeAndPermsFlags))
-	{
-		//symbolic link
-		strcpy(fileTypeString, "Symbolic Link");
 
-	}
-	else if (S_ISFIFO(fileTypeAndPermsFlags))
-	{
-		//named pipe
-		strcpy(fileTypeString, "Named Pipe");
+/*---------------------------------------------------------*/
 
-	}
-	else
-	{
-		//socket
-		strcpy(fileTypeString, "Socket");
+void initTimeFormatting()
+{
 
-	}
+	/*===========================================
+	 The time zone is read once. The current year
+	 only changes through
+	 updateTimeFormattingYear()
+	============================================*/
+	tzset();
 
+	setTimeFormattingYear(time(NULL));
 }
 
+
 /*---------------------------------------------------------*/
 
-void getFilePermissionsString( char * filePermsString ,
-				mode_t fileTypeAndPermsFlags)
+void setTimeFormattingYear(time_t currentTime)
 {
 
-	/*================================================
-	 FILE PERMISSIONS IN LINUX
-	---------------------------------------------
-	 This function returns a string that contains
-	 the information about the access permissions
-	  of the file, eg 'rwxrwxr--'
+	struct tm currentBrokenDownTime;
 
+	struct tm yearEndBrokenDownTime;
 
-	 This function uses a numerical flag value
-	 as input to produce the string
-	 version of file access permissions
+	time_t yearEnd;
 
-	
-	 ----------------------------------
 
-	 SECTION 1: User-related Permissions
 
-	 SECTION 2: Group-related Permissions
+	localtime_r(&currentTime, &currentBrokenDownTime);
 
-	 SECTION 3: Others-related Permissions
-		
+	//Local midnight on the 1st of January of the
+	// next year
+	memset(&yearEndBrokenDownTime, 0, sizeof(yearEndBrokenDownTime));
 
-	 Each section consists of three parts, which
-	 are:
-	   (a) Read permission
-	   (b) Write Permission
-	   (c) Execute Permission
+	yearEndBrokenDownTime.tm_year = currentBrokenDownTime.tm_year + 1;
 
-	If the user(User/Group/Others) does not have
-	a particular permission, it would be labelled
-	as '-', otherwise it would be labelled
-	as 'r', 'w' or 'x' respectively.
-	=================================================*/
+	yearEndBrokenDownTime.tm_mday = 1;
 
+	yearEndBrokenDownTime.tm_isdst = -1;
 
+	yearEnd = mktime(&yearEndBrokenDownTime);
 
+	//Checked again in an hour if it cannot be
+	// told
+	timeFormatYearEnd = (yearEnd > currentTime)
+			    ? yearEnd : currentTime + 3600;
 
-	/*================================================
-	 SECTION 1: User-related Permissions
-	=================================================*/
-	
-	/*------------------------------
-	  Part(a) User Read Permission
-	-------------------------------*/
-	if(fileTypeAndPermsFlags & S_IRUSR)
-	{
-		filePermsString[0] = 'r';
-	}
-	else
-	{
-		filePermsString[0] = '-';
-	}
+	__atomic_store_n(&timeFormatCurrentYear,
+			 1900 + currentBrokenDownTime.tm_year,
+			 __ATOMIC_RELAXED);
+}
 
 
-	
-	/*-------------------------------
-	 Part(b) User Write Permission
-	--------------------------------*/
-	if (fileTypeAndPermsFlags & S_IWUSR)
-	{
-		filePermsString[1] = 'w';
-	}
-	else
-	{
-		filePermsString[1] = '-';
-	}
+/*---------------------------------------------------------*/
+
+void updateTimeFormattingYear()
+{
+
+	time_t currentTime;
 
 
 
-	/*---------------------------------
-	 Part(c) User Execute Permission	
-	----------------------------------*/
+	pthread_once(&timeFormattingInitOnce, initTimeFormatting);
 
-	if (fileTypeAndPermsFlags & S_IXUSR)
+	currentTime = time(NULL);
+
+	pthread_mutex_lock(&timeFormatYearLock);
+
+	if (currentTime >= timeFormatYearEnd)
 	{
-		filePermsString[2] = 'x';
+		setTimeFormattingYear(currentTime);
 	}
-	else
+
+	pthread_mutex_unlock(&timeFormatYearLock);
+}
+
+
+/*---------------------------------------------------------*/
+
+static inline long long floorDivideByDay(time_t givenTime)
+{
+	//Rounds towards minus infinity, so times
+	// before 1970 fall on the right day as well
+	long long dayNumber = givenTime / SECONDS_PER_DAY;
+
+	if (givenTime % SECONDS_PER_DAY < 0)
 	{
-		filePermsString[2] = '-';
+		dayNumber--;
 	}
 
+	return dayNumber;
+}
 
 
+/*---------------------------------------------------------*/
 
-	/*================================================
-	 SECTION 2: Group-related Permissions
-	=================================================*/
+int fillDayCacheEntry(struct DayCacheEntry * entryPtr,
+		      time_t givenTime,
+		      const struct tm * givenBrokenDownTime)
+{
 
+	struct tm startBrokenDownTime;
 
-	/*---------------------------------
-	 Part(a) Group Read Permission
-	----------------------------------*/
-	if (fileTypeAndPermsFlags & S_IRGRP)
-	{
-		filePermsString[3] = 'r';
-	}
-	else
-	{
-		filePermsString[3] = '-';
-	}
+	struct tm endBrokenDownTime;
 
+	time_t dayStart;
 
+	time_t dayEnd;
 
-	/*---------------------------------
-	 Part(b) Group Write Permission
-	----------------------------------*/
-	if (fileTypeAndPermsFlags & S_IWGRP)
-	{
-		filePermsString[4] = 'w';
-	}
-	else
-	{
-		filePermsString[4] = '-';
-	}
 
 
+	/*===========================================
+	 SECTION 1: Finding the candidate day
 
-	/*---------------------------------
-	 Part(c) Group Execute Permission
-	---------------------------------*/
-	if (fileTypeAndPermsFlags & S_IXGRP)
-	{
-		filePermsString[5] = 'x';
-	}
-	else
-	{
-		filePermsString[5] = '-';
-	}
+	 Subtracting the time of day gives local
+	 midnight, provided the offset from UTC does
+	 not change during the day
+	============================================*/
+	dayStart = givenTime
+		   - (givenBrokenDownTime->tm_hour * 3600
+		      + givenBrokenDownTime->tm_min * 60
+		      + givenBrokenDownTime->tm_sec);
 
+	dayEnd = dayStart + SECONDS_PER_DAY;
 
 
-	
-	/*==============================================
-	 SECTION 3: Others-related Permissions
-	===============================================*/
 
-	/*----------------------------------
-	 Part (a) Others Read Permission
-	----------------------------------*/
-	if (fileTypeAndPermsFlags & S_IROTH)
-	{
-		filePermsString[6] = 'r';
-	}
-	else
+	/*===========================================
+	 SECTION 2: Checking the candidate
+
+	 Both ends of the day must be on the same
+	 date, at 00:00:00 and 23:59:59, with the
+	 same offset as 'givenTime'. This rejects
+	 the days of daylight saving transitions (and
+	 leap seconds), which are never cached
+	============================================*/
+	if (localtime_r(&dayStart, &startBrokenDownTime) == NULL)
 	{
-		filePermsString[6] = '-';
+		return -1;
 	}
 
+	dayEnd--;
 
-
-	/*----------------------------------
-	 Part (b) Others Write Permission
-	-----------------------------------*/
-	if (fileTypeAndPermsFlags & S_IWOTH)
+	if (localtime_r(&dayEnd, &endBrokenDownTime) == NULL)
 	{
-		filePermsString[7] = 'w';
+		return -1;
 	}
-	else
+
+	dayEnd++;
+
+
+	if (startBrokenDownTime.tm_gmtoff
+		!= givenBrokenDownTime->tm_gmtoff
+	    || endBrokenDownTime.tm_gmtoff
+		!= givenBrokenDownTime->tm_gmtoff
+	    || startBrokenDownTime.tm_mday
+		!= givenBrokenDownTime->tm_mday
+	    || endBrokenDownTime.tm_mday
+		!= givenBrokenDownTime->tm_mday
+	    || startBrokenDownTime.tm_hour != 0
+	    || startBrokenDownTime.tm_min != 0
+	    || startBrokenDownTime.tm_sec != 0
+	    || endBrokenDownTime.tm_hour != 23
+	    || endBrokenDownTime.tm_min != 59
+	    || endBrokenDownTime.tm_sec != 59)
 	{
-		filePermsString[7] = '-';
+		return -1;
 	}
 
 
 
-	/*---------------------------------
-	 Part(c) Others Execute Permission
-	---------------------------------*/
-	if (fileTypeAndPermsFlags & S_IXOTH)
-	{
-		filePermsString[8] = 'x';
-	}
-	else
-	{
-		filePermsString[8] = '-';
-	}
+	/*===========================================
+	 SECTION 3: Storing the day
+	============================================*/
+	entryPtr->dayStart = dayStart;
 
+	entryPtr->dayEnd = dayEnd;
 
+	entryPtr->year = 1900 + givenBrokenDownTime->tm_year;
 
-	/*-------------------------------------
-	 Appending of the null-terminating
-	 character
-	--------------------------------------*/	
+	entryPtr->day = givenBrokenDownTime->tm_mday;
 
-	filePermsString[9] = '\0';
-}
+	getMonthString(entryPtr->monthString,
+		       givenBrokenDownTime->tm_mon);
 
 
+	return 0;
+}
+
 
 /*---------------------------------------------------------*/
 
@@ -897,68 +15595,108 @@ void convertTimeToDateString(char * dateString,
 
 	struct  tm givenBrokenDownTime;
 
-	struct  tm currentBrokenDownTime;
-
-	time_t currentTime;
-
-	int currentYear;
+	struct DayCacheEntry * entryPtr = NULL;
 
-	int givenYear;
+	struct DayCacheEntry uncachedEntry;
 
-	int givenMonth;
+	long long dayNumber;
 
-	int givenDay;
+	int secondsIntoDay;
 
 	int givenHour;
 
 	int givenMinute;
 
-	char givenMonthString[4];
+	char * charPtr = dateString;
+
+	int currentYear;
 
 
 
 
 	/*================================================
-	 SECTION 2: Converting the values to desired form
+	 SECTION 2: Finding the date of the given time
+
+	 The date is looked up in 'dayCache', which maps
+	 each UTC day number to the local day covering
+	 it. Only on a miss is localtime_r() called, and
+	 the day it returns is cached in the slots of
+	 both UTC days it overlaps
 	=================================================*/
+	pthread_once(&timeFormattingInitOnce, initTimeFormatting);
 
+	currentYear = __atomic_load_n(&timeFormatCurrentYear,
+				      __ATOMIC_RELAXED);
 
-	/*------------------------------------------
-	 Part (a) Breaking the time into different
-	 	 parts, such as year and month,
-		 and store them in structs
-	-------------------------------------------*/
-	currentTime = time(NULL);
+	dayNumber = floorDivideByDay(givenTime);
 
-	localtime_r(&currentTime, &currentBrokenDownTime);
+	entryPtr = &dayCache[dayNumber & (DAY_CACHE_SLOTS - 1)];
 
-	localtime_r(&givenTime, &givenBrokenDownTime);
-	
 
+	if (givenTime < entryPtr->dayStart
+	    || givenTime >= entryPtr->dayEnd)
+	{
+		if (localtime_r(&givenTime, &givenBrokenDownTime)
+			== NULL)
+		{
+			strcpy(dateString, "N/A");
+
+			return;
+		}
 
-	/*------------------------------------------
-	 Part (b) Retrieving the desired values from
-		 the structs
-	-------------------------------------------*/
-	currentYear = 1900 + currentBrokenDownTime.tm_year;
 
-	givenYear = 1900 + givenBrokenDownTime.tm_year;
-	
-	givenMonth = givenBrokenDownTime.tm_mon;
+		if (fillDayCacheEntry(&uncachedEntry, givenTime,
+				      &givenBrokenDownTime) == 0)
+		{
+			dayCache[floorDivideByDay(uncachedEntry.dayStart)
+				 & (DAY_CACHE_SLOTS - 1)] = uncachedEntry;
+
+			dayCache[floorDivideByDay(uncachedEntry.dayEnd - 1)
+				 & (DAY_CACHE_SLOTS - 1)] = uncachedEntry;
 
-	givenDay = givenBrokenDownTime.tm_mday;
+			entryPtr = &uncachedEntry;
+		}
+		else
+		{
+			//A day that cannot be cached is
+			// formatted straight from the
+			// broken-down time
+			uncachedEntry.dayStart = givenTime
+				- (givenBrokenDownTime.tm_hour * 3600
+				   + givenBrokenDownTime.tm_min * 60
+				   + givenBrokenDownTime.tm_sec);
 
-	givenHour = givenBrokenDownTime.tm_hour;
+			uncachedEntry.year =
+				1900 + givenBrokenDownTime.tm_year;
+
+			uncachedEntry.day = givenBrokenDownTime.tm_mday;
+
+			getMonthString(uncachedEntry.monthString,
+				       givenBrokenDownTime.tm_mon);
+
+			entryPtr = &uncachedEntry;
+		}
+	}
 
-	givenMinute = givenBrokenDownTime.tm_min;
 
-	getMonthString(givenMonthString, givenMonth);
-	
+
+	/*================================================
+	 SECTION 3: Deriving the time of day
+
+	 Within a cached day the offset from UTC is
+	 constant, so the hour and minute follow from
+	 the seconds elapsed since local midnight
+	=================================================*/
+	secondsIntoDay = (int) (givenTime - entryPtr->dayStart);
+
+	givenHour = secondsIntoDay / 3600;
+
+	givenMinute = (secondsIntoDay / 60) % 60;
 
 
 	
 	/*=================================================
-	 SECTION 3: Storing the string in the desired
+	 SECTION 4: Storing the string in the desired
 		    format and returning the string
 
 
@@ -973,24 +15711,64 @@ void convertTimeToDateString(char * dateString,
 	 However, if the date does not have the same year
 	 as the current year, the year will be displayed
 	 in place of the time
+
+	 The string is built by hand, matching the
+	 formats "%3s %2d %02d:%02d" and "%3s %2d %5d".
+	 Years outside 0..99999 are left to snprintf()
 	==================================================*/
-	if (currentYear == givenYear)
+	if (entryPtr->year != currentYear
+	    && (entryPtr->year < 0 || entryPtr->year > 99999))
+	{
+		snprintf(dateString,
+			 DATE_STRING_SIZE,
+			 "%3s %2d %5d", 
+			 entryPtr->monthString, entryPtr->day, 
+			 entryPtr->year); 
+
+		return;
+	}
+
+
+	memcpy(charPtr, entryPtr->monthString, 3);
+
+	charPtr += 3;
+
+	*charPtr++ = ' ';
+
+	*charPtr++ = (entryPtr->day >= 10)
+		     ? (char) ('0' + entryPtr->day / 10) : ' ';
+
+	*charPtr++ = (char) ('0' + entryPtr->day % 10);
+
+	*charPtr++ = ' ';
+
+
+	if (entryPtr->year == currentYear)
 	{
-		snprintf(dateString, 
-			sizeof(char) *(MAX_STRING_SIZE - 1),
-			 "%3s %2d %02d:%02d",
-			 givenMonthString, givenDay,
-			 givenHour, givenMinute);
+		*charPtr++ = (char) ('0' + givenHour / 10);
+
+		*charPtr++ = (char) ('0' + givenHour % 10);
+
+		*charPtr++ = ':';
+
+		*charPtr++ = (char) ('0' + givenMinute / 10);
+
+		*charPtr++ = (char) ('0' + givenMinute % 10);
 	}
 	else
 	{
-		snprintf(dateString,
-			 sizeof(char) * (MAX_STRING_SIZE -1),
-			 "%3s %2d %5d", 
-			 givenMonthString, givenDay, 
-			 givenYear); 
+		//Right-aligned in five columns
+		for (int divisor = 10000; divisor > 0; divisor /= 10)
+		{
+			*charPtr++ = (entryPtr->year >= divisor
+				      || divisor == 1)
+				? (char) ('0' + (entryPtr->year / divisor)
+					  % 10)
+				: ' ';
+		}
 	}
-	
+
+	*charPtr = '\0';
 
 }
 
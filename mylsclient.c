@@ -0,0 +1,514 @@
+/***********************************
+*
+* File name: mylsclient.c
+*
+* Aim: Send a listing request to a myls daemon
+*      started with 'myls --serve=SOCKET', and
+*      print what it answers
+*
+* Build: gcc -o mylsclient mylsclient.c
+*
+* Usage: ./mylsclient [--fields=LIST]
+*		      [--format=text|jsonl|bin]
+*		      [-d DIR]... SOCKET [FILE]...
+*
+*	 The FILEs and then the DIRs are listed
+*	 as 'myls' with the same options would
+*	 list them, by the daemon, with the
+*	 options it was started with otherwise.
+*	 Relative paths are taken from the
+*	 directory the daemon was started in.
+*	 Exits with 1 if the daemon reports an
+*	 error, or its answer is cut short
+*
+***********************************/
+
+
+#define _GNU_SOURCE
+
+
+//For errno
+#include <errno.h>
+
+
+//For getopt_long()
+#include <getopt.h>
+
+
+//For signal()
+#include <signal.h>
+
+
+//For fprintf()
+#include <stdio.h>
+
+
+//For malloc(), realloc(), free()
+#include <stdlib.h>
+
+
+//For strlen(), strcpy(), strerror(), memcmp(),
+// memmove()
+#include <string.h>
+
+
+//For socket(), connect(), shutdown()
+#include <sys/socket.h>
+
+
+//For struct sockaddr_un
+#include <sys/un.h>
+
+
+//For read(), write(), close()
+#include <unistd.h>
+
+
+
+
+//Every answer of the daemon ends with a status
+// line of STATUS_SIZE bytes: a NUL, the prefix,
+// the number of errors in STATUS_DIGITS digits
+// and a newline
+#define STATUS_PREFIX "\0myls-status "
+
+#define STATUS_PREFIX_LENGTH (sizeof(STATUS_PREFIX) - 1)
+
+#define STATUS_DIGITS 10
+
+#define STATUS_SIZE (STATUS_PREFIX_LENGTH + STATUS_DIGITS + 1)
+
+
+	/*------------------------------------------------
+	 A request being built: NUL-terminated
+	 'KEY=VALUE' records, one after the other
+	------------------------------------------------*/
+struct Request
+{
+	char * data;
+
+	size_t length;
+
+	size_t capacity;
+};
+
+
+
+
+	/*------------------------------------------------
+	 Brief: Appends the record 'key=value' to
+		'request'
+
+		Returns 0 on success, -1 if the request
+		could not be grown
+	------------------------------------------------*/
+int addRequestRecord(struct Request * request,
+		     const char * key, const char * value);
+
+
+	/*------------------------------------------------
+	 Brief: Writes the 'numBytes' bytes of 'bytes'
+		to 'fd', repeating the call after a
+		partial write
+
+		Returns 0 on success, -1 with 'errno'
+		set on failure
+	------------------------------------------------*/
+int writeAll(int fd, const char * bytes, size_t numBytes);
+
+
+	/*------------------------------------------------
+	 Brief: Reads the status line of STATUS_SIZE
+		bytes at 'status'
+
+		Returns the number of errors it reports,
+		or -1 if it is not a status line
+	------------------------------------------------*/
+long parseStatus(const char * status);
+
+
+	/*------------------------------------------------
+	 Brief: Displays how to run the program on
+		stderr
+	------------------------------------------------*/
+void printUsage();
+
+
+
+
+int main(int argc, char * argv[])
+{
+
+	/*=============================================
+	 SECTION 1: Building the request from the
+		    command line options
+	==============================================*/
+	static const struct option longOptions[] =
+	{
+		{"fields", required_argument, NULL, 'F'},
+		{"format", required_argument, NULL, 'T'},
+		{"dir",    required_argument, NULL, 'd'},
+		{NULL,     0,                 NULL, 0}
+	};
+
+	struct Request request = {NULL, 0, 0};
+
+	struct sockaddr_un socketAddress;
+
+	const char ** listedDirs = NULL;
+
+	int numListedDirs = 0;
+
+	const char * socketPath = NULL;
+
+	char responseBuffer[STATUS_SIZE + 64 * 1024];
+
+	size_t numHeld = 0;
+
+	ssize_t numRead;
+
+	long numErrors;
+
+	int socketFd;
+
+	int optionChar;
+
+	int addFailed = 0;
+
+	int isSent;
+
+
+	//Every argument could be a --dir option, so
+	// this is always large enough
+	listedDirs = malloc(sizeof(*listedDirs) * argc);
+
+	if (listedDirs == NULL)
+	{
+		perror("mylsclient");
+
+		return 1;
+	}
+
+
+	while ((optionChar = getopt_long(argc, argv, "d:",
+					 longOptions, NULL)) != -1)
+	{
+		switch (optionChar)
+		{
+			case 'F':
+				addFailed |= addRequestRecord(&request,
+							      "fields",
+							      optarg);
+
+				break;
+
+			case 'T':
+				addFailed |= addRequestRecord(&request,
+							      "format",
+							      optarg);
+
+				break;
+
+			case 'd':
+				listedDirs[numListedDirs++] = optarg;
+
+				break;
+
+			default:
+				printUsage();
+
+				return 1;
+		}
+	}
+
+	if (optind >= argc)
+	{
+		printUsage();
+
+		return 1;
+	}
+
+	socketPath = argv[optind++];
+
+
+	//As myls does, the files first, then the
+	// directories
+	for (int index = optind; index < argc; index++)
+	{
+		addFailed |= addRequestRecord(&request, "file",
+					      argv[index]);
+	}
+
+	for (int index = 0; index < numListedDirs; index++)
+	{
+		addFailed |= addRequestRecord(&request, "dir",
+					      listedDirs[index]);
+	}
+
+	free(listedDirs);
+
+	if (addFailed)
+	{
+		perror("mylsclient");
+
+		return 1;
+	}
+
+
+
+	/*=============================================
+	 SECTION 2: Sending the request. Closing the
+		    sending side ends it
+	==============================================*/
+	if (strlen(socketPath) >= sizeof(socketAddress.sun_path))
+	{
+		fprintf(stderr, "mylsclient: Socket path '%s' is too"
+			" long\n", socketPath);
+
+		return 1;
+	}
+
+	memset(&socketAddress, 0, sizeof(socketAddress));
+
+	socketAddress.sun_family = AF_UNIX;
+
+	strcpy(socketAddress.sun_path, socketPath);
+
+	//A daemon that turns the client away closes
+	// the connection without reading the
+	// request, whose sending then fails with
+	// EPIPE. Its reason is read below
+	signal(SIGPIPE, SIG_IGN);
+
+
+	socketFd = socket(AF_UNIX, SOCK_STREAM, 0);
+
+	if (socketFd == -1
+	    || connect(socketFd, (struct sockaddr *) &socketAddress,
+		       sizeof(socketAddress)) == -1)
+	{
+		fprintf(stderr, "mylsclient: Cannot connect to '%s': %s\n",
+			socketPath, strerror(errno));
+
+		return 1;
+	}
+
+	isSent = (writeAll(socketFd, request.data, request.length) == 0
+		  && shutdown(socketFd, SHUT_WR) == 0);
+
+	if (!isSent && errno != EPIPE)
+	{
+		fprintf(stderr, "mylsclient: Cannot send the request: %s\n",
+			strerror(errno));
+
+		close(socketFd);
+
+		return 1;
+	}
+
+	free(request.data);
+
+
+
+	/*=============================================
+	 SECTION 3: Copying the answer to stdout
+		    until the daemon closes the
+		    connection. The last STATUS_SIZE
+		    bytes received are held back, as
+		    they may be the status line
+	==============================================*/
+	while ((numRead = read(socketFd, responseBuffer + numHeld,
+			       sizeof(responseBuffer) - numHeld)) != 0)
+	{
+		if (numRead == -1 && errno == EINTR)
+		{
+			continue;
+		}
+
+		if (numRead == -1)
+		{
+			perror("mylsclient");
+
+			close(socketFd);
+
+			return 1;
+		}
+
+		numHeld += (size_t) numRead;
+
+		if (numHeld <= STATUS_SIZE)
+		{
+			continue;
+		}
+
+		if (writeAll(STDOUT_FILENO, responseBuffer,
+			     numHeld - STATUS_SIZE) == -1)
+		{
+			perror("mylsclient");
+
+			close(socketFd);
+
+			return 1;
+		}
+
+		memmove(responseBuffer,
+			responseBuffer + numHeld - STATUS_SIZE, STATUS_SIZE);
+
+		numHeld = STATUS_SIZE;
+	}
+
+	close(socketFd);
+
+
+
+	/*=============================================
+	 SECTION 4: Exiting with the status the
+		    daemon reported. Without one, the
+		    daemon stopped or gave up on the
+		    client before the end
+	==============================================*/
+	numErrors = (numHeld == STATUS_SIZE)
+		    ? parseStatus(responseBuffer) : -1;
+
+	if (numErrors == -1)
+	{
+		writeAll(STDOUT_FILENO, responseBuffer, numHeld);
+
+		fprintf(stderr, "mylsclient: The answer of the daemon was"
+			" cut short\n");
+
+		return 1;
+	}
+
+
+	return (numErrors == 0) ? 0 : 1;
+}
+
+
+/*---------------------------------------------------------*/
+
+int addRequestRecord(struct Request * request,
+		     const char * key, const char * value)
+{
+
+	size_t keyLength = strlen(key);
+
+	size_t recordLength = keyLength + 1 + strlen(value) + 1;
+
+	size_t newCapacity;
+
+	char * newData = NULL;
+
+
+
+	if (request->length + recordLength > request->capacity)
+	{
+		newCapacity = (request->capacity > 0)
+			      ? request->capacity * 2 : 4096;
+
+		while (newCapacity < request->length + recordLength)
+		{
+			newCapacity *= 2;
+		}
+
+		newData = realloc(request->data, newCapacity);
+
+		if (newData == NULL)
+		{
+			return -1;
+		}
+
+		request->data = newData;
+
+		request->capacity = newCapacity;
+	}
+
+
+	memcpy(request->data + request->length, key, keyLength);
+
+	request->data[request->length + keyLength] = '=';
+
+	strcpy(request->data + request->length + keyLength + 1, value);
+
+	request->length += recordLength;
+
+
+	return 0;
+}
+
+
+/*---------------------------------------------------------*/
+
+int writeAll(int fd, const char * bytes, size_t numBytes)
+{
+
+	ssize_t numWritten;
+
+
+
+	while (numBytes > 0)
+	{
+		numWritten = write(fd, bytes, numBytes);
+
+		if (numWritten == -1 && errno == EINTR)
+		{
+			continue;
+		}
+
+		if (numWritten == -1)
+		{
+			return -1;
+		}
+
+		bytes += numWritten;
+
+		numBytes -= (size_t) numWritten;
+	}
+
+
+	return 0;
+}
+
+
+/*---------------------------------------------------------*/
+
+long parseStatus(const char * status)
+{
+
+	long numErrors = 0;
+
+
+
+	if (memcmp(status, STATUS_PREFIX, STATUS_PREFIX_LENGTH) != 0
+	    || status[STATUS_SIZE - 1] != '\n')
+	{
+		return -1;
+	}
+
+	for (size_t index = STATUS_PREFIX_LENGTH;
+	     index < STATUS_SIZE - 1; index++)
+	{
+		if (status[index] < '0' || status[index] > '9')
+		{
+			return -1;
+		}
+
+		numErrors = numErrors * 10 + (status[index] - '0');
+	}
+
+
+	return numErrors;
+}
+
+
+/*---------------------------------------------------------*/
+
+void printUsage()
+{
+	fprintf(stderr,
+		"Usage: mylsclient [OPTION]... SOCKET [FILE]...\n"
+		"  -d, --dir=DIR            list the contents of DIR\n"
+		"  --fields=LIST            comma-separated fields to"
+		" print\n"
+		"  --format=FORMAT          text, jsonl or bin\n");
+}
@@ -0,0 +1,552 @@
+/***********************************
+*
+* File name: mylsread.c
+*
+* Aim: Read the binary listing written by
+*      'myls --format=bin' and print it as
+*      text, JSON Lines or binary records
+*
+* Build: gcc -pthread -o mylsread mylsread.c
+*
+* Usage: ./mylsread [--format=text|jsonl|bin]
+*		    [FILE]
+*
+*	 Reads standard input when no FILE is
+*	 given. The output is what myls itself
+*	 would have written in that format, so
+*	 'myls --format=bin | mylsread
+*	 --format=jsonl' matches
+*	 'myls --format=jsonl'
+*
+***********************************/
+
+
+//Only the functions of myls are needed: the
+// binary layout, and the writers of every
+// output format
+#define MYLS_NO_MAIN
+
+#include "myls.c"
+
+
+
+
+	/*------------------------------------------------
+	 Brief: Returns the little-endian integer of
+		'numBytes' bytes at 'bytes'
+	------------------------------------------------*/
+uint64_t loadLittleEndian(const unsigned char * bytes,
+			  int numBytes);
+
+
+	/*------------------------------------------------
+	 Brief: Maps the file 'filePath' into memory,
+		or reads all of standard input if it is
+		NULL, and stores its address and length
+		in 'data' and 'dataLength'. 'isMapped'
+		tells whether munmap() or free() releases
+		it
+
+		Returns 0 on success. On failure, an
+		error message is printed and -1 is
+		returned
+	------------------------------------------------*/
+int loadListing(const char * filePath,
+		const unsigned char ** data,
+		size_t * dataLength, int * isMapped);
+
+
+	/*------------------------------------------------
+	 Brief: Checks the header of the listing in
+		'data', storing the record size and the
+		fields present, and writes every record
+		to stdout in the selected format
+
+		Returns 0 on success. If the header is not
+		recognised or the listing is truncated,
+		an error message is printed and -1 is
+		returned. -1 is also returned if the
+		listing holds errors, e.g. from a myls
+		daemon, which are printed in place
+	------------------------------------------------*/
+int printListing(const unsigned char * data,
+		 size_t dataLength);
+
+
+
+
+int main(int argc, char * argv[])
+{
+
+	/*=============================================
+	 SECTION 1: Parsing the command line options
+	==============================================*/
+	static const struct option longOptions[] =
+	{
+		{"format", required_argument, NULL, 'T'},
+		{NULL,     0,                 NULL, 0}
+	};
+
+	int optionChar;
+
+	const char * filePath = NULL;
+
+	const unsigned char * data = NULL;
+
+	size_t dataLength = 0;
+
+	int isMapped = 0;
+
+	int returnValue;
+
+
+	listingOptions.outputFormat = FORMAT_JSONL;
+
+
+	while ((optionChar = getopt_long(argc, argv, "",
+					 longOptions, NULL)) != -1)
+	{
+		if (optionChar == 'T' && strcmp(optarg, "text") == 0)
+		{
+			listingOptions.outputFormat = FORMAT_TEXT;
+		}
+		else if (optionChar == 'T'
+			 && strcmp(optarg, "jsonl") == 0)
+		{
+			listingOptions.outputFormat = FORMAT_JSONL;
+		}
+		else if (optionChar == 'T'
+			 && strcmp(optarg, "bin") == 0)
+		{
+			listingOptions.outputFormat = FORMAT_BIN;
+		}
+		else
+		{
+			fprintf(stderr,
+				"Usage: mylsread [--format=text|jsonl|bin]"
+				" [FILE]\n");
+
+			return 1;
+		}
+	}
+
+	if (optind < argc)
+	{
+		filePath = argv[optind];
+	}
+
+
+
+	/*=============================================
+	 SECTION 2: Reading and printing the listing
+	==============================================*/
+	if (loadListing(filePath, &data, &dataLength,
+			&isMapped) == -1)
+	{
+		return 1;
+	}
+
+	if (initOutputBuffer(&stdoutBuffer, STDOUT_FILENO,
+			     DEFAULT_OUTPUT_BUFFER_SIZE) == -1)
+	{
+		perror("mylsread");
+
+		return 1;
+	}
+
+
+	returnValue = printListing(data, dataLength);
+
+
+	flushOutputBuffer(&stdoutBuffer);
+
+	destroyOutputBuffer(&stdoutBuffer);
+
+	if (isMapped)
+	{
+		munmap((void *) data, dataLength);
+	}
+	else
+	{
+		free((void *) data);
+	}
+
+
+	return (returnValue == 0) ? 0 : 1;
+}
+
+
+
+/*---------------------------------------------------------*/
+
+uint64_t loadLittleEndian(const unsigned char * bytes,
+			  int numBytes)
+{
+	uint64_t value = 0;
+
+
+	for (int index = numBytes - 1; index >= 0; index--)
+	{
+		value = (value << 8) | bytes[index];
+	}
+
+
+	return value;
+}
+
+
+
+/*---------------------------------------------------------*/
+
+int loadListing(const char * filePath,
+		const unsigned char ** data,
+		size_t * dataLength, int * isMapped)
+{
+
+	int fileFd;
+
+	struct stat statBuf;
+
+	unsigned char * buffer = NULL;
+
+	unsigned char * newBuffer = NULL;
+
+	size_t capacity = 0;
+
+	size_t length = 0;
+
+	ssize_t numRead;
+
+
+
+	/*=============================================
+	 SECTION 1: Mapping a file. Records are then
+		    read straight from the page cache
+	==============================================*/
+	if (filePath != NULL)
+	{
+		fileFd = open(filePath, O_RDONLY | O_CLOEXEC);
+
+		if (fileFd == -1 || fstat(fileFd, &statBuf) == -1)
+		{
+			fprintf(stderr, "mylsread: Cannot open '%s': %s\n",
+				filePath, strerror(errno));
+
+			if (fileFd != -1)
+			{
+				close(fileFd);
+			}
+
+			return -1;
+		}
+
+		*dataLength = statBuf.st_size;
+
+		*data = (*dataLength > 0)
+			? mmap(NULL, *dataLength, PROT_READ, MAP_PRIVATE,
+			       fileFd, 0)
+			: NULL;
+
+		close(fileFd);
+
+		if (*data == MAP_FAILED)
+		{
+			fprintf(stderr, "mylsread: Cannot map '%s': %s\n",
+				filePath, strerror(errno));
+
+			return -1;
+		}
+
+		*isMapped = (*dataLength > 0);
+
+		return 0;
+	}
+
+
+
+	/*=============================================
+	 SECTION 2: Reading all of standard input,
+		    which may be a pipe
+	==============================================*/
+	for (;;)
+	{
+		if (length == capacity)
+		{
+			capacity = (capacity > 0) ? capacity * 2
+						  : 1024 * 1024;
+
+			newBuffer = realloc(buffer, capacity);
+
+			if (newBuffer == NULL)
+			{
+				perror("mylsread");
+
+				free(buffer);
+
+				return -1;
+			}
+
+			buffer = newBuffer;
+		}
+
+		numRead = read(STDIN_FILENO, buffer + length,
+			       capacity - length);
+
+		if (numRead == 0)
+		{
+			break;
+		}
+
+		if (numRead == -1)
+		{
+			if (errno == EINTR)
+			{
+				continue;
+			}
+
+			perror("mylsread");
+
+			free(buffer);
+
+			return -1;
+		}
+
+		length += numRead;
+	}
+
+
+	*data = buffer;
+
+	*dataLength = length;
+
+	*isMapped = 0;
+
+
+	return 0;
+}
+
+
+
+/*---------------------------------------------------------*/
+
+int printListing(const unsigned char * data,
+		 size_t dataLength)
+{
+
+	/*=============================================
+	 SECTION 1: Declaration of variables
+	==============================================*/
+
+	size_t headerSize;
+
+	size_t recordSize;
+
+	size_t position;
+
+	const unsigned char * recordPtr = NULL;
+
+	unsigned int recordKind;
+
+	size_t nameLength;
+
+	size_t pieceLength;
+
+	char * name = NULL;
+
+	size_t nameCapacity = 0;
+
+	size_t nameUsed;
+
+	struct EntryRecord entryRecord;
+
+	struct stat statBuf;
+
+	int numErrors = 0;
+
+
+
+	/*=============================================
+	 SECTION 2: Checking the header. Newer minor
+		    additions may lengthen the header
+		    and the records, so both sizes are
+		    taken from the header
+	==============================================*/
+	if (dataLength < BINARY_HEADER_SIZE
+	    || memcmp(data, BINARY_MAGIC, sizeof(BINARY_MAGIC)) != 0)
+	{
+		fprintf(stderr,
+			"mylsread: Not a binary listing of myls\n");
+
+		return -1;
+	}
+
+	if (loadLittleEndian(data + 8, 4) != BINARY_FORMAT_VERSION)
+	{
+		fprintf(stderr,
+			"mylsread: Unsupported format version %u\n",
+			(unsigned int) loadLittleEndian(data + 8, 4));
+
+		return -1;
+	}
+
+	headerSize = loadLittleEndian(data + 12, 4);
+
+	recordSize = loadLittleEndian(data + 16, 4);
+
+	listingOptions.outputFields = loadLittleEndian(data + 20, 4)
+				      & FIELD_ALL;
+
+	if (headerSize < BINARY_HEADER_SIZE
+	    || recordSize < BINARY_RECORD_SIZE
+	    || headerSize > dataLength)
+	{
+		fprintf(stderr, "mylsread: Invalid header\n");
+
+		return -1;
+	}
+
+	if (listingOptions.outputFormat == FORMAT_BIN)
+	{
+		writeBinaryHeader(&stdoutBuffer);
+	}
+
+
+
+	/*=============================================
+	 SECTION 3: Printing every record, after
+		    gathering the continuation records
+		    of a long name
+	==============================================*/
+	memset(&statBuf, 0, sizeof(statBuf));
+
+	position = headerSize;
+
+	while (position + recordSize <= dataLength)
+	{
+		recordPtr = data + position;
+
+		recordKind = loadLittleEndian(recordPtr + 68, 2);
+
+		nameLength = loadLittleEndian(recordPtr + 72, 4);
+
+		position += recordSize;
+
+
+		if (nameLength + 1 > nameCapacity)
+		{
+			free(name);
+
+			nameCapacity = nameLength + 1;
+
+			name = malloc(nameCapacity);
+
+			if (name == NULL)
+			{
+				perror("mylsread");
+
+				return -1;
+			}
+		}
+
+		pieceLength = (nameLength < BINARY_NAME_SIZE)
+			      ? nameLength : BINARY_NAME_SIZE;
+
+		memcpy(name, recordPtr + BINARY_NAME_OFFSET, pieceLength);
+
+		nameUsed = pieceLength;
+
+		while (nameUsed < nameLength
+		       && position + recordSize <= dataLength
+		       && loadLittleEndian(data + position + 68, 2)
+			  == BINARY_RECORD_CONT)
+		{
+			pieceLength = (nameLength - nameUsed < BINARY_NAME_SIZE)
+				      ? nameLength - nameUsed : BINARY_NAME_SIZE;
+
+			memcpy(name + nameUsed,
+			       data + position + BINARY_NAME_OFFSET,
+			       pieceLength);
+
+			nameUsed += pieceLength;
+
+			position += recordSize;
+		}
+
+		if (nameUsed < nameLength)
+		{
+			break;
+		}
+
+		name[nameLength] = '\0';
+
+
+		if (recordKind == BINARY_RECORD_DIR)
+		{
+			writeDirHeading(&stdoutBuffer, name);
+		}
+		else if (recordKind == BINARY_RECORD_REMOVED)
+		{
+			writeRemovedEntry(&stdoutBuffer, name);
+		}
+		else if (recordKind == BINARY_RECORD_ERROR)
+		{
+			writeErrorRecord(&stdoutBuffer, name);
+
+			numErrors++;
+		}
+		else if (recordKind == BINARY_RECORD_ENTRY)
+		{
+			entryRecord.fileSize = loadLittleEndian(recordPtr, 8);
+
+			entryRecord.inodeNum =
+				loadLittleEndian(recordPtr + 8, 8);
+
+			entryRecord.lastAccessTime =
+				(int64_t) loadLittleEndian(recordPtr + 16, 8);
+
+			entryRecord.lastModTime =
+				(int64_t) loadLittleEndian(recordPtr + 24, 8);
+
+			entryRecord.lastStatChgTime =
+				(int64_t) loadLittleEndian(recordPtr + 32, 8);
+
+			entryRecord.lastModNanoseconds =
+				loadLittleEndian(recordPtr + 40, 4);
+
+			entryRecord.fileTypeAndPermsFlags =
+				loadLittleEndian(recordPtr + 44, 4);
+
+			entryRecord.userId = loadLittleEndian(recordPtr + 48, 4);
+
+			entryRecord.groupId = loadLittleEndian(recordPtr + 52, 4);
+
+			entryRecord.numOfHardLinks =
+				loadLittleEndian(recordPtr + 56, 4);
+
+			entryRecord.deviceMajorNum =
+				loadLittleEndian(recordPtr + 60, 4);
+
+			entryRecord.deviceMinorNum =
+				loadLittleEndian(recordPtr + 64, 4);
+
+			loadEntryRecordStat(&entryRecord, &statBuf);
+
+			writeFileStatInfo(&stdoutBuffer, name, &statBuf);
+		}
+	}
+
+	free(name);
+
+
+	if (position != dataLength)
+	{
+		flushOutputBuffer(&stdoutBuffer);
+
+		fprintf(stderr, "mylsread: The listing is truncated\n");
+
+		return -1;
+	}
+
+
+	return (numErrors == 0) ? 0 : -1;
+}
@@ -0,0 +1,123 @@
+#!/bin/sh
+#***********************************
+#
+# File name: tests/check_files_from.sh
+#
+# Aim: Check that --files-from reads names one
+#      per line, and with -0 up to each NUL, so
+#      that names holding spaces and newlines
+#      come through whole, that empty names are
+#      skipped, and that the names are listed
+#      after the arguments, in order, with or
+#      without -j
+#
+# Usage: sh tests/check_files_from.sh
+#
+#***********************************
+
+. "$(dirname "$0")/common.sh"
+
+
+
+#=== SECTION 1: Making the files and lists ===
+
+DIR="$WORK_DIR/dir"
+
+mkdir "$DIR"
+
+(
+	cd "$DIR"
+	i=1
+
+	while [ $i -le 300 ]
+	do
+		echo "file$i"
+		i=$((i + 1))
+	done > many.list
+
+	xargs touch < many.list
+	touch a b 'sp ace' "$(printf 'new\nline')" ' lead'
+
+	# An empty name between the first two, and
+	# one naming no file
+	printf 'a\0\0sp ace\0new\nline\0 lead\0missing\0' > names.nul
+	printf 'a\n\nsp ace\n' > names.lines
+)
+
+
+# Lists, from inside the directory, with the
+# given options, printing the names only
+listFiles()
+{
+	(cd "$DIR" && "$MYLS" --format=jsonl --fields=name "$@" 2>&1)
+}
+
+
+
+#=== SECTION 2: Reading the names ===
+
+listFiles b --files-from=names.nul -0 > "$WORK_DIR/actual"
+
+cat > "$WORK_DIR/expected" << 'EOF'
+{"name":"b"}
+{"name":"a"}
+{"name":"sp ace"}
+{"name":"new\u000aline"}
+{"name":" lead"}
+
+myls: Cannot access 'missing': No such file or directory
+
+EOF
+
+expectSameFiles "$WORK_DIR/expected" "$WORK_DIR/actual" \
+		"NUL-separated list after an argument"
+
+listFiles -0 < "$DIR/names.nul" > "$WORK_DIR/actual"
+
+sed 1d "$WORK_DIR/expected" > "$WORK_DIR/expected.stdin"
+
+expectSameFiles "$WORK_DIR/expected.stdin" "$WORK_DIR/actual" \
+		"NUL-separated list on stdin"
+
+expectEqual "$(listFiles --files-from=- < "$DIR/names.lines")" \
+	    "$(printf '%s\n' '{"name":"a"}' '{"name":"sp ace"}')" \
+	    "newline-separated list on stdin"
+
+if listFiles --files-from=no-such.list > /dev/null
+then
+	fail "a missing list was accepted"
+fi
+
+
+
+#=== SECTION 3: In order, with -j ===
+
+listFiles b a --files-from=many.list > "$WORK_DIR/expected"
+
+expectEqual "$(wc -l < "$WORK_DIR/expected")" 302 "names listed"
+
+for options in "-j2" "-j8"
+do
+	listFiles b a --files-from=many.list $options \
+		> "$WORK_DIR/actual"
+
+	expectSameFiles "$WORK_DIR/expected" "$WORK_DIR/actual" \
+			"list with $options"
+done
+
+listFiles b a --files-from=many.list -j4 --unordered \
+	| LC_ALL=C sort > "$WORK_DIR/actual"
+
+LC_ALL=C sort "$WORK_DIR/expected" > "$WORK_DIR/expected.sorted"
+
+expectSameFiles "$WORK_DIR/expected.sorted" "$WORK_DIR/actual" \
+		"list with -j4 --unordered"
+
+# The filter matches the names from the list as
+# it does arguments
+expectEqual "$(listFiles --files-from=many.list -j4 \
+		--filter='name=file2?' | tr -d '\n')" \
+	    "$(printf '{"name":"file2%d"}' 0 1 2 3 4 5 6 7 8 9)" \
+	    "filtered list with -j4"
+
+pass
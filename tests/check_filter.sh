@@ -0,0 +1,142 @@
+#!/bin/sh
+#***********************************
+#
+# File name: tests/check_filter.sh
+#
+# Aim: Check the predicates of --filter, that
+#      the name stage keeps rejected entries
+#      from being looked up and the metadata
+#      stage keeps them from being formatted,
+#      and that file arguments, -R and -j are
+#      filtered as documented
+#
+# Usage: sh tests/check_filter.sh
+#
+#***********************************
+
+. "$(dirname "$0")/common.sh"
+
+
+
+#=== SECTION 1: Making the directory ===
+
+DIR="$WORK_DIR/dir"
+
+mkdir "$DIR" "$DIR/sub"
+
+(
+	cd "$DIR"
+	printf '0123456789' > small.log
+	truncate -s 2M big.log
+	truncate -s 1K notes.txt
+	printf 'old' > old.txt
+	touch -d '10 days ago' old.txt
+	touch file7 file17 data.bin 'comma,name' sub/inner.log
+	ln -s small.log link.log
+	mkfifo pipe
+)
+
+NUM_ENTRIES=11
+
+
+
+#=== SECTION 2: Each predicate ===
+
+# Prints the names myls lists with the given
+# options, in order, on one line
+listNames()
+{
+	"$MYLS" --dir="$DIR" --sort=name --format=jsonl --fields=name "$@" \
+		| sed 's/^{"name":"\(.*\)"}$/\1/' | tr '\n' ' '
+}
+
+# Fails unless the filter $1 (and any other
+# options) lists the names $2, serially and
+# with -j
+expectNames()
+{
+	expectedNames=$1
+	shift
+
+	expectEqual "$(listNames "$@")" "$expectedNames" "$*"
+	expectEqual "$(listNames -j3 "$@")" "$expectedNames" "-j3 $*"
+}
+
+
+expectNames "big.log link.log small.log " --filter='name=*.log'
+expectNames "file17 file7 " --filter='regex=7$'
+expectNames "sub " --filter='type=d'
+expectNames "link.log pipe " --filter='type=lp'
+expectNames "notes.txt sub " --filter='size=1K..1M'
+expectNames "notes.txt " --filter='size=1K..1M,type=f'
+expectNames "big.log " --filter='size=1M..'
+expectNames "comma,name data.bin file17 file7 " \
+	    --filter='type=f,size=0'
+expectNames "old.txt " --filter='mtime=2d..'
+expectNames "big.log notes.txt small.log " \
+	    --filter='type=f,mtime=..1h,size=1..'
+expectNames "comma,name " --filter='name=comma\,name'
+expectNames "small.log " --filter='name=*.log' --filter='size=10'
+expectNames "" --filter='uid=4294967294'
+expectNames "big.log " --filter="uid=$(id -u),name=b*"
+
+
+# Each predicate may appear once, and one that
+# cannot be parsed is refused
+for expression in 'bogus=1' 'size=abc' 'mtime=5x' 'type=q' \
+		  'regex=(' 'name=a,name=b' 'uid=4294967296'
+do
+	if "$MYLS" --dir="$DIR" --filter="$expression" \
+		> /dev/null 2>&1
+	then
+		fail "--filter='$expression' was accepted"
+	fi
+done
+
+
+
+#=== SECTION 3: File arguments and -R ===
+
+# Arguments are matched by their last component
+expectEqual "$("$MYLS" --filter='name=*.log' --fields=name \
+		--format=jsonl "$DIR/small.log" "$DIR/notes.txt" \
+		"$DIR/sub/inner.log")" \
+	    "$(printf '%s\n%s' '{"name":"'"$DIR"'/small.log"}' \
+		      '{"name":"'"$DIR"'/sub/inner.log"}')" \
+	    "file arguments"
+
+# The rejected subdirectory is still walked
+expectEqual "$(listNames -R --filter='name=inner.log' \
+		| tr -d ' ')" '{"dir":"'"$DIR"'"}{"dir":"'"$DIR"'/sub"}inner.log' \
+	    "-R through a rejected subdirectory"
+
+
+
+#=== SECTION 4: The stages ===
+
+# Prints the number of metadata lookups, and of
+# entries whose owner was resolved, when
+# listing with the given options
+countStages()
+{
+	"$MYLS" --dir="$DIR" --stats "$@" 2>&1 > /dev/null \
+		| awk '$2 == "stat" { lookups = $3 }
+		       /user name cache:/ { resolved = $5 + $7 }
+		       END { print lookups + 0, resolved + 0 }'
+}
+
+expectEqual "$(countStages)" "$NUM_ENTRIES $NUM_ENTRIES" \
+	    "lookups and names without a filter"
+
+expectEqual "$(countStages --filter='name=*.log')" "3 3" \
+	    "lookups and names with a name filter"
+
+expectEqual "$(countStages --filter='size=1K..1M')" \
+	    "$NUM_ENTRIES 2" "lookups and names with a size filter"
+
+# The type is known from d_type, so only the
+# eight regular files are looked up
+expectEqual "$(countStages --filter='size=1K..1M,type=f')" "8 1" \
+	    "lookups and names with a size and type filter"
+
+pass
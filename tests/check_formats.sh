@@ -0,0 +1,106 @@
+#!/bin/sh
+#***********************************
+#
+# File name: tests/check_formats.sh
+#
+# Aim: Check that the binary records of
+#      'myls --format=bin', read back by
+#      mylsread, give exactly what myls writes
+#      in JSON Lines and in text, and the same
+#      binary records again
+#
+# Usage: sh tests/check_formats.sh
+#
+#***********************************
+
+. "$(dirname "$0")/common.sh"
+
+
+
+#=== SECTION 1: Making the tree ===
+
+# Every type of entry, and names that JSON must
+# escape
+TREE="$WORK_DIR/tree"
+
+if [ -x "$GEN_TREE" ]
+then
+	"$GEN_TREE" --files=200 --depth=1 --fanout=2 "$TREE" > /dev/null
+else
+	mkdir "$TREE"
+fi
+
+(
+	cd "$TREE"
+	touch 'quote"d' 'back\slash' 'tab	bed' "$(printf 'new\nline')" \
+	      'ünïcödé' "$(printf 'control\001')"
+	printf 'some bytes' > sized
+	mkdir empty
+)
+
+
+
+#=== SECTION 2: Comparing the formats ===
+
+# Lists the tree with the given options
+listTree()
+{
+	"$MYLS" "$@" --dir="$TREE" "$TREE/sized" "$TREE/missing" \
+		2> /dev/null
+}
+
+
+for options in "" "-R" "--fields=name,size,mtime,perms" \
+	       "-R --fields=name,type,links,inode"
+do
+	# Reading a directory can update its access
+	# time once, so a first listing settles them
+	listTree -R > /dev/null || true
+
+	listTree $options --format=bin > "$WORK_DIR/listing.bin" || true
+
+	listTree $options --format=jsonl > "$WORK_DIR/expected.jsonl" \
+		|| true
+
+	listTree $options > "$WORK_DIR/expected.text" || true
+
+
+	"$MYLSREAD" --format=jsonl "$WORK_DIR/listing.bin" \
+		> "$WORK_DIR/actual.jsonl" \
+		|| fail "reading the records of '$options'"
+
+	expectSameFiles "$WORK_DIR/expected.jsonl" "$WORK_DIR/actual.jsonl" \
+			"bin to jsonl with '$options'"
+
+	"$MYLSREAD" --format=text < "$WORK_DIR/listing.bin" \
+		> "$WORK_DIR/actual.text" \
+		|| fail "reading the records of '$options' from stdin"
+
+	expectSameFiles "$WORK_DIR/expected.text" "$WORK_DIR/actual.text" \
+			"bin to text with '$options'"
+
+	"$MYLSREAD" --format=bin "$WORK_DIR/listing.bin" \
+		> "$WORK_DIR/actual.bin" \
+		|| fail "copying the records of '$options'"
+
+	expectSameFiles "$WORK_DIR/listing.bin" "$WORK_DIR/actual.bin" \
+			"bin to bin with '$options'"
+done
+
+
+# A listing cut short is an error, not a
+# shorter listing
+listTree --format=bin > "$WORK_DIR/listing.bin" || true
+
+# Cut within the last record
+listingSize=$(wc -c < "$WORK_DIR/listing.bin")
+
+head -c $((listingSize - 7)) "$WORK_DIR/listing.bin" \
+	> "$WORK_DIR/truncated.bin"
+
+if "$MYLSREAD" "$WORK_DIR/truncated.bin" > /dev/null 2>&1
+then
+	fail "a truncated listing was read without an error"
+fi
+
+pass
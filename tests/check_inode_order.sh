@@ -0,0 +1,75 @@
+#!/bin/sh
+#***********************************
+#
+# File name: tests/check_inode_order.sh
+#
+# Aim: Check that --inode-order, which looks
+#      the entries of each batch up sorted by
+#      inode, still prints them in directory
+#      order, across several batches and with
+#      each way of looking them up
+#
+# Usage: sh tests/check_inode_order.sh
+#
+#***********************************
+
+. "$(dirname "$0")/common.sh"
+
+
+
+#=== SECTION 1: Making the directory ===
+
+# Names are made in an order unrelated to the
+# inodes they get, and removing some leaves
+# holes for new ones to reuse
+DIR="$WORK_DIR/dir"
+
+mkdir "$DIR"
+
+(
+	cd "$DIR"
+	seq -f 'file%.0f' 1 3000 | sort -r | xargs touch
+	rm -f file1?? file2??
+	seq -f 'new%.0f' 1 300 | xargs touch
+	mkdir sub
+	ln -s file1 link
+	mkfifo fifo
+)
+
+
+
+#=== SECTION 2: Listing it ===
+
+# Lists the directory with the given options
+listDir()
+{
+	"$MYLS" --dir="$DIR" --fields=name,type,inode,links "$@"
+}
+
+
+listDir > "$WORK_DIR/expected" || fail "listing in directory order"
+
+expectEqual "$(grep -c '^File Name: ' "$WORK_DIR/expected")" 3103 \
+	    "entries listed"
+
+# Small batches make the sort run many times
+for options in "" "--batch-size=1024" "--enum=readdir" "--uring" \
+	       "-j3" "--sort=inode"
+do
+	listDir --inode-order $options > "$WORK_DIR/actual" \
+		|| fail "listing with --inode-order $options"
+
+	if [ "$options" = "--sort=inode" ]
+	then
+		listDir $options > "$WORK_DIR/expected.sorted"
+
+		expectSameFiles "$WORK_DIR/expected.sorted" \
+				"$WORK_DIR/actual" \
+				"listing with --inode-order $options"
+	else
+		expectSameFiles "$WORK_DIR/expected" "$WORK_DIR/actual" \
+				"listing with --inode-order $options"
+	fi
+done
+
+pass
@@ -0,0 +1,130 @@
+#!/bin/sh
+#***********************************
+#
+# File name: tests/check_links.sh
+#
+# Aim: Check that --links groups the listed
+#      names of each hard-linked file under its
+#      inode, reports only files listed by more
+#      than one name, and gives the same groups
+#      with -j, --uring and many files
+#
+# Usage: sh tests/check_links.sh
+#
+#***********************************
+
+. "$(dirname "$0")/common.sh"
+
+
+
+#=== SECTION 1: Making the tree ===
+
+DIR="$WORK_DIR/dir"
+
+mkdir "$DIR" "$DIR/sub"
+
+(
+	cd "$DIR"
+	echo 1 > a
+	ln a sub/b
+	ln a c
+	ln a sub/z
+	echo 2 > d
+	ln d sub/e
+	echo 3 > single
+	ln -s a symlink
+)
+
+# The device is printed as major:minor
+DEVICE=$(stat -c %d "$DIR")
+MAJOR=$(((DEVICE >> 8) & 0xfff))
+MINOR=$(((DEVICE & 0xff) | ((DEVICE >> 12) & 0xfff00)))
+
+INODE_A=$(stat -c %i "$DIR/a")
+INODE_D=$(stat -c %i "$DIR/d")
+
+
+
+#=== SECTION 2: The groups ===
+
+"$MYLS" --links -R --dir="$DIR" > "$WORK_DIR/actual" \
+	|| fail "listing with --links"
+
+cat > "$WORK_DIR/expected" << EOF
+
+Inode $INODE_A on device $MAJOR:$MINOR, 4 links, listed as:
+	$DIR/a
+	$DIR/c
+	$DIR/sub/b
+	$DIR/sub/z
+
+Inode $INODE_D on device $MAJOR:$MINOR, 2 links, listed as:
+	$DIR/d
+	$DIR/sub/e
+
+Files listed by more than one name: 2, by 6 names
+EOF
+
+expectSameFiles "$WORK_DIR/expected" "$WORK_DIR/actual" "text groups"
+
+
+for options in "-j4" "-j4 --unordered" "--uring" "--sort=size"
+do
+	"$MYLS" --links -R --dir="$DIR" $options > "$WORK_DIR/actual" \
+		|| fail "listing with --links $options"
+
+	expectSameFiles "$WORK_DIR/expected" "$WORK_DIR/actual" \
+			"text groups with $options"
+done
+
+
+# Without -R, d is listed by one name only
+"$MYLS" --links --format=jsonl --dir="$DIR" > "$WORK_DIR/actual" \
+	|| fail "listing with --links in JSON"
+
+expectEqual "$(cat "$WORK_DIR/actual")" \
+	    "{\"linked\":{\"major\":$MAJOR,\"minor\":$MINOR,\
+\"inode\":$INODE_A,\"links\":4,\"paths\":[\"$DIR/a\",\"$DIR/c\"]}}" \
+	    "JSON groups"
+
+
+# File arguments count as names, and entries
+# the filter rejects do not
+expectEqual "$("$MYLS" --links "$DIR/d" "$DIR/sub/e" "$DIR/single" \
+		| sed -n 2p)" \
+	    "Inode $INODE_D on device $MAJOR:$MINOR, 2 links, listed as:" \
+	    "groups of file arguments"
+
+expectEqual "$("$MYLS" --links -R --filter='name=[ab]' --dir="$DIR" \
+		| tail -1)" \
+	    "Files listed by more than one name: 1, by 2 names" \
+	    "groups with a filter"
+
+
+
+#=== SECTION 3: Many files ===
+
+# Every file of a gen_tree tree under a second
+# name, which grows the table of inodes many
+# times over
+if [ -x "$GEN_TREE" ]
+then
+	"$GEN_TREE" --files=500 --depth=1 --fanout=4 --mix=reg:1 \
+		"$WORK_DIR/tree" > /dev/null
+
+	cp -al "$WORK_DIR/tree" "$WORK_DIR/copy"
+
+	numFiles=$(find "$WORK_DIR/tree" -type f | wc -l)
+
+	for options in "" "-j4"
+	do
+		expectEqual "$("$MYLS" --links -R $options \
+				--dir="$WORK_DIR/tree" \
+				--dir="$WORK_DIR/copy" | tail -1)" \
+			    "Files listed by more than one name: $numFiles,\
+ by $((2 * numFiles)) names" \
+			    "groups of the tree and its copy $options"
+	done
+fi
+
+pass
@@ -0,0 +1,146 @@
+#!/bin/sh
+#***********************************
+#
+# File name: tests/check_recursive.sh
+#
+# Aim: Check that -R lists a deep synthetic
+#      tree, deeper than PATH_MAX allows a path
+#      to be, the same way with every directory
+#      backend and with the parallel walk, and
+#      that a symbolic link looping back up the
+#      tree is listed but not followed
+#
+# Usage: sh tests/check_recursive.sh [DEPTH]
+#
+#***********************************
+
+. "$(dirname "$0")/common.sh"
+
+# Levels made by each mkdir -p, short enough for
+# one path. DEPTH is rounded up to a multiple
+LEVELS_PER_STEP=100
+
+DEPTH=${1:-3000}
+DEPTH=$(((DEPTH + LEVELS_PER_STEP - 1) / LEVELS_PER_STEP \
+	 * LEVELS_PER_STEP))
+
+
+
+#=== SECTION 1: Making the tree ===
+
+# A chain of DEPTH directories named 'd', with a
+# file 'f' in each. It is made a few levels at a
+# time, from inside the deepest one so far, as
+# the whole path would be too long
+TREE="$WORK_DIR/tree"
+
+mkdir "$TREE"
+
+stepDirs=""
+stepFiles=""
+level=1
+
+while [ "$level" -le "$LEVELS_PER_STEP" ]
+do
+	stepDirs="${stepDirs}d/"
+	stepFiles="$stepFiles ${stepDirs}f"
+	level=$((level + 1))
+done
+
+(
+	cd "$TREE"
+	touch f
+	level=0
+
+	while [ "$level" -lt "$DEPTH" ]
+	do
+		mkdir -p "$stepDirs"
+		touch $stepFiles
+		cd -P "$stepDirs"
+		level=$((level + LEVELS_PER_STEP))
+	done
+
+	# Three levels back up the chain
+	ln -s "../../.." loop
+)
+
+ln -s . "$TREE/self"
+
+# A wider part, with every type of entry
+if [ -x "$GEN_TREE" ]
+then
+	"$GEN_TREE" --files=300 --depth=2 --fanout=3 "$TREE/wide" \
+		> /dev/null
+fi
+
+
+
+
+#=== SECTION 2: Listing it ===
+
+# Lists the tree with the given options
+listTree()
+{
+	"$MYLS" -R --dir="$TREE" --fields=name,type,size "$@"
+}
+
+# Prefixes every entry with its directory and
+# sorts them, for the listings whose entries
+# or directories come in no fixed order.
+# Headings and entries are paragraphs, and a
+# heading is the one line paragraph ending
+# in ':'
+sortByDir()
+{
+	awk 'BEGIN { RS = "" }
+	     /:$/ && !/\n/ { dir = $0; next }
+	     { gsub(/\n/, " "); print dir " " $0 }' "$1" \
+		| LC_ALL=C sort
+}
+
+
+listTree > "$WORK_DIR/expected" \
+	|| fail "listing with the getdents64() backend"
+
+numDirs=$(grep -c ':$' "$WORK_DIR/expected" || true)
+
+numWideDirs=0
+
+if [ -d "$TREE/wide" ]
+then
+	numWideDirs=$(find "$TREE/wide" -type d | wc -l)
+fi
+
+expectEqual "$numDirs" $((DEPTH + 1 + numWideDirs)) \
+	    "directories listed"
+
+expectEqual "$(grep -A1 -x 'File Name: loop' "$WORK_DIR/expected" \
+	       | grep -c -x 'Type of file: Symbolic Link')" 1 \
+	    "loop link listed"
+
+
+for options in "--enum=readdir" "--batch-size=512" "--uring" \
+	       "--inode-order"
+do
+	listTree $options > "$WORK_DIR/actual" \
+		|| fail "listing with $options"
+
+	expectSameFiles "$WORK_DIR/expected" "$WORK_DIR/actual" \
+			"listing with $options"
+done
+
+
+sortByDir "$WORK_DIR/expected" > "$WORK_DIR/expected.sorted"
+
+for options in "-j4" "-j4 --unordered" "--sort=name" "-j2 --uring"
+do
+	listTree $options > "$WORK_DIR/actual" \
+		|| fail "listing with $options"
+
+	sortByDir "$WORK_DIR/actual" > "$WORK_DIR/actual.sorted"
+
+	expectSameFiles "$WORK_DIR/expected.sorted" \
+			"$WORK_DIR/actual.sorted" "listing with $options"
+done
+
+pass
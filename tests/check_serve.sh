@@ -0,0 +1,287 @@
+#!/bin/sh
+#***********************************
+#
+# File name: tests/check_serve.sh
+#
+# Aim: Check that a myls daemon answers as myls
+#      lists, in every format and past the size
+#      of the replies it holds in memory, that
+#      errors reach the client and make
+#      mylsclient fail, and that a client which
+#      does not read, or sends its request too
+#      slowly, holds up no other, that the
+#      age windows of --filter move on with
+#      each request, and that only the daemon's
+#      user is served
+#
+# Usage: sh tests/check_serve.sh
+#
+#***********************************
+
+. "$(dirname "$0")/common.sh"
+
+
+
+#=== SECTION 1: Making the files and starting the daemon ===
+
+DIR="$WORK_DIR/dir"
+
+SOCKET="$WORK_DIR/myls.sock"
+
+mkdir "$DIR" "$DIR/sub"
+
+(
+	cd "$DIR"
+	echo text > a
+	touch 'sp ace' "$(printf 'quo"te')" sub/inner
+	ln -s a link
+	mkfifo pipe
+)
+
+# More than the 4 MiB a reply is held in
+# memory for, as text
+if [ -x "$GEN_TREE" ]
+then
+	"$GEN_TREE" --files=15000 --depth=0 "$DIR/big" > /dev/null
+fi
+
+# Reading the directories sets their access
+# times, which are then listed unchanged
+"$MYLS" -R --dir="$DIR" > /dev/null
+
+
+(cd "$DIR" && exec "$MYLS" --serve="$SOCKET" 2> "$WORK_DIR/daemon.err") &
+
+BACKGROUND_PIDS="$!"
+
+waited=0
+
+while [ ! -S "$SOCKET" ]
+do
+	[ $waited -lt 50 ] || fail "the daemon did not start"
+	sleep 0.1
+	waited=$((waited + 1))
+done
+
+
+# Lists with mylsclient, passing on its options
+# and paths
+serve()
+{
+	"$MYLSCLIENT" "$SOCKET" "$@"
+}
+
+# Lists with myls from inside the directory
+listHere()
+{
+	(cd "$DIR" && "$MYLS" "$@")
+}
+
+
+
+#=== SECTION 2: The same listings as myls ===
+
+for format in text jsonl
+do
+	serve --format=$format -d . -d sub a link \
+		> "$WORK_DIR/actual" || fail "serving $format"
+
+	listHere --format=$format --dir=. --dir=sub a link \
+		> "$WORK_DIR/expected"
+
+	expectSameFiles "$WORK_DIR/expected" "$WORK_DIR/actual" \
+			"served $format listing"
+done
+
+serve --format=bin -d . -d sub a link | "$MYLSREAD" --format=jsonl \
+	> "$WORK_DIR/actual" || fail "serving bin"
+
+expectSameFiles "$WORK_DIR/expected" "$WORK_DIR/actual" \
+		"served bin listing"
+
+if [ -d "$DIR/big" ]
+then
+	serve -d big > "$WORK_DIR/actual" || fail "serving a long listing"
+
+	listHere --dir=big > "$WORK_DIR/expected"
+
+	expectSameFiles "$WORK_DIR/expected" "$WORK_DIR/actual" \
+			"served listing of the large directory"
+fi
+
+
+
+#=== SECTION 3: Errors reach the client ===
+
+if serve --format=jsonl --fields=name a missing -d a \
+	> "$WORK_DIR/actual"
+then
+	fail "mylsclient succeeded with errors"
+fi
+
+cat > "$WORK_DIR/expected" << 'EOF'
+{"name":"a"}
+{"error":"Cannot access 'missing': No such file or directory"}
+{"dir":"a"}
+{"error":"Failed to open directory 'a': Not a directory"}
+EOF
+
+expectSameFiles "$WORK_DIR/expected" "$WORK_DIR/actual" \
+		"errors in a jsonl reply"
+
+# The text is what myls prints on stderr
+serve --fields=name missing > "$WORK_DIR/actual" || true
+
+listHere --fields=name missing > "$WORK_DIR/expected" 2>&1 || true
+
+expectSameFiles "$WORK_DIR/expected" "$WORK_DIR/actual" \
+		"errors in a text reply"
+
+if serve --format=bin --fields=name missing \
+	| "$MYLSREAD" > "$WORK_DIR/actual"
+then
+	fail "mylsread succeeded with error records"
+fi
+
+expectEqual "$(cat "$WORK_DIR/actual")" \
+	    "{\"error\":\"Cannot access 'missing': No such file or directory\"}" \
+	    "errors in a bin reply"
+
+if serve --format=bogus a > "$WORK_DIR/actual"
+then
+	fail "mylsclient succeeded with an invalid request"
+fi
+
+expectEqual "$(cat "$WORK_DIR/actual")" \
+	    "myls: Invalid request: format=bogus" "invalid request"
+
+# None of them went to the daemon's stderr
+if grep -q "Cannot access\|Failed to open" "$WORK_DIR/daemon.err"
+then
+	fail "errors went to the daemon's stderr"
+fi
+
+
+
+#=== SECTION 4: Clients that hold up their own answer only ===
+
+# A client whose stdout is not read stops
+# reading its reply, while another is served
+if [ -d "$DIR/big" ]
+then
+	serve -d big 2> /dev/null | sleep 30 &
+
+	BACKGROUND_PIDS="$BACKGROUND_PIDS $!"
+
+	sleep 1
+
+	timeout 3 "$MYLSCLIENT" --fields=name "$SOCKET" a \
+		> "$WORK_DIR/actual" \
+		|| fail "a client was held up by one not reading"
+
+	expectEqual "$(cat "$WORK_DIR/actual")" \
+		    "$(listHere --fields=name a)" \
+		    "reply next to a client not reading"
+fi
+
+# A request sent a byte at a time is cut off
+# once its time is up, while another is served
+if command -v python3 > /dev/null
+then
+	python3 - "$SOCKET" > "$WORK_DIR/actual" << 'PYEOF' &
+import socket, sys, time
+
+client = socket.socket(socket.AF_UNIX)
+client.connect(sys.argv[1])
+start = time.time()
+
+try:
+    while time.time() - start < 10:
+        client.send(b"d")
+        time.sleep(0.5)
+except OSError:
+    pass
+
+reply = b""
+
+while True:
+    data = client.recv(4096)
+    if not data:
+        break
+    reply += data
+
+print(reply.split(b"\0")[0].decode().strip(), int(time.time() - start))
+PYEOF
+
+	slowPid=$!
+
+	sleep 1
+
+	timeout 3 "$MYLSCLIENT" --fields=name "$SOCKET" a > /dev/null \
+		|| fail "a client was held up by a slow request"
+
+	wait $slowPid || fail "sending a slow request"
+
+	expectEqual "$(cat "$WORK_DIR/actual")" \
+		    "myls: Invalid request: too large or too slow 5" \
+		    "slow request"
+fi
+
+
+
+#=== SECTION 5: Age windows counted from each request ===
+
+FILTER_SOCKET="$WORK_DIR/filter.sock"
+
+(cd "$DIR" && exec "$MYLS" --serve="$FILTER_SOCKET" --filter='mtime=..2s' \
+	2> /dev/null) &
+
+BACKGROUND_PIDS="$BACKGROUND_PIDS $!"
+
+waited=0
+
+while [ ! -S "$FILTER_SOCKET" ]
+do
+	[ $waited -lt 50 ] || fail "the filtering daemon did not start"
+	sleep 0.1
+	waited=$((waited + 1))
+done
+
+touch "$DIR/sub/inner"
+
+expectEqual "$("$MYLSCLIENT" --fields=name "$FILTER_SOCKET" sub/inner \
+		| grep .)" \
+	    "File Name: sub/inner" "file within the age window"
+
+sleep 3
+
+expectEqual "$("$MYLSCLIENT" --fields=name "$FILTER_SOCKET" sub/inner \
+		| grep .)" \
+	    "" "file past the age window"
+
+
+
+#=== SECTION 6: Only the daemon's user served ===
+
+expectEqual "$(stat -c %a "$SOCKET")" "700" "mode of the socket"
+
+# Run as root, a client of another user is let
+# past the mode of the socket, to be turned
+# away by the daemon itself
+if [ "$(id -u)" -eq 0 ] && command -v setpriv > /dev/null
+then
+	chmod 755 "$WORK_DIR"
+	chmod 777 "$SOCKET"
+	cp "$MYLSCLIENT" "$WORK_DIR/mylsclient"
+
+	if setpriv --reuid=65534 --regid=65534 --clear-groups \
+		"$WORK_DIR/mylsclient" "$SOCKET" a > "$WORK_DIR/actual"
+	then
+		fail "a client of another user was served"
+	fi
+
+	expectEqual "$(cat "$WORK_DIR/actual")" "myls: Permission denied" \
+		    "client of another user"
+fi
+
+pass
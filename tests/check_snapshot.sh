@@ -0,0 +1,117 @@
+#!/bin/sh
+#***********************************
+#
+# File name: tests/check_snapshot.sh
+#
+# Aim: Check that --since-snapshot prints
+#      exactly what a fresh listing prints,
+#      reusing unchanged directories whole and
+#      looking up only the new entries of the
+#      others, and that a damaged snapshot is
+#      ignored
+#
+# Usage: sh tests/check_snapshot.sh
+#
+#***********************************
+
+. "$(dirname "$0")/common.sh"
+
+
+
+#=== SECTION 1: Making the tree and its snapshot ===
+
+TREE="$WORK_DIR/tree"
+
+SNAPSHOT="$WORK_DIR/tree.snapshot"
+
+mkdir "$TREE" "$TREE/kept" "$TREE/added" "$TREE/renamed" \
+      "$TREE/replaced"
+
+(
+	cd "$TREE"
+	touch kept/one kept/two added/one renamed/one renamed/two \
+	      replaced/one
+	ln -s kept link
+	mkfifo fifo
+)
+
+# A directory changed less than a second
+# before the snapshot is read again anyway
+sleep 1.1
+
+# Reading the directories sets their access
+# times, which are then listed unchanged
+"$MYLS" -R --dir="$TREE" > /dev/null
+
+"$MYLS" -R --dir="$TREE" --snapshot="$SNAPSHOT" > /dev/null \
+	|| fail "writing the snapshot"
+
+
+# Lists the tree with the given options,
+# keeping the counters of --stats
+listTree()
+{
+	"$MYLS" -R --dir="$TREE" --stats "$@" 2> "$WORK_DIR/stats"
+}
+
+# Prints the snapshot counters of --stats
+snapshotStats()
+{
+	grep '^myls: snapshot:' "$WORK_DIR/stats" || true
+}
+
+
+
+#=== SECTION 2: Listing it unchanged ===
+
+listTree > "$WORK_DIR/expected"
+
+listTree --since-snapshot="$SNAPSHOT" > "$WORK_DIR/actual" \
+	|| fail "listing an unchanged tree"
+
+expectSameFiles "$WORK_DIR/expected" "$WORK_DIR/actual" \
+		"listing of an unchanged tree"
+
+expectEqual "$(snapshotStats)" \
+	    "myls: snapshot: 5 directories reused, 0 read, 12 entries reused, 0 looked up" \
+	    "counters of an unchanged tree"
+
+
+
+#=== SECTION 3: Listing it changed ===
+
+# A new name, a renamed entry and an entry
+# whose name now has another inode
+(
+	cd "$TREE"
+	touch added/two
+	mv renamed/two renamed/three
+	touch replaced/new
+	mv replaced/new replaced/one
+)
+
+listTree > "$WORK_DIR/expected"
+
+listTree --since-snapshot="$SNAPSHOT" > "$WORK_DIR/actual" \
+	|| fail "listing a changed tree"
+
+expectSameFiles "$WORK_DIR/expected" "$WORK_DIR/actual" \
+		"listing of a changed tree"
+
+expectEqual "$(snapshotStats)" \
+	    "myls: snapshot: 2 directories reused, 3 read, 10 entries reused, 3 looked up" \
+	    "counters of a changed tree"
+
+
+
+#=== SECTION 4: A damaged snapshot is ignored ===
+
+head -c 100 "$SNAPSHOT" > "$WORK_DIR/damaged.snapshot"
+
+listTree --since-snapshot="$WORK_DIR/damaged.snapshot" \
+	> "$WORK_DIR/actual" || fail "listing with a damaged snapshot"
+
+expectSameFiles "$WORK_DIR/expected" "$WORK_DIR/actual" \
+		"listing with a damaged snapshot"
+
+pass
@@ -0,0 +1,146 @@
+#!/bin/sh
+#***********************************
+#
+# File name: tests/check_summary.sh
+#
+# Aim: Check the totals of --summary per type
+#      and per age, that a hard-linked file is
+#      counted once, the largest files with
+#      their ties, the JSON Lines form, and
+#      that -j and --uring give the same
+#      summary as a serial listing
+#
+# Usage: sh tests/check_summary.sh
+#
+#***********************************
+
+. "$(dirname "$0")/common.sh"
+
+
+
+#=== SECTION 1: Making the tree ===
+
+DIR="$WORK_DIR/dir"
+
+mkdir "$DIR" "$DIR/sub"
+
+(
+	cd "$DIR"
+	truncate -s 100 old
+	truncate -s 300 linked
+	truncate -s 300 sub/tied
+	ln linked linked2
+	touch -d '2 days ago' old
+	mkfifo pipe
+	ln -s old link
+)
+
+SUB_SIZE=$(stat -c %s "$DIR/sub")
+
+
+
+#=== SECTION 2: The totals ===
+
+# old, linked, pipe, link, sub and sub/tied are
+# counted, linked2 only as another name
+"$MYLS" --summary=2 -R --dir="$DIR" > "$WORK_DIR/actual" \
+	|| fail "listing with --summary"
+
+cat > "$WORK_DIR/expected" << EOF
+
+Entries: 6
+Total size (bytes): $((703 + SUB_SIZE))
+Other names of linked files, not counted: 1
+Named Pipe: 1 entries, 0 bytes
+Directory: 1 entries, $SUB_SIZE bytes
+Regular: 3 entries, 700 bytes
+Symbolic Link: 1 entries, 3 bytes
+Modified under 1 hour ago: 5 entries, $((603 + SUB_SIZE)) bytes
+Modified 1 hour to 1 day ago: 0 entries, 0 bytes
+Modified 1 day to 1 week ago: 1 entries, 100 bytes
+Modified 1 week to 30 days ago: 0 entries, 0 bytes
+Modified 30 days to 1 year ago: 0 entries, 0 bytes
+Modified over 1 year ago: 0 entries, 0 bytes
+Large file: 300 bytes, $DIR/linked
+Large file: 300 bytes, $DIR/sub/tied
+
+EOF
+
+# Whichever name of the linked file comes first
+# is counted
+sed "s|$DIR/linked2|$DIR/linked|" "$WORK_DIR/actual" \
+	> "$WORK_DIR/actual.names"
+
+expectSameFiles "$WORK_DIR/expected" "$WORK_DIR/actual.names" \
+		"text summary"
+
+
+"$MYLS" --summary=1 --format=jsonl --filter='type=f' --dir="$DIR" \
+	> "$WORK_DIR/actual" || fail "listing with --summary in JSON"
+
+sed "s|$DIR/linked2|$DIR/linked|" "$WORK_DIR/actual" \
+	> "$WORK_DIR/actual.names"
+
+expectEqual "$(cat "$WORK_DIR/actual.names")" \
+	    "{\"summary\":{\"entries\":2,\"bytes\":400,\"links_skipped\":1,\
+\"types\":[{\"type\":\"Regular\",\"entries\":2,\"bytes\":400}],\
+\"ages\":[{\"max_age\":3600,\"entries\":1,\"bytes\":300},\
+{\"max_age\":86400,\"entries\":0,\"bytes\":0},\
+{\"max_age\":604800,\"entries\":1,\"bytes\":100},\
+{\"max_age\":2592000,\"entries\":0,\"bytes\":0},\
+{\"max_age\":31536000,\"entries\":0,\"bytes\":0},\
+{\"max_age\":null,\"entries\":0,\"bytes\":0}],\
+\"largest\":[{\"path\":\"$DIR/linked\",\"size\":300}]}}" \
+	    "JSON summary of the regular files"
+
+
+
+#=== SECTION 3: The same whatever the backend ===
+
+# A larger tree, without hard links, whose
+# files have few distinct sizes so that the
+# largest tie
+if [ -x "$GEN_TREE" ]
+then
+	"$GEN_TREE" --files=400 --depth=2 --fanout=3 --size=4096 \
+		"$WORK_DIR/tree" > /dev/null
+
+	"$MYLS" --summary=20 -R --dir="$WORK_DIR/tree" \
+		> "$WORK_DIR/expected" || fail "summary of the tree"
+
+	for options in "-j4" "-j4 --unordered" "--uring" "--enum=readdir"
+	do
+		"$MYLS" --summary=20 -R --dir="$WORK_DIR/tree" $options \
+			> "$WORK_DIR/actual" \
+			|| fail "summary of the tree with $options"
+
+		expectSameFiles "$WORK_DIR/expected" "$WORK_DIR/actual" \
+				"summary of the tree with $options"
+	done
+
+
+	# A hard-linked copy, so that the threads
+	# of -j meet other names of the same
+	# inodes at once, each counted once
+	cp -al "$WORK_DIR/tree" "$WORK_DIR/copy"
+
+	"$MYLS" --summary=20 -R --dir="$WORK_DIR/tree" \
+		--dir="$WORK_DIR/copy" > "$WORK_DIR/expected" \
+		|| fail "summary of the tree and its copy"
+
+	"$MYLS" --summary=20 -R --dir="$WORK_DIR/tree" \
+		--dir="$WORK_DIR/copy" -j8 > "$WORK_DIR/actual" \
+		|| fail "summary of the tree and its copy with -j8"
+
+	expectSameFiles "$WORK_DIR/expected" "$WORK_DIR/actual" \
+			"summary of the tree and its copy with -j8"
+fi
+
+
+# Nothing to summarise in binary records
+if "$MYLS" --summary --format=bin --dir="$DIR" > /dev/null 2>&1
+then
+	fail "--summary was accepted with --format=bin"
+fi
+
+pass
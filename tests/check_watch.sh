@@ -0,0 +1,123 @@
+#!/bin/sh
+#***********************************
+#
+# File name: tests/check_watch.sh
+#
+# Aim: Check that --watch, after the first
+#      listing, prints exactly one record for
+#      each entry changed by a burst of writes,
+#      renames, or a creation and removal,
+#      within the coalescing window
+#
+# Usage: sh tests/check_watch.sh
+#
+#***********************************
+
+. "$(dirname "$0")/common.sh"
+
+# Long enough for each burst below to fall
+# within one window
+WINDOW_MS=500
+
+# How long a record may take to appear, in
+# tenths of a second
+WAIT_LIMIT=50
+
+
+
+#=== SECTION 1: Starting the watch ===
+
+DIR="$WORK_DIR/dir"
+OUTPUT="$WORK_DIR/output"
+
+mkdir "$DIR"
+touch "$DIR/a" "$DIR/b" "$DIR/c"
+
+"$MYLS" --watch --watch-window=$WINDOW_MS --dir="$DIR" \
+	--format=jsonl --fields=name,size > "$OUTPUT" 2>&1 &
+
+BACKGROUND_PIDS=$!
+
+
+# Waits until the output has $1 lines, then for
+# two more windows, so that a record that should
+# not be there has the time to show up
+waitForLines()
+{
+	waited=0
+
+	while [ "$(wc -l < "$OUTPUT")" -lt "$1" ]
+	do
+		if [ "$waited" -ge "$WAIT_LIMIT" ]
+		then
+			cat "$OUTPUT" >&2
+			fail "waiting for $1 lines of output"
+		fi
+
+		sleep 0.1
+		waited=$((waited + 1))
+	done
+
+	sleep 1
+
+	expectEqual "$(wc -l < "$OUTPUT")" "$1" "lines of output"
+}
+
+# Fails unless line $1 of the output is $2
+expectLine()
+{
+	expectEqual "$(sed -n "${1}p" "$OUTPUT")" "$2" "line $1"
+}
+
+
+waitForLines 3
+
+
+
+#=== SECTION 2: Changing entries in bursts ===
+
+# Many writes to one file
+i=0
+
+while [ $i -lt 50 ]
+do
+	echo x >> "$DIR/a"
+	i=$((i + 1))
+done
+
+waitForLines 4
+
+expectLine 4 "{\"name\":\"$DIR/a\",\"size\":100}"
+
+
+# A rename, seen as the old name removed and
+# the new one created
+mv "$DIR/b" "$DIR/renamed"
+
+waitForLines 6
+
+expectEqual "$(sed -n '5,6p' "$OUTPUT" | LC_ALL=C sort)" \
+	    "$(printf '%s\n%s' \
+		      "{\"name\":\"$DIR/renamed\",\"size\":0}" \
+		      "{\"removed\":\"$DIR/b\"}")" \
+	    "records of the rename"
+
+
+# A file made and removed again within the
+# window, and writes to two others
+touch "$DIR/short-lived"
+echo x >> "$DIR/c"
+echo x >> "$DIR/renamed"
+rm "$DIR/short-lived"
+echo x >> "$DIR/c"
+
+waitForLines 9
+
+expectEqual "$(sed -n '7,9p' "$OUTPUT" | LC_ALL=C sort)" \
+	    "$(printf '%s\n%s\n%s' \
+		      "{\"name\":\"$DIR/c\",\"size\":4}" \
+		      "{\"name\":\"$DIR/renamed\",\"size\":2}" \
+		      "{\"removed\":\"$DIR/short-lived\"}")" \
+	    "records of the mixed burst"
+
+pass
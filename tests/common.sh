@@ -0,0 +1,100 @@
+#***********************************
+#
+# File name: tests/common.sh
+#
+# Aim: Shared setup of the tests under tests/,
+#      which source it: the binaries to run, a
+#      work directory under /tmp removed on exit,
+#      and the checks that end a test with a
+#      message when they fail
+#
+#      MYLS, MYLSREAD, MYLSCLIENT and GEN_TREE
+#      select the binaries (default ./myls,
+#      ./mylsread, ./mylsclient and ./gen_tree,
+#      as built by make)
+#
+#***********************************
+
+set -eu
+
+TEST_NAME=$(basename "$0" .sh)
+
+# Makes a path absolute, so that it still
+# works after a cd
+absolutePath()
+{
+	echo "$(cd "$(dirname "$1")" && pwd)/$(basename "$1")"
+}
+
+MYLS=$(absolutePath "${MYLS:-./myls}")
+MYLSREAD=$(absolutePath "${MYLSREAD:-./mylsread}")
+MYLSCLIENT=$(absolutePath "${MYLSCLIENT:-./mylsclient}")
+GEN_TREE=$(absolutePath "${GEN_TREE:-./gen_tree}")
+
+if [ ! -x "$MYLS" ]
+then
+	echo "$TEST_NAME: '$MYLS' not found, build it first" \
+	     "or set MYLS" >&2
+	exit 1
+fi
+
+
+WORK_DIR=$(mktemp -d "/tmp/myls-$TEST_NAME.XXXXXX")
+
+# Processes started in the background by a test
+# are stopped with it
+BACKGROUND_PIDS=""
+
+cleanup()
+{
+	for pid in $BACKGROUND_PIDS
+	do
+		kill "$pid" 2>/dev/null || true
+		wait "$pid" 2>/dev/null || true
+	done
+
+	rm -rf "$WORK_DIR"
+}
+
+trap cleanup EXIT
+trap 'exit 1' INT TERM
+
+
+
+#=== Checks ===
+
+# Ends the test with a message
+fail()
+{
+	echo "$TEST_NAME: FAILED: $*" >&2
+	exit 1
+}
+
+# Fails unless files $1 and $2 are identical,
+# showing how they differ. $3 says what was
+# compared
+expectSameFiles()
+{
+	if ! cmp -s "$1" "$2"
+	then
+		diff "$1" "$2" | head -20 >&2 || true
+		fail "$3"
+	fi
+}
+
+# Fails unless $1 equals $2. $3 says what was
+# compared
+expectEqual()
+{
+	if [ "$1" != "$2" ]
+	then
+		fail "$3: got '$1', expected '$2'"
+	fi
+}
+
+# Ends the test as passed
+pass()
+{
+	echo "$TEST_NAME: ok"
+	exit 0
+}
@@ -0,0 +1,506 @@
+/***********************************
+*
+* File name: tests/test_dates.c
+*
+* Aim: Check that convertTimeToDateString()
+*      and its day cache give the same strings
+*      as the localtime_r() formatting they
+*      replaced, in time zones with daylight
+*      saving, around each of their
+*      transitions and around the new year
+*
+* Build: gcc -O2 -pthread -o test_dates tests/test_dates.c
+*
+* Usage: ./test_dates [TZ]...
+*
+*	 Each time zone is checked in a process
+*	 of its own, as the time zone is read
+*	 once per process. Without arguments, a
+*	 built-in list is checked
+*
+***********************************/
+
+
+//Only the functions of myls are needed
+#define MYLS_NO_MAIN
+
+#include "../myls.c"
+
+
+//For waitpid()
+#include <sys/wait.h>
+
+
+
+
+//Number of times checked at random, over
+// about 550 years either side of 1970
+#define NUM_RANDOM_TIMES 100000
+
+#define RANDOM_TIME_RANGE (1LL << 34)
+
+
+//Mismatches printed per time zone before the
+// rest are only counted
+#define MAX_REPORTED_MISMATCHES 10
+
+
+//Most transitions found in the checked years
+#define MAX_TRANSITIONS 64
+
+
+
+	/*------------------------------------------------
+	 Time zones with transitions forwards and
+	 backwards, by half an hour, at midnight (so
+	 that a day has no 00:00), in the southern
+	 hemisphere and with a negative daylight
+	 saving offset. The POSIX rules work without
+	 the zoneinfo files
+	------------------------------------------------*/
+static const char * const defaultTimeZones[] =
+{
+	"UTC0",
+	"EST5EDT,M3.2.0,M11.1.0",
+	"CET-1CEST,M3.5.0,M10.5.0/3",
+	"<+1030>-10:30<+11>-11,M10.1.0,M4.1.0",
+	"<-03>3<-02>,M10.3.0/0,M2.3.0/0",
+	"America/New_York",
+	"Europe/London",
+	"Europe/Dublin",
+	"Australia/Lord_Howe",
+	"America/Sao_Paulo",
+	"Asia/Kolkata"
+};
+
+
+	/*------------------------------------------------
+	 Years whose transitions are checked
+	------------------------------------------------*/
+static const int checkedYears[] =
+{
+	1969, 1970, 1999, 2000, 2024, 2025, 2026, 2037, 2038
+};
+
+
+//Mismatches found in this process
+static unsigned long numMismatches = 0;
+
+static unsigned long numChecked = 0;
+
+
+
+
+	/*------------------------------------------------
+	 Brief: The implementation from before the day
+		cache, kept here as the reference,
+		except that the current year is given
+	------------------------------------------------*/
+void legacyConvertTimeToDateString(char * dateString,
+				   time_t givenTime, int currentYear);
+
+
+	/*------------------------------------------------
+	 Brief: Compares the string of 'givenTime' with
+		the reference, counting and reporting a
+		mismatch
+	------------------------------------------------*/
+void checkTime(time_t givenTime, int currentYear);
+
+
+	/*------------------------------------------------
+	 Brief: Checks every minute of the day either
+		side of 'centreTime', and every
+		second of the two minutes either side
+	------------------------------------------------*/
+void checkAround(time_t centreTime, int currentYear);
+
+
+	/*------------------------------------------------
+	 Brief: Checks the time zone in TZ, returning
+		0 if every time matched
+	------------------------------------------------*/
+int checkTimeZone(const char * timeZone);
+
+
+	/*------------------------------------------------
+	 Brief: Stores in 'transitions' the times at
+		which the offset from UTC changes during
+		the checked years, found hour by hour and
+		then to the second, and returns how many
+		there are
+	------------------------------------------------*/
+int findTransitions(time_t * transitions);
+
+
+	/*------------------------------------------------
+	 Brief: Returns local midnight on the 1st of
+		January of 'year'
+	------------------------------------------------*/
+time_t getYearStart(int year);
+
+
+
+
+int main(int argc, char * argv[])
+{
+
+	/*=============================================
+	 SECTION 1: Declaration of variables
+	==============================================*/
+
+	const char * const * timeZones = defaultTimeZones;
+
+	int numTimeZones = sizeof(defaultTimeZones)
+			   / sizeof(defaultTimeZones[0]);
+
+	int numFailed = 0;
+
+	int childStatus;
+
+	pid_t childPid;
+
+
+
+	if (argc > 1)
+	{
+		timeZones = (const char * const *) (argv + 1);
+
+		numTimeZones = argc - 1;
+	}
+
+
+
+	/*=============================================
+	 SECTION 2: Checking each time zone in a
+		    child, which reads TZ afresh
+	==============================================*/
+	for (int index = 0; index < numTimeZones; index++)
+	{
+		fflush(stdout);
+
+		childPid = fork();
+
+		if (childPid == -1)
+		{
+			perror("test_dates");
+
+			return 1;
+		}
+
+		if (childPid == 0)
+		{
+			_exit(checkTimeZone(timeZones[index]));
+		}
+
+
+		if (waitpid(childPid, &childStatus, 0) == -1
+		    || !WIFEXITED(childStatus)
+		    || WEXITSTATUS(childStatus) != 0)
+		{
+			numFailed++;
+		}
+	}
+
+
+
+	/*=============================================
+	 SECTION 3: Reporting
+	==============================================*/
+	printf("%d of %d time zones failed\n", numFailed, numTimeZones);
+
+
+	return numFailed == 0 ? 0 : 1;
+}
+
+
+/*---------------------------------------------------------*/
+
+int checkTimeZone(const char * timeZone)
+{
+
+	struct tm brokenDownTime;
+
+	time_t transitions[MAX_TRANSITIONS];
+
+	time_t currentTimes[3];
+
+	int numTransitions;
+
+	int currentYear;
+
+	unsigned long long seed = 12345;
+
+	long long randomTime;
+
+
+
+	/*=============================================
+	 SECTION 1: Reading the time zone. The first
+		    update runs initTimeFormatting()
+	==============================================*/
+	setenv("TZ", timeZone, 1);
+
+	updateTimeFormattingYear();
+
+	numTransitions = findTransitions(transitions);
+
+
+	//The current year is moved back and forth,
+	// as --serve and --watch do across a new
+	// year, so that times are formatted against
+	// several of them
+	currentTimes[0] = time(NULL);
+
+	currentTimes[1] = getYearStart(2000);
+
+	currentTimes[2] = getYearStart(2026) - 1;
+
+
+	for (int currentIndex = 0; currentIndex < 3; currentIndex++)
+	{
+		setTimeFormattingYear(currentTimes[currentIndex]);
+
+		localtime_r(&currentTimes[currentIndex], &brokenDownTime);
+
+		currentYear = 1900 + brokenDownTime.tm_year;
+
+
+
+		/*=====================================
+		 SECTION 2: Around each transition,
+			    and around each new year
+		======================================*/
+		for (int index = 0; index < numTransitions; index++)
+		{
+			checkAround(transitions[index], currentYear);
+		}
+
+		for (size_t yearIndex = 0;
+		     yearIndex < sizeof(checkedYears)
+				 / sizeof(checkedYears[0]);
+		     yearIndex++)
+		{
+			checkAround(getYearStart(checkedYears[yearIndex]),
+				    currentYear);
+		}
+
+
+
+		/*=====================================
+		 SECTION 3: At random, in an order
+			    that makes the cache both
+			    hit and miss
+		======================================*/
+		for (int index = 0; index < NUM_RANDOM_TIMES; index++)
+		{
+			seed = seed * 6364136223846793005ULL
+			       + 1442695040888963407ULL;
+
+			randomTime = (long long) (seed >> 28)
+				     % (2 * RANDOM_TIME_RANGE)
+				     - RANDOM_TIME_RANGE;
+
+			checkTime((time_t) randomTime, currentYear);
+		}
+	}
+
+
+
+	/*=============================================
+	 SECTION 4: Reporting. The output is flushed
+		    here, as the child ends with
+		    _exit()
+	==============================================*/
+	printf("%-40s %2d transitions, %lu times, %lu mismatches\n",
+	       timeZone, numTransitions, numChecked, numMismatches);
+
+	fflush(stdout);
+
+
+	return numMismatches == 0 ? 0 : 1;
+}
+
+
+/*---------------------------------------------------------*/
+
+int findTransitions(time_t * transitions)
+{
+
+	struct tm brokenDownTime;
+
+	time_t searchTime;
+
+	time_t searchEnd;
+
+	time_t lowTime;
+
+	time_t highTime;
+
+	time_t middleTime;
+
+	long startOffset;
+
+	int numTransitions = 0;
+
+
+
+	for (size_t yearIndex = 0;
+	     yearIndex < sizeof(checkedYears) / sizeof(checkedYears[0]);
+	     yearIndex++)
+	{
+		searchEnd = getYearStart(checkedYears[yearIndex] + 1);
+
+		for (searchTime = getYearStart(checkedYears[yearIndex]);
+		     searchTime < searchEnd
+		     && numTransitions < MAX_TRANSITIONS;
+		     searchTime += 3600)
+		{
+			localtime_r(&searchTime, &brokenDownTime);
+
+			startOffset = brokenDownTime.tm_gmtoff;
+
+			highTime = searchTime + 3600;
+
+			localtime_r(&highTime, &brokenDownTime);
+
+			if (brokenDownTime.tm_gmtoff == startOffset)
+			{
+				continue;
+			}
+
+
+			lowTime = searchTime;
+
+			while (highTime - lowTime > 1)
+			{
+				middleTime = lowTime + (highTime - lowTime) / 2;
+
+				localtime_r(&middleTime, &brokenDownTime);
+
+				if (brokenDownTime.tm_gmtoff == startOffset)
+				{
+					lowTime = middleTime;
+				}
+				else
+				{
+					highTime = middleTime;
+				}
+			}
+
+			transitions[numTransitions++] = highTime;
+		}
+	}
+
+
+	return numTransitions;
+}
+
+
+/*---------------------------------------------------------*/
+
+void checkAround(time_t centreTime, int currentYear)
+{
+	for (time_t offset = -SECONDS_PER_DAY;
+	     offset <= SECONDS_PER_DAY; offset += 60)
+	{
+		checkTime(centreTime + offset, currentYear);
+	}
+
+	for (time_t offset = -120; offset <= 120; offset++)
+	{
+		checkTime(centreTime + offset, currentYear);
+	}
+}
+
+
+/*---------------------------------------------------------*/
+
+void checkTime(time_t givenTime, int currentYear)
+{
+
+	char dateString[DATE_STRING_SIZE];
+
+	char expectedString[DATE_STRING_SIZE];
+
+
+
+	convertTimeToDateString(dateString, givenTime);
+
+	legacyConvertTimeToDateString(expectedString, givenTime,
+				      currentYear);
+
+	numChecked++;
+
+
+	if (strcmp(dateString, expectedString) != 0)
+	{
+		if (numMismatches < MAX_REPORTED_MISMATCHES)
+		{
+			printf("TZ=%s time %lld: '%s', expected '%s'\n",
+			       getenv("TZ"), (long long) givenTime,
+			       dateString, expectedString);
+		}
+
+		numMismatches++;
+	}
+}
+
+
+/*---------------------------------------------------------*/
+
+time_t getYearStart(int year)
+{
+	struct tm brokenDownTime;
+
+
+	memset(&brokenDownTime, 0, sizeof(brokenDownTime));
+
+	brokenDownTime.tm_year = year - 1900;
+
+	brokenDownTime.tm_mday = 1;
+
+	brokenDownTime.tm_isdst = -1;
+
+	return mktime(&brokenDownTime);
+}
+
+
+/*---------------------------------------------------------*/
+
+void legacyConvertTimeToDateString(char * dateString,
+				   time_t givenTime, int currentYear)
+{
+
+	struct  tm givenBrokenDownTime;
+
+	char givenMonthString[4];
+
+
+
+	if (localtime_r(&givenTime, &givenBrokenDownTime) == NULL)
+	{
+		strcpy(dateString, "N/A");
+
+		return;
+	}
+
+	getMonthString(givenMonthString, givenBrokenDownTime.tm_mon);
+
+
+	if (currentYear == 1900 + givenBrokenDownTime.tm_year)
+	{
+		snprintf(dateString, DATE_STRING_SIZE,
+			 "%3s %2d %02d:%02d",
+			 givenMonthString, givenBrokenDownTime.tm_mday,
+			 givenBrokenDownTime.tm_hour,
+			 givenBrokenDownTime.tm_min);
+	}
+	else
+	{
+		snprintf(dateString, DATE_STRING_SIZE,
+			 "%3s %2d %5d",
+			 givenMonthString, givenBrokenDownTime.tm_mday,
+			 1900 + givenBrokenDownTime.tm_year);
+	}
+}
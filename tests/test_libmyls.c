@@ -0,0 +1,564 @@
+/***********************************
+*
+* File name: tests/test_libmyls.c
+*
+* Aim: Check libmyls from the outside, as a
+*      program linked with libmyls.a: that a
+*      listing returns every entry of a
+*      directory once, across many batches,
+*      with the metadata fstatat() gives, in
+*      the same order with MYLS_INODE_ORDER
+*      and from two threads at once, and that
+*      its errors and early stops behave as
+*      libmyls.h describes. It also defines a
+*      function named as one of myls, which
+*      libmyls.a must keep to itself for the
+*      program to link
+*
+* Build: gcc -O2 -pthread -o test_libmyls tests/test_libmyls.c libmyls.a
+*
+* Usage: ./test_libmyls
+*
+***********************************/
+
+
+#define _GNU_SOURCE
+
+
+//For errno
+#include <errno.h>
+
+
+//For open()
+#include <fcntl.h>
+
+
+//For pthread_create(), pthread_join()
+#include <pthread.h>
+
+
+//For getpwuid()
+#include <pwd.h>
+
+
+//For printf(), snprintf()
+#include <stdio.h>
+
+
+//For malloc(), free(), mkdtemp(), system()
+#include <stdlib.h>
+
+
+//For strcmp(), strdup()
+#include <string.h>
+
+
+//For fstatat(), mkdirat()
+#include <sys/stat.h>
+
+
+//For close(), symlinkat(), linkat(), ftruncate()
+#include <unistd.h>
+
+
+#include "../libmyls.h"
+
+
+
+
+//Numbered files made, enough for many batches
+#define NUM_NUMBERED_FILES 2000
+
+//Entries made besides the numbered files
+#define NUM_OTHER_ENTRIES 5
+
+#define NUM_ENTRIES (NUM_NUMBERED_FILES + NUM_OTHER_ENTRIES)
+
+//Entries after which the callback stops the
+// listing early
+#define STOP_AFTER 10
+
+
+
+	/*------------------------------------------------
+	 The entries of one listing, copied out of
+	 its batches
+	------------------------------------------------*/
+struct ListedEntries
+{
+	char * names[NUM_ENTRIES + 1];
+
+	struct MylsEntry entries[NUM_ENTRIES + 1];
+
+	int numEntries;
+
+	unsigned int flags;
+
+	int failed;
+};
+
+
+//Directory listed, and its fd for fstatat()
+static char dirPath[] = "/tmp/myls-test_libmyls.XXXXXX";
+
+static int dirFd;
+
+static int numFailures = 0;
+
+
+
+
+	/*------------------------------------------------
+	 Brief: Counts a failed check and reports it
+	------------------------------------------------*/
+void checkThat(int condition, const char * description);
+
+
+	/*------------------------------------------------
+	 Brief: Makes the entries of the directory
+		listed. Returns 0 on success, -1 on
+		failure
+	------------------------------------------------*/
+int makeEntries();
+
+
+	/*------------------------------------------------
+	 Brief: Lists the directory into
+		'listedEntries', with its flags. Run as
+		a thread too
+	------------------------------------------------*/
+void * listEntries(void * listedEntries);
+
+
+	/*------------------------------------------------
+	 Brief: Checks every entry of 'listedEntries'
+		against fstatat(), and that none is
+		listed twice
+	------------------------------------------------*/
+void checkEntries(const struct ListedEntries * listedEntries);
+
+
+	/*------------------------------------------------
+	 Brief: Callback of mylsForEachEntry(), which
+		counts the entries in 'userData' and
+		stops after STOP_AFTER of them
+	------------------------------------------------*/
+int countEntries(const struct MylsEntry * entry, void * userData);
+
+
+	/*------------------------------------------------
+	 Brief: Frees the names of 'listedEntries'
+	------------------------------------------------*/
+void freeEntries(struct ListedEntries * listedEntries);
+
+
+	/*------------------------------------------------
+	 Brief: Prints how the test is run. myls has a
+		printUsage() of its own
+	------------------------------------------------*/
+void printUsage();
+
+
+
+
+int main(int argc, char * argv[])
+{
+
+	/*=============================================
+	 SECTION 1: Declaration of variables
+	==============================================*/
+
+	static struct ListedEntries firstListing;
+
+	static struct ListedEntries inodeOrderListing;
+
+	static struct ListedEntries threadListings[2];
+
+	pthread_t threads[2];
+
+	struct passwd * userEntry = NULL;
+
+	char command[sizeof(dirPath) + 16];
+
+	int numCounted = 0;
+
+	int sameOrder;
+
+
+
+	/*=============================================
+	 SECTION 2: Making the directory
+	==============================================*/
+	(void) argv;
+
+	if (argc > 1)
+	{
+		printUsage();
+
+		return 1;
+	}
+
+	if (mkdtemp(dirPath) == NULL
+	    || (dirFd = open(dirPath, O_RDONLY | O_DIRECTORY)) == -1
+	    || makeEntries() == -1)
+	{
+		perror("test_libmyls");
+
+		return 1;
+	}
+
+
+
+	/*=============================================
+	 SECTION 3: Listing it in directory order and
+		    in inode order
+	==============================================*/
+	firstListing.flags = 0;
+
+	listEntries(&firstListing);
+
+	checkThat(!firstListing.failed, "listing in directory order");
+
+	checkEntries(&firstListing);
+
+
+	inodeOrderListing.flags = MYLS_INODE_ORDER;
+
+	listEntries(&inodeOrderListing);
+
+	checkThat(!inodeOrderListing.failed, "listing in inode order");
+
+	sameOrder = (inodeOrderListing.numEntries
+		     == firstListing.numEntries);
+
+	for (int index = 0; sameOrder
+			    && index < firstListing.numEntries; index++)
+	{
+		sameOrder = strcmp(firstListing.names[index],
+				   inodeOrderListing.names[index]) == 0;
+	}
+
+	checkThat(sameOrder, "MYLS_INODE_ORDER keeps directory order");
+
+
+
+	/*=============================================
+	 SECTION 4: Two listings at once, from two
+		    threads
+	==============================================*/
+	for (int index = 0; index < 2; index++)
+	{
+		threadListings[index].flags = (index == 0)
+					      ? 0 : MYLS_INODE_ORDER;
+
+		if (pthread_create(&threads[index], NULL, listEntries,
+				   &threadListings[index]) != 0)
+		{
+			perror("test_libmyls");
+
+			return 1;
+		}
+	}
+
+	for (int index = 0; index < 2; index++)
+	{
+		pthread_join(threads[index], NULL);
+
+		checkThat(!threadListings[index].failed,
+			  "listing from a thread");
+
+		checkEntries(&threadListings[index]);
+
+		freeEntries(&threadListings[index]);
+	}
+
+
+
+	/*=============================================
+	 SECTION 5: Stopping early, errors and names
+	==============================================*/
+	checkThat(mylsForEachEntry(dirPath, 0, countEntries,
+				   &numCounted) == 0
+		  && numCounted == STOP_AFTER,
+		  "mylsForEachEntry() stops when told to");
+
+	errno = 0;
+
+	checkThat(mylsOpenListing("/nonexistent/myls-test", 0) == NULL
+		  && errno == ENOENT,
+		  "opening a missing directory fails with ENOENT");
+
+	errno = 0;
+
+	checkThat(mylsForEachEntry("/nonexistent/myls-test", 0,
+				   countEntries, &numCounted) == -1
+		  && errno == ENOENT,
+		  "mylsForEachEntry() on a missing directory fails");
+
+	userEntry = getpwuid(getuid());
+
+	checkThat(strcmp(mylsUserName(getuid()),
+			 (userEntry != NULL) ? userEntry->pw_name
+					     : "Not Available") == 0,
+		  "mylsUserName() names the current user");
+
+
+
+	/*=============================================
+	 SECTION 6: Cleaning up and reporting
+	==============================================*/
+	freeEntries(&firstListing);
+
+	freeEntries(&inodeOrderListing);
+
+	close(dirFd);
+
+	snprintf(command, sizeof(command), "rm -rf '%s'", dirPath);
+
+	if (system(command) != 0)
+	{
+		fprintf(stderr, "test_libmyls: Cannot remove '%s'\n",
+			dirPath);
+	}
+
+
+	printf("test_libmyls: %s\n", (numFailures == 0) ? "ok" : "FAILED");
+
+	return numFailures == 0 ? 0 : 1;
+}
+
+
+/*---------------------------------------------------------*/
+
+void checkThat(int condition, const char * description)
+{
+	if (!condition)
+	{
+		fprintf(stderr, "test_libmyls: FAILED: %s\n", description);
+
+		numFailures++;
+	}
+}
+
+
+/*---------------------------------------------------------*/
+
+int makeEntries()
+{
+
+	char name[32];
+
+	int fileFd;
+
+
+
+	//The numbered files are made in reverse, so
+	// that names and inodes are in different
+	// orders
+	for (int index = NUM_NUMBERED_FILES; index > 0; index--)
+	{
+		snprintf(name, sizeof(name), "file%04d", index);
+
+		fileFd = openat(dirFd, name, O_WRONLY | O_CREAT | O_EXCL,
+				0640);
+
+		if (fileFd == -1
+		    || ftruncate(fileFd, index) == -1)
+		{
+			return -1;
+		}
+
+		close(fileFd);
+	}
+
+
+	fileFd = openat(dirFd, "sparse", O_WRONLY | O_CREAT | O_EXCL,
+			0600);
+
+	if (fileFd == -1
+	    || ftruncate(fileFd, 1 << 30) == -1)
+	{
+		return -1;
+	}
+
+	close(fileFd);
+
+
+	if (mkdirat(dirFd, "subdir", 0755) == -1
+	    || symlinkat("file0001", dirFd, "link") == -1
+	    || linkat(dirFd, "file0002", dirFd, "hardlink", 0) == -1
+	    || mkfifoat(dirFd, "fifo", 0600) == -1)
+	{
+		return -1;
+	}
+
+
+	return 0;
+}
+
+
+/*---------------------------------------------------------*/
+
+void * listEntries(void * listedEntriesPtr)
+{
+
+	struct ListedEntries * listedEntries = listedEntriesPtr;
+
+	struct MylsListing * listing = NULL;
+
+	const struct MylsEntry * entries = NULL;
+
+	long numEntries;
+
+
+
+	listing = mylsOpenListing(dirPath, listedEntries->flags);
+
+	if (listing == NULL)
+	{
+		listedEntries->failed = 1;
+
+		return NULL;
+	}
+
+
+	while ((numEntries = mylsReadEntries(listing, &entries)) > 0)
+	{
+		for (long index = 0; index < numEntries; index++)
+		{
+			//More entries than made is a failure
+			// of its own
+			if (listedEntries->numEntries > NUM_ENTRIES)
+			{
+				listedEntries->failed = 1;
+
+				break;
+			}
+
+			listedEntries->entries[listedEntries->numEntries]
+				= entries[index];
+
+			listedEntries->names[listedEntries->numEntries++]
+				= strdup(entries[index].name);
+		}
+	}
+
+	if (numEntries == -1)
+	{
+		listedEntries->failed = 1;
+	}
+
+	mylsCloseListing(listing);
+
+
+	return NULL;
+}
+
+
+/*---------------------------------------------------------*/
+
+void checkEntries(const struct ListedEntries * listedEntries)
+{
+
+	const struct MylsEntry * entryPtr = NULL;
+
+	struct stat statBuf;
+
+	char * seen = NULL;
+
+	int numNumbered = 0;
+
+	int numMismatches = 0;
+
+	int fileNumber;
+
+
+
+	checkThat(listedEntries->numEntries == NUM_ENTRIES,
+		  "every entry is listed");
+
+	seen = calloc(NUM_NUMBERED_FILES + 1, 1);
+
+	if (seen == NULL)
+	{
+		checkThat(0, "memory for the check");
+
+		return;
+	}
+
+
+	for (int index = 0; index < listedEntries->numEntries; index++)
+	{
+		entryPtr = &listedEntries->entries[index];
+
+		if (fstatat(dirFd, listedEntries->names[index], &statBuf,
+			    AT_SYMLINK_NOFOLLOW) == -1
+		    || entryPtr->errorNumber != 0
+		    || entryPtr->mode != statBuf.st_mode
+		    || entryPtr->size != (uint64_t) statBuf.st_size
+		    || entryPtr->inode != statBuf.st_ino
+		    || entryPtr->numLinks != statBuf.st_nlink
+		    || entryPtr->userId != statBuf.st_uid
+		    || entryPtr->groupId != statBuf.st_gid
+		    || entryPtr->modTime != statBuf.st_mtim.tv_sec
+		    || entryPtr->modNanoseconds
+		       != (uint32_t) statBuf.st_mtim.tv_nsec)
+		{
+			numMismatches++;
+		}
+
+		if (sscanf(listedEntries->names[index], "file%d",
+			   &fileNumber) == 1
+		    && fileNumber > 0 && fileNumber <= NUM_NUMBERED_FILES
+		    && !seen[fileNumber])
+		{
+			seen[fileNumber] = 1;
+
+			numNumbered++;
+		}
+	}
+
+	free(seen);
+
+
+	checkThat(numMismatches == 0, "entries match fstatat()");
+
+	checkThat(numNumbered == NUM_NUMBERED_FILES,
+		  "every numbered file is listed once");
+}
+
+
+/*---------------------------------------------------------*/
+
+int countEntries(const struct MylsEntry * entry, void * userData)
+{
+	int * numCounted = userData;
+
+	(void) entry;
+
+
+	(*numCounted)++;
+
+	return *numCounted >= STOP_AFTER;
+}
+
+
+/*---------------------------------------------------------*/
+
+void freeEntries(struct ListedEntries * listedEntries)
+{
+	for (int index = 0; index < listedEntries->numEntries; index++)
+	{
+		free(listedEntries->names[index]);
+	}
+
+	listedEntries->numEntries = 0;
+}
+
+
+/*---------------------------------------------------------*/
+
+void printUsage()
+{
+	fprintf(stderr, "Usage: ./test_libmyls\n");
+}